@@ -0,0 +1,162 @@
+/*
+ * Batch operations on arrays of ApInt values
+ * Function implementations
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "apint.h"
+#include "apbatch.h"
+#include "apthread.h"
+#include "apstats.h"
+
+#define BATCH_BLOCK 64 //elements per block
+#define BATCH_PARALLEL_MIN 4096 //fewer elements are not worth forking for
+
+typedef enum { BATCH_ADD, BATCH_SUB, BATCH_COMPARE, BATCH_NEGATE, BATCH_FORMAT } BatchOp;
+
+typedef struct {
+	BatchOp op;
+	void *results;
+	ApInt *const *a;
+	ApInt *const *b;
+} BatchJob;
+
+/* 
+ * a + b when bflags is b's sign, a - b when it is the opposite sign
+ * Works on the limbs directly: one allocation, one pass
+ */
+static ApInt *add_signed(const ApInt *a, const ApInt *b, uint32_t bflags) {
+	size_t an = limbs_normalized_len(a->data, a->len);
+	size_t bn = limbs_normalized_len(b->data, b->len);
+	uint32_t aflags = a->flags;
+	const uint64_t *ap = a->data, *bp = b->data;
+
+	if (aflags == bflags) { //same signs, magnitudes add
+		if (an < bn) {
+			const uint64_t *tp = ap;
+			size_t tn = an;
+			ap = bp; an = bn;
+			bp = tp; bn = tn;
+		}
+		uint64_t *sum = (uint64_t *)malloc((an + 1) * sizeof(uint64_t));
+		assert(sum != NULL); //check memory allocation
+		sum[an] = limbs_add(sum, ap, an, bp, bn);
+		return apint_wrap_limbs(sum, an + 1, aflags);
+	}
+
+	//opposite signs, result takes the sign of the larger magnitude
+	int cmp = (an != bn) ? ((an > bn) ? 1 : -1) : limbs_cmp(ap, bp, an);
+	if (cmp < 0) {
+		const uint64_t *tp = ap;
+		size_t tn = an;
+		ap = bp; an = bn;
+		bp = tp; bn = tn;
+		aflags = bflags;
+	}
+	uint64_t *diff = (uint64_t *)malloc((an > 0 ? an : 1) * sizeof(uint64_t));
+	assert(diff != NULL); //check memory allocation
+	limbs_sub(diff, ap, an, bp, bn);
+	return apint_wrap_limbs(diff, an, aflags);
+}
+
+/* 
+ * Same ordering as apint_compare, with lengths normalized first
+ */
+static int compare_one(const ApInt *left, const ApInt *right) {
+	size_t ln = limbs_normalized_len(left->data, left->len);
+	size_t rn = limbs_normalized_len(right->data, right->len);
+	int lsign = (ln == 0) ? 0 : (left->flags ? 1 : -1);
+	int rsign = (rn == 0) ? 0 : (right->flags ? 1 : -1);
+	if (lsign != rsign) {
+		return (lsign > rsign) ? 1 : -1;
+	}
+	int mag = (ln != rn) ? ((ln > rn) ? 1 : -1) : limbs_cmp(left->data, right->data, ln);
+	return (lsign < 0) ? -mag : mag;
+}
+
+/* 
+ * Processes elements [lo, hi) of a job one block at a time,
+ * prefetching the next block's operand headers while working
+ */
+static void batch_range(void *arg, size_t lo, size_t hi) {
+	BatchJob *job = (BatchJob *)arg;
+	for (size_t block = lo; block < hi; block += BATCH_BLOCK) {
+		size_t end = (hi - block < BATCH_BLOCK) ? hi : block + BATCH_BLOCK;
+		for (size_t i = end; i < hi && i < end + BATCH_BLOCK; i++) {
+			__builtin_prefetch(job->a[i]);
+			if (job->b != NULL) {
+				__builtin_prefetch(job->b[i]);
+			}
+		}
+		for (size_t i = block; i < end; i++) {
+			switch (job->op) {
+				case BATCH_ADD:
+					((ApInt **)job->results)[i] = add_signed(job->a[i], job->b[i], job->b[i]->flags);
+					break;
+				case BATCH_SUB:
+					((ApInt **)job->results)[i] = add_signed(job->a[i], job->b[i], job->b[i]->flags ^ 1);
+					break;
+				case BATCH_COMPARE:
+					((int *)job->results)[i] = compare_one(job->a[i], job->b[i]);
+					break;
+				case BATCH_NEGATE:
+					((ApInt **)job->results)[i] = apint_negate(job->a[i]);
+					break;
+				case BATCH_FORMAT:
+					((char **)job->results)[i] = apint_format_as_hex(job->a[i]);
+					break;
+			}
+		}
+	}
+}
+
+static void run_batch(BatchJob *job, size_t n) {
+	if (apint_threads_active() && n >= BATCH_PARALLEL_MIN) {
+		size_t chunk = n / (4 * apint_threads_count()); //a few chunks per thread for stealing
+		apint_parallel_for(n, (chunk > BATCH_BLOCK) ? chunk : BATCH_BLOCK, batch_range, job);
+	} else {
+		batch_range(job, 0, n);
+	}
+}
+
+/* 
+ * results[i] = a[i] + b[i]
+ */
+void apint_add_batch(ApInt **results, ApInt *const *a, ApInt *const *b, size_t n) {
+	BatchJob job = { BATCH_ADD, results, a, b };
+	run_batch(&job, n);
+}
+
+/* 
+ * results[i] = a[i] - b[i]
+ */
+void apint_sub_batch(ApInt **results, ApInt *const *a, ApInt *const *b, size_t n) {
+	BatchJob job = { BATCH_SUB, results, a, b };
+	run_batch(&job, n);
+}
+
+/* 
+ * results[i] = apint_compare(left[i], right[i]) (1, 0 or -1)
+ */
+void apint_compare_batch(int *results, ApInt *const *left, ApInt *const *right, size_t n) {
+	BatchJob job = { BATCH_COMPARE, results, left, right };
+	run_batch(&job, n);
+}
+
+/* 
+ * results[i] = -a[i]
+ */
+void apint_negate_batch(ApInt **results, ApInt *const *a, size_t n) {
+	BatchJob job = { BATCH_NEGATE, results, a, NULL };
+	run_batch(&job, n);
+}
+
+/* 
+ * results[i] = apint_format_as_hex(a[i])
+ */
+void apint_format_as_hex_batch(char **results, ApInt *const *a, size_t n) {
+	BatchJob job = { BATCH_FORMAT, results, a, NULL };
+	run_batch(&job, n);
+}
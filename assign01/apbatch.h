@@ -0,0 +1,31 @@
+/*
+ * Batch operations on arrays of ApInt values
+ *
+ * Element i of every output array is computed from element i of the
+ * input arrays. Work is done in blocks of consecutive elements, and the
+ * blocks are spread over the thread pool (see apthread.h) when it is
+ * running. Results are ordinary ApInt values / strings, freed one by
+ * one with apint_destroy / free.
+ */
+
+#ifndef APBATCH_H
+#define APBATCH_H
+
+#include <stddef.h>
+#include "apint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void apint_add_batch(ApInt **results, ApInt *const *a, ApInt *const *b, size_t n);
+void apint_sub_batch(ApInt **results, ApInt *const *a, ApInt *const *b, size_t n);
+void apint_compare_batch(int *results, ApInt *const *left, ApInt *const *right, size_t n);
+void apint_negate_batch(ApInt **results, ApInt *const *a, size_t n);
+void apint_format_as_hex_batch(char **results, ApInt *const *a, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APBATCH_H */
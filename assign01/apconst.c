@@ -0,0 +1,266 @@
+/*
+ * Constants by binary splitting
+ * Function implementations
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "apint.h"
+#include "apthread.h"
+#include "apfloat.h"
+#include "apconst.h"
+#include "apstats.h"
+
+#define SPLIT_TASK_TERMS 64 //ranges from this many terms split onto the pool
+#define CONST_GUARD_BITS 32
+
+#define CHUDNOVSKY_A 13591409UL
+#define CHUDNOVSKY_B 545140134UL
+#define CHUDNOVSKY_C3_24 10939058860032000UL //640320^3 / 24
+#define CHUDNOVSKY_BITS_PER_TERM 47.11        //log2(640320^3 / 1728)
+
+/*
+ * P, Q, B and T of a range; p is only kept when the caller needs it and
+ * b is NULL when it is 1
+ */
+typedef struct {
+	ApInt *p, *q, *b, *t;
+} Split;
+
+typedef struct {
+	ApSeriesFn fn;
+	uint64_t lo, hi;
+	int need_p;
+	Split s;
+} SplitTask;
+
+static void split_range(ApSeriesFn fn, uint64_t lo, uint64_t hi, int need_p, Split *s);
+
+static void split_task(void *arg) {
+	SplitTask *task = (SplitTask *)arg;
+	split_range(task->fn, task->lo, task->hi, task->need_p, &task->s);
+}
+
+static void split_leaf(ApSeriesFn fn, uint64_t n, int need_p, Split *s) {
+	ApSeriesTerm term;
+	memset(&term, 0, sizeof(term));
+	term.a = 1;
+	term.b = 1;
+	fn(n, &term);
+	assert(term.np <= APSERIES_FACTORS && term.nq <= APSERIES_FACTORS);
+	ApInt *p = apint_product_u64(term.p, term.np);
+	if (term.p_neg && !apint_is_zero(p)) {
+		p->flags = 0;
+	}
+	s->q = apint_product_u64(term.q, term.nq);
+	s->b = (term.b == 1) ? NULL : apint_create_from_u64(term.b);
+	s->t = apint_mul_u64(p, term.a);
+	if (need_p) {
+		s->p = p;
+	} else {
+		s->p = NULL;
+		apint_destroy(p);
+	}
+}
+
+/*
+ * Terms lo .. hi-1; a left half always needs its P for the merge, a
+ * right half only when the whole range does
+ */
+static void split_range(ApSeriesFn fn, uint64_t lo, uint64_t hi, int need_p, Split *s) {
+	if (hi - lo == 1) {
+		split_leaf(fn, lo, need_p, s);
+		return;
+	}
+	uint64_t mid = lo + (hi - lo) / 2;
+	Split l, r;
+	if (apint_threads_active() && hi - lo >= SPLIT_TASK_TERMS) {
+		SplitTask task = { fn, lo, mid, 1, { NULL, NULL, NULL, NULL } };
+		ApTaskGroup g;
+		ApTask t;
+		apint_task_group_init(&g);
+		apint_task_spawn(&g, &t, split_task, &task);
+		split_range(fn, mid, hi, need_p, &r);
+		apint_task_wait(&g);
+		l = task.s;
+	} else {
+		split_range(fn, lo, mid, 1, &l);
+		split_range(fn, mid, hi, need_p, &r);
+	}
+
+	//T = Br Qr Tl + Bl Pl Tr
+	ApInt *left = apint_mul(l.t, r.q);
+	if (r.b != NULL) {
+		ApInt *tmp = apint_mul(left, r.b);
+		apint_destroy(left);
+		left = tmp;
+	}
+	ApInt *right = r.t;
+	if (l.b != NULL) {
+		right = apint_mul(r.t, l.b);
+		apint_destroy(r.t);
+	}
+	apint_addmul(left, l.p, right);
+	apint_destroy(right);
+	apint_destroy(l.t);
+	s->t = left;
+
+	s->q = apint_mul(l.q, r.q);
+	apint_destroy(l.q);
+	apint_destroy(r.q);
+	if (l.b != NULL && r.b != NULL) {
+		s->b = apint_mul(l.b, r.b);
+		apint_destroy(l.b);
+		apint_destroy(r.b);
+	} else {
+		s->b = (l.b != NULL) ? l.b : r.b;
+	}
+	s->p = need_p ? apint_mul(l.p, r.p) : NULL;
+	apint_destroy(l.p);
+	if (r.p != NULL) {
+		apint_destroy(r.p);
+	}
+}
+
+static void split_destroy(Split *s) {
+	apint_destroy(s->q);
+	apint_destroy(s->t);
+	if (s->b != NULL) {
+		apint_destroy(s->b);
+	}
+	if (s->p != NULL) {
+		apint_destroy(s->p);
+	}
+}
+
+static size_t bits_of(const ApInt *ap) {
+	size_t n = limbs_normalized_len(ap->data, ap->len);
+	return (n == 0) ? 1 : 64 * n - (size_t) __builtin_clzl(ap->data[n - 1]);
+}
+
+/*
+ * T / (B Q), computed by the exact operands so only the quotient rounds
+ */
+ApFloat *apint_series_sum(ApSeriesFn fn, uint64_t n, size_t prec) {
+	APINT_STATS_OP(AP_OP_SERIES, prec / 64);
+	if (n == 0) {
+		ApInt *zero = apint_create_from_u64(0UL);
+		ApFloat *f = apint_float_from_apint(zero, prec, AP_ROUND_NEAREST);
+		apint_destroy(zero);
+		return f;
+	}
+	Split s;
+	split_range(fn, 0, n, 0, &s);
+	ApInt *den = (s.b != NULL) ? apint_mul(s.b, s.q) : apint_copy(s.q);
+	ApFloat *t = apint_float_from_apint(s.t, bits_of(s.t), AP_ROUND_NEAREST);
+	ApFloat *d = apint_float_from_apint(den, bits_of(den), AP_ROUND_NEAREST);
+	ApFloat *sum = apint_float_div(t, d, prec, AP_ROUND_NEAREST);
+	apint_float_destroy(t);
+	apint_float_destroy(d);
+	apint_destroy(den);
+	split_destroy(&s);
+	return sum;
+}
+
+/*
+ * Chudnovsky: 1 / pi = 12 / 640320^(3/2) * sum over n of
+ *   (-1)^n (6n)! (A + B n) / ((3n)! n!^3 640320^(3n))
+ * where the ratio of consecutive terms is
+ *   -(6n-5)(2n-1)(6n-1) / (n^3 640320^3 / 24)
+ */
+static void chudnovsky_term(uint64_t n, ApSeriesTerm *term) {
+	term->a = CHUDNOVSKY_A + CHUDNOVSKY_B * n;
+	if (n == 0) {
+		return;
+	}
+	term->p[0] = 6 * n - 5;
+	term->p[1] = 2 * n - 1;
+	term->p[2] = 6 * n - 1;
+	term->np = 3;
+	term->p_neg = 1;
+	term->q[0] = n;
+	term->q[1] = n;
+	term->q[2] = n;
+	term->q[3] = CHUDNOVSKY_C3_24;
+	term->nq = 4;
+}
+
+/*
+ * pi = 426880 sqrt(10005) Q / T, as the series has B = 1
+ */
+ApFloat *apint_const_pi(size_t prec) {
+	APINT_STATS_OP(AP_OP_SERIES, prec / 64);
+	size_t wp = prec + CONST_GUARD_BITS;
+	Split s;
+	split_range(chudnovsky_term, 0, (uint64_t) (wp / CHUDNOVSKY_BITS_PER_TERM) + 2, 0, &s);
+
+	ApInt *c = apint_create_from_u64(10005UL);
+	ApFloat *cf = apint_float_from_apint(c, wp, AP_ROUND_NEAREST);
+	ApFloat *root = apint_float_sqrt(cf, wp, AP_ROUND_NEAREST);
+	ApInt *q = apint_mul_u64(s.q, 426880UL);
+	ApFloat *qf = apint_float_from_apint(q, wp, AP_ROUND_NEAREST);
+	ApFloat *num = apint_float_mul(root, qf, wp, AP_ROUND_NEAREST);
+	ApFloat *tf = apint_float_from_apint(s.t, wp, AP_ROUND_NEAREST);
+	ApFloat *pi = apint_float_div(num, tf, wp, AP_ROUND_NEAREST);
+	ApFloat *result = apint_float_round(pi, prec, AP_ROUND_NEAREST);
+
+	apint_destroy(c);
+	apint_destroy(q);
+	apint_float_destroy(cf);
+	apint_float_destroy(root);
+	apint_float_destroy(qf);
+	apint_float_destroy(num);
+	apint_float_destroy(tf);
+	apint_float_destroy(pi);
+	split_destroy(&s);
+	return result;
+}
+
+/*
+ * e = sum over n of 1 / n!
+ */
+static void e_term(uint64_t n, ApSeriesTerm *term) {
+	if (n > 0) {
+		term->q[0] = n;
+		term->nq = 1;
+	}
+}
+
+ApFloat *apint_const_e(size_t prec) {
+	size_t wp = prec + CONST_GUARD_BITS;
+	uint64_t n = 1;
+	double log2_fact = 0.0;
+	while (log2_fact < (double) wp + 2.0) { //the terms from n on add less than 2 / n!
+		log2_fact += log2((double) n);
+		n++;
+	}
+	ApFloat *sum = apint_series_sum(e_term, n, wp);
+	ApFloat *result = apint_float_round(sum, prec, AP_ROUND_NEAREST);
+	apint_float_destroy(sum);
+	return result;
+}
+
+/*
+ * log 2 = -log(1 - 1/2) = 2 atanh(1/3) = sum over n of 2 / (3 (2n+1) 9^n)
+ */
+static void ln2_term(uint64_t n, ApSeriesTerm *term) {
+	if (n == 0) {
+		term->p[0] = 2;
+		term->np = 1;
+		term->q[0] = 3;
+	} else {
+		term->q[0] = 9;
+	}
+	term->nq = 1;
+	term->b = 2 * n + 1;
+}
+
+ApFloat *apint_const_ln2(size_t prec) {
+	size_t wp = prec + CONST_GUARD_BITS;
+	ApFloat *sum = apint_series_sum(ln2_term, (uint64_t) (wp / 3) + 2, wp); //terms shrink by 9 > 2^3
+	ApFloat *result = apint_float_round(sum, prec, AP_ROUND_NEAREST);
+	apint_float_destroy(sum);
+	return result;
+}
@@ -0,0 +1,59 @@
+/*
+ * Constants by binary splitting
+ *
+ * A hypergeometric-like series sum over n < N of
+ *   a(n) / b(n) * p(0) ... p(n) / (q(0) ... q(n))
+ * with small integer a, b, p and q is the fraction T / (B Q) of
+ * integers built up pairwise over halves of the range [0, N):
+ *   P = Pl Pr, Q = Ql Qr, B = Bl Br, T = Br Qr Tl + Bl Pl Tr
+ * so that the whole sum costs a few multiplications of numbers the size
+ * of the result instead of N divisions at full precision. Both halves
+ * are independent and run as pool tasks when the pool is active. A
+ * term's p, q are given as products of up to APSERIES_FACTORS 64-bit
+ * factors (multiplied by apint_product_u64), p with a sign.
+ *
+ * The constants are within an ulp of the exact value at prec bits.
+ */
+
+#ifndef APCONST_H
+#define APCONST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "apint.h"
+#include "apfloat.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APSERIES_FACTORS 4
+
+typedef struct {
+	uint64_t p[APSERIES_FACTORS]; //p(n) = -p[0] ... p[np-1] if p_neg
+	size_t np;
+	int p_neg;
+	uint64_t q[APSERIES_FACTORS]; //q(n) = q[0] ... q[nq-1]
+	size_t nq;
+	uint64_t a;
+	uint64_t b;
+} ApSeriesTerm;
+
+/*
+ * Fills in term n; the term starts out as p = q = a = b = 1
+ */
+typedef void (*ApSeriesFn)(uint64_t n, ApSeriesTerm *term);
+
+/* Sum of terms 0 .. n-1 rounded to nearest at prec bits */
+ApFloat *apint_series_sum(ApSeriesFn fn, uint64_t n, size_t prec);
+
+/* Constants rounded to prec bits */
+ApFloat *apint_const_pi(size_t prec);
+ApFloat *apint_const_e(size_t prec);
+ApFloat *apint_const_ln2(size_t prec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APCONST_H */
@@ -0,0 +1,422 @@
+/*
+ * Run-time CPU dispatch for the limb kernels
+ * Function implementations
+ *
+ * The BMI2 tier runs the carry chains on adc/sbb with mulx for the
+ * products, and multiply-accumulate (also the fixed 4x4 and 8x8
+ * products) in assembly on two carry chains. The vector tiers add AVX2 /
+ * AVX-512 versions of the shifts and bitwise kernels, whose limbs are
+ * independent. Kernels without a faster version keep the one from the
+ * tier below.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "apint.h"
+#include "apcpu.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/* Generic until cpu_init runs, so the table is usable from any constructor */
+ApLimbKernels apint_kernels = {
+	limbs_add_n_generic, limbs_sub_n_generic, limbs_mul_1_generic,
+	limbs_addmul_1_generic, limbs_submul_1_generic, limbs_lshift_generic,
+	limbs_rshift_generic, limbs_and_n_generic, limbs_ior_n_generic,
+	limbs_xor_n_generic, limbs_mul_4x4_generic, limbs_mul_8x8_generic
+};
+
+static ApCpuTier cpu_tier = AP_CPU_GENERIC;
+
+static const char *const tier_names[] = { "generic", "bmi2", "avx2", "avx512" };
+
+#if defined(__x86_64__)
+/*
+ * BMI2 / ADX kernels
+ */
+__attribute__((target("bmi2,adx")))
+static uint64_t add_n_bmi2(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n) {
+	unsigned char c = 0;
+	unsigned long long r;
+	for (size_t i = 0; i < n; i++) {
+		c = _addcarry_u64(c, ap[i], bp[i], &r);
+		rp[i] = r;
+	}
+	return c;
+}
+
+__attribute__((target("bmi2,adx")))
+static uint64_t sub_n_bmi2(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n) {
+	unsigned char c = 0;
+	unsigned long long r;
+	for (size_t i = 0; i < n; i++) {
+		c = _subborrow_u64(c, ap[i], bp[i], &r);
+		rp[i] = r;
+	}
+	return c;
+}
+
+/*
+ * The high half of each product goes into the next limb through the
+ * carry flag chain instead of 128 bit adds
+ */
+__attribute__((target("bmi2,adx")))
+static uint64_t mul_1_bmi2(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b) {
+	unsigned char c = 0;
+	unsigned long long hi = 0, lo, r;
+	for (size_t i = 0; i < n; i++) {
+		unsigned long long prev = hi;
+		lo = _mulx_u64(ap[i], b, &hi);
+		c = _addcarry_u64(c, lo, prev, &r);
+		rp[i] = r;
+	}
+	return hi + c; //the product fits in n + 1 limbs
+}
+
+/*
+ * Multiply-accumulate in assembly: mulx leaves the flags alone, adcx
+ * carries only through CF and adox only through OF, so the product chain
+ * (low half + previous high half) and the accumulation chain into rp run
+ * interleaved without saving flags. Loop control uses lea and jrcxz,
+ * which do not touch flags either. Steps alternate the register that
+ * holds the previous high half.
+ */
+#define MAC_STEP_A(off, acc) \
+	"mulx " off "(%[ap]), %[t0], %[t1]\n\t" \
+	"adcx %[hi], %[t0]\n\t" \
+	acc \
+	"mov %[t0], " off "(%[rp])\n\t"
+#define MAC_STEP_B(off, acc) \
+	"mulx " off "(%[ap]), %[t0], %[hi]\n\t" \
+	"adcx %[t1], %[t0]\n\t" \
+	acc \
+	"mov %[t0], " off "(%[rp])\n\t"
+
+/* rp + t through OF */
+#define MAC_ADD(off) "adox " off "(%[rp]), %[t0]\n\t"
+/* rp - t as rp + ~t + 1 through OF, which starts set */
+#define MAC_SUB(off) "not %[t0]\n\t" "adox " off "(%[rp]), %[t0]\n\t"
+
+#define MAC_LOOP(acc) \
+	"mov %[blocks], %%rcx\n" \
+	"1:\n\t" \
+	"jrcxz 2f\n\t" \
+	MAC_STEP_A("0", acc("0")) \
+	MAC_STEP_B("8", acc("8")) \
+	MAC_STEP_A("16", acc("16")) \
+	MAC_STEP_B("24", acc("24")) \
+	"lea 32(%[ap]), %[ap]\n\t" \
+	"lea 32(%[rp]), %[rp]\n\t" \
+	"lea -1(%%rcx), %%rcx\n\t" \
+	"jmp 1b\n" \
+	"2:\n\t" \
+	"mov %[rest], %%rcx\n" \
+	"3:\n\t" \
+	"jrcxz 4f\n\t" \
+	MAC_STEP_A("0", acc("0")) \
+	"mov %[t1], %[hi]\n\t" \
+	"lea 8(%[ap]), %[ap]\n\t" \
+	"lea 8(%[rp]), %[rp]\n\t" \
+	"lea -1(%%rcx), %%rcx\n\t" \
+	"jmp 3b\n" \
+	"4:\n\t"
+
+__attribute__((target("bmi2,adx")))
+static uint64_t addmul_1_adx(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b) {
+	uint64_t hi, t0, t1;
+	__asm__(
+		"xor %k[hi], %k[hi]\n\t" //clears CF and OF
+		MAC_LOOP(MAC_ADD)
+		"mov $0, %k[t0]\n\t"
+		"adcx %[t0], %[hi]\n\t"
+		"adox %[t0], %[hi]\n\t"
+		: [rp] "+&r" (rp), [ap] "+&r" (ap), [hi] "=&r" (hi), [t0] "=&r" (t0), [t1] "=&r" (t1)
+		: [blocks] "r" (n / 4), [rest] "r" (n % 4), "d" (b)
+		: "rcx", "cc", "memory");
+	return hi;
+}
+
+__attribute__((target("bmi2,adx")))
+static uint64_t submul_1_adx(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b) {
+	uint64_t hi, t0, t1;
+	__asm__(
+		"xor %k[hi], %k[hi]\n\t"
+		"mov $0x7fffffff, %k[t0]\n\t"
+		"add $1, %k[t0]\n\t" //OF = 1 (no borrow yet), CF = 0
+		MAC_LOOP(MAC_SUB)
+		"mov $0, %k[t0]\n\t"
+		"adcx %[t0], %[hi]\n\t"
+		"setno %b[t0]\n\t" //borrow out of rp is 1 - OF
+		"add %[t0], %[hi]\n\t"
+		: [rp] "+&r" (rp), [ap] "+&r" (ap), [hi] "=&r" (hi), [t0] "=&r" (t0), [t1] "=&r" (t1)
+		: [blocks] "r" (n / 4), [rest] "r" (n % 4), "d" (b)
+		: "rcx", "cc", "memory");
+	return hi;
+}
+
+/*
+ * rp[0..4) += ap[0..4) * b + carry, straight line; returns the carry out
+ */
+__attribute__((target("bmi2,adx")))
+static inline uint64_t addmul_4_adx(uint64_t *rp, const uint64_t *ap, uint64_t b, uint64_t carry) {
+	uint64_t hi, t0, t1;
+	__asm__(
+		"xor %k[t0], %k[t0]\n\t"
+		"mov %[carry], %[hi]\n\t"
+		MAC_STEP_A("0", MAC_ADD("0"))
+		MAC_STEP_B("8", MAC_ADD("8"))
+		MAC_STEP_A("16", MAC_ADD("16"))
+		MAC_STEP_B("24", MAC_ADD("24"))
+		"mov $0, %k[t0]\n\t"
+		"adcx %[t0], %[hi]\n\t"
+		"adox %[t0], %[hi]\n\t"
+		: [hi] "=&r" (hi), [t0] "=&r" (t0), [t1] "=&r" (t1)
+		: [rp] "r" (rp), [ap] "r" (ap), [carry] "r" (carry), "d" (b)
+		: "cc", "memory");
+	return hi;
+}
+
+/*
+ * Fixed size products: one unrolled row per limb of bp, no loops
+ */
+__attribute__((target("bmi2,adx")))
+static void mul_4x4_adx(uint64_t *rp, const uint64_t *ap, const uint64_t *bp) {
+	memset(rp, 0, 4 * sizeof(uint64_t));
+	for (int j = 0; j < 4; j++) {
+		rp[4 + j] = addmul_4_adx(rp + j, ap, bp[j], 0);
+	}
+}
+
+__attribute__((target("bmi2,adx")))
+static void mul_8x8_adx(uint64_t *rp, const uint64_t *ap, const uint64_t *bp) {
+	memset(rp, 0, 8 * sizeof(uint64_t));
+	for (int j = 0; j < 8; j++) {
+		uint64_t carry = addmul_4_adx(rp + j, ap, bp[j], 0);
+		rp[8 + j] = addmul_4_adx(rp + j + 4, ap + 4, bp[j], carry);
+	}
+}
+
+/*
+ * AVX2 kernels, 4 limbs per instruction
+ * The left shift runs from the top down and the right shift from the
+ * bottom up, loading each block before it is overwritten, so rp may be ap
+ */
+__attribute__((target("avx2")))
+static uint64_t lshift_avx2(uint64_t *rp, const uint64_t *ap, size_t n, unsigned s) {
+	uint64_t out = ap[n - 1] >> (64 - s);
+	const __m128i left = _mm_cvtsi32_si128((int) s);
+	const __m128i right = _mm_cvtsi32_si128((int) (64 - s));
+	size_t i = n; //limbs [i, n) are done
+	for (; i >= 5; i -= 4) {
+		__m256i hi = _mm256_loadu_si256((const __m256i *)(ap + i - 4));
+		__m256i lo = _mm256_loadu_si256((const __m256i *)(ap + i - 5));
+		hi = _mm256_or_si256(_mm256_sll_epi64(hi, left), _mm256_srl_epi64(lo, right));
+		_mm256_storeu_si256((__m256i *)(rp + i - 4), hi);
+	}
+	for (; i > 1; i--) {
+		rp[i - 1] = (ap[i - 1] << s) | (ap[i - 2] >> (64 - s));
+	}
+	rp[0] = ap[0] << s;
+	return out;
+}
+
+__attribute__((target("avx2")))
+static uint64_t rshift_avx2(uint64_t *rp, const uint64_t *ap, size_t n, unsigned s) {
+	uint64_t out = ap[0] << (64 - s);
+	const __m128i left = _mm_cvtsi32_si128((int) (64 - s));
+	const __m128i right = _mm_cvtsi32_si128((int) s);
+	size_t i = 0;
+	for (; i + 5 <= n; i += 4) {
+		__m256i lo = _mm256_loadu_si256((const __m256i *)(ap + i));
+		__m256i hi = _mm256_loadu_si256((const __m256i *)(ap + i + 1));
+		lo = _mm256_or_si256(_mm256_srl_epi64(lo, right), _mm256_sll_epi64(hi, left));
+		_mm256_storeu_si256((__m256i *)(rp + i), lo);
+	}
+	for (; i + 1 < n; i++) {
+		rp[i] = (ap[i] >> s) | (ap[i + 1] << (64 - s));
+	}
+	rp[n - 1] = ap[n - 1] >> s;
+	return out;
+}
+
+#define BITWISE_AVX2(name, vop, op) \
+__attribute__((target("avx2"))) \
+static void name(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n) { \
+	size_t i = 0; \
+	for (; i + 4 <= n; i += 4) { \
+		__m256i a = _mm256_loadu_si256((const __m256i *)(ap + i)); \
+		__m256i b = _mm256_loadu_si256((const __m256i *)(bp + i)); \
+		_mm256_storeu_si256((__m256i *)(rp + i), vop(a, b)); \
+	} \
+	for (; i < n; i++) { \
+		rp[i] = ap[i] op bp[i]; \
+	} \
+}
+
+BITWISE_AVX2(and_n_avx2, _mm256_and_si256, &)
+BITWISE_AVX2(ior_n_avx2, _mm256_or_si256, |)
+BITWISE_AVX2(xor_n_avx2, _mm256_xor_si256, ^)
+
+/*
+ * AVX-512 kernels, 8 limbs per instruction, same structure as AVX2
+ */
+__attribute__((target("avx512f")))
+static uint64_t lshift_avx512(uint64_t *rp, const uint64_t *ap, size_t n, unsigned s) {
+	uint64_t out = ap[n - 1] >> (64 - s);
+	const __m128i left = _mm_cvtsi32_si128((int) s);
+	const __m128i right = _mm_cvtsi32_si128((int) (64 - s));
+	size_t i = n;
+	for (; i >= 9; i -= 8) {
+		__m512i hi = _mm512_loadu_si512((const void *)(ap + i - 8));
+		__m512i lo = _mm512_loadu_si512((const void *)(ap + i - 9));
+		hi = _mm512_or_si512(_mm512_sll_epi64(hi, left), _mm512_srl_epi64(lo, right));
+		_mm512_storeu_si512((void *)(rp + i - 8), hi);
+	}
+	for (; i > 1; i--) {
+		rp[i - 1] = (ap[i - 1] << s) | (ap[i - 2] >> (64 - s));
+	}
+	rp[0] = ap[0] << s;
+	return out;
+}
+
+__attribute__((target("avx512f")))
+static uint64_t rshift_avx512(uint64_t *rp, const uint64_t *ap, size_t n, unsigned s) {
+	uint64_t out = ap[0] << (64 - s);
+	const __m128i left = _mm_cvtsi32_si128((int) (64 - s));
+	const __m128i right = _mm_cvtsi32_si128((int) s);
+	size_t i = 0;
+	for (; i + 9 <= n; i += 8) {
+		__m512i lo = _mm512_loadu_si512((const void *)(ap + i));
+		__m512i hi = _mm512_loadu_si512((const void *)(ap + i + 1));
+		lo = _mm512_or_si512(_mm512_srl_epi64(lo, right), _mm512_sll_epi64(hi, left));
+		_mm512_storeu_si512((void *)(rp + i), lo);
+	}
+	for (; i + 1 < n; i++) {
+		rp[i] = (ap[i] >> s) | (ap[i + 1] << (64 - s));
+	}
+	rp[n - 1] = ap[n - 1] >> s;
+	return out;
+}
+
+#define BITWISE_AVX512(name, vop, op) \
+__attribute__((target("avx512f"))) \
+static void name(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n) { \
+	size_t i = 0; \
+	for (; i + 8 <= n; i += 8) { \
+		__m512i a = _mm512_loadu_si512((const void *)(ap + i)); \
+		__m512i b = _mm512_loadu_si512((const void *)(bp + i)); \
+		_mm512_storeu_si512((void *)(rp + i), vop(a, b)); \
+	} \
+	for (; i < n; i++) { \
+		rp[i] = ap[i] op bp[i]; \
+	} \
+}
+
+BITWISE_AVX512(and_n_avx512, _mm512_and_si512, &)
+BITWISE_AVX512(ior_n_avx512, _mm512_or_si512, |)
+BITWISE_AVX512(xor_n_avx512, _mm512_xor_si512, ^)
+#endif
+
+/*
+ * Whether the CPU has the instructions a tier's own kernels use
+ */
+static int cpu_has(ApCpuTier tier) {
+#if defined(__x86_64__)
+	__builtin_cpu_init(); //needed when called from a constructor
+	switch (tier) {
+		case AP_CPU_GENERIC:
+			return 1;
+		case AP_CPU_BMI2:
+			return __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("adx");
+		case AP_CPU_AVX2:
+			return __builtin_cpu_supports("avx2");
+		case AP_CPU_AVX512:
+			return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2");
+	}
+	return 0;
+#else
+	return tier == AP_CPU_GENERIC;
+#endif
+}
+
+/*
+ * Highest tier this CPU supports (a CPU with AVX2 but no ADX is still
+ * AVX2, its carry chains just stay generic)
+ */
+ApCpuTier apint_cpu_detect(void) {
+	for (int t = AP_CPU_AVX512; t > AP_CPU_GENERIC; t--) {
+		if (cpu_has((ApCpuTier) t)) {
+			return (ApCpuTier) t;
+		}
+	}
+	return AP_CPU_GENERIC;
+}
+
+ApCpuTier apint_cpu_tier(void) {
+	return cpu_tier;
+}
+
+/*
+ * Routes every kernel to the best version at or below tier
+ * Returns the tier in effect
+ */
+ApCpuTier apint_cpu_set_tier(ApCpuTier tier) {
+	ApCpuTier best = apint_cpu_detect();
+	if (tier > best) {
+		tier = best;
+	}
+	ApLimbKernels k = {
+		limbs_add_n_generic, limbs_sub_n_generic, limbs_mul_1_generic,
+		limbs_addmul_1_generic, limbs_submul_1_generic, limbs_lshift_generic,
+		limbs_rshift_generic, limbs_and_n_generic, limbs_ior_n_generic,
+		limbs_xor_n_generic, limbs_mul_4x4_generic, limbs_mul_8x8_generic
+	};
+#if defined(__x86_64__)
+	if (tier >= AP_CPU_BMI2 && cpu_has(AP_CPU_BMI2)) {
+		k.add_n = add_n_bmi2;
+		k.sub_n = sub_n_bmi2;
+		k.mul_1 = mul_1_bmi2;
+		k.addmul_1 = addmul_1_adx;
+		k.submul_1 = submul_1_adx;
+		k.mul_4x4 = mul_4x4_adx;
+		k.mul_8x8 = mul_8x8_adx;
+	}
+	if (tier >= AP_CPU_AVX2) {
+		k.lshift = lshift_avx2;
+		k.rshift = rshift_avx2;
+		k.and_n = and_n_avx2;
+		k.ior_n = ior_n_avx2;
+		k.xor_n = xor_n_avx2;
+	}
+	if (tier >= AP_CPU_AVX512) {
+		k.lshift = lshift_avx512;
+		k.rshift = rshift_avx512;
+		k.and_n = and_n_avx512;
+		k.ior_n = ior_n_avx512;
+		k.xor_n = xor_n_avx512;
+	}
+#endif
+	apint_kernels = k;
+	cpu_tier = tier;
+	return tier;
+}
+
+const char *apint_cpu_tier_name(ApCpuTier tier) {
+	return (tier <= AP_CPU_AVX512) ? tier_names[tier] : "unknown";
+}
+
+/*
+ * Load time selection, capped by APINT_CPU (unknown names are ignored)
+ */
+__attribute__((constructor))
+static void cpu_init(void) {
+	ApCpuTier tier = apint_cpu_detect();
+	const char *env = getenv("APINT_CPU");
+	for (int t = AP_CPU_GENERIC; env != NULL && t < (int) tier; t++) {
+		if (strcmp(env, tier_names[t]) == 0) {
+			tier = (ApCpuTier) t;
+		}
+	}
+	apint_cpu_set_tier(tier);
+}
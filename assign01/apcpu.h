@@ -0,0 +1,72 @@
+/*
+ * Run-time CPU dispatch for the limb kernels
+ *
+ * The library is built for the baseline instruction set, so kernels that
+ * gain from newer instructions come in several versions and the limbs_*
+ * functions in apint.h call the best one for this CPU through the
+ * apint_kernels table. The tier is detected once at load time. Setting
+ * the environment variable APINT_CPU to generic, bmi2, avx2 or avx512
+ * caps it (for benchmarking), as does apint_cpu_set_tier, which must not
+ * be called while other threads are using the library. A tier above
+ * what the CPU supports is lowered to the best supported one.
+ */
+
+#ifndef APCPU_H
+#define APCPU_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+	AP_CPU_GENERIC, //portable C
+	AP_CPU_BMI2,    //mulx, adcx, adox (BMI2 + ADX) for carry chains and products
+	AP_CPU_AVX2,    //256 bit vectors for shifts and bitwise operations
+	AP_CPU_AVX512   //512 bit vectors
+} ApCpuTier;
+
+typedef struct {
+	uint64_t (*add_n)(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n);
+	uint64_t (*sub_n)(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n);
+	uint64_t (*mul_1)(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b);
+	uint64_t (*addmul_1)(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b);
+	uint64_t (*submul_1)(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b);
+	uint64_t (*lshift)(uint64_t *rp, const uint64_t *ap, size_t n, unsigned s);
+	uint64_t (*rshift)(uint64_t *rp, const uint64_t *ap, size_t n, unsigned s);
+	void (*and_n)(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n);
+	void (*ior_n)(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n);
+	void (*xor_n)(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n);
+	void (*mul_4x4)(uint64_t *rp, const uint64_t *ap, const uint64_t *bp);
+	void (*mul_8x8)(uint64_t *rp, const uint64_t *ap, const uint64_t *bp);
+} ApLimbKernels;
+
+extern ApLimbKernels apint_kernels;
+
+/* Tier selection */
+ApCpuTier apint_cpu_detect(void);
+ApCpuTier apint_cpu_tier(void);
+ApCpuTier apint_cpu_set_tier(ApCpuTier tier);
+const char *apint_cpu_tier_name(ApCpuTier tier);
+
+/* Portable kernels (the generic tier, see apint.c) */
+uint64_t limbs_add_n_generic(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n);
+uint64_t limbs_sub_n_generic(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n);
+uint64_t limbs_mul_1_generic(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b);
+uint64_t limbs_addmul_1_generic(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b);
+uint64_t limbs_submul_1_generic(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b);
+uint64_t limbs_lshift_generic(uint64_t *rp, const uint64_t *ap, size_t n, unsigned s);
+uint64_t limbs_rshift_generic(uint64_t *rp, const uint64_t *ap, size_t n, unsigned s);
+void limbs_and_n_generic(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n);
+void limbs_ior_n_generic(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n);
+void limbs_xor_n_generic(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n);
+void limbs_mul_4x4_generic(uint64_t *rp, const uint64_t *ap, const uint64_t *bp);
+void limbs_mul_8x8_generic(uint64_t *rp, const uint64_t *ap, const uint64_t *bp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APCPU_H */
@@ -0,0 +1,265 @@
+/*
+ * Compile-time fixed-width integers for C++ callers
+ *
+ * FixedInt<Bits> is a two's complement integer of Bits bits (a multiple
+ * of 64) kept in an inline array of limbs, with the same little-endian
+ * limb order as ApInt data. Arithmetic wraps modulo 2^Bits. Add, sub,
+ * shifts and compares are constexpr and unrolled limb by limb, so small
+ * widths stay in registers; nothing allocates except to_apint.
+ */
+
+#ifndef APFIXED_HPP
+#define APFIXED_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+#include "apint.h"
+
+namespace apint {
+
+template <unsigned Bits>
+class FixedInt {
+	static_assert(Bits > 0 && Bits % 64 == 0, "FixedInt width must be a whole number of 64 bit limbs");
+
+public:
+	static constexpr std::size_t Limbs = Bits / 64;
+
+	constexpr FixedInt() : limbs_{} {}
+
+	/* sign-extends v to Bits bits */
+	constexpr FixedInt(int64_t v) : limbs_{} {
+		limbs_[0] = (uint64_t) v;
+		for (std::size_t i = 1; i < Limbs; i++) {
+			limbs_[i] = (v < 0) ? ~0UL : 0UL;
+		}
+	}
+
+	static constexpr FixedInt from_u64(uint64_t v) {
+		FixedInt r;
+		r.limbs_[0] = v;
+		return r;
+	}
+
+	/* value of ap modulo 2^Bits */
+	static FixedInt from_apint(const ApInt *ap) {
+		FixedInt r;
+		for (std::size_t i = 0; i < Limbs && i < ap->len; i++) {
+			r.limbs_[i] = ap->data[i];
+		}
+		return (ap->flags == 0) ? -r : r;
+	}
+
+	/* new ApInt with the same (signed) value, free with apint_destroy */
+	ApInt *to_apint() const {
+		FixedInt mag = is_negative() ? -*this : *this;
+		uint64_t *data = new_limbs();
+		for (std::size_t i = 0; i < Limbs; i++) {
+			data[i] = mag.limbs_[i];
+		}
+		//the most negative value is its own negation and is read unsigned
+		return apint_wrap_limbs(data, Limbs, is_negative() ? 0 : 1);
+	}
+
+	constexpr uint64_t limb(std::size_t i) const {
+		return limbs_[i];
+	}
+
+	constexpr bool is_negative() const {
+		return (limbs_[Limbs - 1] >> 63) != 0;
+	}
+
+	constexpr bool is_zero() const {
+		return compare(*this, FixedInt()) == 0;
+	}
+
+	/* 1, 0 or -1 as a is greater, equal or less than b (signed) */
+	static constexpr int compare(const FixedInt &a, const FixedInt &b) {
+		return compare_impl(a, b, std::make_index_sequence<Limbs>());
+	}
+
+	friend constexpr FixedInt operator+(const FixedInt &a, const FixedInt &b) {
+		return add_impl(a, b, std::make_index_sequence<Limbs>());
+	}
+
+	friend constexpr FixedInt operator-(const FixedInt &a, const FixedInt &b) {
+		return sub_impl(a, b, std::make_index_sequence<Limbs>());
+	}
+
+	constexpr FixedInt operator-() const {
+		return FixedInt() - *this;
+	}
+
+	/* 
+	 * Low Bits bits of the product; at run time this is the schoolbook
+	 * basecase of apint.c (limbs_addmul_1) cut off at Limbs limbs
+	 */
+	friend constexpr FixedInt operator*(const FixedInt &a, const FixedInt &b) {
+		FixedInt r;
+		if (!__builtin_is_constant_evaluated()) {
+			for (std::size_t j = 0; j < Limbs; j++) {
+				limbs_addmul_1(r.limbs_ + j, a.limbs_, Limbs - j, b.limbs_[j]);
+			}
+			return r;
+		}
+		for (std::size_t j = 0; j < Limbs; j++) {
+			uint64_t carry = 0;
+			for (std::size_t i = 0; i + j < Limbs; i++) {
+				u128 p = (u128) a.limbs_[i] * b.limbs_[j] + r.limbs_[i + j] + carry;
+				r.limbs_[i + j] = (uint64_t) p;
+				carry = (uint64_t) (p >> 64);
+			}
+		}
+		return r;
+	}
+
+	friend constexpr FixedInt operator<<(const FixedInt &a, unsigned n) {
+		return lshift_impl(a, n, std::make_index_sequence<Limbs>());
+	}
+
+	/* arithmetic shift, the sign bit is copied in */
+	friend constexpr FixedInt operator>>(const FixedInt &a, unsigned n) {
+		return rshift_impl(a, n, std::make_index_sequence<Limbs>());
+	}
+
+	friend constexpr FixedInt operator&(const FixedInt &a, const FixedInt &b) {
+		return bitwise_impl(a, b, [](uint64_t x, uint64_t y) { return x & y; }, std::make_index_sequence<Limbs>());
+	}
+
+	friend constexpr FixedInt operator|(const FixedInt &a, const FixedInt &b) {
+		return bitwise_impl(a, b, [](uint64_t x, uint64_t y) { return x | y; }, std::make_index_sequence<Limbs>());
+	}
+
+	friend constexpr FixedInt operator^(const FixedInt &a, const FixedInt &b) {
+		return bitwise_impl(a, b, [](uint64_t x, uint64_t y) { return x ^ y; }, std::make_index_sequence<Limbs>());
+	}
+
+	constexpr FixedInt operator~() const {
+		return *this ^ FixedInt(-1);
+	}
+
+	constexpr FixedInt &operator+=(const FixedInt &b) { return *this = *this + b; }
+	constexpr FixedInt &operator-=(const FixedInt &b) { return *this = *this - b; }
+	constexpr FixedInt &operator*=(const FixedInt &b) { return *this = *this * b; }
+	constexpr FixedInt &operator<<=(unsigned n) { return *this = *this << n; }
+	constexpr FixedInt &operator>>=(unsigned n) { return *this = *this >> n; }
+
+	friend constexpr bool operator==(const FixedInt &a, const FixedInt &b) { return compare(a, b) == 0; }
+	friend constexpr bool operator!=(const FixedInt &a, const FixedInt &b) { return compare(a, b) != 0; }
+	friend constexpr bool operator<(const FixedInt &a, const FixedInt &b) { return compare(a, b) < 0; }
+	friend constexpr bool operator<=(const FixedInt &a, const FixedInt &b) { return compare(a, b) <= 0; }
+	friend constexpr bool operator>(const FixedInt &a, const FixedInt &b) { return compare(a, b) > 0; }
+	friend constexpr bool operator>=(const FixedInt &a, const FixedInt &b) { return compare(a, b) >= 0; }
+
+private:
+	__extension__ typedef unsigned __int128 u128;
+
+	uint64_t limbs_[Limbs];
+
+	static uint64_t *new_limbs();
+
+	static constexpr uint64_t add_limb(uint64_t a, uint64_t b, uint64_t &carry) {
+		uint64_t s = a + b;
+		uint64_t c = s < a;
+		uint64_t r = s + carry;
+		carry = c | (r < s);
+		return r;
+	}
+
+	static constexpr uint64_t sub_limb(uint64_t a, uint64_t b, uint64_t &borrow) {
+		uint64_t d = a - b;
+		uint64_t c = a < b;
+		uint64_t r = d - borrow;
+		borrow = c | (d < borrow);
+		return r;
+	}
+
+	/* the comma folds below run once per limb, lowest limb first */
+	template <std::size_t... I>
+	static constexpr FixedInt add_impl(const FixedInt &a, const FixedInt &b, std::index_sequence<I...>) {
+		FixedInt r;
+		uint64_t carry = 0;
+		((r.limbs_[I] = add_limb(a.limbs_[I], b.limbs_[I], carry)), ...);
+		return r;
+	}
+
+	template <std::size_t... I>
+	static constexpr FixedInt sub_impl(const FixedInt &a, const FixedInt &b, std::index_sequence<I...>) {
+		FixedInt r;
+		uint64_t borrow = 0;
+		((r.limbs_[I] = sub_limb(a.limbs_[I], b.limbs_[I], borrow)), ...);
+		return r;
+	}
+
+	/* I counts down from the top limb, which is compared signed */
+	template <std::size_t... I>
+	static constexpr int compare_impl(const FixedInt &a, const FixedInt &b, std::index_sequence<I...>) {
+		int res = 0;
+		((res = (res != 0) ? res : compare_limb(a.limbs_[Limbs - 1 - I], b.limbs_[Limbs - 1 - I], I == 0)), ...);
+		return res;
+	}
+
+	static constexpr int compare_limb(uint64_t a, uint64_t b, bool is_signed) {
+		if (a == b) {
+			return 0;
+		}
+		if (is_signed) {
+			return ((int64_t) a > (int64_t) b) ? 1 : -1;
+		}
+		return (a > b) ? 1 : -1;
+	}
+
+	/* limb i of a, with fill beyond either end */
+	static constexpr uint64_t limb_or(const FixedInt &a, std::ptrdiff_t i, uint64_t fill) {
+		return (i >= 0 && i < (std::ptrdiff_t) Limbs) ? a.limbs_[i] : fill;
+	}
+
+	static constexpr uint64_t shifted_limb(uint64_t hi, uint64_t lo, unsigned s) {
+		return (s == 0) ? hi : (hi << s) | (lo >> (64 - s));
+	}
+
+	template <std::size_t... I>
+	static constexpr FixedInt lshift_impl(const FixedInt &a, unsigned n, std::index_sequence<I...>) {
+		FixedInt r;
+		std::ptrdiff_t q = n / 64;
+		unsigned s = n % 64;
+		((r.limbs_[I] = shifted_limb(limb_or(a, (std::ptrdiff_t) I - q, 0), limb_or(a, (std::ptrdiff_t) I - q - 1, 0), s)), ...);
+		return r;
+	}
+
+	static constexpr uint64_t rshifted_limb(uint64_t lo, uint64_t hi, unsigned s) {
+		return (s == 0) ? lo : (lo >> s) | (hi << (64 - s));
+	}
+
+	template <std::size_t... I>
+	static constexpr FixedInt rshift_impl(const FixedInt &a, unsigned n, std::index_sequence<I...>) {
+		FixedInt r;
+		std::ptrdiff_t q = n / 64;
+		unsigned s = n % 64;
+		uint64_t fill = a.is_negative() ? ~0UL : 0UL;
+		((r.limbs_[I] = rshifted_limb(limb_or(a, (std::ptrdiff_t) I + q, fill), limb_or(a, (std::ptrdiff_t) I + q + 1, fill), s)), ...);
+		return r;
+	}
+
+	template <typename Op, std::size_t... I>
+	static constexpr FixedInt bitwise_impl(const FixedInt &a, const FixedInt &b, Op op, std::index_sequence<I...>) {
+		FixedInt r;
+		((r.limbs_[I] = op(a.limbs_[I], b.limbs_[I])), ...);
+		return r;
+	}
+};
+
+/* limb array for to_apint, owned by the ApInt afterwards (freed with free) */
+template <unsigned Bits>
+uint64_t *FixedInt<Bits>::new_limbs() {
+	uint64_t *data = (uint64_t *) malloc(Limbs * sizeof(uint64_t));
+	if (data == nullptr) {
+		abort();
+	}
+	return data;
+}
+
+} // namespace apint
+
+#endif /* APFIXED_HPP */
@@ -0,0 +1,613 @@
+/*
+ * Binary floating point over ApInt
+ * Function implementations
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <math.h>
+#include <assert.h>
+#include "apint.h"
+#include "apfloat.h"
+#include "apstats.h"
+
+#define GUARD_BITS 16    //kept between the rounding point and the error bound
+#define SHORT_MUL_MIN 24 //limbs below which the full product is cheaper
+#define MULHIGH_MAX 128  //limbs above which a Karatsuba full product wins
+
+__extension__ typedef unsigned __int128 u128;
+
+static size_t limbs_for(size_t bits) {
+	return (bits + 63) / 64;
+}
+
+/*
+ * Number of significant bits of d[0..n)
+ */
+static size_t bit_len(const uint64_t *d, size_t n) {
+	n = limbs_normalized_len(d, n);
+	return (n == 0) ? 0 : 64 * n - __builtin_clzl(d[n - 1]);
+}
+
+/*
+ * Bits p .. p + 63 of d[0..n), which is 0 outside itself (p may be < 0)
+ */
+static uint64_t bits_at(const uint64_t *d, size_t n, int64_t p) {
+	int64_t i = (p >= 0) ? p / 64 : -((63 - p) / 64);
+	unsigned s = (unsigned) (p - 64 * i);
+	uint64_t lo = (i >= 0 && i < (int64_t) n) ? d[i] : 0;
+	uint64_t hi = (i + 1 >= 0 && i + 1 < (int64_t) n) ? d[i + 1] : 0;
+	return (s == 0) ? lo : (lo >> s) | (hi << (64 - s));
+}
+
+/*
+ * dst[0..dn) = floor(src * 2^sh) mod 2^(64 dn), in place when sh <= 0
+ */
+static void shift_into(uint64_t *dst, size_t dn, const uint64_t *src, size_t sn, int64_t sh) {
+	for (size_t i = 0; i < dn; i++) {
+		dst[i] = bits_at(src, sn, 64 * (int64_t) i - sh);
+	}
+}
+
+/*
+ * Bits lo..hi of d: 0 if all are 0 (or there are none), 1 if all are 1,
+ * 2 if mixed
+ */
+static int bits_state(const uint64_t *d, size_t n, int64_t lo, int64_t hi) {
+	int zeros = 1, ones = 1;
+	for (int64_t p = lo; p <= hi && (zeros || ones); p += 64) {
+		uint64_t mask = (hi - p < 63) ? (UINT64_C(1) << (hi - p + 1)) - 1 : ~UINT64_C(0);
+		uint64_t w = bits_at(d, n, p) & mask;
+		zeros &= w == 0;
+		ones &= w == mask;
+	}
+	return zeros ? 0 : (ones ? 1 : 2);
+}
+
+static int any_below(const uint64_t *d, size_t n, int64_t p) {
+	return bits_state(d, n, 0, p - 1) != 0;
+}
+
+/*
+ * Whether r, off from the exact value by less than 2^k either way, rounds
+ * to prec bits like the exact value does: the bits between the rounding
+ * point and 2^k must be neither all 0 (no carry or borrow can cross, and
+ * the exact value is not on a rounding boundary) nor all 1
+ */
+static int can_round(const uint64_t *r, size_t rn, int64_t k, size_t prec) {
+	int64_t t = (int64_t) bit_len(r, rn) - 1;
+	return bits_state(r, rn, k, t - (int64_t) prec - 1) == 2;
+}
+
+/*
+ * |r| >> sh rounded by rnd into new limbs (*qn of them); sticky tells
+ * of nonzero bits already dropped below r
+ */
+static uint64_t *round_shift(const uint64_t *r, size_t rn, size_t sh, int neg, int sticky, ApRound rnd, size_t *qn) {
+	size_t n = (sh / 64 < rn) ? rn - sh / 64 + 1 : 1;
+	uint64_t *q = (uint64_t *)malloc(n * sizeof(uint64_t));
+	assert(q != NULL); //check memory allocation
+	shift_into(q, n, r, rn, -(int64_t) sh);
+	int half = sh > 0 && (bits_at(r, rn, (int64_t) sh - 1) & 1);
+	int rest = sticky || any_below(r, rn, (int64_t) sh - 1);
+	int up;
+	switch (rnd) {
+	case AP_ROUND_NEAREST:
+		up = half && (rest || (q[0] & 1));
+		break;
+	case AP_ROUND_ZERO:
+		up = 0;
+		break;
+	case AP_ROUND_UP:
+		up = !neg && (half || rest);
+		break;
+	default:
+		up = neg && (half || rest);
+		break;
+	}
+	if (up) {
+		limbs_add_1(q, q, n, 1);
+	}
+	*qn = n;
+	return q;
+}
+
+static ApFloat *float_wrap(ApInt *man, int64_t exp, size_t prec) {
+	ApFloat *f = (ApFloat *)malloc(sizeof(ApFloat));
+	assert(f != NULL); //check memory allocation
+	f->man = man;
+	f->exp = apint_is_zero(man) ? 0 : exp;
+	f->prec = prec;
+	return f;
+}
+
+/*
+ * |r| * 2^exp, negated if neg, rounded to prec bits; r needs prec + 2
+ * bits when sticky is set, so that it holds the rounding bit
+ */
+static ApFloat *round_to(const uint64_t *r, size_t rn, int64_t exp, int neg, int sticky, size_t prec, ApRound rnd) {
+	size_t t = bit_len(r, rn);
+	if (t == 0) {
+		return float_wrap(apint_create_from_u64(0UL), 0, prec);
+	}
+	uint64_t *q;
+	size_t n;
+	if (t <= prec) {
+		assert(!sticky); //the rounding bit is missing
+		n = limbs_for(prec);
+		q = (uint64_t *)malloc(n * sizeof(uint64_t));
+		assert(q != NULL); //check memory allocation
+		shift_into(q, n, r, rn, (int64_t) (prec - t));
+		exp -= (int64_t) (prec - t);
+	} else {
+		q = round_shift(r, rn, t - prec, neg, sticky, rnd, &n);
+		exp += (int64_t) (t - prec);
+		if (bit_len(q, n) > prec) { //rounded up to 2^prec
+			shift_into(q, n, q, n, -1);
+			exp++;
+		}
+	}
+	return float_wrap(apint_wrap_limbs(q, n, neg ? 0 : 1), exp, prec);
+}
+
+static int is_neg(const ApFloat *f) {
+	return f->man->flags == 0;
+}
+
+static size_t man_bits(const ApFloat *f) {
+	return bit_len(f->man->data, f->man->len);
+}
+
+/*
+ * Position of the top bit of a nonzero f
+ */
+static int64_t top_bit(const ApFloat *f) {
+	return f->exp + (int64_t) man_bits(f) - 1;
+}
+
+/*
+ * floor(|man| * 2^sh) as a new nonnegative ApInt of at most bits bits
+ */
+static ApInt *man_shifted(const ApFloat *f, int64_t sh, size_t bits) {
+	size_t n = limbs_for(bits) + 1;
+	uint64_t *data = (uint64_t *)malloc(n * sizeof(uint64_t));
+	assert(data != NULL); //check memory allocation
+	shift_into(data, n, f->man->data, f->man->len, sh);
+	return apint_wrap_limbs(data, n, 1);
+}
+
+ApFloat *apint_float_from_apint(const ApInt *ap, size_t prec, ApRound rnd) {
+	return round_to(ap->data, ap->len, 0, ap->flags == 0, 0, prec, rnd);
+}
+
+ApFloat *apint_float_from_double(double d, size_t prec, ApRound rnd) {
+	assert(isfinite(d));
+	int e;
+	uint64_t m = (uint64_t) ldexp(frexp(fabs(d), &e), 53);
+	return round_to(&m, 1, (int64_t) e - 53, d < 0, 0, prec, rnd);
+}
+
+ApFloat *apint_float_copy(const ApFloat *f) {
+	return float_wrap(apint_copy(f->man), f->exp, f->prec);
+}
+
+void apint_float_destroy(ApFloat *f) {
+	apint_destroy(f->man);
+	free(f);
+}
+
+ApFloat *apint_float_round(const ApFloat *f, size_t prec, ApRound rnd) {
+	return round_to(f->man->data, f->man->len, f->exp, is_neg(f), 0, prec, rnd);
+}
+
+/*
+ * f rounded to an integer by rnd
+ */
+ApInt *apint_float_to_apint(const ApFloat *f, ApRound rnd) {
+	size_t n;
+	uint64_t *data;
+	if (f->exp >= 0) {
+		n = limbs_for(man_bits(f) + (size_t) f->exp) + 1;
+		data = (uint64_t *)malloc(n * sizeof(uint64_t));
+		assert(data != NULL); //check memory allocation
+		shift_into(data, n, f->man->data, f->man->len, f->exp);
+	} else {
+		data = round_shift(f->man->data, f->man->len, (size_t) -f->exp, is_neg(f), 0, rnd, &n);
+	}
+	return apint_wrap_limbs(data, n, is_neg(f) ? 0 : 1);
+}
+
+/*
+ * Hex float like C's %a, "0x1.8p+1" for 3 and "0x0p+0" for 0
+ */
+char *apint_float_format_as_hex(const ApFloat *f) {
+	size_t frac = (f->prec > 0) ? f->prec - 1 : 0;
+	size_t pad = (4 - frac % 4) % 4;
+	size_t digits = (frac + pad) / 4;
+	char *s = (char *)malloc(digits + 48);
+	assert(s != NULL); //check memory allocation
+	if (apint_float_is_zero(f)) {
+		strcpy(s, "0x0p+0");
+		return s;
+	}
+	size_t pos = (size_t) sprintf(s, "%s0x1.", is_neg(f) ? "-" : "");
+	for (size_t i = digits; i > 0; i--) {
+		s[pos++] = "0123456789abcdef"[bits_at(f->man->data, f->man->len, 4 * (int64_t) (i - 1) - (int64_t) pad) & 0xf];
+	}
+	while (s[pos - 1] == '0') {
+		pos--;
+	}
+	if (s[pos - 1] == '.') {
+		pos--;
+	}
+	sprintf(s + pos, "p%+" PRId64, f->exp + (int64_t) f->prec - 1);
+	return s;
+}
+
+/*
+ * Decimal with digits digits after the point, truncated toward zero,
+ * "3.1415" for pi and 4 digits; the scale 10^digits is a product tree
+ * over 10^19 factors
+ */
+char *apint_float_format_as_decimal(const ApFloat *f, size_t digits) {
+	uint64_t *tens = (uint64_t *)malloc((digits / 19 + 1) * sizeof(uint64_t));
+	assert(tens != NULL); //check memory allocation
+	size_t nt = 0;
+	for (size_t left = digits; left > 0; nt++) {
+		size_t k = (left < 19) ? left : 19;
+		tens[nt] = 1;
+		for (size_t i = 0; i < k; i++) {
+			tens[nt] *= 10;
+		}
+		left -= k;
+	}
+	ApInt *scale = apint_product_u64(tens, nt);
+	free(tens);
+	ApFloat scaled = {apint_mul(f->man, scale), f->exp, f->prec};
+	ApInt *x = apint_float_to_apint(&scaled, AP_ROUND_ZERO);
+	char *s = apint_format_as_decimal(x);
+	apint_destroy(scale);
+	apint_destroy(scaled.man);
+	apint_destroy(x);
+
+	int neg = (s[0] == '-');
+	size_t n = strlen(s + neg);
+	size_t width = (n > digits) ? n : digits + 1; //at least one integer digit
+	char *out = (char *)malloc(width + neg + 2);
+	assert(out != NULL); //check memory allocation
+	size_t pos = 0;
+	if (neg) {
+		out[pos++] = '-';
+	}
+	memset(out + pos, '0', width - n);
+	memcpy(out + pos + width - n, s + neg, n);
+	pos += width - digits;
+	if (digits > 0) { //make room for the point
+		memmove(out + pos + 1, out + pos, digits);
+		out[pos] = '.';
+		pos++;
+	}
+	out[pos + digits] = '\0';
+	free(s);
+	return out;
+}
+
+int apint_float_is_zero(const ApFloat *f) {
+	return apint_is_zero(f->man);
+}
+
+/*
+ * Returns 1: left greater, -1: right greater, 0: equal
+ */
+int apint_float_compare(const ApFloat *left, const ApFloat *right) {
+	int ls = apint_float_is_zero(left) ? 0 : (is_neg(left) ? -1 : 1);
+	int rs = apint_float_is_zero(right) ? 0 : (is_neg(right) ? -1 : 1);
+	if (ls != rs || ls == 0) {
+		return (ls > rs) - (ls < rs);
+	}
+	int64_t lt = top_bit(left), rt = top_bit(right);
+	int cmp;
+	if (lt != rt) {
+		cmp = (lt > rt) ? 1 : -1;
+	} else {
+		int64_t e = (left->exp < right->exp) ? left->exp : right->exp;
+		size_t n = limbs_for((size_t) (lt - e + 1));
+		uint64_t *x = (uint64_t *)malloc(2 * n * sizeof(uint64_t));
+		assert(x != NULL); //check memory allocation
+		shift_into(x, n, left->man->data, left->man->len, left->exp - e);
+		shift_into(x + n, n, right->man->data, right->man->len, right->exp - e);
+		cmp = limbs_cmp(x, x + n, n);
+		free(x);
+	}
+	return (ls > 0) ? cmp : -cmp;
+}
+
+ApFloat *apint_float_negate(const ApFloat *f) {
+	return float_wrap(apint_negate(f->man), f->exp, f->prec);
+}
+
+/*
+ * f * 2^n, exact
+ */
+ApFloat *apint_float_mul_2exp(const ApFloat *f, int64_t n) {
+	return float_wrap(apint_copy(f->man), f->exp + n, f->prec);
+}
+
+/*
+ * a + b, or a - b when negate is set
+ * An operand wholly below both the other's last bit and the rounding
+ * point only decides which way to round, so it is replaced by a single
+ * bit half a unit below them rather than shifted into place
+ */
+static ApFloat *float_add(const ApFloat *a, const ApFloat *b, int negate, size_t prec, ApRound rnd) {
+	APINT_STATS_OP(AP_OP_FLOAT, limbs_for(prec));
+	int an = is_neg(a), bn = is_neg(b) ^ negate;
+	if (apint_float_is_zero(b)) {
+		return round_to(a->man->data, a->man->len, a->exp, an, 0, prec, rnd);
+	}
+	if (apint_float_is_zero(a)) {
+		return round_to(b->man->data, b->man->len, b->exp, bn, 0, prec, rnd);
+	}
+	if (top_bit(a) < top_bit(b)) {
+		const ApFloat *t = a;
+		a = b;
+		b = t;
+		int tn = an;
+		an = bn;
+		bn = tn;
+	}
+	int64_t ta = top_bit(a);
+	int64_t low = ta - (int64_t) prec - 3;
+	if (a->exp < low) {
+		low = a->exp;
+	}
+
+	ApFloat *f;
+	if (top_bit(b) < low) { //a +- 2^(low - 1)
+		size_t rn = limbs_for((size_t) (ta - low + 2));
+		uint64_t *r = (uint64_t *)malloc(rn * sizeof(uint64_t));
+		assert(r != NULL); //check memory allocation
+		shift_into(r, rn, a->man->data, a->man->len, a->exp - low + 1);
+		if (an == bn) {
+			r[0] |= 1;
+		} else {
+			limbs_sub_1(r, r, rn, 1);
+		}
+		f = round_to(r, rn, low - 1, an, 0, prec, rnd);
+		free(r);
+		return f;
+	}
+
+	int64_t e = (a->exp < b->exp) ? a->exp : b->exp;
+	size_t rn = limbs_for((size_t) (ta - e + 2));
+	uint64_t *x = (uint64_t *)malloc(2 * rn * sizeof(uint64_t));
+	assert(x != NULL); //check memory allocation
+	uint64_t *y = x + rn;
+	shift_into(x, rn, a->man->data, a->man->len, a->exp - e);
+	shift_into(y, rn, b->man->data, b->man->len, b->exp - e);
+	int neg = an;
+	if (an == bn) {
+		limbs_add_n(x, x, y, rn);
+	} else if (limbs_cmp(x, y, rn) >= 0) {
+		limbs_sub_n(x, x, y, rn);
+	} else {
+		limbs_sub_n(x, y, x, rn);
+		neg = bn;
+	}
+	f = round_to(x, rn, e, neg, 0, prec, rnd);
+	free(x);
+	return f;
+}
+
+ApFloat *apint_float_add(const ApFloat *a, const ApFloat *b, size_t prec, ApRound rnd) {
+	return float_add(a, b, 0, prec, rnd);
+}
+
+ApFloat *apint_float_sub(const ApFloat *a, const ApFloat *b, size_t prec, ApRound rnd) {
+	return float_add(a, b, 1, prec, rnd);
+}
+
+/*
+ * Upper half of the n x n limb product into rp[0..2n): the partial
+ * products below column n - 2 are left out, which comes to less than
+ * n 2^(64 (n - 1)) short of the full product
+ */
+static void limbs_mulhigh(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n) {
+	memset(rp, 0, 2 * n * sizeof(uint64_t));
+	for (size_t i = 0; i < n; i++) {
+		size_t j = (i + 2 < n) ? n - 2 - i : 0;
+		rp[i + n] = (ap[i] != 0) ? limbs_addmul_1(rp + i + j, bp + j, n - j, ap[i]) : 0;
+	}
+}
+
+/*
+ * a * b
+ * Both mantissas are cut to n limbs, top bit first, so with the half
+ * product the result is short by less than 2 2^(64 n) for the cut
+ * operands and n 2^(64 (n - 1)) for the columns left out
+ */
+ApFloat *apint_float_mul(const ApFloat *a, const ApFloat *b, size_t prec, ApRound rnd) {
+	APINT_STATS_OP(AP_OP_FLOAT, limbs_for(prec));
+	if (apint_float_is_zero(a) || apint_float_is_zero(b)) {
+		return float_wrap(apint_create_from_u64(0UL), 0, prec);
+	}
+	int neg = is_neg(a) != is_neg(b);
+	size_t an = limbs_for(man_bits(a)), bn = limbs_for(man_bits(b));
+	size_t n = limbs_for(prec + GUARD_BITS + 5);
+	size_t longer = (an > bn) ? an : bn;
+	ApFloat *f;
+	if (longer > n || (n <= MULHIGH_MAX && longer >= SHORT_MUL_MIN)) {
+		ApScratch local;
+		ApScratch *s = apint_scratch_acquire(&local, 4 * n + limbs_mul_scratch_size(n, n));
+		uint64_t *x = apint_scratch_alloc(s, n);
+		uint64_t *y = apint_scratch_alloc(s, n);
+		uint64_t *r = apint_scratch_alloc(s, 2 * n);
+		int64_t sa = 64 * (int64_t) n - (int64_t) man_bits(a);
+		int64_t sb = 64 * (int64_t) n - (int64_t) man_bits(b);
+		shift_into(x, n, a->man->data, a->man->len, sa);
+		shift_into(y, n, b->man->data, b->man->len, sb);
+		if (n <= MULHIGH_MAX) {
+			limbs_mulhigh(r, x, y, n);
+		} else {
+			limbs_mul(r, x, n, y, n, s);
+		}
+		f = NULL;
+		if (can_round(r, 2 * n, 64 * (int64_t) n + 2, prec)) {
+			f = round_to(r, 2 * n, a->exp + b->exp - sa - sb, neg, 1, prec, rnd);
+		}
+		apint_scratch_return(s, &local);
+		if (f != NULL) {
+			return f;
+		}
+	}
+	ApInt *p = apint_mul(a->man, b->man);
+	f = round_to(p->data, p->len, a->exp + b->exp, neg, 0, prec, rnd);
+	apint_destroy(p);
+	return f;
+}
+
+/*
+ * a / b
+ * The quotient gets prec + GUARD_BITS + 4 bits; a divisor longer than
+ * that is cut to 2 more bits, which with a cut dividend leaves it less
+ * than 2 off. Uncut operands give the exact quotient and remainder
+ */
+ApFloat *apint_float_div(const ApFloat *a, const ApFloat *b, size_t prec, ApRound rnd) {
+	APINT_STATS_OP(AP_OP_FLOAT, limbs_for(prec));
+	if (apint_float_is_zero(b)) {
+		return NULL;
+	}
+	if (apint_float_is_zero(a)) {
+		return float_wrap(apint_create_from_u64(0UL), 0, prec);
+	}
+	int neg = is_neg(a) != is_neg(b);
+	size_t q_bits = prec + GUARD_BITS + 4;
+	size_t abits = man_bits(a), bbits = man_bits(b);
+	int64_t sb = (bbits > q_bits + 2) ? (int64_t) (q_bits + 2) - (int64_t) bbits : 0;
+	size_t dbits = (size_t) ((int64_t) bbits + sb);
+	int64_t sa = (int64_t) (dbits + q_bits) - (int64_t) abits;
+	int cut = (sb < 0 && any_below(b->man->data, b->man->len, -sb)) ||
+		(sa < 0 && any_below(a->man->data, a->man->len, -sa));
+
+	ApInt *num = man_shifted(a, sa, dbits + q_bits);
+	ApInt *den = man_shifted(b, sb, dbits);
+	ApInt *rem;
+	ApInt *q = apint_divmod(num, den, &rem);
+	ApFloat *f = NULL;
+	if (!cut) {
+		f = round_to(q->data, q->len, a->exp - b->exp - sa + sb, neg, !apint_is_zero(rem), prec, rnd);
+	} else if (can_round(q->data, q->len, 1, prec)) {
+		f = round_to(q->data, q->len, a->exp - b->exp - sa + sb, neg, 1, prec, rnd);
+	}
+	apint_destroy(num);
+	apint_destroy(den);
+	apint_destroy(q);
+	apint_destroy(rem);
+	if (f != NULL) {
+		return f;
+	}
+
+	sa = (int64_t) (prec + 2 + bbits) - (int64_t) abits;
+	if (sa < 0) {
+		sa = 0;
+	}
+	num = man_shifted(a, sa, abits + (size_t) sa);
+	den = man_shifted(b, 0, bbits);
+	q = apint_divmod(num, den, &rem);
+	f = round_to(q->data, q->len, a->exp - b->exp - sa, neg, !apint_is_zero(rem), prec, rnd);
+	apint_destroy(num);
+	apint_destroy(den);
+	apint_destroy(q);
+	apint_destroy(rem);
+	return f;
+}
+
+/*
+ * floor(sqrt(m)), with m - floor(sqrt(m))^2 into *rem unless it is NULL
+ * The root of the top half of m, plus 1, is just above the root to half
+ * its bits; one Newton step from there leaves it a few units high
+ */
+static ApInt *isqrt_rem(const ApInt *m, ApInt **rem) {
+	size_t b = bit_len(m->data, m->len);
+	ApInt *r;
+	if (b <= 104) {
+		size_t n = limbs_normalized_len(m->data, m->len);
+		u128 v = ((n > 1) ? (u128) m->data[1] << 64 : 0) | ((n > 0) ? m->data[0] : 0);
+		uint64_t x = (uint64_t) sqrt((double) v);
+		while ((u128) x * x > v) {
+			x--;
+		}
+		while ((u128) (x + 1) * (x + 1) <= v) {
+			x++;
+		}
+		r = apint_create_from_u64(x);
+	} else {
+		unsigned h = (unsigned) (b / 4);
+		ApInt *top = apint_rshift_n(m, 2 * h);
+		ApInt *tr = isqrt_rem(top, NULL);
+		ApInt *x1 = apint_add_u64(tr, 1);
+		ApInt *x = apint_lshift_n(x1, h);
+		ApInt *q = apint_divmod(m, x, NULL);
+		ApInt *sum = apint_add(x, q);
+		r = apint_rshift_n(sum, 1);
+		apint_destroy(top);
+		apint_destroy(tr);
+		apint_destroy(x1);
+		apint_destroy(x);
+		apint_destroy(q);
+		apint_destroy(sum);
+	}
+
+	ApInt *sq = apint_mul(r, r);
+	ApInt *d = apint_sub(m, sq);
+	apint_destroy(sq);
+	while (apint_is_negative(d)) { //(r - 1)^2 = r^2 - 2 (r - 1) - 1
+		ApInt *r1 = apint_sub_u64(r, 1);
+		apint_destroy(r);
+		r = r1;
+		apint_add_shifted(d, r, 1);
+		ApInt *d1 = apint_add_u64(d, 1);
+		apint_destroy(d);
+		d = d1;
+	}
+	if (rem != NULL) {
+		*rem = d;
+	} else {
+		apint_destroy(d);
+	}
+	return r;
+}
+
+/*
+ * sqrt(a)
+ * Only the top 2 prec + 4 bits of a (the exponent made even) are used:
+ * with m = M 2^(2k) + lo, sqrt(m) / 2^k lies in [sqrt(M), sqrt(M + 1)),
+ * which never passes the next integer, so floor(sqrt(M)) is exact and
+ * lo only joins the sticky bit
+ */
+ApFloat *apint_float_sqrt(const ApFloat *a, size_t prec, ApRound rnd) {
+	APINT_STATS_OP(AP_OP_FLOAT, limbs_for(prec));
+	if (is_neg(a)) {
+		return NULL;
+	}
+	if (apint_float_is_zero(a)) {
+		return float_wrap(apint_create_from_u64(0UL), 0, prec);
+	}
+	size_t w = prec + 2;
+	size_t abits = man_bits(a);
+	int64_t s = 2 * (int64_t) w - (int64_t) abits;
+	if ((a->exp - s) & 1) {
+		s--;
+	}
+	int sticky = s < 0 && any_below(a->man->data, a->man->len, -s);
+	ApInt *m = man_shifted(a, s, (size_t) ((int64_t) abits + s));
+	ApInt *rem;
+	ApInt *r = isqrt_rem(m, &rem);
+	ApFloat *f = round_to(r->data, r->len, (a->exp - s) / 2, 0, sticky || !apint_is_zero(rem), prec, rnd);
+	apint_destroy(m);
+	apint_destroy(r);
+	apint_destroy(rem);
+	return f;
+}
@@ -0,0 +1,75 @@
+/*
+ * Binary floating point over ApInt
+ *
+ * An ApFloat is man * 2^exp, where the signed mantissa man has exactly
+ * prec bits (its top bit set), or is 0 with exp 0; there is no negative
+ * zero, infinity or NaN. Every operation takes the precision and
+ * rounding mode of its result and rounds correctly, as if the exact
+ * value had been computed first: to nearest with ties to even, toward
+ * zero, up (toward +inf) or down (toward -inf).
+ *
+ * Exact values are rarely computed, though. A product is a short
+ * product: both mantissas are cut to the limbs the result needs and
+ * only the upper half of their product is formed, leaving out the low
+ * columns. A quotient divides truncated operands the same way. The
+ * error of such an approximation is bounded, so when the bits between
+ * the rounding point and the error are neither all 0 nor all 1, the
+ * exact value rounds the same way; otherwise (rarely, or exactly on a
+ * rounding boundary) the full product or quotient is taken. Square
+ * roots keep only the 2 prec + 4 top mantissa bits, which is exact, and
+ * sums skip the alignment of an operand that lies wholly below the
+ * rounding point, standing in a single sticky bit for it.
+ */
+
+#ifndef APFLOAT_H
+#define APFLOAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "apint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+	AP_ROUND_NEAREST, //ties to even
+	AP_ROUND_ZERO,
+	AP_ROUND_UP,      //toward +inf
+	AP_ROUND_DOWN     //toward -inf
+} ApRound;
+
+typedef struct {
+	ApInt *man;  //prec bits, or 0
+	int64_t exp; //value is man * 2^exp
+	size_t prec;
+} ApFloat;
+
+/* Constructors and destructors */
+ApFloat *apint_float_from_apint(const ApInt *ap, size_t prec, ApRound rnd);
+ApFloat *apint_float_from_double(double d, size_t prec, ApRound rnd);
+ApFloat *apint_float_copy(const ApFloat *f);
+void apint_float_destroy(ApFloat *f);
+
+/* Conversions */
+ApFloat *apint_float_round(const ApFloat *f, size_t prec, ApRound rnd);
+ApInt *apint_float_to_apint(const ApFloat *f, ApRound rnd);
+char *apint_float_format_as_hex(const ApFloat *f);
+char *apint_float_format_as_decimal(const ApFloat *f, size_t digits);
+
+/* Operations, div returns NULL when dividing by 0 and sqrt for a < 0 */
+int apint_float_is_zero(const ApFloat *f);
+int apint_float_compare(const ApFloat *left, const ApFloat *right);
+ApFloat *apint_float_negate(const ApFloat *f);
+ApFloat *apint_float_mul_2exp(const ApFloat *f, int64_t n);
+ApFloat *apint_float_add(const ApFloat *a, const ApFloat *b, size_t prec, ApRound rnd);
+ApFloat *apint_float_sub(const ApFloat *a, const ApFloat *b, size_t prec, ApRound rnd);
+ApFloat *apint_float_mul(const ApFloat *a, const ApFloat *b, size_t prec, ApRound rnd);
+ApFloat *apint_float_div(const ApFloat *a, const ApFloat *b, size_t prec, ApRound rnd);
+ApFloat *apint_float_sqrt(const ApFloat *a, size_t prec, ApRound rnd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APFLOAT_H */
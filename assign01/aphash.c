@@ -0,0 +1,361 @@
+/*
+ * Hashing and hash maps keyed by ApInt
+ * Function implementations
+ *
+ * Short values are hashed wyhash-style, folding 128 bit products of limb
+ * pairs. From HASH_LONG_LIMBS on, stripes of 8 limbs feed 8 independent
+ * xxh3-style accumulators (an AVX2 version runs 4 per instruction and
+ * gives the same hash), which are folded at the end.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "apint.h"
+#include "aphash.h"
+#include "apcpu.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include "apstats.h"
+
+#define HASH_LONG_LIMBS 16   //values this long use the striped accumulators
+#define HASH_STRIPE 8        //limbs per stripe, one per accumulator
+#define HASH_SCRAMBLE 8      //stripes between accumulator scrambles
+#define HASH_PRIME32 0x9E3779B1UL
+
+__extension__ typedef unsigned __int128 u128;
+
+static const uint64_t secret[8] = {
+	0xa0761d6478bd642fUL, 0xe7037ed1a0b428dbUL, 0x8ebc6af09c88c6e3UL, 0x589965cc75374cc3UL,
+	0x1d8e4e27c47d124fUL, 0x9e3779b97f4a7c15UL, 0xc2b2ae3d27d4eb4fUL, 0x165667b19e3779f9UL,
+};
+
+/*
+ * Folds the 128 bit product of a and b
+ */
+static uint64_t mum(uint64_t a, uint64_t b) {
+	u128 p = (u128) a * b;
+	return (uint64_t) p ^ (uint64_t) (p >> 64);
+}
+
+/*
+ * Chains n limbs into h two at a time
+ */
+static uint64_t hash_chain(const uint64_t *d, size_t n, uint64_t h) {
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		h = mum(d[i] ^ secret[1], d[i + 1] ^ h);
+	}
+	if (i < n) {
+		h = mum(d[i] ^ secret[2], h ^ secret[3]);
+	}
+	return h;
+}
+
+/*
+ * Portable stripe kernels
+ */
+static void accumulate_generic(uint64_t *acc, const uint64_t *d, size_t stripes, const uint64_t *key) {
+	for (size_t s = 0; s < stripes; s++, d += HASH_STRIPE) {
+		for (int i = 0; i < HASH_STRIPE; i++) {
+			uint64_t dk = d[i] ^ key[i];
+			acc[i ^ 1] += d[i];
+			acc[i] += (dk & 0xFFFFFFFFUL) * (dk >> 32);
+		}
+	}
+}
+
+static void scramble_generic(uint64_t *acc, const uint64_t *key) {
+	for (int i = 0; i < HASH_STRIPE; i++) {
+		acc[i] ^= acc[i] >> 47;
+		acc[i] ^= key[i];
+		acc[i] *= HASH_PRIME32;
+	}
+}
+
+#if defined(__x86_64__)
+/*
+ * AVX2 stripe kernels, the same arithmetic 4 accumulators at a time
+ */
+__attribute__((target("avx2")))
+static void accumulate_avx2(uint64_t *acc, const uint64_t *d, size_t stripes, const uint64_t *key) {
+	__m256i a0 = _mm256_loadu_si256((const __m256i *)acc);
+	__m256i a1 = _mm256_loadu_si256((const __m256i *)(acc + 4));
+	const __m256i k0 = _mm256_loadu_si256((const __m256i *)key);
+	const __m256i k1 = _mm256_loadu_si256((const __m256i *)(key + 4));
+	for (size_t s = 0; s < stripes; s++, d += HASH_STRIPE) {
+		__m256i d0 = _mm256_loadu_si256((const __m256i *)d);
+		__m256i d1 = _mm256_loadu_si256((const __m256i *)(d + 4));
+		__m256i dk0 = _mm256_xor_si256(d0, k0);
+		__m256i dk1 = _mm256_xor_si256(d1, k1);
+		//acc[i ^ 1] += d[i] swaps neighbouring 64 bit lanes
+		a0 = _mm256_add_epi64(a0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2)));
+		a1 = _mm256_add_epi64(a1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2)));
+		a0 = _mm256_add_epi64(a0, _mm256_mul_epu32(dk0, _mm256_srli_epi64(dk0, 32)));
+		a1 = _mm256_add_epi64(a1, _mm256_mul_epu32(dk1, _mm256_srli_epi64(dk1, 32)));
+	}
+	_mm256_storeu_si256((__m256i *)acc, a0);
+	_mm256_storeu_si256((__m256i *)(acc + 4), a1);
+}
+
+__attribute__((target("avx2")))
+static void scramble_avx2(uint64_t *acc, const uint64_t *key) {
+	const __m256i prime = _mm256_set1_epi64x(HASH_PRIME32);
+	for (int i = 0; i < HASH_STRIPE; i += 4) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(acc + i));
+		a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+		a = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i *)(key + i)));
+		//64 x 32 bit multiply from two 32 x 32 bit halves
+		__m256i lo = _mm256_mul_epu32(a, prime);
+		__m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+		_mm256_storeu_si256((__m256i *)(acc + i), _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+	}
+}
+#endif
+
+/*
+ * Striped hash of n >= HASH_LONG_LIMBS limbs
+ */
+static uint64_t hash_long(const uint64_t *d, size_t n, uint64_t seed) {
+	uint64_t acc[HASH_STRIPE], key[HASH_STRIPE];
+	for (int i = 0; i < HASH_STRIPE; i++) {
+		key[i] = (i & 1) ? secret[i] - seed : secret[i] + seed;
+		acc[i] = secret[(i + 3) % HASH_STRIPE];
+	}
+	size_t stripes = n / HASH_STRIPE;
+	int avx2 = apint_cpu_tier() >= AP_CPU_AVX2;
+	for (size_t s = 0; s < stripes; s += HASH_SCRAMBLE) {
+		size_t block = (stripes - s < HASH_SCRAMBLE) ? stripes - s : HASH_SCRAMBLE;
+#if defined(__x86_64__)
+		if (avx2) {
+			accumulate_avx2(acc, d + s * HASH_STRIPE, block, key);
+			if (block == HASH_SCRAMBLE) {
+				scramble_avx2(acc, key);
+			}
+			continue;
+		}
+#endif
+		accumulate_generic(acc, d + s * HASH_STRIPE, block, key);
+		if (block == HASH_SCRAMBLE) {
+			scramble_generic(acc, key);
+		}
+	}
+	(void) avx2;
+
+	uint64_t h = (uint64_t) n * secret[5] ^ seed;
+	for (int i = 0; i < HASH_STRIPE; i += 2) {
+		h += mum(acc[i] ^ secret[i], acc[i + 1] ^ secret[i + 1]);
+	}
+	return hash_chain(d + stripes * HASH_STRIPE, n % HASH_STRIPE, h);
+}
+
+/*
+ * Seedable hash of the value of ap (sign and normalized limbs)
+ */
+uint64_t apint_hash(const ApInt *ap, uint64_t seed) {
+	APINT_STATS_OP(AP_OP_HASH, ap->len);
+	size_t n = limbs_normalized_len(ap->data, ap->len);
+	if (n != 0 && ap->flags == 0) {
+		seed ^= secret[7];
+	}
+	uint64_t h;
+	if (n >= HASH_LONG_LIMBS) {
+		h = hash_long(ap->data, n, seed);
+	} else {
+		h = hash_chain(ap->data, n, seed ^ mum(seed ^ secret[0], n ^ secret[1]));
+	}
+	return mum(h ^ secret[4], (uint64_t) n ^ secret[6]);
+}
+
+/*
+ * 1 if a and b have the same value, without apint_compare's ordering work:
+ * shared limbs and mismatched signs or lengths are decided up front
+ */
+int apint_equal(const ApInt *a, const ApInt *b) {
+	if (a == b || (a->data == b->data && a->len == b->len && a->flags == b->flags)) {
+		return 1;
+	}
+	size_t an = limbs_normalized_len(a->data, a->len);
+	size_t bn = limbs_normalized_len(b->data, b->len);
+	if (an != bn || (an != 0 && a->flags != b->flags)) {
+		return 0;
+	}
+	return memcmp(a->data, b->data, an * sizeof(uint64_t)) == 0;
+}
+
+/*
+ * Maps
+ */
+
+static const uint64_t *entry_limbs(const ApIntMapEntry *e) {
+	return (e->len <= AP_MAP_INLINE) ? e->k.limbs : e->k.key->data;
+}
+
+static uint64_t map_hash(const ApIntMap *map, const ApInt *key) {
+	uint64_t h = apint_hash(key, map->seed);
+	return (h != 0) ? h : 1; //0 marks empty slots
+}
+
+/*
+ * Slot holding key, or the empty slot that ends its probe sequence
+ */
+static size_t map_probe(const ApIntMap *map, const ApInt *key, uint64_t h) {
+	size_t mask = map->capacity - 1;
+	size_t n = limbs_normalized_len(key->data, key->len);
+	uint32_t flags = (n == 0) ? 1 : key->flags;
+	size_t i = h & mask;
+	while (map->slots[i].hash != 0) {
+		const ApIntMapEntry *e = &map->slots[i];
+		if (e->hash == h && e->len == n && e->flags == flags
+				&& memcmp(entry_limbs(e), key->data, n * sizeof(uint64_t)) == 0) {
+			return i;
+		}
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+static void map_alloc(ApIntMap *map, size_t capacity) {
+	map->capacity = capacity;
+	map->slots = (ApIntMapEntry *)calloc(capacity, sizeof(ApIntMapEntry));
+	assert(map->slots != NULL); //check memory allocation
+}
+
+/*
+ * Map sized for expected keys without growing, hashed with seed
+ */
+ApIntMap *apint_map_create(size_t expected, uint64_t seed) {
+	ApIntMap *map = (ApIntMap *)malloc(sizeof(ApIntMap));
+	assert(map != NULL); //check memory allocation
+	size_t capacity = 16;
+	while (capacity * 3 < expected * 4) { //load factor stays at most 3/4
+		capacity *= 2;
+	}
+	map_alloc(map, capacity);
+	map->size = 0;
+	map->seed = seed;
+	return map;
+}
+
+/*
+ * Frees the map and its copies of the keys, not the values
+ */
+void apint_map_destroy(ApIntMap *map) {
+	for (size_t i = 0; i < map->capacity; i++) {
+		if (map->slots[i].hash != 0 && map->slots[i].len > AP_MAP_INLINE) {
+			apint_destroy(map->slots[i].k.key);
+		}
+	}
+	free(map->slots);
+	free(map);
+}
+
+/*
+ * Doubles the table, entries move with their stored hashes
+ */
+static void map_grow(ApIntMap *map) {
+	ApIntMapEntry *old = map->slots;
+	size_t old_capacity = map->capacity;
+	map_alloc(map, 2 * old_capacity);
+	size_t mask = map->capacity - 1;
+	for (size_t i = 0; i < old_capacity; i++) {
+		if (old[i].hash != 0) {
+			size_t j = old[i].hash & mask;
+			while (map->slots[j].hash != 0) {
+				j = (j + 1) & mask;
+			}
+			map->slots[j] = old[i];
+		}
+	}
+	free(old);
+}
+
+/*
+ * Address of the value stored for key, NULL if key is absent
+ * (valid until the next insert or remove)
+ */
+void **apint_map_find(const ApIntMap *map, const ApInt *key) {
+	size_t i = map_probe(map, key, map_hash(map, key));
+	return (map->slots[i].hash != 0) ? &map->slots[i].value : NULL;
+}
+
+/*
+ * Maps key to value, returns 1 if key was added, 0 if its value was replaced
+ */
+int apint_map_insert(ApIntMap *map, const ApInt *key, void *value) {
+	if ((map->size + 1) * 4 > map->capacity * 3) {
+		map_grow(map);
+	}
+	uint64_t h = map_hash(map, key);
+	size_t i = map_probe(map, key, h);
+	ApIntMapEntry *e = &map->slots[i];
+	if (e->hash != 0) {
+		e->value = value;
+		return 0;
+	}
+	size_t n = limbs_normalized_len(key->data, key->len);
+	e->hash = h;
+	e->len = n;
+	e->flags = (n == 0) ? 1 : key->flags;
+	if (n <= AP_MAP_INLINE) {
+		memset(e->k.limbs, 0, sizeof(e->k.limbs));
+		memcpy(e->k.limbs, key->data, n * sizeof(uint64_t));
+	} else {
+		e->k.key = apint_copy(key);
+	}
+	e->value = value;
+	map->size++;
+	return 1;
+}
+
+/*
+ * Removes key, returns 1 and its value (if value is not NULL) when it
+ * was present, 0 otherwise
+ * Later entries of the probe run are shifted back, so no tombstones
+ */
+int apint_map_remove(ApIntMap *map, const ApInt *key, void **value) {
+	size_t i = map_probe(map, key, map_hash(map, key));
+	if (map->slots[i].hash == 0) {
+		return 0;
+	}
+	if (value != NULL) {
+		*value = map->slots[i].value;
+	}
+	if (map->slots[i].len > AP_MAP_INLINE) {
+		apint_destroy(map->slots[i].k.key);
+	}
+	size_t mask = map->capacity - 1;
+	for (size_t j = (i + 1) & mask; map->slots[j].hash != 0; j = (j + 1) & mask) {
+		size_t home = map->slots[j].hash & mask;
+		//j may move into the hole at i unless its home lies cyclically in (i, j]
+		int stays = (i <= j) ? (home > i && home <= j) : (home > i || home <= j);
+		if (!stays) {
+			map->slots[i] = map->slots[j];
+			i = j;
+		}
+	}
+	map->slots[i].hash = 0;
+	map->size--;
+	return 1;
+}
+
+/*
+ * Calls fn for every entry, in table order; inline keys are passed as
+ * ApInt views of the slot, valid only during the call
+ */
+void apint_map_foreach(const ApIntMap *map, void (*fn)(void *arg, const ApInt *key, void *value), void *arg) {
+	for (size_t i = 0; i < map->capacity; i++) {
+		const ApIntMapEntry *e = &map->slots[i];
+		if (e->hash == 0) {
+			continue;
+		}
+		if (e->len > AP_MAP_INLINE) {
+			fn(arg, e->k.key, e->value);
+		} else {
+			ApInt view = { (e->len > 0) ? e->len : 1, e->flags, (uint64_t *) e->k.limbs, NULL };
+			fn(arg, &view, e->value);
+		}
+	}
+}
@@ -0,0 +1,59 @@
+/*
+ * Hashing and hash maps keyed by ApInt
+ *
+ * apint_hash covers the sign and the normalized limbs, so equal values
+ * hash equally whatever their len. An ApIntMap is an open-addressing
+ * (linear probing) table from ApInt keys to void * values. Keys of up
+ * to AP_MAP_INLINE limbs are copied into the slot itself, so probing
+ * and comparing them touches no other memory; longer keys share their
+ * limbs with the caller's value (see apint_copy).
+ */
+
+#ifndef APHASH_H
+#define APHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "apint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AP_MAP_INLINE 2 //limbs stored in the slot
+
+typedef struct {
+	uint64_t hash;  //0 marks an empty slot
+	uint32_t len;   //normalized limbs of the key
+	uint32_t flags;
+	union {
+		uint64_t limbs[AP_MAP_INLINE]; //len <= AP_MAP_INLINE
+		ApInt *key;                    //longer keys
+	} k;
+	void *value;
+} ApIntMapEntry;
+
+typedef struct {
+	ApIntMapEntry *slots;
+	size_t capacity; //power of 2
+	size_t size;
+	uint64_t seed;
+} ApIntMap;
+
+/* Hashing and equality */
+uint64_t apint_hash(const ApInt *ap, uint64_t seed);
+int apint_equal(const ApInt *a, const ApInt *b);
+
+/* Maps */
+ApIntMap *apint_map_create(size_t expected, uint64_t seed);
+void apint_map_destroy(ApIntMap *map);
+void **apint_map_find(const ApIntMap *map, const ApInt *key);
+int apint_map_insert(ApIntMap *map, const ApInt *key, void *value);
+int apint_map_remove(ApIntMap *map, const ApInt *key, void **value);
+void apint_map_foreach(const ApIntMap *map, void (*fn)(void *arg, const ApInt *key, void *value), void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APHASH_H */
@@ -8,8 +8,12 @@
 #include <string.h>
 #include <assert.h>
 #include "apint.h"
+#include "apthread.h"
+#include "apcpu.h"
 #include <stdio.h>
+#include <pthread.h>
 #include <math.h>
+#include "apstats.h"
 
 /* Parameters: val (unsigned 64 bit value) 
  * Declare and initialize new ApInt using val 
@@ -20,6 +24,7 @@ ApInt *apint_create_from_u64(uint64_t val) {
         assert(ap != NULL); //check memory allocation
         ap->len = 1;
         ap->flags = 1; //1 = 0/+, 0 = - , unsigned, so always +
+        ap->refs = NULL;
         ap->data = (uint64_t *)calloc(1, sizeof(uint64_t));
         ap->data[0] = val;
         return ap;
@@ -118,9 +123,11 @@ ApInt * fill_data_from_hex(ApInt * ap, const char * hex, int start) {
  * Returns pointer to ApInt instance, NULL if invalid hex string
  */
 ApInt *apint_create_from_hex(const char *hex) {
+        APINT_STATS_OP(AP_OP_CREATE_FROM_HEX, strlen(hex) / 16 + 1);
         ApInt *ap = (ApInt*) malloc(sizeof(ApInt));
         assert(ap != NULL); //check memory allocation
         ap->flags = 1;
+        ap->refs = NULL;
         int start = 0;
         if (*hex == '-') { //neg hex value
                 ap->flags = 0; //1 = 0/+, 0 = -
@@ -148,11 +155,86 @@ ApInt *apint_create_from_hex(const char *hex) {
  * Destructor, frees memory in data and ApInt
  */
 void apint_destroy(ApInt *ap) {
-        /* TODO: implement */
-        free(ap->data);
+        limbs_release(ap);
         free(ap);
 }
 
+/*
+ * Shared limb buffers
+ * data is owned outright while refs is NULL. The first copy installs a
+ * heap counter (starting at 1 for the original) that every sharer points
+ * to; the last sharer to let go frees data and the counter. Writers call
+ * apint_make_writable, which copies the limbs only if they are shared.
+ */
+
+/* 
+ * Drops ap's reference to its limbs, freeing them if it was the last one
+ */
+void limbs_release(ApInt *ap) {
+	if (ap->refs == NULL) {
+		free(ap->data);
+	} else if (__atomic_sub_fetch(ap->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+		free(ap->data);
+		free(ap->refs);
+	}
+	ap->data = NULL;
+	ap->refs = NULL;
+}
+
+/* 
+ * Returns a new ApInt sharing the limbs of ap
+ * Safe while other threads copy or read the same ap
+ */
+ApInt *apint_copy(const ApInt *ap) {
+	APINT_STATS_OP(AP_OP_COPY, ap->len);
+	ApInt *copy = (ApInt*) malloc(sizeof(ApInt));
+	assert(copy != NULL); //check memory allocation
+	long *refs = __atomic_load_n(&ap->refs, __ATOMIC_ACQUIRE);
+	if (refs == NULL) { //first share, install a counter for the original
+		long *fresh = (long *)malloc(sizeof(long));
+		assert(fresh != NULL); //check memory allocation
+		*fresh = 1;
+		if (__atomic_compare_exchange_n(&((ApInt *) ap)->refs, &refs, fresh, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			refs = fresh;
+		} else {
+			free(fresh); //another thread installed one first, refs now holds it
+		}
+	}
+	__atomic_add_fetch(refs, 1, __ATOMIC_RELAXED);
+	copy->len = ap->len;
+	copy->flags = ap->flags;
+	copy->data = ap->data;
+	copy->refs = refs;
+	return copy;
+}
+
+/* 
+ * Makes ap the only owner of its limbs and grows them to at least len
+ * limbs (new limbs are 0, ap->len is raised to match)
+ */
+void apint_make_writable(ApInt *ap, size_t len) {
+	if (len < ap->len) {
+		len = ap->len;
+	}
+	if (ap->refs != NULL && __atomic_load_n(ap->refs, __ATOMIC_ACQUIRE) == 1) {
+		free(ap->refs); //every other sharer is gone
+		ap->refs = NULL;
+	}
+	if (ap->refs != NULL) { //still shared, copy
+		uint64_t *data = (uint64_t *)malloc(len * sizeof(uint64_t));
+		assert(data != NULL); //check memory allocation
+		memcpy(data, ap->data, ap->len * sizeof(uint64_t));
+		memset(data + ap->len, 0, (len - ap->len) * sizeof(uint64_t));
+		limbs_release(ap);
+		ap->data = data;
+	} else if (len > ap->len) {
+		ap->data = (uint64_t *)realloc(ap->data, len * sizeof(uint64_t));
+		assert(ap->data != NULL); //check memory allocation
+		memset(ap->data + ap->len, 0, (len - ap->len) * sizeof(uint64_t));
+	}
+	ap->len = len;
+}
+
 /* 
  * Determines if ApInt data is equal to 0 
  * Loops through all elements of ApInt data array
@@ -288,6 +370,7 @@ char * rev_hex_string(const ApInt *ap, char * hex) {
  */
 
 char *apint_format_as_hex(const ApInt *ap) {
+        APINT_STATS_OP(AP_OP_FORMAT_AS_HEX, ap->len);
         if (apint_is_zero(ap) == 1) {
                 char *hex = malloc(2*sizeof(char));
                 hex[0] = '0';
@@ -318,33 +401,28 @@ char *apint_format_as_hex(const ApInt *ap) {
 
 /* 
  * Creates new instance of ApInt with same data value and opposite flag
+ * The limbs are shared with ap, not copied
  * If 0, flag remains 1
  */
 ApInt *apint_negate(const ApInt *ap) {
-        uint32_t i;
-        int is_zero = 1; //1 if true, 0 if false
-
-        ApInt *ap2 = (ApInt*) malloc(sizeof(ApInt));
-        assert(ap2 != NULL);    //check if memory allocated
-
-        //copy length and data of ap to negated ap
-        ap2->len = ap->len;
-        ap2->data = (uint64_t *)calloc(ap2->len, sizeof(uint64_t));
-        for (i=0; i<ap->len; i++) {
-                ap2->data[i] = ap->data[i];
-                if(ap->data[i] != 0) {
-                        is_zero = 0;
-                }
-        }
-
-        if (is_zero == 1) {
-                ap2->flags = ap->flags; //flag 1 for data == 0
-        } else {
+        APINT_STATS_OP(AP_OP_NEGATE, ap->len);
+        ApInt *ap2 = apint_copy(ap);
+        if (apint_is_zero(ap) == 0) {
                 ap2->flags = (ap->flags == 0) ? 1: 0; //input opposite flag
         }
         return ap2;
 }
 
+/* 
+ * Creates new instance of ApInt with the magnitude of ap, sharing its limbs
+ */
+ApInt *apint_abs(const ApInt *ap) {
+        APINT_STATS_OP(AP_OP_NEGATE, ap->len);
+        ApInt *ap2 = apint_copy(ap);
+        ap2->flags = 1;
+        return ap2;
+}
+
 /* 
  * Allocates memory for ApInt data array 
  * Sets flag, len, data for condition 0
@@ -357,13 +435,45 @@ void set_zero_data(ApInt *ap) {
 	ap->flags = 1;
 }
 
+/* 
+ * Sign-magnitude view of ap, borrows its limbs
+ */
+ApView apint_view(const ApInt *ap) {
+	ApView v = { ap->len, ap->flags, ap->data };
+	return v;
+}
+
+/* 
+ * View of -ap over the same limbs, 0 keeps flag 1
+ */
+ApView apint_view_negated(const ApInt *ap) {
+	ApView v = { ap->len, ap->flags, ap->data };
+	if (apint_is_zero(ap) == 0) {
+		v.flags = (ap->flags == 0) ? 1 : 0;
+	}
+	return v;
+}
+
+/* 
+ * Compares the magnitudes of two views, same results as left_greater
+ */
+static int view_greater(const ApView *left, const ApView *right) {
+	size_t ln = limbs_normalized_len(left->data, left->len);
+	size_t rn = limbs_normalized_len(right->data, right->len);
+	if (ln != rn) {
+		return (ln > rn) ? 1 : -1;
+	}
+	return limbs_cmp(left->data, right->data, ln);
+}
+
 /*
- * Perform mathematical subtraction for two ApInt instances 
+ * Perform mathematical subtraction for two views (difference of magnitudes)
+ * diff takes the sign of the view with the greater magnitude
  */
-ApInt *calc_sub(const ApInt *a, const ApInt *b, ApInt *diff) {
-        int a_greater = left_greater(a, b);
-        const ApInt *greater = a;
-      	const ApInt *less = b;
+ApInt *calc_sub(const ApView *a, const ApView *b, ApInt *diff) {
+        int a_greater = view_greater(a, b);
+        const ApView *greater = a;
+      	const ApView *less = b;
         if (a_greater == 0) { //subtraction of equal values is 0
 		set_zero_data(diff); 
                 return diff;
@@ -371,108 +481,83 @@ ApInt *calc_sub(const ApInt *a, const ApInt *b, ApInt *diff) {
                 greater = b;
                 less = a;
         }
-        uint64_t next_borrow = 0, prev_borrow = 0;
-
-        diff->flags = greater->flags; //flags and len from larger value
-        diff->len = greater->len;
-        diff->data = (uint64_t *)calloc(diff->len, sizeof(uint64_t));
-        for (uint32_t pos = 0; pos < greater->len; pos++) {
-                if (pos <= less->len - 1) {
-                        if (greater->data[pos] < less->data[pos] + prev_borrow) { //overflow
-                                next_borrow = 1;
-                        } else {
-                                next_borrow = 0;
-                        }
-
-                        diff->data[pos] = greater->data[pos] - less->data[pos] - prev_borrow;
-                } else { //if less is shorter than greater 
-			if (greater->data[pos] - prev_borrow > greater->data[pos]) { //overflow
-				next_borrow = 1; 
-			} else {
-				next_borrow = 0; 
-			}
-                        diff->data[pos] = greater->data[pos] - prev_borrow;
-                }
-		
-		prev_borrow = next_borrow; 
-        }
+	size_t gn = limbs_normalized_len(greater->data, greater->len);
+	size_t ln = limbs_normalized_len(less->data, less->len);
 
+        diff->flags = greater->flags; //flags from larger value
+        diff->data = (uint64_t *)malloc(gn * sizeof(uint64_t));
+	assert(diff->data != NULL); //check memory allocation
+	if (ln == 0) {
+		memcpy(diff->data, greater->data, gn * sizeof(uint64_t));
+	} else {
+		limbs_sub(diff->data, greater->data, gn, less->data, ln);
+	}
+	diff->len = limbs_normalized_len(diff->data, gn); //nonzero, magnitudes differ
         return diff;
 }
 
 /* 
- * Performs mathematical addition 
+ * Performs mathematical addition of two views (sum of magnitudes)
+ * sum takes the sign of a
  */
-ApInt *calc_add(const ApInt *a, const ApInt *b, ApInt *sum) {
-        int a_greater = left_greater(a, b);
-        const ApInt *greater = a;
-        const ApInt *less = b;
-        if (apint_is_zero(a) == 1 && apint_is_zero(b) == 1) { //addition of equal values
+ApInt *calc_add(const ApView *a, const ApView *b, ApInt *sum) {
+        const ApView *greater = a;
+        const ApView *less = b;
+	size_t gn = limbs_normalized_len(a->data, a->len);
+	size_t ln = limbs_normalized_len(b->data, b->len);
+        if (gn == 0 && ln == 0) { //addition of zeros
 		set_zero_data(sum); 
                 return sum;
         }
-        if (a_greater == -1) {
+        if (gn < ln) {
                 greater = b;
                 less = a;
+		size_t t = gn;
+		gn = ln;
+		ln = t;
         }
-        uint64_t next_carry = 0, prev_carry = 0;
-        sum->flags = greater->flags; //set flags and len of greater
-        sum->len = greater->len;
-        sum->data = (uint64_t *)calloc(sum->len, sizeof(uint64_t));
-	uint64_t sum_value; 
-        for (uint32_t pos = 0; pos < greater->len; pos++) {
-                if (pos <= less->len - 1) {
-                        sum_value = greater->data[pos] + less->data[pos] + prev_carry;
-                        if (sum_value < greater->data[pos] || sum_value < less->data[pos]) {
-                                next_carry = 1;
-                        } else {
-                                next_carry = 0;
-                        }
-
-                } else {
-			sum_value = greater->data[pos] + prev_carry; 
-			if (sum_value < greater->data[pos]) {
-				next_carry = 1; 
-			} else {
-				next_carry = 0; 
-			}
-                }
-                sum->data[pos] = sum_value;
-                prev_carry = next_carry;
-        }
-
-	//allocate additional data for carry over
-        if (prev_carry == 1) {
-                sum->data = (uint64_t *)realloc(sum->data, (sum->len + 1)*sizeof(uint64_t));
-                sum->data[sum->len] = 1UL;
-		sum->len = sum->len + 1;
-        }
-
+        sum->flags = a->flags;
+        sum->data = (uint64_t *)malloc((gn + 1) * sizeof(uint64_t)); //room for a carry out
+	assert(sum->data != NULL); //check memory allocation
+	sum->data[gn] = limbs_add(sum->data, greater->data, gn, less->data, ln);
+	sum->len = gn + (sum->data[gn] != 0);
         return sum;
 }
 
 /* 
- * Returns addition of two ApInt instances
+ * Returns a + b for two views, the limbs are read once and nothing is copied
  */
-ApInt *apint_add(const ApInt *a, const ApInt *b) {
+ApInt *apint_add_views(const ApView *a, const ApView *b) {
         ApInt *result = (ApInt*) malloc(sizeof(ApInt));
         assert(result != NULL); //check memory allocation
+        result->refs = NULL;
         if (a->flags == b->flags) { //if both neg/pos, then data is sum
-                result = calc_add(a, b, result);
+                calc_add(a, b, result);
         } else { //if opposite flags, then data is difference
-               result = calc_sub(a, b, result);
+		calc_sub(a, b, result);
 	}
         return result;
 }
 
+/* 
+ * Returns addition of two ApInt instances
+ */
+ApInt *apint_add(const ApInt *a, const ApInt *b) {
+	APINT_STATS_OP(AP_OP_ADD, (a->len > b->len) ? a->len : b->len);
+	ApView va = apint_view(a);
+	ApView vb = apint_view(b);
+	return apint_add_views(&va, &vb);
+}
+
 /*
  * Returns subtraction of two ApInt instances
+ * Subtraction is addition of a negated view of b, b is neither copied nor modified
  */
 ApInt *apint_sub(const ApInt *a, const ApInt *b) {
-	ApInt *neg_b = apint_negate(b); 
-	ApInt *result = apint_add(a, neg_b); //subtraction is addition of neg number
-	apint_destroy(neg_b); 
-	return result; 
+	APINT_STATS_OP(AP_OP_SUB, (a->len > b->len) ? a->len : b->len);
+	ApView va = apint_view(a);
+	ApView vb = apint_view_negated(b);
+	return apint_add_views(&va, &vb);
 }
 
 /* 
@@ -509,6 +594,7 @@ int left_greater(const ApInt *left, const ApInt *right) {
  * Returns 1: left > right, -1: right > left, 0: right == left
  */
 int apint_compare(const ApInt *left, const ApInt *right) {
+        APINT_STATS_OP(AP_OP_COMPARE, (left->len > right->len) ? left->len : right->len);
         if (left->flags > right->flags) {
                 return 1; //left pos, right neg
         }
@@ -540,7 +626,7 @@ ApInt *apint_lshift(ApInt *ap) {
  */
 ApInt *full_left_shifts(ApInt *ap, ApInt *ap_shift, unsigned full_shifts) {
 	for (uint32_t i=0; i<ap_shift->len; i++) {
-                if (i < full_shifts) {
+                if (i < full_shifts || i - full_shifts >= ap->len) { //past either end of ap
                         ap_shift->data[i] = 0UL;
                 } else {
                         ap_shift->data[i] =  ap->data[i - full_shifts];
@@ -579,9 +665,11 @@ ApInt *bit_left_shifts(ApInt *ap, ApInt *ap_shift, unsigned indiv_shifts) {
  * Returns new ApInt instance of shifted left n times
  */
 ApInt *apint_lshift_n(ApInt *ap, unsigned n) {
+	APINT_STATS_OP(AP_OP_LSHIFT_N, ap->len);
 	ApInt *ap_shift = (ApInt*) malloc(sizeof(ApInt));
         assert(ap_shift != NULL); //check memory allocation
         ap_shift->flags  = ap->flags;
+        ap_shift->refs = NULL;
 
 	int highest_bit = apint_highest_bit_set(ap); 
 	int full_shifts = (n+1+highest_bit)/64;
@@ -604,3 +692,2014 @@ ApInt *apint_lshift_n(ApInt *ap, unsigned n) {
 	return ap_shift; 
 
 }
+
+/*
+ * Limb kernels
+ * Operate on little-endian arrays of 64 bit limbs (same layout as ApInt data)
+ */
+
+__extension__ typedef unsigned __int128 u128;
+
+/* 
+ * Number of limbs once leading zero limbs are ignored
+ * Returns 0 if every limb is 0
+ */
+size_t limbs_normalized_len(const uint64_t *ap, size_t n) {
+	while (n > 0 && ap[n - 1] == 0) {
+		n--;
+	}
+	return n;
+}
+
+/* 
+ * Compares two n limb arrays
+ * Returns 1: a greater, -1: b greater, 0: equal
+ */
+int limbs_cmp(const uint64_t *ap, const uint64_t *bp, size_t n) {
+	while (n > 0) {
+		n--;
+		if (ap[n] != bp[n]) {
+			return (ap[n] > bp[n]) ? 1 : -1;
+		}
+	}
+	return 0;
+}
+
+/* 
+ * rp = ap + bp (n limbs each), returns carry out
+ */
+uint64_t limbs_add_n_generic(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n) {
+	uint64_t carry = 0;
+	for (size_t i = 0; i < n; i++) {
+		uint64_t s = ap[i] + bp[i];
+		uint64_t c = s < ap[i];
+		rp[i] = s + carry;
+		carry = c | (rp[i] < s);
+	}
+	return carry;
+}
+
+/* 
+ * rp = ap - bp (n limbs each), returns borrow out
+ */
+uint64_t limbs_sub_n_generic(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n) {
+	uint64_t borrow = 0;
+	for (size_t i = 0; i < n; i++) {
+		uint64_t d = ap[i] - bp[i];
+		uint64_t b = ap[i] < bp[i];
+		rp[i] = d - borrow;
+		borrow = b | (d < borrow);
+	}
+	return borrow;
+}
+
+/* 
+ * rp = ap + b (n limbs, single limb b), returns carry out
+ */
+uint64_t limbs_add_1(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b) {
+	for (size_t i = 0; i < n; i++) {
+		rp[i] = ap[i] + b;
+		b = rp[i] < b;
+	}
+	return b;
+}
+
+/* 
+ * rp = ap - b (n limbs, single limb b), returns borrow out
+ */
+uint64_t limbs_sub_1(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b) {
+	for (size_t i = 0; i < n; i++) {
+		uint64_t a = ap[i];
+		rp[i] = a - b;
+		b = a < b;
+	}
+	return b;
+}
+
+/* 
+ * rp = ap + bp where an >= bn, rp has an limbs, returns carry out
+ */
+uint64_t limbs_add(uint64_t *rp, const uint64_t *ap, size_t an, const uint64_t *bp, size_t bn) {
+	uint64_t carry = limbs_add_n(rp, ap, bp, bn);
+	return limbs_add_1(rp + bn, ap + bn, an - bn, carry);
+}
+
+/* 
+ * rp = ap - bp where an >= bn, rp has an limbs, returns borrow out
+ */
+uint64_t limbs_sub(uint64_t *rp, const uint64_t *ap, size_t an, const uint64_t *bp, size_t bn) {
+	uint64_t borrow = limbs_sub_n(rp, ap, bp, bn);
+	return limbs_sub_1(rp + bn, ap + bn, an - bn, borrow);
+}
+
+/* 
+ * rp = ap * b (n limbs), returns the high limb of the product
+ */
+uint64_t limbs_mul_1_generic(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b) {
+	uint64_t carry = 0;
+	for (size_t i = 0; i < n; i++) {
+		u128 p = (u128) ap[i] * b + carry;
+		rp[i] = (uint64_t) p;
+		carry = (uint64_t) (p >> 64);
+	}
+	return carry;
+}
+
+/* 
+ * rp += ap * b (n limbs), returns the limb carried out of rp[n-1]
+ */
+uint64_t limbs_addmul_1_generic(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b) {
+	uint64_t carry = 0;
+	for (size_t i = 0; i < n; i++) {
+		u128 p = (u128) ap[i] * b + rp[i] + carry;
+		rp[i] = (uint64_t) p;
+		carry = (uint64_t) (p >> 64);
+	}
+	return carry;
+}
+
+/* 
+ * rp -= ap * b (n limbs), returns the limb borrowed out of rp[n-1]
+ */
+uint64_t limbs_submul_1_generic(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b) {
+	uint64_t borrow = 0;
+	for (size_t i = 0; i < n; i++) {
+		u128 p = (u128) ap[i] * b + borrow;
+		uint64_t lo = (uint64_t) p;
+		borrow = (uint64_t) (p >> 64) + (rp[i] < lo);
+		rp[i] -= lo;
+	}
+	return borrow;
+}
+
+/* 
+ * floor((B^2 - 1) / d) - B for a normalized d (top bit set), B = 2^64
+ */
+static uint64_t limb_reciprocal(uint64_t d) {
+	return (uint64_t) ((((u128) ~d) << 64 | ~0UL) / d);
+}
+
+/* 
+ * Divides (u1, u0) by a normalized d with u1 < d using its reciprocal v
+ * (Moller-Granlund), returns the quotient and stores the remainder in r
+ */
+static uint64_t div_2by1(uint64_t *r, uint64_t u1, uint64_t u0, uint64_t d, uint64_t v) {
+	u128 q = (u128) v * u1 + (((u128) u1 << 64) | u0);
+	uint64_t q1 = (uint64_t) (q >> 64) + 1;
+	uint64_t q0 = (uint64_t) q;
+	uint64_t rem = u0 - q1 * d;
+	if (rem > q0) {
+		q1--;
+		rem += d;
+	}
+	if (rem >= d) {
+		q1++;
+		rem -= d;
+	}
+	*r = rem;
+	return q1;
+}
+
+/* 
+ * Prepares d != 0 for repeated division: normalized copy and reciprocal
+ */
+void limb_divisor_init(ApLimbDivisor *dv, uint64_t d) {
+	dv->shift = __builtin_clzl(d);
+	dv->norm = d << dv->shift;
+	dv->v = limb_reciprocal(dv->norm);
+}
+
+/* 
+ * (a * b) mod d for a, b < d
+ */
+uint64_t limb_mulmod(uint64_t a, uint64_t b, const ApLimbDivisor *dv) {
+	u128 t = ((u128) a * b) << dv->shift; //a * b < d^2, so this fits and its high limb is < norm
+	uint64_t r;
+	div_2by1(&r, (uint64_t) (t >> 64), (uint64_t) t, dv->norm, dv->v);
+	return r >> dv->shift;
+}
+
+/* 
+ * qp = ap / d (n limbs), returns ap mod d; qp may be ap
+ * The divisor's reciprocal turns every limb into multiplications
+ */
+uint64_t limbs_divrem_1_preinv(uint64_t *qp, const uint64_t *ap, size_t n, const ApLimbDivisor *dv) {
+	unsigned shift = dv->shift;
+	uint64_t r = (shift != 0) ? ap[n - 1] >> (64 - shift) : 0; //bits shifted out of the top
+	for (size_t i = n; i-- > 0;) {
+		uint64_t u0 = ap[i] << shift;
+		if (shift != 0 && i > 0) {
+			u0 |= ap[i - 1] >> (64 - shift);
+		}
+		uint64_t q = div_2by1(&r, r, u0, dv->norm, dv->v);
+		if (qp != NULL) {
+			qp[i] = q;
+		}
+	}
+	return r >> shift;
+}
+
+/* 
+ * qp = ap / d (n limbs, d != 0), returns ap mod d; qp may be ap or NULL
+ */
+uint64_t limbs_divrem_1(uint64_t *qp, const uint64_t *ap, size_t n, uint64_t d) {
+	ApLimbDivisor dv;
+	limb_divisor_init(&dv, d);
+	return limbs_divrem_1_preinv(qp, ap, n, &dv);
+}
+
+/* 
+ * rp = ap << s (n limbs, 0 < s < 64), returns the bits shifted out
+ * rp may be ap
+ */
+uint64_t limbs_lshift_generic(uint64_t *rp, const uint64_t *ap, size_t n, unsigned s) {
+	uint64_t out = ap[n - 1] >> (64 - s);
+	for (size_t i = n - 1; i > 0; i--) {
+		rp[i] = (ap[i] << s) | (ap[i - 1] >> (64 - s));
+	}
+	rp[0] = ap[0] << s;
+	return out;
+}
+
+/* 
+ * rp = ap >> s (n limbs, 0 < s < 64), returns the bits shifted out
+ * (in the top of the limb); rp may be ap
+ */
+uint64_t limbs_rshift_generic(uint64_t *rp, const uint64_t *ap, size_t n, unsigned s) {
+	uint64_t out = ap[0] << (64 - s);
+	for (size_t i = 0; i + 1 < n; i++) {
+		rp[i] = (ap[i] >> s) | (ap[i + 1] << (64 - s));
+	}
+	rp[n - 1] = ap[n - 1] >> s;
+	return out;
+}
+
+/* 
+ * rp = ap & bp, ap | bp, ap ^ bp (n limbs each), rp may be ap or bp
+ */
+void limbs_and_n_generic(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		rp[i] = ap[i] & bp[i];
+	}
+}
+
+void limbs_ior_n_generic(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		rp[i] = ap[i] | bp[i];
+	}
+}
+
+void limbs_xor_n_generic(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		rp[i] = ap[i] ^ bp[i];
+	}
+}
+
+/* 
+ * Dispatched kernels, the version for this CPU (see apcpu.h)
+ */
+uint64_t limbs_add_n(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n) {
+	return apint_kernels.add_n(rp, ap, bp, n);
+}
+
+uint64_t limbs_sub_n(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n) {
+	return apint_kernels.sub_n(rp, ap, bp, n);
+}
+
+uint64_t limbs_mul_1(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b) {
+	return apint_kernels.mul_1(rp, ap, n, b);
+}
+
+uint64_t limbs_addmul_1(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b) {
+	return apint_kernels.addmul_1(rp, ap, n, b);
+}
+
+uint64_t limbs_submul_1(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b) {
+	return apint_kernels.submul_1(rp, ap, n, b);
+}
+
+uint64_t limbs_lshift(uint64_t *rp, const uint64_t *ap, size_t n, unsigned s) {
+	return apint_kernels.lshift(rp, ap, n, s);
+}
+
+uint64_t limbs_rshift(uint64_t *rp, const uint64_t *ap, size_t n, unsigned s) {
+	return apint_kernels.rshift(rp, ap, n, s);
+}
+
+void limbs_and_n(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n) {
+	apint_kernels.and_n(rp, ap, bp, n);
+}
+
+void limbs_ior_n(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n) {
+	apint_kernels.ior_n(rp, ap, bp, n);
+}
+
+void limbs_xor_n(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n) {
+	apint_kernels.xor_n(rp, ap, bp, n);
+}
+
+/* 
+ * Schoolbook long division (Knuth D): qp (un - dn + 1 limbs) = up / dp and
+ * rp (dn limbs) = up mod dp, for un >= dn >= 1 and dp[dn - 1] != 0
+ * Each quotient limb is estimated from the top two limbs and corrected
+ * at most twice, plus a rare add-back
+ */
+void limbs_divrem(uint64_t *qp, uint64_t *rp, const uint64_t *up, size_t un, const uint64_t *dp, size_t dn) {
+	if (dn == 1) {
+		rp[0] = limbs_divrem_1(qp, up, un, dp[0]);
+		return;
+	}
+	unsigned s = __builtin_clzl(dp[dn - 1]);
+	uint64_t *vn = (uint64_t *)malloc((dn + un + 1) * sizeof(uint64_t));
+	assert(vn != NULL); //check memory allocation
+	uint64_t *u = vn + dn;
+	if (s != 0) {
+		limbs_lshift(vn, dp, dn, s);
+		u[un] = limbs_lshift(u, up, un, s);
+	} else {
+		memcpy(vn, dp, dn * sizeof(uint64_t));
+		memcpy(u, up, un * sizeof(uint64_t));
+		u[un] = 0;
+	}
+	uint64_t v1 = vn[dn - 1], v2 = vn[dn - 2];
+
+	for (size_t j = un - dn + 1; j-- > 0;) {
+		u128 num = ((u128) u[j + dn] << 64) | u[j + dn - 1];
+		u128 qhat = num / v1;
+		u128 rhat = num - qhat * v1;
+		while (qhat >> 64 != 0 || qhat * v2 > ((rhat << 64) | u[j + dn - 2])) {
+			qhat--;
+			rhat += v1;
+			if (rhat >> 64 != 0) {
+				break;
+			}
+		}
+		uint64_t borrow = limbs_submul_1(u + j, vn, dn, (uint64_t) qhat);
+		uint64_t top = u[j + dn];
+		u[j + dn] = top - borrow;
+		if (top < borrow) { //estimate was one too large, add back
+			qhat--;
+			u[j + dn] += limbs_add_n(u + j, u + j, vn, dn);
+		}
+		qp[j] = (uint64_t) qhat;
+	}
+
+	if (s != 0) {
+		limbs_rshift(rp, u, dn, s);
+	} else {
+		memcpy(rp, u, dn * sizeof(uint64_t));
+	}
+	free(vn);
+}
+
+/*
+ * Scratch arena
+ * Bump allocator for temporaries of the multiplication routines,
+ * released in stack order by resetting used to an earlier mark
+ */
+void apint_scratch_init(ApScratch *s, size_t limbs) {
+	s->size = limbs;
+	s->used = 0;
+	s->base = NULL;
+	if (limbs > 0) {
+		s->base = (uint64_t *)malloc(limbs * sizeof(uint64_t));
+		assert(s->base != NULL); //check memory allocation
+	}
+}
+
+/* 
+ * Grows the arena to at least limbs, only valid while nothing is allocated
+ */
+void apint_scratch_reserve(ApScratch *s, size_t limbs) {
+	assert(s->used == 0);
+	if (limbs > s->size) {
+		free(s->base);
+		apint_scratch_init(s, limbs);
+	}
+}
+
+uint64_t *apint_scratch_alloc(ApScratch *s, size_t limbs) {
+	assert(s->used + limbs <= s->size); //sized up front by limbs_mul_scratch_size
+	uint64_t *p = s->base + s->used;
+	s->used += limbs;
+	return p;
+}
+
+void apint_scratch_release(ApScratch *s, size_t mark) {
+	s->used = mark;
+}
+
+void apint_scratch_destroy(ApScratch *s) {
+	free(s->base);
+	s->base = NULL;
+	s->size = 0;
+	s->used = 0;
+}
+
+/*
+ * Per-thread arenas
+ * Each thread keeps one arena between operations, so repeated products
+ * reuse its memory instead of allocating per call. The arena is taken
+ * with apint_scratch_acquire and given back with apint_scratch_return;
+ * while it is taken (nested operations, or a pool worker running a
+ * stolen task inside another one) callers get their local arena
+ * instead. Arenas above SCRATCH_KEEP_LIMBS are shrunk back to it on
+ * return, and freed when the thread exits.
+ */
+#define SCRATCH_KEEP_LIMBS (1UL << 20)
+
+typedef struct {
+	ApScratch s;
+	int taken;
+} ThreadScratch;
+
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+static _Thread_local ThreadScratch *thread_scratch;
+
+static void thread_scratch_free(void *p) {
+	ThreadScratch *t = (ThreadScratch *)p;
+	apint_scratch_destroy(&t->s);
+	free(t);
+}
+
+static void scratch_key_init(void) {
+	pthread_key_create(&scratch_key, thread_scratch_free); //runs at thread exit
+}
+
+/*
+ * Returns the calling thread's arena, or local (initialized empty) if
+ * that is taken; either way with at least limbs free
+ */
+ApScratch *apint_scratch_acquire(ApScratch *local, size_t limbs) {
+	ThreadScratch *t = thread_scratch;
+	if (t == NULL) {
+		t = (ThreadScratch *)calloc(1, sizeof(ThreadScratch));
+		assert(t != NULL); //check memory allocation
+		pthread_once(&scratch_once, scratch_key_init);
+		pthread_setspecific(scratch_key, t);
+		thread_scratch = t;
+	}
+	ApScratch *s = local;
+	if (t->taken) {
+		apint_scratch_init(local, 0);
+	} else {
+		t->taken = 1;
+		s = &t->s;
+	}
+	apint_scratch_reserve(s, limbs);
+	return s;
+}
+
+/*
+ * Gives back an arena from apint_scratch_acquire with the same local
+ */
+void apint_scratch_return(ApScratch *s, ApScratch *local) {
+	if (s == local) {
+		apint_scratch_destroy(local);
+		return;
+	}
+	s->used = 0;
+	if (s->size > SCRATCH_KEEP_LIMBS) {
+		uint64_t *base = (uint64_t *)realloc(s->base, SCRATCH_KEEP_LIMBS * sizeof(uint64_t));
+		assert(base != NULL); //check memory allocation
+		s->base = base;
+		s->size = SCRATCH_KEEP_LIMBS;
+	}
+	thread_scratch->taken = 0;
+}
+
+/*
+ * Multiplication
+ * Schoolbook below KARATSUBA_THRESHOLD limbs, Karatsuba above it
+ */
+#define KARATSUBA_THRESHOLD 32
+
+/* 
+ * Schoolbook product, rp (an + bn limbs) = ap * bp, an >= bn >= 1
+ */
+void limbs_mul_basecase(uint64_t *rp, const uint64_t *ap, size_t an, const uint64_t *bp, size_t bn) {
+	if (an == bn && an == 4) {
+		apint_kernels.mul_4x4(rp, ap, bp);
+		return;
+	}
+	if (an == bn && an == 8) {
+		apint_kernels.mul_8x8(rp, ap, bp);
+		return;
+	}
+	rp[an] = limbs_mul_1(rp, ap, an, bp[0]);
+	for (size_t j = 1; j < bn; j++) {
+		rp[an + j] = limbs_addmul_1(rp + j, ap, an, bp[j]);
+	}
+}
+
+/* 
+ * Fixed n x n schoolbook product with 128 bit accumulation, the loops
+ * unroll completely for constant n
+ */
+static inline void mul_fixed_generic(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		rp[i] = 0;
+	}
+	for (size_t j = 0; j < n; j++) {
+		uint64_t carry = 0;
+		for (size_t i = 0; i < n; i++) {
+			u128 p = (u128) ap[i] * bp[j] + rp[i + j] + carry;
+			rp[i + j] = (uint64_t) p;
+			carry = (uint64_t) (p >> 64);
+		}
+		rp[n + j] = carry;
+	}
+}
+
+/* 
+ * rp (8 limbs) = ap * bp (4 limbs each)
+ */
+void limbs_mul_4x4_generic(uint64_t *rp, const uint64_t *ap, const uint64_t *bp) {
+	mul_fixed_generic(rp, ap, bp, 4);
+}
+
+/* 
+ * rp (16 limbs) = ap * bp (8 limbs each)
+ */
+void limbs_mul_8x8_generic(uint64_t *rp, const uint64_t *ap, const uint64_t *bp) {
+	mul_fixed_generic(rp, ap, bp, 8);
+}
+
+/* 
+ * Scratch limbs needed by an n x n Karatsuba product
+ */
+static size_t karatsuba_scratch_size(size_t n) {
+	size_t total = 0;
+	while (n >= KARATSUBA_THRESHOLD) {
+		size_t h = (n + 1) / 2;
+		total += 6 * h + 1;
+		n = h;
+	}
+	return total;
+}
+
+/* 
+ * Scratch limbs needed by limbs_mul for an an x bn product
+ */
+size_t limbs_mul_scratch_size(size_t an, size_t bn) {
+	if (bn < KARATSUBA_THRESHOLD) {
+		return 0;
+	}
+	if (an == bn) {
+		return karatsuba_scratch_size(bn);
+	}
+	size_t rest = limbs_mul_scratch_size(bn, an % bn);
+	size_t full = karatsuba_scratch_size(bn);
+	return 2 * bn + (rest > full ? rest : full);
+}
+
+/* 
+ * rp = |ap - bp| where ap has n limbs and bp has m <= n limbs
+ * Returns 1 if ap < bp (difference is negative), 0 otherwise
+ */
+static int limbs_abs_diff(uint64_t *rp, const uint64_t *ap, size_t n, const uint64_t *bp, size_t m) {
+	if (limbs_normalized_len(ap + m, n - m) > 0 || limbs_cmp(ap, bp, m) >= 0) {
+		limbs_sub(rp, ap, n, bp, m);
+		return 0;
+	}
+	limbs_sub_n(rp, bp, ap, m); //ap fits in m limbs here
+	memset(rp + m, 0, (n - m) * sizeof(uint64_t));
+	return 1;
+}
+
+/*
+ * Sub-product handed to the thread pool
+ */
+typedef struct {
+	uint64_t *rp;
+	const uint64_t *ap;
+	size_t an;
+	const uint64_t *bp;
+	size_t bn;
+} MulTask;
+
+static void mul_task(void *arg) {
+	MulTask *m = (MulTask *)arg;
+	ApScratch local;
+	ApScratch *s = apint_scratch_acquire(&local, limbs_mul_scratch_size(m->an, m->bn));
+	limbs_mul(m->rp, m->ap, m->an, m->bp, m->bn, s);
+	apint_scratch_return(s, &local);
+}
+
+/* 
+ * Karatsuba product of two n limb arrays into rp (2n limbs)
+ * Uses the subtractive form: z1 = z0 + z2 - (a0 - a1)(b0 - b1)
+ */
+static void limbs_mul_karatsuba(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n, ApScratch *s) {
+	size_t h = (n + 1) / 2, l = n - h;
+	size_t mark = s->used;
+	uint64_t *da = apint_scratch_alloc(s, h);
+	uint64_t *db = apint_scratch_alloc(s, h);
+	uint64_t *t = apint_scratch_alloc(s, 2 * h);
+	uint64_t *z1 = apint_scratch_alloc(s, 2 * h + 1);
+
+	int neg = limbs_abs_diff(da, ap, h, ap + h, l);
+	neg ^= limbs_abs_diff(db, bp, h, bp + h, l);
+
+	if (apint_threads_active() && n >= apint_threads_grain()) {
+		//z0 and z2 go to the pool, each with its own scratch
+		MulTask z0 = { rp, ap, h, bp, h }, z2 = { rp + 2 * h, ap + h, l, bp + h, l };
+		ApTaskGroup g;
+		ApTask t0, t2;
+		apint_task_group_init(&g);
+		apint_task_spawn(&g, &t0, mul_task, &z0);
+		apint_task_spawn(&g, &t2, mul_task, &z2);
+		limbs_mul(t, da, h, db, h, s);
+		apint_task_wait(&g);
+	} else {
+		limbs_mul(rp, ap, h, bp, h, s); //z0 = a0 * b0
+		limbs_mul(rp + 2 * h, ap + h, l, bp + h, l, s); //z2 = a1 * b1
+		limbs_mul(t, da, h, db, h, s);
+	}
+
+	//z1 = z0 + z2 -/+ t
+	z1[2 * h] = limbs_add(z1, rp, 2 * h, rp + 2 * h, 2 * l);
+	if (neg) {
+		z1[2 * h] += limbs_add_n(z1, z1, t, 2 * h);
+	} else {
+		z1[2 * h] -= limbs_sub_n(z1, z1, t, 2 * h);
+	}
+
+	//add z1 at offset h, limbs past 2n are zero since the product fits
+	size_t add_len = 2 * h + 1;
+	if (h + add_len > 2 * n) {
+		add_len = 2 * n - h;
+	}
+	uint64_t carry = limbs_add_n(rp + h, rp + h, z1, add_len);
+	limbs_add_1(rp + h + add_len, rp + h + add_len, 2 * n - h - add_len, carry);
+
+	apint_scratch_release(s, mark);
+}
+
+/* 
+ * rp (an + bn limbs) = ap * bp, an >= bn >= 1, rp must not overlap the inputs
+ * s must have at least limbs_mul_scratch_size(an, bn) free limbs
+ */
+void limbs_mul(uint64_t *rp, const uint64_t *ap, size_t an, const uint64_t *bp, size_t bn, ApScratch *s) {
+	if (bn < KARATSUBA_THRESHOLD) {
+		limbs_mul_basecase(rp, ap, an, bp, bn);
+		return;
+	}
+	if (an == bn) {
+		limbs_mul_karatsuba(rp, ap, bp, bn, s);
+		return;
+	}
+
+	//unbalanced: multiply bn limb chunks of ap and accumulate
+	size_t mark = s->used;
+	uint64_t *tmp = apint_scratch_alloc(s, 2 * bn);
+	limbs_mul_karatsuba(rp, ap, bp, bn, s);
+	for (size_t i = bn; i < an; i += bn) {
+		size_t c = (an - i < bn) ? an - i : bn;
+		if (c == bn) {
+			limbs_mul_karatsuba(tmp, ap + i, bp, bn, s);
+		} else {
+			limbs_mul(tmp, bp, bn, ap + i, c, s);
+		}
+		uint64_t carry = limbs_add_n(rp + i, rp + i, tmp, bn);
+		limbs_add_1(rp + i + bn, tmp + bn, c, carry);
+	}
+	apint_scratch_release(s, mark);
+}
+
+/* 
+ * Wraps a malloc'd limb array (ownership is taken) into a new ApInt
+ * Leading zero limbs are trimmed, a zero value gets flags 1
+ */
+ApInt *apint_wrap_limbs(uint64_t *data, size_t n, uint32_t flags) {
+	ApInt *ap = (ApInt*) malloc(sizeof(ApInt));
+	assert(ap != NULL); //check memory allocation
+	ap->refs = NULL;
+	n = limbs_normalized_len(data, n);
+	if (n == 0) {
+		free(data);
+		set_zero_data(ap);
+		return ap;
+	}
+	ap->data = data;
+	ap->len = n;
+	ap->flags = flags;
+	return ap;
+}
+
+/* 
+ * Multiplies magnitudes of a and b using scratch, returns the product limbs
+ * Sets *n to the product length, returns NULL if either value is 0
+ */
+static uint64_t *mul_magnitudes(const uint64_t *ap, size_t an, const uint64_t *bp, size_t bn, size_t *n, ApScratch *s) {
+	an = limbs_normalized_len(ap, an);
+	bn = limbs_normalized_len(bp, bn);
+	if (an == 0 || bn == 0) {
+		*n = 0;
+		return NULL;
+	}
+	if (an < bn) { //limbs_mul wants the longer operand first
+		const uint64_t *tp = ap;
+		size_t tn = an;
+		ap = bp; an = bn;
+		bp = tp; bn = tn;
+	}
+	uint64_t *prod = (uint64_t *)malloc((an + bn) * sizeof(uint64_t));
+	assert(prod != NULL); //check memory allocation
+	apint_scratch_reserve(s, limbs_mul_scratch_size(an, bn));
+	limbs_mul(prod, ap, an, bp, bn, s);
+	*n = an + bn;
+	return prod;
+}
+
+/* 
+ * Product of a and b using an existing scratch arena
+ */
+static ApInt *mul_with_scratch(const ApInt *a, const ApInt *b, ApScratch *s) {
+	size_t n;
+	uint64_t *prod = mul_magnitudes(a->data, a->len, b->data, b->len, &n, s);
+	return apint_wrap_limbs(prod, n, (a->flags == b->flags) ? 1 : 0);
+}
+
+/* 
+ * Returns product of two ApInt instances
+ */
+ApInt *apint_mul(const ApInt *a, const ApInt *b) {
+	APINT_STATS_OP(AP_OP_MUL, (a->len > b->len) ? a->len : b->len);
+	ApScratch local;
+	ApScratch *s = apint_scratch_acquire(&local, 0);
+	ApInt *result = mul_with_scratch(a, b, s);
+	apint_scratch_return(s, &local);
+	return result;
+}
+
+/*
+ * Product trees
+ */
+#define PRODUCT_LEAF_SIZE 16
+
+/*
+ * Product subtree handed to the thread pool, either over single limb
+ * factors (v) or over ApInt factors (factors, lens)
+ */
+typedef struct {
+	ApInt *const *factors;
+	const size_t *lens;
+	const uint64_t *v;
+	size_t lo, hi;
+	uint64_t *prod;
+	size_t n;
+} ProductTask;
+
+static uint64_t *product_of_limbs(const uint64_t *v, size_t m, size_t *n, ApScratch *s);
+static uint64_t *product_of_range(ApInt *const *factors, const size_t *lens, size_t lo, size_t hi, size_t *n, ApScratch *s);
+
+static void product_task(void *arg) {
+	ProductTask *p = (ProductTask *)arg;
+	ApScratch local;
+	ApScratch *s = apint_scratch_acquire(&local, 0);
+	if (p->v != NULL) {
+		p->prod = product_of_limbs(p->v + p->lo, p->hi - p->lo, &p->n, s);
+	} else {
+		p->prod = product_of_range(p->factors, p->lens, p->lo, p->hi, &p->n, s);
+	}
+	apint_scratch_return(s, &local);
+}
+
+/* 
+ * Product of single limb factors v[0..m), by linear mul_1 for short runs
+ * and balanced halving above PRODUCT_LEAF_SIZE
+ * Returns malloc'd limbs, length in *n
+ */
+static uint64_t *product_of_limbs(const uint64_t *v, size_t m, size_t *n, ApScratch *s) {
+	if (m <= PRODUCT_LEAF_SIZE) {
+		uint64_t *prod = (uint64_t *)malloc(m * sizeof(uint64_t));
+		assert(prod != NULL); //check memory allocation
+		size_t len = 1;
+		prod[0] = v[0];
+		for (size_t i = 1; i < m; i++) {
+			uint64_t high = limbs_mul_1(prod, prod, len, v[i]);
+			if (high != 0) {
+				prod[len++] = high;
+			}
+		}
+		*n = len;
+		return prod;
+	}
+
+	size_t ln, rn;
+	uint64_t *left, *right;
+	if (apint_threads_active() && m >= apint_threads_grain()) {
+		ProductTask task = { NULL, NULL, v, 0, m / 2, NULL, 0 };
+		ApTaskGroup g;
+		ApTask t;
+		apint_task_group_init(&g);
+		apint_task_spawn(&g, &t, product_task, &task);
+		right = product_of_limbs(v + m / 2, m - m / 2, &rn, s);
+		apint_task_wait(&g);
+		left = task.prod;
+		ln = task.n;
+	} else {
+		left = product_of_limbs(v, m / 2, &ln, s);
+		right = product_of_limbs(v + m / 2, m - m / 2, &rn, s);
+	}
+	uint64_t *prod = mul_magnitudes(left, ln, right, rn, n, s);
+	free(left);
+	free(right);
+	*n = limbs_normalized_len(prod, *n);
+	return prod;
+}
+
+/* 
+ * Product of n u64 factors with temporaries from s
+ * Consecutive factors are packed into single limbs while they fit,
+ * then the limbs are multiplied in a balanced product tree
+ */
+static ApInt *product_u64_with_scratch(const uint64_t *factors, size_t n, ApScratch *s) {
+	if (n == 0) {
+		return apint_create_from_u64(1UL);
+	}
+	uint64_t *packed = (uint64_t *)malloc(n * sizeof(uint64_t));
+	assert(packed != NULL); //check memory allocation
+	size_t m = 0;
+	uint64_t acc = 1;
+	for (size_t i = 0; i < n; i++) {
+		if (factors[i] == 0) {
+			free(packed);
+			return apint_create_from_u64(0UL);
+		}
+		u128 p = (u128) acc * factors[i];
+		if ((p >> 64) != 0) { //limb is full, start the next one
+			packed[m++] = acc;
+			acc = factors[i];
+		} else {
+			acc = (uint64_t) p;
+		}
+	}
+	packed[m++] = acc;
+
+	size_t len;
+	uint64_t *prod = product_of_limbs(packed, m, &len, s);
+	free(packed);
+	return apint_wrap_limbs(prod, len, 1);
+}
+
+/* 
+ * Returns product of n u64 factors (1 if n is 0)
+ */
+ApInt *apint_product_u64(const uint64_t *factors, size_t n) {
+	APINT_STATS_OP(AP_OP_PRODUCT, n);
+	ApScratch local;
+	ApScratch *s = apint_scratch_acquire(&local, 0);
+	ApInt *result = product_u64_with_scratch(factors, n, s);
+	apint_scratch_return(s, &local);
+	return result;
+}
+
+/* 
+ * Product of factors[lo..hi) magnitudes, splitting where half of the
+ * total limb count is reached so both subtrees have similar sizes
+ * lens holds the normalized length of each factor
+ */
+static uint64_t *product_of_range(ApInt *const *factors, const size_t *lens, size_t lo, size_t hi, size_t *n, ApScratch *s) {
+	if (hi - lo == 1) {
+		uint64_t *copy = (uint64_t *)malloc(lens[lo] * sizeof(uint64_t));
+		assert(copy != NULL); //check memory allocation
+		memcpy(copy, factors[lo]->data, lens[lo] * sizeof(uint64_t));
+		*n = lens[lo];
+		return copy;
+	}
+
+	size_t total = 0, half = 0, mid = lo;
+	for (size_t i = lo; i < hi; i++) {
+		total += lens[i];
+	}
+	while (mid < hi - 1 && (mid == lo || 2 * (half + lens[mid]) <= total)) {
+		half += lens[mid++];
+	}
+
+	size_t ln, rn;
+	uint64_t *left, *right;
+	if (apint_threads_active() && total >= apint_threads_grain()) {
+		ProductTask task = { factors, lens, NULL, lo, mid, NULL, 0 };
+		ApTaskGroup g;
+		ApTask t;
+		apint_task_group_init(&g);
+		apint_task_spawn(&g, &t, product_task, &task);
+		right = product_of_range(factors, lens, mid, hi, &rn, s);
+		apint_task_wait(&g);
+		left = task.prod;
+		ln = task.n;
+	} else {
+		left = product_of_range(factors, lens, lo, mid, &ln, s);
+		right = product_of_range(factors, lens, mid, hi, &rn, s);
+	}
+	uint64_t *prod = mul_magnitudes(left, ln, right, rn, n, s);
+	free(left);
+	free(right);
+	*n = limbs_normalized_len(prod, *n);
+	return prod;
+}
+
+/* 
+ * Returns product of n ApInt factors (1 if n is 0)
+ * Factors are combined in a size-balanced product tree sharing one scratch arena
+ */
+ApInt *apint_product(ApInt *const *factors, size_t n) {
+	APINT_STATS_OP(AP_OP_PRODUCT, n);
+	if (n == 0) {
+		return apint_create_from_u64(1UL);
+	}
+	size_t *lens = (size_t *)malloc(n * sizeof(size_t));
+	assert(lens != NULL); //check memory allocation
+	uint32_t flags = 1;
+	for (size_t i = 0; i < n; i++) {
+		lens[i] = limbs_normalized_len(factors[i]->data, factors[i]->len);
+		if (lens[i] == 0) {
+			free(lens);
+			return apint_create_from_u64(0UL);
+		}
+		if (factors[i]->flags == 0) {
+			flags ^= 1; //each negative factor flips the sign
+		}
+	}
+
+	ApScratch local;
+	ApScratch *s = apint_scratch_acquire(&local, 0);
+	size_t len;
+	uint64_t *prod = product_of_range(factors, lens, 0, n, &len, s);
+	apint_scratch_return(s, &local);
+	free(lens);
+	return apint_wrap_limbs(prod, len, flags);
+}
+
+/* 
+ * Sieve of Eratosthenes, returns malloc'd array of primes <= n, count in *count
+ */
+static uint64_t *primes_up_to(uint64_t n, size_t *count) {
+	*count = 0;
+	if (n < 2) {
+		return NULL;
+	}
+	char *composite = (char *)calloc(n + 1, sizeof(char));
+	assert(composite != NULL); //check memory allocation
+	size_t found = 0;
+	for (uint64_t i = 2; i <= n; i++) {
+		if (!composite[i]) {
+			found++;
+			for (uint64_t j = i * i; j <= n; j += i) {
+				composite[j] = 1;
+			}
+		}
+	}
+	uint64_t *primes = (uint64_t *)malloc(found * sizeof(uint64_t));
+	assert(primes != NULL); //check memory allocation
+	for (uint64_t i = 2; i <= n; i++) {
+		if (!composite[i]) {
+			primes[(*count)++] = i;
+		}
+	}
+	free(composite);
+	return primes;
+}
+
+/* 
+ * Returns product of all primes <= n
+ */
+ApInt *apint_primorial(uint64_t n) {
+	APINT_STATS_OP(AP_OP_PRODUCT, n);
+	size_t count;
+	uint64_t *primes = primes_up_to(n, &count);
+	ApInt *result = apint_product_u64(primes, count);
+	free(primes);
+	return result;
+}
+
+/* 
+ * Swing factor n! / (floor(n/2)!)^2 as a product of prime powers
+ * The exponent of p is the number of odd values of floor(n / p^i)
+ */
+static ApInt *prime_swing(uint64_t n, const uint64_t *primes, size_t count, ApScratch *s) {
+	uint64_t *powers = (uint64_t *)malloc((count + 1) * sizeof(uint64_t));
+	assert(powers != NULL); //check memory allocation
+	size_t m = 0;
+	for (size_t i = 0; i < count && primes[i] <= n; i++) {
+		uint64_t q = n, pe = 1;
+		while ((q /= primes[i]) > 0) {
+			if (q & 1) {
+				pe *= primes[i];
+			}
+		}
+		if (pe > 1) {
+			powers[m++] = pe;
+		}
+	}
+	ApInt *result = product_u64_with_scratch(powers, m, s);
+	free(powers);
+	return result;
+}
+
+/* 
+ * n! = (floor(n/2)!)^2 * swing(n)
+ */
+static ApInt *factorial_rec(uint64_t n, const uint64_t *primes, size_t count, ApScratch *s) {
+	if (n < 2) {
+		return apint_create_from_u64(1UL);
+	}
+	ApInt *half = factorial_rec(n / 2, primes, count, s);
+	ApInt *sq = mul_with_scratch(half, half, s);
+	ApInt *swing = prime_swing(n, primes, count, s);
+	ApInt *result = mul_with_scratch(sq, swing, s);
+	apint_destroy(half);
+	apint_destroy(sq);
+	apint_destroy(swing);
+	return result;
+}
+
+/* 
+ * Returns n! using the prime swing decomposition
+ */
+ApInt *apint_factorial(uint64_t n) {
+	APINT_STATS_OP(AP_OP_PRODUCT, n);
+	size_t count;
+	uint64_t *primes = primes_up_to(n, &count);
+	ApScratch local;
+	ApScratch *s = apint_scratch_acquire(&local, 0);
+	ApInt *result = factorial_rec(n, primes, count, s);
+	apint_scratch_return(s, &local);
+	free(primes);
+	return result;
+}
+
+/* 
+ * Returns binomial coefficient n choose k (0 if k > n)
+ * Built from the prime factorization given by Legendre's formula,
+ * every prime power divides it and is at most n
+ */
+ApInt *apint_binomial(uint64_t n, uint64_t k) {
+	APINT_STATS_OP(AP_OP_PRODUCT, k);
+	if (k > n) {
+		return apint_create_from_u64(0UL);
+	}
+	size_t count;
+	uint64_t *primes = primes_up_to(n, &count);
+	uint64_t *powers = (uint64_t *)malloc((count + 1) * sizeof(uint64_t));
+	assert(powers != NULL); //check memory allocation
+	size_t m = 0;
+	for (size_t i = 0; i < count; i++) {
+		uint64_t p = primes[i], pe = 1;
+		uint64_t qn = n, qk = k, qnk = n - k;
+		while ((qn /= p) > 0) {
+			qk /= p;
+			qnk /= p;
+			for (uint64_t e = qn - qk - qnk; e > 0; e--) {
+				pe *= p;
+			}
+		}
+		if (pe > 1) {
+			powers[m++] = pe;
+		}
+	}
+	ApInt *result = apint_product_u64(powers, m);
+	free(powers);
+	free(primes);
+	return result;
+}
+
+/*
+ * Fused sums of shifted terms
+ */
+
+/* 
+ * Limb i of (d << (64 * q + s)), d having len limbs
+ */
+static uint64_t term_limb(const uint64_t *d, size_t len, size_t q, unsigned s, size_t i) {
+	uint64_t hi = (i >= q && i - q < len) ? d[i - q] : 0;
+	if (s == 0) {
+		return hi;
+	}
+	uint64_t lo = (i >= q + 1 && i - q - 1 < len) ? d[i - q - 1] : 0;
+	return (hi << s) | (lo >> (64 - s));
+}
+
+/* 
+ * Limbs needed to hold any sum of the terms, with room for the carries
+ */
+static size_t linear_sum_len(const ApTerm *terms, size_t n) {
+	size_t len = 1;
+	for (size_t i = 0; i < n; i++) {
+		size_t tl = terms[i].ap->len + terms[i].shift / 64 + (terms[i].shift % 64 != 0);
+		if (tl > len) {
+			len = tl;
+		}
+	}
+	return len + 1; //n terms carry at most log2(n) < 64 bits
+}
+
+/* 
+ * out = sum of the terms in a single pass over the limbs, keeping a
+ * signed 128 bit carry; a negative total comes out in two's complement
+ * and is negated in place
+ * Returns the flags (sign) of the result
+ */
+static uint32_t linear_sum_pass(uint64_t *out, size_t out_len, const ApTerm *terms, size_t n) {
+	__extension__ __int128 carry = 0;
+	for (size_t i = 0; i < out_len; i++) {
+		__extension__ __int128 acc = carry;
+		for (size_t t = 0; t < n; t++) {
+			const ApInt *ap = terms[t].ap;
+			uint64_t limb = term_limb(ap->data, ap->len, terms[t].shift / 64, terms[t].shift % 64, i);
+			if ((ap->flags == 0) != (terms[t].negate != 0)) {
+				acc -= limb;
+			} else {
+				acc += limb;
+			}
+		}
+		out[i] = (uint64_t) acc;
+		carry = acc >> 64; //arithmetic shift keeps the sign
+	}
+	if (carry >= 0) {
+		return 1;
+	}
+	uint64_t one = 1;
+	for (size_t i = 0; i < out_len; i++) { //two's complement: ~x + 1
+		out[i] = ~out[i] + one;
+		one = one && out[i] == 0;
+	}
+	return 0;
+}
+
+/* 
+ * Returns the sum of n terms, each +/-(ap << shift), as a new ApInt
+ * The result is written once, without intermediate values
+ */
+ApInt *apint_linear_sum(const ApTerm *terms, size_t n) {
+	APINT_STATS_OP(AP_OP_LINEAR_SUM, linear_sum_len(terms, n));
+	size_t len = linear_sum_len(terms, n);
+	uint64_t *out = (uint64_t *)malloc(len * sizeof(uint64_t));
+	assert(out != NULL); //check memory allocation
+	uint32_t flags = linear_sum_pass(out, len, terms, n);
+	return apint_wrap_limbs(out, len, flags);
+}
+
+/* 
+ * dest = sum of n terms, in place
+ * dest may be one of the terms (e.g. dest += a << k) as long as it is
+ * not shifted; a shifted dest term would read limbs already written,
+ * so that case is computed separately and moved into dest
+ */
+void apint_linear_sum_into(ApInt *dest, const ApTerm *terms, size_t n) {
+	APINT_STATS_OP(AP_OP_LINEAR_SUM, linear_sum_len(terms, n));
+	for (size_t i = 0; i < n; i++) {
+		if (terms[i].ap == dest && terms[i].shift != 0) {
+			ApInt *sum = apint_linear_sum(terms, n);
+			limbs_release(dest);
+			*dest = *sum;
+			free(sum);
+			return;
+		}
+	}
+
+	//grow with zero limbs, dest reads as the same value
+	apint_make_writable(dest, linear_sum_len(terms, n));
+	uint32_t flags = linear_sum_pass(dest->data, dest->len, terms, n);
+	dest->len = limbs_normalized_len(dest->data, dest->len);
+	if (dest->len == 0) {
+		dest->len = 1;
+		flags = 1;
+	}
+	dest->flags = flags;
+}
+
+/*
+ * Fused multiply-add
+ * acc += a * b and friends, updating acc's limbs in place: the product
+ * rows are accumulated (or subtracted) directly into acc, so nothing but
+ * acc's own growth is allocated below the Karatsuba threshold
+ */
+
+/* 
+ * Adds c into rp (n limbs), stopping as soon as the carry dies out
+ */
+static uint64_t carry_into(uint64_t *rp, size_t n, uint64_t c) {
+	for (size_t i = 0; i < n && c != 0; i++) {
+		rp[i] += c;
+		c = rp[i] < c;
+	}
+	return c;
+}
+
+/* 
+ * Subtracts c from rp (n limbs), stopping as soon as the borrow dies out
+ */
+static uint64_t borrow_from(uint64_t *rp, size_t n, uint64_t c) {
+	for (size_t i = 0; i < n && c != 0; i++) {
+		uint64_t r = rp[i];
+		rp[i] = r - c;
+		c = r < c;
+	}
+	return c;
+}
+
+/* 
+ * acc += (ap * bp) << (64 * offset), subtracted instead when negative is set
+ * an >= bn >= 1 and acc must not share limbs with ap or bp
+ * The magnitude is updated in two's complement over acc's limbs; if it
+ * goes below 0 it is negated once at the end and the sign flipped
+ */
+static void acc_update(ApInt *acc, const uint64_t *ap, size_t an, const uint64_t *bp, size_t bn, size_t offset, int negative) {
+	size_t need = (an + bn + offset > acc->len) ? an + bn + offset : acc->len;
+	apint_make_writable(acc, need + 1); //the extra limb absorbs the final carry
+	uint64_t *d = acc->data;
+	size_t len = acc->len;
+	int same_sign = (negative != 0) == (acc->flags == 0);
+	uint64_t out = 0;
+
+	if (bn >= KARATSUBA_THRESHOLD) { //rows would be quadratic, add one full product
+		ApScratch local;
+		ApScratch *s = apint_scratch_acquire(&local, an + bn + limbs_mul_scratch_size(an, bn));
+		uint64_t *p = apint_scratch_alloc(s, an + bn);
+		limbs_mul(p, ap, an, bp, bn, s);
+		size_t pn = limbs_normalized_len(p, an + bn);
+		if (same_sign) {
+			out = carry_into(d + offset + pn, len - offset - pn, limbs_add_n(d + offset, d + offset, p, pn));
+		} else {
+			out = borrow_from(d + offset + pn, len - offset - pn, limbs_sub_n(d + offset, d + offset, p, pn));
+		}
+		apint_scratch_return(s, &local);
+	} else if (same_sign) {
+		for (size_t j = 0; j < bn; j++) {
+			uint64_t c = limbs_addmul_1(d + offset + j, ap, an, bp[j]);
+			out |= carry_into(d + offset + j + an, len - offset - j - an, c);
+		}
+	} else {
+		for (size_t j = 0; j < bn; j++) {
+			uint64_t c = limbs_submul_1(d + offset + j, ap, an, bp[j]);
+			out |= borrow_from(d + offset + j + an, len - offset - j - an, c);
+		}
+	}
+
+	if (!same_sign && out != 0) { //magnitude went negative, take the two's complement
+		for (size_t i = 0; i < len; i++) {
+			d[i] = ~d[i];
+		}
+		carry_into(d, len, 1);
+		acc->flags = (acc->flags == 0) ? 1 : 0;
+	}
+	acc->len = limbs_normalized_len(d, len);
+	if (acc->len == 0) {
+		acc->len = 1;
+		acc->flags = 1;
+	}
+}
+
+/* 
+ * acc += a * b, negated product when negate is set
+ */
+static void fused_mul(ApInt *acc, const ApInt *a, const ApInt *b, int negate) {
+	ApInt *ca = NULL, *cb = NULL;
+	if (a == acc) { //share the old limbs so writing acc copies them first
+		a = ca = apint_copy(a);
+	}
+	if (b == acc) {
+		b = cb = apint_copy(b);
+	}
+	size_t an = limbs_normalized_len(a->data, a->len);
+	size_t bn = limbs_normalized_len(b->data, b->len);
+	if (an != 0 && bn != 0) {
+		int negative = (a->flags != b->flags) != (negate != 0);
+		if (an >= bn) {
+			acc_update(acc, a->data, an, b->data, bn, 0, negative);
+		} else {
+			acc_update(acc, b->data, bn, a->data, an, 0, negative);
+		}
+	}
+	if (ca != NULL) {
+		apint_destroy(ca);
+	}
+	if (cb != NULL) {
+		apint_destroy(cb);
+	}
+}
+
+void apint_addmul(ApInt *acc, const ApInt *a, const ApInt *b) {
+	APINT_STATS_OP(AP_OP_ADDMUL, (a->len > b->len) ? a->len : b->len);
+	fused_mul(acc, a, b, 0);
+}
+
+void apint_submul(ApInt *acc, const ApInt *a, const ApInt *b) {
+	APINT_STATS_OP(AP_OP_SUBMUL, (a->len > b->len) ? a->len : b->len);
+	fused_mul(acc, a, b, 1);
+}
+
+/* 
+ * acc += a * b for a single limb b, negated product when negate is set
+ */
+static void fused_mul_u64(ApInt *acc, const ApInt *a, uint64_t b, int negate) {
+	ApInt *ca = NULL;
+	if (a == acc) {
+		a = ca = apint_copy(a);
+	}
+	size_t an = limbs_normalized_len(a->data, a->len);
+	if (an != 0 && b != 0) {
+		acc_update(acc, a->data, an, &b, 1, 0, (a->flags == 0) != (negate != 0));
+	}
+	if (ca != NULL) {
+		apint_destroy(ca);
+	}
+}
+
+void apint_addmul_u64(ApInt *acc, const ApInt *a, uint64_t b) {
+	APINT_STATS_OP(AP_OP_ADDMUL, a->len);
+	fused_mul_u64(acc, a, b, 0);
+}
+
+void apint_submul_u64(ApInt *acc, const ApInt *a, uint64_t b) {
+	APINT_STATS_OP(AP_OP_SUBMUL, a->len);
+	fused_mul_u64(acc, a, b, 1);
+}
+
+/* 
+ * acc += a << shift (acc -= a << shift for apint_sub_shifted)
+ * Whole limbs of the shift become an offset into acc, the bit part is
+ * a one limb multiplier, so this is one carry-propagating pass
+ */
+static void fused_shifted(ApInt *acc, const ApInt *a, unsigned shift, int negate) {
+	ApInt *ca = NULL;
+	if (a == acc) {
+		a = ca = apint_copy(a);
+	}
+	size_t an = limbs_normalized_len(a->data, a->len);
+	if (an != 0) {
+		uint64_t bit = 1UL << (shift % 64);
+		acc_update(acc, a->data, an, &bit, 1, shift / 64, (a->flags == 0) != (negate != 0));
+	}
+	if (ca != NULL) {
+		apint_destroy(ca);
+	}
+}
+
+void apint_add_shifted(ApInt *acc, const ApInt *a, unsigned shift) {
+	APINT_STATS_OP(AP_OP_ADD_SHIFTED, a->len);
+	fused_shifted(acc, a, shift, 0);
+}
+
+void apint_sub_shifted(ApInt *acc, const ApInt *a, unsigned shift) {
+	APINT_STATS_OP(AP_OP_ADD_SHIFTED, a->len);
+	fused_shifted(acc, a, shift, 1);
+}
+
+/*
+ * Scalar operands
+ * ApInt op uint64_t/int64_t without building an ApInt for the scalar:
+ * the limb kernels take it directly, and a one limb ApInt is handled
+ * with plain 128-bit arithmetic
+ */
+
+/* 
+ * Magnitude and flags of an int64_t
+ */
+static uint64_t i64_magnitude(int64_t b, uint32_t *flags) {
+	*flags = (b < 0) ? 0 : 1;
+	return (b < 0) ? -(uint64_t) b : (uint64_t) b;
+}
+
+/* 
+ * a + mag with mag's sign given by flags
+ */
+static ApInt *add_scalar(const ApInt *a, uint64_t mag, uint32_t flags) {
+	if (mag == 0) {
+		return apint_copy(a);
+	}
+	size_t n = limbs_normalized_len(a->data, a->len);
+	uint64_t *data;
+	if (n == 0 || a->flags == flags) { //magnitudes add
+		data = (uint64_t *)malloc((n + 1) * sizeof(uint64_t));
+		assert(data != NULL); //check memory allocation
+		data[n] = limbs_add_1(data, a->data, n, mag);
+		return apint_wrap_limbs(data, n + 1, flags);
+	}
+	if (n == 1 && a->data[0] < mag) { //sign changes, only possible for one limb
+		data = (uint64_t *)malloc(sizeof(uint64_t));
+		assert(data != NULL); //check memory allocation
+		data[0] = mag - a->data[0];
+		return apint_wrap_limbs(data, 1, flags);
+	}
+	data = (uint64_t *)malloc(n * sizeof(uint64_t));
+	assert(data != NULL); //check memory allocation
+	limbs_sub_1(data, a->data, n, mag);
+	return apint_wrap_limbs(data, n, a->flags);
+}
+
+ApInt *apint_add_u64(const ApInt *a, uint64_t b) {
+	APINT_STATS_OP(AP_OP_SCALAR, a->len);
+	return add_scalar(a, b, 1);
+}
+
+ApInt *apint_sub_u64(const ApInt *a, uint64_t b) {
+	APINT_STATS_OP(AP_OP_SCALAR, a->len);
+	return add_scalar(a, b, 0);
+}
+
+ApInt *apint_add_i64(const ApInt *a, int64_t b) {
+	APINT_STATS_OP(AP_OP_SCALAR, a->len);
+	uint32_t flags;
+	uint64_t mag = i64_magnitude(b, &flags);
+	return add_scalar(a, mag, flags);
+}
+
+ApInt *apint_sub_i64(const ApInt *a, int64_t b) {
+	APINT_STATS_OP(AP_OP_SCALAR, a->len);
+	uint32_t flags;
+	uint64_t mag = i64_magnitude(b, &flags);
+	return add_scalar(a, mag, flags ^ 1);
+}
+
+/* 
+ * a * mag, the product is negated when flags is 0
+ */
+static ApInt *mul_scalar(const ApInt *a, uint64_t mag, uint32_t flags) {
+	size_t n = limbs_normalized_len(a->data, a->len);
+	if (n == 0 || mag == 0) {
+		return apint_create_from_u64(0UL);
+	}
+	uint64_t *data = (uint64_t *)malloc((n + 1) * sizeof(uint64_t));
+	assert(data != NULL); //check memory allocation
+	if (n == 1) {
+		u128 p = (u128) a->data[0] * mag;
+		data[0] = (uint64_t) p;
+		data[1] = (uint64_t) (p >> 64);
+	} else {
+		data[n] = limbs_mul_1(data, a->data, n, mag);
+	}
+	return apint_wrap_limbs(data, n + 1, (a->flags == flags) ? 1 : 0);
+}
+
+ApInt *apint_mul_u64(const ApInt *a, uint64_t b) {
+	APINT_STATS_OP(AP_OP_SCALAR, a->len);
+	return mul_scalar(a, b, 1);
+}
+
+ApInt *apint_mul_i64(const ApInt *a, int64_t b) {
+	APINT_STATS_OP(AP_OP_SCALAR, a->len);
+	uint32_t flags;
+	uint64_t mag = i64_magnitude(b, &flags);
+	return mul_scalar(a, mag, flags);
+}
+
+/* 
+ * |a| / mag, stores |a| mod mag in rem
+ * The quotient is negated when a's flags differ from flags
+ */
+static ApInt *divmod_scalar(const ApInt *a, uint64_t mag, uint32_t flags, uint64_t *rem) {
+	assert(mag != 0); //division by 0
+	size_t n = limbs_normalized_len(a->data, a->len);
+	if (n == 0) {
+		*rem = 0;
+		return apint_create_from_u64(0UL);
+	}
+	uint64_t *data = (uint64_t *)malloc(n * sizeof(uint64_t));
+	assert(data != NULL); //check memory allocation
+	if (n == 1) { //native division beats setting up the reciprocal
+		data[0] = a->data[0] / mag;
+		*rem = a->data[0] % mag;
+	} else {
+		*rem = limbs_divrem_1(data, a->data, n, mag);
+	}
+	return apint_wrap_limbs(data, n, (a->flags == flags) ? 1 : 0);
+}
+
+/* 
+ * Returns a / b rounded toward 0 and stores |a| mod b in rem (may be NULL)
+ * The remainder has the sign of a, as with C's / and %
+ */
+ApInt *apint_divmod_u64(const ApInt *a, uint64_t b, uint64_t *rem) {
+	APINT_STATS_OP(AP_OP_SCALAR, a->len);
+	uint64_t r;
+	ApInt *q = divmod_scalar(a, b, 1, &r);
+	if (rem != NULL) {
+		*rem = r;
+	}
+	return q;
+}
+
+/* 
+ * Returns a / b rounded toward 0 and stores a % b in rem (may be NULL),
+ * same signs as C's / and %
+ */
+ApInt *apint_divmod_i64(const ApInt *a, int64_t b, int64_t *rem) {
+	APINT_STATS_OP(AP_OP_SCALAR, a->len);
+	uint32_t flags;
+	uint64_t r, mag = i64_magnitude(b, &flags);
+	ApInt *q = divmod_scalar(a, mag, flags, &r);
+	if (rem != NULL) {
+		*rem = (a->flags == 0) ? -(int64_t) r : (int64_t) r;
+	}
+	return q;
+}
+
+/* 
+ * Returns 1: a > b, -1: a < b, 0: a == b
+ */
+int apint_compare_u64(const ApInt *a, uint64_t b) {
+	size_t n = limbs_normalized_len(a->data, a->len);
+	if (n == 0) {
+		return (b == 0) ? 0 : -1;
+	}
+	if (a->flags == 0) {
+		return -1;
+	}
+	if (n > 1) {
+		return 1;
+	}
+	return (a->data[0] > b) - (a->data[0] < b);
+}
+
+/* 
+ * Returns 1: a > b, -1: a < b, 0: a == b
+ */
+int apint_compare_i64(const ApInt *a, int64_t b) {
+	if (b >= 0) {
+		return apint_compare_u64(a, (uint64_t) b);
+	}
+	if (a->flags == 1) { //includes 0
+		return 1;
+	}
+	size_t n = limbs_normalized_len(a->data, a->len);
+	uint64_t mag = -(uint64_t) b;
+	if (n > 1) {
+		return -1;
+	}
+	return (a->data[0] < mag) - (a->data[0] > mag); //both negative, larger magnitude is smaller
+}
+
+/*
+ * Division
+ */
+
+#define DIV_NEWTON_THRESHOLD 1200 //divisor and quotient limbs from which division goes by reciprocal
+#define RECIPROCAL_BASE_LIMBS 100 //reciprocals of divisors this short come from schoolbook division
+
+/* 
+ * Knuth division of a (an limbs) by b (bn limbs, an >= bn)
+ */
+static ApInt *divmod_schoolbook(const ApInt *a, size_t an, const ApInt *b, size_t bn, ApInt **rem) {
+	uint64_t *q = (uint64_t *)malloc((an - bn + 1) * sizeof(uint64_t));
+	uint64_t *r = (uint64_t *)malloc(bn * sizeof(uint64_t));
+	assert(q != NULL && r != NULL); //check memory allocation
+	limbs_divrem(q, r, a->data, an, b->data, bn);
+	if (rem != NULL) {
+		*rem = apint_wrap_limbs(r, bn, a->flags);
+	} else {
+		free(r);
+	}
+	return apint_wrap_limbs(q, an - bn + 1, (a->flags == b->flags) ? 1 : 0);
+}
+
+/* 
+ * floor(2^(2k) / d) to within a few units, for d > 0 of exactly k bits
+ * The reciprocal xh of the top h = k/2 + 2 bits of d, shifted into place
+ * as x0 = xh 2^(k - h), is accurate to about h bits; one Newton step
+ * x0 + x0 (2^(2k) - d x0) / 2^(2k) doubles that. Both products are taken
+ * with xh, which is half as long as x0
+ */
+static ApInt *reciprocal(const ApInt *d, unsigned k) {
+	ApInt *one = apint_create_from_u64(1UL);
+	ApInt *pow = apint_lshift_n(one, 2 * k);
+	apint_destroy(one);
+	size_t dn = limbs_normalized_len(d->data, d->len);
+	if (dn < RECIPROCAL_BASE_LIMBS) {
+		ApInt *x = divmod_schoolbook(pow, limbs_normalized_len(pow->data, pow->len), d, dn, NULL);
+		apint_destroy(pow);
+		return x;
+	}
+
+	unsigned h = k / 2 + 2;
+	ApInt *dh = apint_rshift_n(d, k - h);
+	ApInt *xh = reciprocal(dh, h);
+	ApInt *dx = apint_mul(d, xh);
+	ApInt *dx0 = apint_lshift_n(dx, k - h);
+	ApInt *e = apint_sub(pow, dx0);
+	ApInt *xe = apint_mul(xh, e);
+	ApInt *step = apint_rshift_n(xe, k + h);
+	ApInt *x0 = apint_lshift_n(xh, k - h);
+	ApInt *x = apint_add(x0, step);
+	apint_destroy(pow);
+	apint_destroy(dh);
+	apint_destroy(xh);
+	apint_destroy(dx);
+	apint_destroy(dx0);
+	apint_destroy(e);
+	apint_destroy(xe);
+	apint_destroy(step);
+	apint_destroy(x0);
+	return x;
+}
+
+/* 
+ * Bits lo .. lo + n - 1 of |x|, as a new nonnegative ApInt
+ */
+static ApInt *bit_range(const ApInt *x, size_t lo, size_t n) {
+	size_t xn = limbs_normalized_len(x->data, x->len);
+	size_t len = (n + 63) / 64 + 1;
+	uint64_t *data = (uint64_t *)calloc(len, sizeof(uint64_t));
+	assert(data != NULL); //check memory allocation
+	size_t skip = lo / 64;
+	if (skip < xn) {
+		size_t take = (xn - skip < len) ? xn - skip : len;
+		if (lo % 64 != 0) {
+			limbs_rshift(data, x->data + skip, take, lo % 64);
+			if (skip + take < xn) {
+				data[take - 1] |= x->data[skip + take] << (64 - lo % 64);
+			}
+		} else {
+			memcpy(data, x->data + skip, take * sizeof(uint64_t));
+		}
+	}
+	if (n % 64 != 0) {
+		data[n / 64] &= (1UL << (n % 64)) - 1;
+	}
+	for (size_t i = (n + 63) / 64; i < len; i++) {
+		data[i] = 0;
+	}
+	return apint_wrap_limbs(data, len, 1);
+}
+
+/* 
+ * a / d for d > 0 of k bits, given v within a few units of
+ * floor(2^(2k) / d)
+ * a is taken k bits at a time from the top, each step dividing
+ * r 2^k + (next k bits), which is below d 2^k, by Barrett's estimate
+ * ((x >> (k - 1)) v) >> (k + 1); with an exact v that is at most 2 short
+ * of the quotient, and each unit v is off moves it by at most one more
+ */
+static ApInt *divmod_reciprocal(const ApInt *a, const ApInt *d, const ApInt *v, unsigned k, ApInt **rem) {
+	size_t abits = 64 * limbs_normalized_len(a->data, a->len);
+	size_t steps = (abits + k - 1) / k;
+	size_t qlen = (steps * k) / 64 + 2;
+	uint64_t *qd = (uint64_t *)calloc(qlen, sizeof(uint64_t));
+	assert(qd != NULL); //check memory allocation
+	ApInt *q = apint_wrap_limbs(qd, qlen, 1);
+	ApInt *r = apint_create_from_u64(0UL);
+	for (size_t i = steps; i > 0; i--) {
+		ApInt *chunk = bit_range(a, (i - 1) * k, k);
+		ApInt *x = apint_is_zero(r) ? apint_copy(chunk) : apint_lshift_n(r, k);
+		if (!apint_is_zero(r)) {
+			apint_add_shifted(x, chunk, 0);
+		}
+		ApInt *top = apint_rshift_n(x, k - 1);
+		ApInt *tv = apint_mul(top, v);
+		ApInt *qi = apint_rshift_n(tv, k + 1);
+		apint_destroy(r);
+		r = apint_copy(x);
+		apint_submul(r, qi, d);
+		while (apint_is_negative(r) || apint_compare(r, d) >= 0) {
+			int low = apint_is_negative(r);
+			ApInt *r1 = low ? apint_add(r, d) : apint_sub(r, d);
+			ApInt *q1 = low ? apint_sub_u64(qi, 1) : apint_add_u64(qi, 1);
+			apint_destroy(r);
+			apint_destroy(qi);
+			r = r1;
+			qi = q1;
+		}
+		apint_add_shifted(q, qi, (unsigned) ((i - 1) * k));
+		apint_destroy(chunk);
+		apint_destroy(x);
+		apint_destroy(top);
+		apint_destroy(tv);
+		apint_destroy(qi);
+	}
+	if (rem != NULL) {
+		if (!apint_is_zero(r)) {
+			r->flags = a->flags;
+		}
+		*rem = r;
+	} else {
+		apint_destroy(r);
+	}
+	return q;
+}
+
+/* 
+ * Returns a / b rounded toward 0 and stores a % b in rem (may be NULL)
+ * The remainder has the sign of a, as with C's / and %
+ */
+ApInt *apint_divmod(const ApInt *a, const ApInt *b, ApInt **rem) {
+	APINT_STATS_OP(AP_OP_DIVMOD, a->len);
+	size_t an = limbs_normalized_len(a->data, a->len);
+	size_t bn = limbs_normalized_len(b->data, b->len);
+	assert(bn != 0); //division by 0
+	if (an < bn) {
+		if (rem != NULL) {
+			*rem = apint_copy(a);
+		}
+		return apint_create_from_u64(0UL);
+	}
+	if (bn >= DIV_NEWTON_THRESHOLD && an - bn >= DIV_NEWTON_THRESHOLD) {
+		ApInt *d = apint_abs(b);
+		unsigned k = (unsigned) (64 * bn - __builtin_clzl(b->data[bn - 1]));
+		ApInt *v = reciprocal(d, k);
+		ApInt *q = divmod_reciprocal(a, d, v, k, rem);
+		if (!apint_is_zero(q)) {
+			q->flags = (a->flags == b->flags) ? 1 : 0;
+		}
+		apint_destroy(d);
+		apint_destroy(v);
+		return q;
+	}
+	return divmod_schoolbook(a, an, b, bn, rem);
+}
+
+#define DEC_CHUNK_DIGITS 19
+#define DEC_CHUNK 10000000000000000000UL //10^19, the largest power of 10 in a limb
+#define DEC_BASECASE_LIMBS 32            //values this short are converted a chunk at a time
+#define DEC_MAX_LEVELS 64
+
+/*
+ * pows[i] = 10^(19 2^i) with its bit length, and its reciprocal where
+ * dividing by it goes by reciprocal (NULL elsewhere)
+ */
+typedef struct {
+	ApInt *pows[DEC_MAX_LEVELS];
+	ApInt *recips[DEC_MAX_LEVELS];
+	unsigned bits[DEC_MAX_LEVELS];
+} DecimalPowers;
+
+typedef struct {
+	const DecimalPowers *dp;
+	const ApInt *x;
+	unsigned level;
+	char *out;
+} DecimalTask;
+
+static void format_decimal(const DecimalPowers *dp, const ApInt *x, unsigned level, char *out);
+
+static void decimal_task(void *arg) {
+	DecimalTask *t = (DecimalTask *)arg;
+	format_decimal(t->dp, t->x, t->level, t->out);
+}
+
+/* 
+ * Writes |x| < 10^(19 2^level) as exactly 19 2^level digits, with
+ * leading zeros: the quotient and remainder by 10^(19 2^(level - 1))
+ * give the two halves, down to values short enough to peel off 19
+ * digits at a time with a single limb divisor
+ */
+static void format_decimal(const DecimalPowers *dp, const ApInt *x, unsigned level, char *out) {
+	size_t n = limbs_normalized_len(x->data, x->len);
+	size_t width = (size_t) DEC_CHUNK_DIGITS << level;
+	if (n <= DEC_BASECASE_LIMBS) {
+		uint64_t t[DEC_BASECASE_LIMBS];
+		memcpy(t, x->data, n * sizeof(uint64_t));
+		ApLimbDivisor dv;
+		limb_divisor_init(&dv, DEC_CHUNK);
+		for (char *p = out + width; p > out;) {
+			uint64_t c = (n > 0) ? limbs_divrem_1_preinv(t, t, n, &dv) : 0;
+			n = limbs_normalized_len(t, n);
+			for (int j = 0; j < DEC_CHUNK_DIGITS; j++) {
+				*--p = (char) ('0' + c % 10);
+				c /= 10;
+			}
+		}
+		return;
+	}
+
+	ApInt *rem;
+	ApInt *q;
+	if (dp->recips[level - 1] != NULL) {
+		q = divmod_reciprocal(x, dp->pows[level - 1], dp->recips[level - 1], dp->bits[level - 1], &rem);
+	} else {
+		q = apint_divmod(x, dp->pows[level - 1], &rem);
+	}
+	char *low = out + width / 2;
+	if (apint_threads_active() && n >= apint_threads_grain()) {
+		DecimalTask task = { dp, q, level - 1, out };
+		ApTaskGroup g;
+		ApTask t;
+		apint_task_group_init(&g);
+		apint_task_spawn(&g, &t, decimal_task, &task);
+		format_decimal(dp, rem, level - 1, low);
+		apint_task_wait(&g);
+	} else {
+		format_decimal(dp, q, level - 1, out);
+		format_decimal(dp, rem, level - 1, low);
+	}
+	apint_destroy(q);
+	apint_destroy(rem);
+}
+
+/* 
+ * Converts ApInt to a decimal string, "-" first if negative
+ * Divide and conquer over the squares of 10^19, so the conversion costs
+ * about as much as the divisions by the largest of them; a reciprocal
+ * is found once per level and reused by every division at that level
+ */
+char *apint_format_as_decimal(const ApInt *ap) {
+	APINT_STATS_OP(AP_OP_FORMAT_AS_DECIMAL, ap->len);
+	size_t n = limbs_normalized_len(ap->data, ap->len);
+	size_t xbits = (n == 0) ? 0 : 64 * n - __builtin_clzl(ap->data[n - 1]);
+	DecimalPowers dp;
+	memset(&dp, 0, sizeof(dp));
+	dp.pows[0] = apint_create_from_u64(DEC_CHUNK);
+	dp.bits[0] = 64;
+	unsigned level = 0;
+	while (dp.bits[level] - 1 < xbits) { //pows[level] may not exceed |x| yet
+		level++;
+		if (2 * dp.bits[level - 1] - 2 >= xbits) { //its square will
+			break;
+		}
+		dp.pows[level] = apint_mul(dp.pows[level - 1], dp.pows[level - 1]);
+		size_t pn = limbs_normalized_len(dp.pows[level]->data, dp.pows[level]->len);
+		dp.bits[level] = (unsigned) (64 * pn - __builtin_clzl(dp.pows[level]->data[pn - 1]));
+	}
+	for (unsigned i = 0; i < level; i++) {
+		if (dp.bits[i] >= 64 * DIV_NEWTON_THRESHOLD) {
+			dp.recips[i] = reciprocal(dp.pows[i], dp.bits[i]);
+		}
+	}
+
+	size_t width = (size_t) DEC_CHUNK_DIGITS << level;
+	char *s = (char *)malloc(width + 2);
+	assert(s != NULL); //check memory allocation
+	format_decimal(&dp, ap, level, s + 1);
+	size_t skip = 1;
+	while (skip < width && s[skip] == '0') {
+		skip++;
+	}
+	if (n != 0 && ap->flags == 0) {
+		s[--skip] = '-';
+	}
+	memmove(s, s + skip, width + 1 - skip);
+	s[width + 1 - skip] = '\0';
+	for (unsigned i = 0; i < DEC_MAX_LEVELS; i++) {
+		if (dp.pows[i] != NULL) {
+			apint_destroy(dp.pows[i]);
+		}
+		if (dp.recips[i] != NULL) {
+			apint_destroy(dp.recips[i]);
+		}
+	}
+	return s;
+}
+
+/* 
+ * Right shift by n, the magnitude is shifted so negative values round
+ * toward 0 (same as apint_divmod by 2^n)
+ */
+ApInt *apint_rshift_n(const ApInt *ap, unsigned n) {
+	APINT_STATS_OP(AP_OP_RSHIFT_N, ap->len);
+	size_t an = limbs_normalized_len(ap->data, ap->len);
+	size_t skip = n / 64;
+	if (skip >= an) {
+		return apint_create_from_u64(0UL);
+	}
+	size_t len = an - skip;
+	uint64_t *data = (uint64_t *)malloc(len * sizeof(uint64_t));
+	assert(data != NULL); //check memory allocation
+	if (n % 64 != 0) {
+		limbs_rshift(data, ap->data + skip, len, n % 64);
+	} else {
+		memcpy(data, ap->data + skip, len * sizeof(uint64_t));
+	}
+	return apint_wrap_limbs(data, len, ap->flags);
+}
+
+/* 
+ * Binary gcd of single limbs
+ */
+static uint64_t gcd_u64(uint64_t a, uint64_t b) {
+	if (a == 0 || b == 0) {
+		return a | b;
+	}
+	int shift = __builtin_ctzl(a | b);
+	a >>= __builtin_ctzl(a);
+	do {
+		b >>= __builtin_ctzl(b);
+		if (a > b) {
+			uint64_t t = a;
+			a = b;
+			b = t;
+		}
+		b -= a;
+	} while (b != 0);
+	return a << shift;
+}
+
+/* 
+ * rp = a * up + b * vp over n limbs, for a and b of opposite signs (or
+ * zero) whose combination is known to be nonnegative and below 2^(64n)
+ */
+static void lehmer_combine(uint64_t *rp, const uint64_t *up, const uint64_t *vp, size_t n, int64_t a, int64_t b) {
+	uint64_t high, borrow;
+	if (b <= 0) {
+		high = limbs_mul_1(rp, up, n, (uint64_t) a);
+		borrow = limbs_submul_1(rp, vp, n, -(uint64_t) b);
+	} else {
+		high = limbs_mul_1(rp, vp, n, (uint64_t) b);
+		borrow = limbs_submul_1(rp, up, n, -(uint64_t) a);
+	}
+	assert(high == borrow); //the result fits in n limbs
+	(void) high;
+	(void) borrow;
+}
+
+/* 
+ * Top 62 bits of u and the bits of v at the same positions (un >= 2)
+ */
+static void lehmer_top(const uint64_t *u, const uint64_t *v, size_t un, int64_t *uh, int64_t *vh) {
+	unsigned s = __builtin_clzl(u[un - 1]);
+	u128 uw = (((u128) u[un - 1] << 64) | u[un - 2]) << s;
+	u128 vw = (((u128) v[un - 1] << 64) | v[un - 2]) << s;
+	*uh = (int64_t) (uw >> 66);
+	*vh = (int64_t) (vw >> 66);
+}
+
+/* 
+ * Returns the greatest common divisor of |a| and |b|, 0 only if both are 0
+ * Lehmer's algorithm: the Euclid quotients are simulated on the top 62
+ * bits for as long as they provably match the full ones (Knuth 4.5.2 L),
+ * then the collected single limb cofactors are applied to both values in
+ * one linear pass; a full division step is taken when no quotient can
+ * be trusted. Binary gcd finishes once the smaller value fits in a limb
+ */
+ApInt *apint_gcd(const ApInt *a, const ApInt *b) {
+	APINT_STATS_OP(AP_OP_GCD, (a->len > b->len) ? a->len : b->len);
+	size_t un = limbs_normalized_len(a->data, a->len);
+	size_t vn = limbs_normalized_len(b->data, b->len);
+	if (un < vn || (un == vn && limbs_cmp(a->data, b->data, un) < 0)) {
+		const ApInt *t = a;
+		a = b;
+		b = t;
+		size_t tn = un;
+		un = vn;
+		vn = tn;
+	}
+	if (vn == 0) {
+		return apint_abs(a);
+	}
+
+	ApScratch local;
+	ApScratch *s = apint_scratch_acquire(&local, 4 * (un + 1));
+	uint64_t *u = apint_scratch_alloc(s, un + 1);
+	uint64_t *v = apint_scratch_alloc(s, un + 1);
+	uint64_t *r = apint_scratch_alloc(s, un + 1);
+	uint64_t *q = apint_scratch_alloc(s, un + 1);
+	memcpy(u, a->data, un * sizeof(uint64_t));
+	memset(v, 0, (un + 1) * sizeof(uint64_t));
+	memcpy(v, b->data, vn * sizeof(uint64_t));
+	while (vn > 1) {
+		int64_t uh, vh, ca = 1, cb = 0, cc = 0, cd = 1;
+		lehmer_top(u, v, un, &uh, &vh);
+		while (vh + cc != 0 && vh + cd != 0) {
+			int64_t qh = (uh + ca) / (vh + cc);
+			if (qh != (uh + cb) / (vh + cd)) {
+				break;
+			}
+			int64_t t = ca - qh * cc;
+			ca = cc;
+			cc = t;
+			t = cb - qh * cd;
+			cb = cd;
+			cd = t;
+			t = uh - qh * vh;
+			uh = vh;
+			vh = t;
+		}
+
+		uint64_t *t = u;
+		if (cb == 0) { //u, v, r = v, u mod v, u
+			limbs_divrem(q, r, u, un, v, vn);
+			memset(r + vn, 0, (un + 1 - vn) * sizeof(uint64_t));
+			u = v;
+			v = r;
+			r = t;
+		} else { //u, v, r = A u + B v, C u + D v, u
+			lehmer_combine(r, u, v, un, ca, cb);
+			lehmer_combine(q, u, v, un, cc, cd);
+			u = r;
+			r = t;
+			t = v;
+			v = q;
+			q = t;
+		}
+		un = limbs_normalized_len(u, un);
+		vn = limbs_normalized_len(v, un);
+	}
+
+	uint64_t *data;
+	size_t len;
+	if (vn == 0) {
+		len = un;
+		data = (uint64_t *)malloc(len * sizeof(uint64_t));
+		assert(data != NULL); //check memory allocation
+		memcpy(data, u, len * sizeof(uint64_t));
+	} else {
+		len = 1;
+		data = (uint64_t *)malloc(sizeof(uint64_t));
+		assert(data != NULL); //check memory allocation
+		data[0] = gcd_u64(v[0], limbs_divrem_1(q, u, un, v[0]));
+	}
+	apint_scratch_return(s, &local);
+	return apint_wrap_limbs(data, len, 1);
+}
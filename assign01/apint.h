@@ -21,11 +21,57 @@ typedef struct {
         uint32_t len;
         uint32_t flags;
         uint64_t *data;
+        long *refs; //NULL while data is not shared (see apint_copy)
 } ApInt;
 
+/*
+ * Scratch arena for temporaries of the multiplication routines:
+ * a single block handed out in stack order (see apint_scratch_alloc)
+ */
+typedef struct {
+	uint64_t *base;
+	size_t size;
+	size_t used;
+} ApScratch;
+
+/*
+ * Read-only sign-magnitude view of an ApInt's limbs with its own sign,
+ * lets subtraction negate an operand without copying it (see apint_sub)
+ */
+typedef struct {
+	uint32_t len;
+	uint32_t flags;
+	const uint64_t *data;
+} ApView;
+
+/*
+ * Single limb divisor with its precomputed reciprocal, for dividing
+ * many values by the same limb (see limb_divisor_init)
+ */
+typedef struct {
+	uint64_t norm;  //divisor shifted so its top bit is set
+	uint64_t v;     //reciprocal of norm
+	unsigned shift;
+} ApLimbDivisor;
+
+/*
+ * Source of uniformly random 64 bit words, called with its context
+ */
+typedef uint64_t (*ApRandomFn)(void *ctx);
+
+/*
+ * One term of a fused sum: ap << shift, subtracted when negate is set
+ */
+typedef struct {
+	const ApInt *ap;
+	int negate;
+	unsigned shift;
+} ApTerm;
+
 /* Constructors and destructors */
 ApInt *apint_create_from_u64(uint64_t val);
 ApInt *apint_create_from_hex(const char *hex);
+ApInt *apint_copy(const ApInt *ap);
 void apint_destroy(ApInt *ap);
 
 /* Operations */
@@ -34,20 +80,102 @@ int apint_is_negative(const ApInt *ap);
 uint64_t apint_get_bits(const ApInt *ap, unsigned n);
 int apint_highest_bit_set(const ApInt *ap);
 char *apint_format_as_hex(const ApInt *ap);
+char *apint_format_as_decimal(const ApInt *ap);
 ApInt *apint_negate(const ApInt *ap);
+ApInt *apint_abs(const ApInt *ap);
 ApInt *apint_add(const ApInt *a, const ApInt *b);
 ApInt *apint_sub(const ApInt *a, const ApInt *b);
 int apint_compare(const ApInt *left, const ApInt *right);
 ApInt *apint_lshift(ApInt *ap);
 ApInt *apint_lshift_n(ApInt *ap, unsigned n);
 int left_greater(const ApInt *left, const ApInt *right); 
-ApInt *calc_sub(const ApInt *a, const ApInt *b, ApInt *diff);
-ApInt *calc_add(const ApInt *a, const ApInt *b, ApInt *sum);
+ApInt *calc_sub(const ApView *a, const ApView *b, ApInt *diff);
+ApInt *calc_add(const ApView *a, const ApView *b, ApInt *sum);
 char intToChar(uint64_t i);
 int charToInt(char c);
 void set_zero_data(ApInt *ap);
 ApInt *apint_lshift(ApInt *ap);
 ApInt *apint_lshift_n(ApInt *ap, unsigned n);
+ApInt *apint_wrap_limbs(uint64_t *data, size_t n, uint32_t flags);
+void apint_make_writable(ApInt *ap, size_t len);
+
+/* Operand views */
+ApView apint_view(const ApInt *ap);
+ApView apint_view_negated(const ApInt *ap);
+ApInt *apint_add_views(const ApView *a, const ApView *b);
+void limbs_release(ApInt *ap);
+
+/* Fused sums of shifted terms */
+ApInt *apint_linear_sum(const ApTerm *terms, size_t n);
+void apint_linear_sum_into(ApInt *dest, const ApTerm *terms, size_t n);
+
+/* Division */
+ApInt *apint_divmod(const ApInt *a, const ApInt *b, ApInt **rem);
+ApInt *apint_rshift_n(const ApInt *ap, unsigned n);
+ApInt *apint_gcd(const ApInt *a, const ApInt *b);
+
+/* Scalar operands, the scalar is never allocated */
+ApInt *apint_add_u64(const ApInt *a, uint64_t b);
+ApInt *apint_sub_u64(const ApInt *a, uint64_t b);
+ApInt *apint_mul_u64(const ApInt *a, uint64_t b);
+ApInt *apint_divmod_u64(const ApInt *a, uint64_t b, uint64_t *rem);
+int apint_compare_u64(const ApInt *a, uint64_t b);
+ApInt *apint_add_i64(const ApInt *a, int64_t b);
+ApInt *apint_sub_i64(const ApInt *a, int64_t b);
+ApInt *apint_mul_i64(const ApInt *a, int64_t b);
+ApInt *apint_divmod_i64(const ApInt *a, int64_t b, int64_t *rem);
+int apint_compare_i64(const ApInt *a, int64_t b);
+
+/* Fused multiply-add, acc is updated in place */
+void apint_addmul(ApInt *acc, const ApInt *a, const ApInt *b);
+void apint_submul(ApInt *acc, const ApInt *a, const ApInt *b);
+void apint_addmul_u64(ApInt *acc, const ApInt *a, uint64_t b);
+void apint_submul_u64(ApInt *acc, const ApInt *a, uint64_t b);
+void apint_add_shifted(ApInt *acc, const ApInt *a, unsigned shift);
+void apint_sub_shifted(ApInt *acc, const ApInt *a, unsigned shift);
+
+/* Multiplication and product trees */
+ApInt *apint_mul(const ApInt *a, const ApInt *b);
+ApInt *apint_product(ApInt *const *factors, size_t n);
+ApInt *apint_product_u64(const uint64_t *factors, size_t n);
+ApInt *apint_factorial(uint64_t n);
+ApInt *apint_primorial(uint64_t n);
+ApInt *apint_binomial(uint64_t n, uint64_t k);
+
+/* Scratch arena */
+void apint_scratch_init(ApScratch *s, size_t limbs);
+void apint_scratch_reserve(ApScratch *s, size_t limbs);
+uint64_t *apint_scratch_alloc(ApScratch *s, size_t limbs);
+void apint_scratch_release(ApScratch *s, size_t mark);
+void apint_scratch_destroy(ApScratch *s);
+ApScratch *apint_scratch_acquire(ApScratch *local, size_t limbs);
+void apint_scratch_return(ApScratch *s, ApScratch *local);
+
+/* Limb kernels (little-endian limb arrays, see ApInt data) */
+size_t limbs_normalized_len(const uint64_t *ap, size_t n);
+int limbs_cmp(const uint64_t *ap, const uint64_t *bp, size_t n);
+uint64_t limbs_add_n(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n);
+uint64_t limbs_sub_n(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n);
+uint64_t limbs_add_1(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b);
+uint64_t limbs_sub_1(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b);
+uint64_t limbs_add(uint64_t *rp, const uint64_t *ap, size_t an, const uint64_t *bp, size_t bn);
+uint64_t limbs_sub(uint64_t *rp, const uint64_t *ap, size_t an, const uint64_t *bp, size_t bn);
+uint64_t limbs_mul_1(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b);
+uint64_t limbs_addmul_1(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b);
+uint64_t limbs_submul_1(uint64_t *rp, const uint64_t *ap, size_t n, uint64_t b);
+uint64_t limbs_divrem_1(uint64_t *qp, const uint64_t *ap, size_t n, uint64_t d);
+void limb_divisor_init(ApLimbDivisor *dv, uint64_t d);
+uint64_t limb_mulmod(uint64_t a, uint64_t b, const ApLimbDivisor *dv);
+uint64_t limbs_divrem_1_preinv(uint64_t *qp, const uint64_t *ap, size_t n, const ApLimbDivisor *dv);
+uint64_t limbs_lshift(uint64_t *rp, const uint64_t *ap, size_t n, unsigned s);
+uint64_t limbs_rshift(uint64_t *rp, const uint64_t *ap, size_t n, unsigned s);
+void limbs_and_n(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n);
+void limbs_ior_n(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n);
+void limbs_xor_n(uint64_t *rp, const uint64_t *ap, const uint64_t *bp, size_t n);
+void limbs_divrem(uint64_t *qp, uint64_t *rp, const uint64_t *up, size_t un, const uint64_t *dp, size_t dn);
+void limbs_mul_basecase(uint64_t *rp, const uint64_t *ap, size_t an, const uint64_t *bp, size_t bn);
+void limbs_mul(uint64_t *rp, const uint64_t *ap, size_t an, const uint64_t *bp, size_t bn, ApScratch *s);
+size_t limbs_mul_scratch_size(size_t an, size_t bn);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,303 @@
+/*
+ * C++ interface to the arbitrary-precision integer data type
+ *
+ * apint::Integer owns an ApInt and frees it with apint_destroy. Sums,
+ * differences, negations and left shifts of Integers build expression
+ * objects instead of values; assigning or converting an expression
+ * evaluates all of its terms at once with apint_linear_sum, so
+ *
+ *     Integer d = a + b - c;
+ *     x += y << k;
+ *
+ * each make one pass over the limbs and allocate nothing but the result
+ * (the second one updates x in place). Expressions refer to their
+ * operands, so they must be evaluated within the statement that builds
+ * them; do not keep one in an auto variable.
+ */
+
+#ifndef APINT_HPP
+#define APINT_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "apint.h"
+
+namespace apint {
+
+class Integer;
+
+/* base of all expression nodes, in this namespace so operators are found by ADL */
+struct ExprBase {};
+
+namespace detail {
+
+template <class T>
+struct is_expr : std::is_base_of<ExprBase, T> {};
+
+template <class T>
+struct is_operand : std::integral_constant<bool, is_expr<T>::value || std::is_same<T, Integer>::value> {};
+
+/* leaf: refers to an Integer */
+struct Ref : ExprBase {
+	static constexpr std::size_t count = 1;
+	const Integer &value;
+
+	explicit Ref(const Integer &v) : value(v) {}
+
+	inline void collect(ApTerm *terms, std::size_t &n, bool negate, unsigned shift) const;
+};
+
+/* l + r, or l - r when Sub */
+template <class L, class R, bool Sub>
+struct AddExpr : ExprBase {
+	static constexpr std::size_t count = L::count + R::count;
+	L l;
+	R r;
+
+	AddExpr(const L &left, const R &right) : l(left), r(right) {}
+
+	void collect(ApTerm *terms, std::size_t &n, bool negate, unsigned shift) const {
+		l.collect(terms, n, negate, shift);
+		r.collect(terms, n, negate != Sub, shift);
+	}
+};
+
+/* e << k */
+template <class E>
+struct ShlExpr : ExprBase {
+	static constexpr std::size_t count = E::count;
+	E e;
+	unsigned k;
+
+	ShlExpr(const E &inner, unsigned bits) : e(inner), k(bits) {}
+
+	void collect(ApTerm *terms, std::size_t &n, bool negate, unsigned shift) const {
+		e.collect(terms, n, negate, shift + k);
+	}
+};
+
+/* -e */
+template <class E>
+struct NegExpr : ExprBase {
+	static constexpr std::size_t count = E::count;
+	E e;
+
+	explicit NegExpr(const E &inner) : e(inner) {}
+
+	void collect(ApTerm *terms, std::size_t &n, bool negate, unsigned shift) const {
+		e.collect(terms, n, !negate, shift);
+	}
+};
+
+inline Ref to_expr(const Integer &v) {
+	return Ref(v);
+}
+
+template <class E, typename std::enable_if<is_expr<E>::value, int>::type = 0>
+const E &to_expr(const E &e) {
+	return e;
+}
+
+template <class T>
+using expr_t = typename std::decay<decltype(to_expr(std::declval<const T &>()))>::type;
+
+/* terms of an expression, ready for apint_linear_sum */
+template <class E>
+std::array<ApTerm, E::count> terms_of(const E &e) {
+	std::array<ApTerm, E::count> terms;
+	std::size_t n = 0;
+	e.collect(terms.data(), n, false, 0);
+	return terms;
+}
+
+} // namespace detail
+
+class Integer {
+public:
+	Integer() : ap_(apint_create_from_u64(0UL)) {}
+
+	template <class T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+	Integer(T v) : ap_(nullptr) {
+		if (std::is_signed<T>::value && v < 0) {
+			ap_ = apint_create_from_u64(0UL - (uint64_t) v);
+			ap_->flags = 0;
+		} else {
+			ap_ = apint_create_from_u64((uint64_t) v);
+		}
+	}
+
+	/* throws std::invalid_argument on a malformed hex string */
+	explicit Integer(const char *hex) : ap_(apint_create_from_hex(hex)) {
+		if (ap_ == nullptr) {
+			throw std::invalid_argument("invalid hex string");
+		}
+	}
+
+	/* takes ownership of ap */
+	explicit Integer(ApInt *ap) : ap_(ap) {}
+
+	Integer(const Integer &other) : ap_(copy(other.ap_)) {}
+
+	/* the moved-from Integer is left as 0, with no ApInt of its own */
+	Integer(Integer &&other) noexcept : ap_(other.ap_) {
+		other.ap_ = nullptr;
+	}
+
+	template <class E, typename std::enable_if<detail::is_expr<E>::value, int>::type = 0>
+	Integer(const E &e) : ap_(nullptr) {
+		auto terms = detail::terms_of(e);
+		ap_ = apint_linear_sum(terms.data(), terms.size());
+	}
+
+	~Integer() {
+		if (ap_ != nullptr) {
+			apint_destroy(ap_);
+		}
+	}
+
+	Integer &operator=(const Integer &other) {
+		if (this != &other) {
+			Integer tmp(other);
+			std::swap(ap_, tmp.ap_);
+		}
+		return *this;
+	}
+
+	Integer &operator=(Integer &&other) noexcept {
+		if (this != &other) {
+			if (ap_ != nullptr) {
+				apint_destroy(ap_);
+			}
+			ap_ = other.ap_;
+			other.ap_ = nullptr;
+		}
+		return *this;
+	}
+
+	/* evaluated in place, the expression may refer to *this */
+	template <class E, typename std::enable_if<detail::is_expr<E>::value, int>::type = 0>
+	Integer &operator=(const E &e) {
+		auto terms = detail::terms_of(e);
+		if (ap_ == nullptr) { //moved from, nothing to update
+			ap_ = apint_linear_sum(terms.data(), terms.size());
+		} else {
+			apint_linear_sum_into(ap_, terms.data(), terms.size());
+		}
+		return *this;
+	}
+
+	template <class T, typename std::enable_if<detail::is_operand<T>::value, int>::type = 0>
+	Integer &operator+=(const T &rhs) {
+		return *this = detail::AddExpr<detail::Ref, detail::expr_t<T>, false>(detail::Ref(*this), detail::to_expr(rhs));
+	}
+
+	template <class T, typename std::enable_if<detail::is_operand<T>::value, int>::type = 0>
+	Integer &operator-=(const T &rhs) {
+		return *this = detail::AddExpr<detail::Ref, detail::expr_t<T>, true>(detail::Ref(*this), detail::to_expr(rhs));
+	}
+
+	Integer &operator<<=(unsigned k) {
+		return *this = detail::ShlExpr<detail::Ref>(detail::Ref(*this), k);
+	}
+
+	Integer &operator*=(const Integer &rhs) {
+		Integer prod(apint_mul(value(), rhs.value()));
+		std::swap(ap_, prod.ap_);
+		return *this;
+	}
+
+	friend Integer operator*(const Integer &a, const Integer &b) {
+		return Integer(apint_mul(a.value(), b.value()));
+	}
+
+	/* 1, 0 or -1 like apint_compare */
+	int compare(const Integer &other) const {
+		return apint_compare(value(), other.value());
+	}
+
+	friend bool operator==(const Integer &a, const Integer &b) { return a.compare(b) == 0; }
+	friend bool operator!=(const Integer &a, const Integer &b) { return a.compare(b) != 0; }
+	friend bool operator<(const Integer &a, const Integer &b) { return a.compare(b) < 0; }
+	friend bool operator<=(const Integer &a, const Integer &b) { return a.compare(b) <= 0; }
+	friend bool operator>(const Integer &a, const Integer &b) { return a.compare(b) > 0; }
+	friend bool operator>=(const Integer &a, const Integer &b) { return a.compare(b) >= 0; }
+
+	bool is_zero() const { return apint_is_zero(value()) != 0; }
+	bool is_negative() const { return apint_is_negative(value()) != 0; }
+
+	std::string hex() const {
+		char *s = apint_format_as_hex(value());
+		std::string result(s);
+		free(s);
+		return result;
+	}
+
+	const ApInt *get() const { return value(); }
+
+	/* hands the ApInt to the caller, who frees it with apint_destroy */
+	ApInt *release() {
+		ApInt *ap = (ap_ != nullptr) ? ap_ : apint_create_from_u64(0UL);
+		ap_ = nullptr;
+		return ap;
+	}
+
+private:
+	ApInt *ap_; //NULL reads as 0 (moved from or released)
+
+	/* 0 for every Integer without an ApInt; apint_copy may share it */
+	static const ApInt *zero() {
+		static uint64_t limb = 0;
+		static ApInt z = { 1, 1, &limb, nullptr };
+		return &z;
+	}
+
+	const ApInt *value() const {
+		return (ap_ != nullptr) ? ap_ : zero();
+	}
+
+	/* shares the limbs, they are copied on the first write */
+	static ApInt *copy(const ApInt *ap) {
+		return (ap != nullptr) ? apint_copy(ap) : nullptr;
+	}
+
+	friend struct detail::Ref;
+};
+
+inline void detail::Ref::collect(ApTerm *terms, std::size_t &n, bool negate, unsigned shift) const {
+	terms[n].ap = value.value();
+	terms[n].negate = negate;
+	terms[n].shift = shift;
+	n++;
+}
+
+template <class A, class B, typename std::enable_if<detail::is_operand<A>::value && detail::is_operand<B>::value, int>::type = 0>
+detail::AddExpr<detail::expr_t<A>, detail::expr_t<B>, false> operator+(const A &a, const B &b) {
+	return detail::AddExpr<detail::expr_t<A>, detail::expr_t<B>, false>(detail::to_expr(a), detail::to_expr(b));
+}
+
+template <class A, class B, typename std::enable_if<detail::is_operand<A>::value && detail::is_operand<B>::value, int>::type = 0>
+detail::AddExpr<detail::expr_t<A>, detail::expr_t<B>, true> operator-(const A &a, const B &b) {
+	return detail::AddExpr<detail::expr_t<A>, detail::expr_t<B>, true>(detail::to_expr(a), detail::to_expr(b));
+}
+
+template <class A, typename std::enable_if<detail::is_operand<A>::value, int>::type = 0>
+detail::NegExpr<detail::expr_t<A>> operator-(const A &a) {
+	return detail::NegExpr<detail::expr_t<A>>(detail::to_expr(a));
+}
+
+template <class A, typename std::enable_if<detail::is_operand<A>::value, int>::type = 0>
+detail::ShlExpr<detail::expr_t<A>> operator<<(const A &a, unsigned k) {
+	return detail::ShlExpr<detail::expr_t<A>>(detail::to_expr(a), k);
+}
+
+} // namespace apint
+
+#endif /* APINT_HPP */
@@ -0,0 +1,550 @@
+/*
+ * Benchmarks for arbitrary-precision integer data type
+ *
+ * Usage: ./apintBench [max_threads [digits]]
+ *
+ * Every benchmark runs with 1, 2, 4, ... up to max_threads threads
+ * (default 1) and reports the best wall time and speedup over 1 thread.
+ * Given digits, only pi, e and log 2 are computed to that many digits,
+ * once per thread count, and reported in digits per second.
+ * APINT_CPU=generic|bmi2|avx2|avx512 caps the kernel tier (see apcpu.h).
+ * Built with make STATS=1 it ends with the operation statistics.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "apint.h"
+#include "apthread.h"
+#include "apbatch.h"
+#include "aprns.h"
+#include "apprime.h"
+#include "aprandom.h"
+#include "apsort.h"
+#include "appoly.h"
+#include "aprat.h"
+#include "apfloat.h"
+#include "apconst.h"
+#include "apcpu.h"
+#include "apstats.h"
+
+#define BENCH_REPS 3
+
+typedef struct {
+	const char *name;
+	void (*setup)(size_t size);
+	void (*run)(void);
+	void (*cleanup)(void);
+	size_t size;
+} Benchmark;
+
+static ApInt *bench_a;
+static ApInt *bench_b;
+
+static double now_seconds(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* 
+ * ApInt with size limbs of deterministic pseudo-random data
+ */
+static ApInt *bench_operand(size_t size, uint64_t seed) {
+	uint64_t *data = (uint64_t *)malloc(size * sizeof(uint64_t));
+	for (size_t i = 0; i < size; i++) {
+		seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+		data[i] = seed ^ (seed >> 29);
+	}
+	data[size - 1] |= 1UL << 63;
+	return apint_wrap_limbs(data, size, 1);
+}
+
+static void setup_mul(size_t size) {
+	bench_a = bench_operand(size, 1);
+	bench_b = bench_operand(size, 2);
+}
+
+static void run_mul(void) {
+	apint_destroy(apint_mul(bench_a, bench_b));
+}
+
+static void cleanup_operands(void) {
+	apint_destroy(bench_a);
+	apint_destroy(bench_b);
+}
+
+static size_t bench_n;
+
+static void setup_n(size_t size) {
+	bench_n = size;
+}
+
+static void run_factorial(void) {
+	apint_destroy(apint_factorial(bench_n));
+}
+
+static void run_product(void) {
+	uint64_t *factors = (uint64_t *)malloc(bench_n * sizeof(uint64_t));
+	for (size_t i = 0; i < bench_n; i++) {
+		factors[i] = 0xFFFFFFFF00000000UL + i; //one limb each, no packing
+	}
+	apint_destroy(apint_product_u64(factors, bench_n));
+	free(factors);
+}
+
+static void cleanup_nothing(void) {
+}
+
+static ApInt **batch_a;
+static ApInt **batch_b;
+static ApInt **batch_results;
+
+static void setup_batch(size_t size) {
+	bench_n = size;
+	batch_a = (ApInt **)malloc(size * sizeof(ApInt *));
+	batch_b = (ApInt **)malloc(size * sizeof(ApInt *));
+	batch_results = (ApInt **)malloc(size * sizeof(ApInt *));
+	for (size_t i = 0; i < size; i++) {
+		batch_a[i] = bench_operand(1 + i % 4, 2 * i + 1);
+		batch_b[i] = bench_operand(1 + i % 3, 2 * i + 2);
+	}
+}
+
+static void run_add_loop(void) {
+	for (size_t i = 0; i < bench_n; i++) {
+		batch_results[i] = apint_add(batch_a[i], batch_b[i]);
+	}
+	for (size_t i = 0; i < bench_n; i++) {
+		apint_destroy(batch_results[i]);
+	}
+}
+
+static void run_add_batch(void) {
+	apint_add_batch(batch_results, batch_a, batch_b, bench_n);
+	for (size_t i = 0; i < bench_n; i++) {
+		apint_destroy(batch_results[i]);
+	}
+}
+
+static void cleanup_batch(void) {
+	for (size_t i = 0; i < bench_n; i++) {
+		apint_destroy(batch_a[i]);
+		apint_destroy(batch_b[i]);
+	}
+	free(batch_a);
+	free(batch_b);
+	free(batch_results);
+}
+
+static ApRnsBasis *rns_basis;
+static ApRns *rns_a;
+static ApRns *rns_b;
+static ApRns *rns_r;
+
+/* 
+ * Two limb operands, products need a 256 bit basis
+ */
+static void setup_rns(size_t size) {
+	bench_n = size;
+	batch_a = (ApInt **)malloc(size * sizeof(ApInt *));
+	batch_b = (ApInt **)malloc(size * sizeof(ApInt *));
+	batch_results = (ApInt **)malloc(size * sizeof(ApInt *));
+	rns_basis = apint_rns_basis_create(256);
+	rns_a = apint_rns_create(rns_basis, size);
+	rns_b = apint_rns_create(rns_basis, size);
+	rns_r = apint_rns_create(rns_basis, size);
+	for (size_t i = 0; i < size; i++) {
+		batch_a[i] = bench_operand(2, 2 * i + 1);
+		batch_b[i] = bench_operand(2, 2 * i + 2);
+		apint_rns_set(rns_a, i, batch_a[i]);
+		apint_rns_set(rns_b, i, batch_b[i]);
+	}
+}
+
+static void run_mul_loop(void) {
+	for (size_t i = 0; i < bench_n; i++) {
+		batch_results[i] = apint_mul(batch_a[i], batch_b[i]);
+	}
+	for (size_t i = 0; i < bench_n; i++) {
+		apint_destroy(batch_results[i]);
+	}
+}
+
+static void run_rns_mul(void) {
+	apint_rns_mul(rns_r, rns_a, rns_b);
+}
+
+/* 
+ * Conversion in and out included
+ */
+static void run_rns_roundtrip(void) {
+	for (size_t i = 0; i < bench_n; i++) {
+		apint_rns_set(rns_a, i, batch_a[i]);
+		apint_rns_set(rns_b, i, batch_b[i]);
+	}
+	apint_rns_mul(rns_r, rns_a, rns_b);
+	for (size_t i = 0; i < bench_n; i++) {
+		apint_destroy(apint_rns_get(rns_r, i));
+	}
+}
+
+static void cleanup_rns(void) {
+	apint_rns_destroy(rns_a);
+	apint_rns_destroy(rns_b);
+	apint_rns_destroy(rns_r);
+	apint_rns_basis_destroy(rns_basis);
+	cleanup_batch();
+}
+
+static void run_random_primes(void) {
+	ApRandom rng;
+	apint_random_seed(&rng, 7UL);
+	for (int i = 0; i < 4; i++) {
+		apint_destroy(apint_random_prime(bench_n, apint_random_next, &rng));
+	}
+}
+
+static ApInt **sort_work;
+
+/* 
+ * Random signs and 1 to 3 limbs, sorted from the same order every run
+ */
+static void setup_sort(size_t size) {
+	bench_n = size;
+	batch_a = (ApInt **)malloc(size * sizeof(ApInt *));
+	sort_work = (ApInt **)malloc(size * sizeof(ApInt *));
+	for (size_t i = 0; i < size; i++) {
+		batch_a[i] = bench_operand(1 + i % 3, i + 1);
+		batch_a[i]->flags = (uint32_t) (i / 3) & 1;
+	}
+}
+
+static void run_qsort(void) {
+	memcpy(sort_work, batch_a, bench_n * sizeof(ApInt *));
+	qsort(sort_work, bench_n, sizeof(ApInt *), apint_compare_ptrs);
+}
+
+static void run_radix_sort(void) {
+	memcpy(sort_work, batch_a, bench_n * sizeof(ApInt *));
+	apint_sort(sort_work, bench_n);
+}
+
+static void cleanup_sort(void) {
+	for (size_t i = 0; i < bench_n; i++) {
+		apint_destroy(batch_a[i]);
+	}
+	free(batch_a);
+	free(sort_work);
+}
+
+static ApInt *poly_c[256];
+static size_t poly_n;
+
+static void setup_poly(size_t coeffs, size_t points, size_t point_limbs) {
+	poly_n = coeffs;
+	bench_n = points;
+	for (size_t i = 0; i < poly_n; i++) {
+		poly_c[i] = bench_operand(4, i + 1);
+	}
+	batch_a = (ApInt **)malloc(bench_n * sizeof(ApInt *));
+	batch_results = (ApInt **)malloc(bench_n * sizeof(ApInt *));
+	for (size_t i = 0; i < bench_n; i++) {
+		batch_a[i] = bench_operand(point_limbs, 1000 + i);
+	}
+}
+
+/* 
+ * 256 coefficients of 4 limbs at size one limb points
+ */
+static void setup_poly_points(size_t size) {
+	setup_poly(256, size, 1);
+}
+
+/* 
+ * 64 coefficients of 4 limbs at one point of size limbs
+ */
+static void setup_poly_wide(size_t size) {
+	setup_poly(64, 1, size);
+}
+
+static void run_poly_horner(void) {
+	for (size_t i = 0; i < bench_n; i++) {
+		apint_destroy(apint_poly_horner(poly_c, poly_n, batch_a[i]));
+	}
+}
+
+static void run_poly_estrin(void) {
+	for (size_t i = 0; i < bench_n; i++) {
+		apint_destroy(apint_poly_estrin(poly_c, poly_n, batch_a[i]));
+	}
+}
+
+static void run_poly_multi(void) {
+	apint_poly_eval_multi(poly_c, poly_n, batch_a, bench_n, batch_results);
+	for (size_t i = 0; i < bench_n; i++) {
+		apint_destroy(batch_results[i]);
+	}
+}
+
+static void run_poly_tree(void) {
+	apint_poly_eval_tree(poly_c, poly_n, batch_a, bench_n, batch_results);
+	for (size_t i = 0; i < bench_n; i++) {
+		apint_destroy(batch_results[i]);
+	}
+}
+
+static void cleanup_poly(void) {
+	for (size_t i = 0; i < poly_n; i++) {
+		apint_destroy(poly_c[i]);
+	}
+	for (size_t i = 0; i < bench_n; i++) {
+		apint_destroy(batch_a[i]);
+	}
+	free(batch_a);
+	free(batch_results);
+}
+
+/* 
+ * Sum of 1/(i^2 + 1) for i <= bench_n, reduced after every addition
+ * (eager) or only as the library decides (lazy)
+ */
+static void rat_sum(int eager) {
+	ApInt *one = apint_create_from_u64(1UL);
+	ApRat *sum = apint_rat_from_apint(one);
+	for (size_t i = 1; i <= bench_n; i++) {
+		ApInt *den = apint_create_from_u64(i * i + 1);
+		ApRat *term = apint_rat_create(one, den);
+		ApRat *next = apint_rat_add(sum, term);
+		if (eager) {
+			apint_rat_reduce(next);
+		}
+		apint_rat_destroy(term);
+		apint_rat_destroy(sum);
+		apint_destroy(den);
+		sum = next;
+	}
+	free(apint_rat_format_as_hex(sum));
+	apint_rat_destroy(sum);
+	apint_destroy(one);
+}
+
+static void run_rat_eager(void) {
+	rat_sum(1);
+}
+
+static void run_rat_lazy(void) {
+	rat_sum(0);
+}
+
+static ApFloat *float_a;
+static ApFloat *float_b;
+static size_t float_prec;
+
+#define FLOAT_REPS 2000
+
+/* 
+ * Two floats of size bits, operated on at that precision
+ */
+static void setup_float(size_t size) {
+	float_prec = size;
+	bench_a = bench_operand((size + 63) / 64, 1);
+	bench_b = bench_operand((size + 63) / 64, 2);
+	float_a = apint_float_from_apint(bench_a, size, AP_ROUND_NEAREST);
+	float_b = apint_float_from_apint(bench_b, size, AP_ROUND_NEAREST);
+}
+
+static void run_float_mul(void) {
+	for (int i = 0; i < FLOAT_REPS; i++) {
+		apint_float_destroy(apint_float_mul(float_a, float_b, float_prec, AP_ROUND_NEAREST));
+	}
+}
+
+/* 
+ * The full product rounded afterwards, for comparison with the short one
+ */
+static void run_float_mul_full(void) {
+	for (int i = 0; i < FLOAT_REPS; i++) {
+		ApInt *p = apint_mul(float_a->man, float_b->man);
+		apint_float_destroy(apint_float_from_apint(p, float_prec, AP_ROUND_NEAREST));
+		apint_destroy(p);
+	}
+}
+
+static void run_float_div(void) {
+	for (int i = 0; i < FLOAT_REPS; i++) {
+		apint_float_destroy(apint_float_div(float_a, float_b, float_prec, AP_ROUND_NEAREST));
+	}
+}
+
+static void run_float_sqrt(void) {
+	for (int i = 0; i < FLOAT_REPS; i++) {
+		apint_float_destroy(apint_float_sqrt(float_a, float_prec, AP_ROUND_NEAREST));
+	}
+}
+
+static void cleanup_float(void) {
+	apint_float_destroy(float_a);
+	apint_float_destroy(float_b);
+	cleanup_operands();
+}
+
+/* 
+ * Working precision for digits decimals
+ */
+static size_t digits_prec(size_t digits) {
+	return (size_t) ((double) digits * 3.3219280948873623) + 64;
+}
+
+/* 
+ * A constant to digits decimals, formatted; returns the seconds the
+ * formatting took in *format_seconds
+ */
+static void compute_constant(ApFloat *(*constant)(size_t prec), size_t digits, double *format_seconds) {
+	ApFloat *f = constant(digits_prec(digits));
+	double start = now_seconds();
+	free(apint_float_format_as_decimal(f, digits));
+	*format_seconds = now_seconds() - start;
+	apint_float_destroy(f);
+}
+
+static void run_pi(void) {
+	double format;
+	compute_constant(apint_const_pi, bench_n, &format);
+}
+
+static void run_e(void) {
+	double format;
+	compute_constant(apint_const_e, bench_n, &format);
+}
+
+static void run_ln2(void) {
+	double format;
+	compute_constant(apint_const_ln2, bench_n, &format);
+}
+
+static Benchmark benchmarks[] = {
+	{ "mul 4k limbs", setup_mul, run_mul, cleanup_operands, 4000 },
+	{ "mul 32k limbs", setup_mul, run_mul, cleanup_operands, 32000 },
+	{ "factorial 200000", setup_n, run_factorial, cleanup_nothing, 200000 },
+	{ "product 100k limbs", setup_n, run_product, cleanup_nothing, 100000 },
+	{ "add loop 1M", setup_batch, run_add_loop, cleanup_batch, 1000000 },
+	{ "add batch 1M", setup_batch, run_add_batch, cleanup_batch, 1000000 },
+	{ "mul loop 1M x 2 limbs", setup_rns, run_mul_loop, cleanup_rns, 1000000 },
+	{ "rns mul 1M x 2 limbs", setup_rns, run_rns_mul, cleanup_rns, 1000000 },
+	{ "rns in+mul+out 1M", setup_rns, run_rns_roundtrip, cleanup_rns, 1000000 },
+	{ "4 random primes 1024", setup_n, run_random_primes, cleanup_nothing, 1024 },
+	{ "qsort 1M", setup_sort, run_qsort, cleanup_sort, 1000000 },
+	{ "radix sort 1M", setup_sort, run_radix_sort, cleanup_sort, 1000000 },
+	{ "qsort 10M", setup_sort, run_qsort, cleanup_sort, 10000000 },
+	{ "radix sort 10M", setup_sort, run_radix_sort, cleanup_sort, 10000000 },
+	{ "poly multi 1k points", setup_poly_points, run_poly_multi, cleanup_poly, 1024 },
+	{ "poly tree 1k points", setup_poly_points, run_poly_tree, cleanup_poly, 1024 },
+	{ "poly horner 1k limbs", setup_poly_wide, run_poly_horner, cleanup_poly, 1024 },
+	{ "poly estrin 1k limbs", setup_poly_wide, run_poly_estrin, cleanup_poly, 1024 },
+	{ "rational eager 2k", setup_n, run_rat_eager, cleanup_nothing, 2000 },
+	{ "rational lazy 2k", setup_n, run_rat_lazy, cleanup_nothing, 2000 },
+	{ "float mul 2k x 1k bits", setup_float, run_float_mul, cleanup_float, 1024 },
+	{ "full mul 2k x 1k bits", setup_float, run_float_mul_full, cleanup_float, 1024 },
+	{ "float mul 2k x 4k bits", setup_float, run_float_mul, cleanup_float, 4096 },
+	{ "full mul 2k x 4k bits", setup_float, run_float_mul_full, cleanup_float, 4096 },
+	{ "float div 2k x 4k bits", setup_float, run_float_div, cleanup_float, 4096 },
+	{ "float sqrt 2k x 4k bits", setup_float, run_float_sqrt, cleanup_float, 4096 },
+	{ "pi 100k digits", setup_n, run_pi, cleanup_nothing, 100000 },
+	{ "e 100k digits", setup_n, run_e, cleanup_nothing, 100000 },
+	{ "ln2 100k digits", setup_n, run_ln2, cleanup_nothing, 100000 },
+};
+
+/* 
+ * Best wall time of BENCH_REPS runs
+ */
+static double time_benchmark(Benchmark *b) {
+	double best = -1.0;
+	b->setup(b->size);
+	for (int rep = 0; rep < BENCH_REPS; rep++) {
+		double start = now_seconds();
+		b->run();
+		double elapsed = now_seconds() - start;
+		if (best < 0 || elapsed < best) {
+			best = elapsed;
+		}
+	}
+	b->cleanup();
+	return best;
+}
+
+/* 
+ * Thread count after threads in 1, 2, 4, ..., max_threads (always ending
+ * with max_threads), or max_threads + 1 once that has run
+ */
+static unsigned next_thread_count(unsigned threads, unsigned max_threads) {
+	if (threads >= max_threads) {
+		return max_threads + 1;
+	}
+	return (threads * 2 < max_threads) ? threads * 2 : max_threads;
+}
+
+/* 
+ * ./apintBench max_threads digits: one run of each constant, with the
+ * series and the decimal formatting timed apart
+ */
+static void run_constants(unsigned max_threads, size_t digits) {
+	static const struct {
+		const char *name;
+		ApFloat *(*constant)(size_t prec);
+	} constants[] = {
+		{ "pi", apint_const_pi }, { "e", apint_const_e }, { "ln2", apint_const_ln2 },
+	};
+	printf("%-10s %12s %8s %12s %12s %14s\n", "constant", "digits", "threads", "seconds", "format", "digits/s");
+	for (size_t i = 0; i < sizeof(constants) / sizeof(constants[0]); i++) {
+		for (unsigned threads = 1; threads <= max_threads; threads = next_thread_count(threads, max_threads)) {
+			apint_threads_init(threads);
+			double format;
+			double start = now_seconds();
+			compute_constant(constants[i].constant, digits, &format);
+			double t = now_seconds() - start;
+			printf("%-10s %12zu %8u %12.3f %12.3f %14.0f\n", constants[i].name, digits, threads, t, format, (double) digits / t);
+		}
+	}
+}
+
+/* 
+ * Every benchmark at 1, 2, 4, ... max_threads threads
+ */
+static void run_suite(unsigned max_threads) {
+	printf("%-22s %8s %12s %8s\n", "benchmark", "threads", "seconds", "speedup");
+	for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+		double base = 0.0;
+		for (unsigned threads = 1; threads <= max_threads; threads = next_thread_count(threads, max_threads)) {
+			apint_threads_init(threads);
+			double t = time_benchmark(&benchmarks[i]);
+			if (threads == 1) {
+				base = t;
+			}
+			printf("%-22s %8u %12.4f %8.2f\n", benchmarks[i].name, threads, t, base / t);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	unsigned max_threads = 1;
+	if (argc > 1) {
+		max_threads = (unsigned) atoi(argv[1]);
+		if (max_threads < 1) {
+			max_threads = 1;
+		}
+	}
+
+	printf("kernel tier: %s\n", apint_cpu_tier_name(apint_cpu_tier()));
+	if (argc > 2) {
+		run_constants(max_threads, (size_t) atol(argv[2]));
+	} else {
+		run_suite(max_threads);
+	}
+	apint_threads_shutdown();
+	if (apint_stats_enabled()) { //make STATS=1
+		apint_stats_dump(stdout);
+	}
+	return 0;
+}
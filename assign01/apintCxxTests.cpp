@@ -0,0 +1,269 @@
+/*
+ * Unit tests for the C++ interfaces of the arbitrary-precision integer data type
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "apint.h"
+#include "apfixed.hpp"
+#include "apint.hpp"
+#include "tctest.h"
+
+using apint::FixedInt;
+using apint::Integer;
+
+typedef struct {
+	ApInt *big;
+	ApInt *minus_big;
+} TestObjs;
+
+TestObjs *setup(void);
+void cleanup(TestObjs *objs);
+
+void testFixedConstexpr(TestObjs *objs);
+void testFixedArith(TestObjs *objs);
+void testFixedShift(TestObjs *objs);
+void testFixedInterop(TestObjs *objs);
+void testIntegerOwnership(TestObjs *objs);
+void testIntegerExpressions(TestObjs *objs);
+void testIntegerCompound(TestObjs *objs);
+
+int main(int argc, char **argv) {
+	TEST_INIT();
+
+	if (argc > 1) {
+		tctest_testname_to_execute = argv[1];
+	}
+
+	TEST(testFixedConstexpr);
+	TEST(testFixedArith);
+	TEST(testFixedShift);
+	TEST(testFixedInterop);
+	TEST(testIntegerOwnership);
+	TEST(testIntegerExpressions);
+	TEST(testIntegerCompound);
+
+	TEST_FINI();
+}
+
+TestObjs *setup(void) {
+	TestObjs *objs = (TestObjs *) malloc(sizeof(TestObjs));
+	objs->big = apint_create_from_hex("539de8758b19e823b1badcccc9d587172a8117e2466f06c1");
+	objs->minus_big = apint_create_from_hex("-f2229c93c3f42f893e398c4ca6e5b120dfb7c8d386f626d9aa08010543c52");
+	return objs;
+}
+
+void cleanup(TestObjs *objs) {
+	apint_destroy(objs->big);
+	apint_destroy(objs->minus_big);
+	free(objs);
+}
+
+/* checks that the string form of f matches hex */
+static int fixed_matches(const ApInt *ap, const char *hex) {
+	char *s = apint_format_as_hex(ap);
+	int same = strcmp(s, hex) == 0;
+	free(s);
+	return same;
+}
+
+/* evaluated entirely by the compiler */
+static_assert(FixedInt<256>(5) + FixedInt<256>(7) == FixedInt<256>(12), "add");
+static_assert(FixedInt<256>(5) - FixedInt<256>(7) == FixedInt<256>(-2), "sub");
+static_assert((FixedInt<128>(1) << 100 >> 100) == FixedInt<128>(1), "shift");
+static_assert(FixedInt<128>(-1) < FixedInt<128>(0), "signed compare");
+static_assert((FixedInt<128>::from_u64(~0UL) * FixedInt<128>::from_u64(~0UL)).limb(1) == 0xFFFFFFFFFFFFFFFEUL, "mul");
+static_assert(FixedInt<512>(-1) + FixedInt<512>(1) == FixedInt<512>(), "carry through every limb");
+static_assert(sizeof(FixedInt<256>) == 32, "no overhead beyond the limbs");
+
+void testFixedConstexpr(TestObjs *objs) {
+	(void) objs;
+	constexpr FixedInt<192> x = (FixedInt<192>(1) << 130) - FixedInt<192>(1);
+	ASSERT(x.limb(0) == ~0UL);
+	ASSERT(x.limb(1) == ~0UL);
+	ASSERT(x.limb(2) == 3UL);
+	constexpr FixedInt<192> sq = x * x; //wraps modulo 2^192
+	ASSERT(sq.limb(0) == 1UL);
+	ASSERT(sq.limb(1) == 0UL);
+	ASSERT(sq.limb(2) == 0xFFFFFFFFFFFFFFF8UL);
+}
+
+void testFixedArith(TestObjs *objs) {
+	(void) objs;
+	FixedInt<256> a = FixedInt<256>(-1);
+	FixedInt<256> one(1);
+	ASSERT((a + one).is_zero());
+	ASSERT((FixedInt<256>() - one) == a);
+	ASSERT(a.is_negative());
+	ASSERT(-a == one);
+	ASSERT(~a == FixedInt<256>());
+
+	/* run time mul goes through the limb kernels, match the constexpr path */
+	FixedInt<256> m = FixedInt<256>::from_u64(0x123456789abcdefUL) << 70;
+	m -= FixedInt<256>(12345);
+	FixedInt<256> p = m * m * FixedInt<256>(-3);
+	constexpr FixedInt<256> cm = (FixedInt<256>::from_u64(0x123456789abcdefUL) << 70) - FixedInt<256>(12345);
+	constexpr FixedInt<256> cp = cm * cm * FixedInt<256>(-3);
+	ASSERT(p == cp);
+
+	ASSERT(FixedInt<256>::compare(one, a) == 1);
+	ASSERT(FixedInt<256>::compare(a, one) == -1);
+	ASSERT((a & one) == one);
+	ASSERT((a ^ one) == FixedInt<256>(-2));
+	ASSERT((one | FixedInt<256>(2)) == FixedInt<256>(3));
+}
+
+void testFixedShift(TestObjs *objs) {
+	(void) objs;
+	FixedInt<256> v = FixedInt<256>::from_u64(0x8000000000000001UL);
+	ASSERT((v << 1).limb(0) == 2UL);
+	ASSERT((v << 1).limb(1) == 1UL);
+	ASSERT((v << 192).limb(3) == 0x8000000000000001UL);
+	ASSERT((v << 193).limb(3) == 2UL);
+	ASSERT((v << 256).is_zero());
+	ASSERT(((v << 190) >> 190) == v);
+	ASSERT(((v << 192) >> 192) != v); //top bit became the sign
+	ASSERT((FixedInt<256>(-8) >> 2) == FixedInt<256>(-2));
+	ASSERT((FixedInt<256>(-8) >> 300) == FixedInt<256>(-1));
+	ASSERT((FixedInt<256>(8) >> 300).is_zero());
+}
+
+void testFixedInterop(TestObjs *objs) {
+	FixedInt<256> a = FixedInt<256>::from_apint(objs->big);
+	FixedInt<256> b = FixedInt<256>::from_apint(objs->minus_big);
+	ApInt *back = b.to_apint();
+	ASSERT(0 == apint_compare(back, objs->minus_big));
+	apint_destroy(back);
+
+	ApInt *sum = (a + b).to_apint();
+	ASSERT(fixed_matches(sum, "-f2229c93c3f42a4f5fb2339b0863760531eafc362e84b4319889dc9e53591"));
+	apint_destroy(sum);
+
+	ApInt *prod = (a * FixedInt<256>(-2)).to_apint();
+	ASSERT(fixed_matches(prod, "-a73bd0eb1633d0476375b99993ab0e2e55022fc48cde0d82"));
+	apint_destroy(prod);
+
+	/* values wider than 256 bits are reduced */
+	ApInt *wide = apint_lshift_n(objs->big, 200);
+	FixedInt<256> w = FixedInt<256>::from_apint(wide);
+	ASSERT(w == (a << 200));
+	apint_destroy(wide);
+}
+
+void testIntegerOwnership(TestObjs *objs) {
+	(void) objs;
+	Integer a("-7e35207519b6b06429378631ca460905c19537644f31dc50114e9dc90bb4e4ebc43cfebe6b86d");
+	Integer b(a);
+	ASSERT(a == b);
+	ASSERT(a.get() != b.get());
+	ASSERT(a.get()->data == b.get()->data); //shared until written
+
+	Integer d(b);
+	d += Integer(1);
+	ASSERT(d.get()->data != b.get()->data);
+	ASSERT(d != b);
+	ASSERT(a == b);
+
+	const ApInt *moved = a.get();
+	Integer c(std::move(a));
+	ASSERT(c.get() == moved); //moves take the ApInt and allocate nothing
+	ASSERT(a.is_zero() && a.hex() == "0");
+	ASSERT(c == b);
+	Integer copied(a);
+	ASSERT(copied.is_zero() && copied == a);
+	a = Integer(5);
+	ASSERT(a.hex() == "5");
+
+	//moved-from values take expressions and compound assignment
+	Integer e(std::move(a));
+	a = b + c;
+	ASSERT(a == b + b);
+	Integer f(std::move(a));
+	a += b;
+	ASSERT(a == b);
+	Integer g(std::move(a));
+	a -= e;
+	ASSERT(a.hex() == "-5");
+	Integer h(std::move(a));
+	a <<= 3;
+	ASSERT(a.is_zero());
+	Integer k(std::move(a));
+	a *= b;
+	ASSERT(a.is_zero());
+	ASSERT(f == b + b && g == b && h.hex() == "-5");
+	moved = c.get();
+	a = std::move(c);
+	ASSERT(a == b && a.get() == moved);
+	ASSERT(c.is_zero());
+	c = std::move(c);
+	ASSERT(c.is_zero());
+
+	ApInt *raw = b.release();
+	ASSERT(b.is_zero());
+	ApInt *zero = b.release(); //released again, a fresh 0
+	ASSERT(apint_is_zero(zero));
+	apint_destroy(zero);
+	ASSERT(fixed_matches(raw, "-7e35207519b6b06429378631ca460905c19537644f31dc50114e9dc90bb4e4ebc43cfebe6b86d"));
+	apint_destroy(raw);
+
+	int threw = 0;
+	try {
+		Integer bad("12g4");
+	} catch (const std::invalid_argument &) {
+		threw = 1;
+	}
+	ASSERT(threw);
+	ASSERT(Integer(-3).is_negative());
+	ASSERT(Integer(-3).hex() == "-3");
+}
+
+void testIntegerExpressions(TestObjs *objs) {
+	Integer a(apint_create_from_hex("539de8758b19e823b1badcccc9d587172a8117e2466f06c15bfd8ca26033661b8377b6795060c5feefab6975ec86634e"));
+	Integer b(apint_create_from_hex("-f2229c93c3f42f893e398c4ca6e5b120dfb7c8d386f626d9aa08010543c52"));
+	Integer c(apint_create_from_hex("ffffffffffffffffffffffffffffffff"));
+	(void) objs;
+
+	Integer d = a + b - c;
+	ASSERT(d.hex() == "539de8758b19e823b1badcccc9d587172a71f5b87d32c77e6369a9099b68f7bf7169bafcc328569c8210c8f5dc3226fd");
+
+	Integer e = a - a;
+	ASSERT(e.is_zero());
+	ASSERT(!e.is_negative());
+	ASSERT(e.get()->len == 1);
+
+	Integer f = -(c << 4) + c;
+	ASSERT(f.hex() == "-efffffffffffffffffffffffffffffff1");
+
+	Integer g = (c << 64) - (c << 63) - b;
+	ASSERT(g.hex() == "f2229c93c3f437893e398c4ca6e5b120dfb7c8d386f61ed9aa08010543c52");
+
+	Integer h = b * b - c;
+	ASSERT(h > c);
+}
+
+void testIntegerCompound(TestObjs *objs) {
+	(void) objs;
+	Integer x(1);
+	Integer y("ffffffffffffffff");
+	const ApInt *before = x.get();
+
+	x += y << 3;
+	ASSERT(x.hex() == "7fffffffffffffff9");
+	ASSERT(x.get() == before); //updated in place
+
+	x -= y + y;
+	ASSERT(x.hex() == "5fffffffffffffffb");
+
+	x -= x << 1; //shifted self reference
+	ASSERT(x.hex() == "-5fffffffffffffffb");
+
+	x = y - x;
+	ASSERT(x.hex() == "6fffffffffffffffa");
+
+	x <<= 100;
+	ASSERT(x.hex() == "6fffffffffffffffa0000000000000000000000000");
+
+	x *= Integer(-1);
+	ASSERT(x.hex() == "-6fffffffffffffffa0000000000000000000000000");
+}
@@ -0,0 +1,602 @@
+/*
+ * Differential fuzzer for arbitrary-precision integer data type
+ *
+ * Usage: ./apintFuzz [iterations [seed [first]]]
+ *        ./apintFuzz file...
+ *
+ * Each input is decoded into operands of skewed shapes (runs of all-ones
+ * limbs for long carry and borrow chains, single limbs, powers of two,
+ * sparse limbs, zero, and huge random values past the Karatsuba
+ * threshold) and every operation is checked against a slow schoolbook
+ * reference kept deliberately separate from the library. A mismatch
+ * prints the operands and aborts; the standalone driver first saves the
+ * input to apfuzz-crash.bin so it can be replayed by passing the file.
+ * Every operation is also timed and its cost per unit of work (limbs
+ * for linear operations, limb products for quadratic ones) is tracked,
+ * so the report at exit shows the worst inputs for each operation.
+ *
+ * Built with -DAPINT_LIBFUZZER the driver is left out and
+ * LLVMFuzzerTestOneInput can be linked with libFuzzer, e.g.
+ *   clang -g -O1 -fsanitize=fuzzer,address -DAPINT_LIBFUZZER apintFuzz.c <library sources> -lm
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "apint.h"
+
+#define FUZZ_HUGE_MIN 32
+#define FUZZ_HUGE_MAX 600
+#define FUZZ_SHIFT_MAX 300
+#define FUZZ_WORST_MIN_UNITS 16 //smaller inputs are all timer noise
+
+__extension__ typedef unsigned __int128 u128;
+
+typedef enum {
+	FUZZ_ADD,
+	FUZZ_SUB,
+	FUZZ_MUL,
+	FUZZ_DIVMOD,
+	FUZZ_COMPARE,
+	FUZZ_LSHIFT,
+	FUZZ_RSHIFT,
+	FUZZ_MUL_U64,
+	FUZZ_ADDMUL,
+	FUZZ_SUBMUL,
+	FUZZ_HEX,
+	FUZZ_OPS
+} FuzzOp;
+
+static const char *const fuzz_op_names[FUZZ_OPS] = {
+	"add", "sub", "mul", "divmod", "compare", "lshift_n", "rshift_n",
+	"mul_u64", "addmul", "submul", "hex"
+};
+
+/*
+ * Timing of one operation over all inputs
+ */
+typedef struct {
+	uint64_t runs;
+	double total_ns;
+	double worst_ns_per_unit;
+	double worst_ns;
+	size_t worst_an, worst_bn;
+	uint64_t worst_input;
+} FuzzTiming;
+
+static FuzzTiming fuzz_timing[FUZZ_OPS];
+static uint64_t fuzz_inputs;
+
+/*
+ * Reference values: sign and normalized magnitude, n == 0 for zero
+ */
+typedef struct {
+	uint64_t *d;
+	size_t n;
+	int neg;
+} Ref;
+
+/*
+ * Reads the fuzz input a byte at a time, zeros once it runs out
+ */
+typedef struct {
+	const uint8_t *p;
+	size_t n;
+	size_t pos;
+} FuzzInput;
+
+static uint8_t next_byte(FuzzInput *in) {
+	return (in->pos < in->n) ? in->p[in->pos++] : 0;
+}
+
+static uint64_t next_word(FuzzInput *in) {
+	uint64_t w = 0;
+	for (int i = 0; i < 8; i++) {
+		w |= (uint64_t) next_byte(in) << (8 * i);
+	}
+	return w;
+}
+
+static uint64_t splitmix(uint64_t *state) {
+	uint64_t z = (*state += 0x9E3779B97F4A7C15UL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9UL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBUL;
+	return z ^ (z >> 31);
+}
+
+static double now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * Reference arithmetic on magnitudes, written for obviousness
+ */
+
+static Ref ref_alloc(size_t n, int neg) {
+	Ref r;
+	r.d = (uint64_t *)calloc(n + 1, sizeof(uint64_t));
+	if (r.d == NULL) {
+		abort();
+	}
+	r.n = n;
+	r.neg = neg;
+	return r;
+}
+
+static void ref_norm(Ref *r) {
+	while (r->n > 0 && r->d[r->n - 1] == 0) {
+		r->n--;
+	}
+	if (r->n == 0) {
+		r->neg = 0;
+	}
+}
+
+static int ref_cmp_mag(const Ref *a, const Ref *b) {
+	if (a->n != b->n) {
+		return (a->n > b->n) ? 1 : -1;
+	}
+	for (size_t i = a->n; i-- > 0;) {
+		if (a->d[i] != b->d[i]) {
+			return (a->d[i] > b->d[i]) ? 1 : -1;
+		}
+	}
+	return 0;
+}
+
+static Ref ref_add_mag(const Ref *a, const Ref *b, int neg) {
+	size_t n = (a->n > b->n) ? a->n : b->n;
+	Ref r = ref_alloc(n + 1, neg);
+	u128 carry = 0;
+	for (size_t i = 0; i < n; i++) {
+		carry += (i < a->n) ? a->d[i] : 0;
+		carry += (i < b->n) ? b->d[i] : 0;
+		r.d[i] = (uint64_t) carry;
+		carry >>= 64;
+	}
+	r.d[n] = (uint64_t) carry;
+	ref_norm(&r);
+	return r;
+}
+
+/* |a| - |b| for |a| >= |b| */
+static Ref ref_sub_mag(const Ref *a, const Ref *b, int neg) {
+	Ref r = ref_alloc(a->n, neg);
+	uint64_t borrow = 0;
+	for (size_t i = 0; i < a->n; i++) {
+		uint64_t bi = (i < b->n) ? b->d[i] : 0;
+		r.d[i] = a->d[i] - bi - borrow;
+		borrow = (a->d[i] < bi) || (a->d[i] - bi < borrow);
+	}
+	ref_norm(&r);
+	return r;
+}
+
+static Ref ref_add(const Ref *a, const Ref *b, int negate_b) {
+	int bneg = b->neg ^ (negate_b && b->n > 0);
+	if (a->neg == bneg) {
+		return ref_add_mag(a, b, a->neg);
+	}
+	if (ref_cmp_mag(a, b) >= 0) {
+		return ref_sub_mag(a, b, a->neg);
+	}
+	return ref_sub_mag(b, a, bneg);
+}
+
+static Ref ref_mul(const Ref *a, const Ref *b) {
+	Ref r = ref_alloc(a->n + b->n, a->neg ^ b->neg);
+	for (size_t i = 0; i < a->n; i++) {
+		uint64_t carry = 0;
+		for (size_t j = 0; j < b->n; j++) {
+			u128 t = (u128) a->d[i] * b->d[j] + r.d[i + j] + carry;
+			r.d[i + j] = (uint64_t) t;
+			carry = (uint64_t) (t >> 64);
+		}
+		r.d[i + b->n] = carry;
+	}
+	ref_norm(&r);
+	return r;
+}
+
+static Ref ref_lshift(const Ref *a, unsigned s) {
+	Ref r = ref_alloc(a->n + s / 64 + 1, a->neg);
+	for (size_t bit = 0; bit < a->n * 64; bit++) {
+		if ((a->d[bit / 64] >> (bit % 64)) & 1) {
+			r.d[(bit + s) / 64] |= 1UL << ((bit + s) % 64);
+		}
+	}
+	ref_norm(&r);
+	return r;
+}
+
+static Ref ref_rshift(const Ref *a, unsigned s) {
+	Ref r = ref_alloc(a->n, a->neg);
+	for (size_t bit = s; bit < a->n * 64; bit++) {
+		if ((a->d[bit / 64] >> (bit % 64)) & 1) {
+			r.d[(bit - s) / 64] |= 1UL << ((bit - s) % 64);
+		}
+	}
+	ref_norm(&r);
+	return r;
+}
+
+/*
+ * Bit at a time long division, truncating like C: the quotient is
+ * rounded toward 0 and the remainder takes the sign of a
+ */
+static Ref ref_divmod(const Ref *a, const Ref *b, Ref *rem) {
+	Ref q = ref_alloc(a->n, a->neg ^ b->neg);
+	Ref r = ref_alloc(b->n + 1, a->neg);
+	r.n = 0;
+	for (size_t bit = a->n * 64; bit-- > 0;) {
+		//r = 2r + bit, r < 2|b| fits in b->n + 1 limbs
+		uint64_t carry = (a->d[bit / 64] >> (bit % 64)) & 1;
+		for (size_t i = 0; i <= b->n; i++) {
+			uint64_t top = r.d[i] >> 63;
+			r.d[i] = (r.d[i] << 1) | carry;
+			carry = top;
+		}
+		r.n = b->n + 1;
+		ref_norm(&r);
+		r.neg = a->neg;
+		if (ref_cmp_mag(&r, b) >= 0) {
+			uint64_t borrow = 0;
+			for (size_t i = 0; i <= b->n; i++) {
+				uint64_t bi = (i < b->n) ? b->d[i] : 0;
+				uint64_t ri = r.d[i];
+				r.d[i] = ri - bi - borrow;
+				borrow = (ri < bi) || (ri - bi < borrow);
+			}
+			q.d[bit / 64] |= 1UL << (bit % 64);
+		}
+	}
+	r.n = b->n + 1;
+	ref_norm(&r);
+	ref_norm(&q);
+	*rem = r;
+	return q;
+}
+
+/*
+ * Checking results
+ */
+
+static Ref ref_from_apint(const ApInt *ap) {
+	Ref r = ref_alloc(ap->len, ap->flags == 0);
+	memcpy(r.d, ap->data, ap->len * sizeof(uint64_t));
+	ref_norm(&r);
+	return r;
+}
+
+static void print_ref(const char *label, const Ref *r) {
+	printf("%s = %s0x", label, r->neg ? "-" : "");
+	if (r->n == 0) {
+		printf("0");
+	}
+	for (size_t i = r->n; i-- > 0;) {
+		printf((i == r->n - 1) ? "%lx" : "%016lx", r->d[i]);
+	}
+	printf("\n");
+}
+
+static void (*fuzz_on_failure)(void);
+
+static void fail(FuzzOp op, const Ref *a, const Ref *b, const Ref *expected, const ApInt *got, const char *why) {
+	printf("apintFuzz: %s mismatch (%s)\n", fuzz_op_names[op], why);
+	print_ref("a", a);
+	print_ref("b", b);
+	print_ref("expected", expected);
+	if (got != NULL) {
+		Ref g = ref_from_apint(got);
+		g.neg = got->flags == 0;
+		print_ref("got", &g);
+		free(g.d);
+	}
+	fflush(stdout);
+	if (fuzz_on_failure) {
+		fuzz_on_failure();
+	}
+	abort();
+}
+
+/*
+ * Compares and frees the result and the expected value; zero must be
+ * nonnegative and the magnitude must match once normalized
+ */
+static void check(FuzzOp op, const Ref *a, const Ref *b, Ref expected, ApInt *got) {
+	if (got == NULL) {
+		fail(op, a, b, &expected, NULL, "no result");
+	}
+	size_t n = limbs_normalized_len(got->data, got->len);
+	if (n == 0 && got->flags == 0) {
+		fail(op, a, b, &expected, got, "negative zero");
+	}
+	if (n != expected.n || (n > 0 && (got->flags == 0) != expected.neg)
+		|| memcmp(got->data, expected.d, n * sizeof(uint64_t)) != 0) {
+		fail(op, a, b, &expected, got, "value");
+	}
+	apint_destroy(got);
+	free(expected.d);
+}
+
+static void record(FuzzOp op, double ns, size_t an, size_t bn, double units) {
+	FuzzTiming *t = &fuzz_timing[op];
+	double per_unit = ns / (units + 1);
+	t->runs++;
+	t->total_ns += ns;
+	if (units >= FUZZ_WORST_MIN_UNITS && per_unit > t->worst_ns_per_unit) {
+		t->worst_ns_per_unit = per_unit;
+		t->worst_ns = ns;
+		t->worst_an = an;
+		t->worst_bn = bn;
+		t->worst_input = fuzz_inputs;
+	}
+}
+
+/*
+ * Operand generation
+ */
+
+typedef enum {
+	SHAPE_ONES,   //all-ones limbs: carries and borrows run the full length
+	SHAPE_SINGLE, //one limb
+	SHAPE_RANDOM, //a few limbs of input bytes
+	SHAPE_POW2,   //2^k or 2^k - 1
+	SHAPE_SPARSE, //ones at the ends and zero limbs between
+	SHAPE_ZERO,
+	SHAPE_HUGE,   //random limbs past the Karatsuba threshold
+	SHAPE_COUNT
+} FuzzShape;
+
+static ApInt *make_operand(FuzzInput *in) {
+	uint8_t shape = next_byte(in) % SHAPE_COUNT;
+	uint8_t len = next_byte(in);
+	uint32_t flags = (next_byte(in) & 1) ? 0 : 1;
+	size_t n = 1 + len % 48;
+	uint64_t *data;
+
+	switch (shape) {
+	case SHAPE_ONES:
+		data = (uint64_t *)malloc(n * sizeof(uint64_t));
+		for (size_t i = 0; i < n; i++) {
+			data[i] = ~0UL;
+		}
+		data[0] ^= next_byte(in) & 3; //sometimes just below a power of two
+		break;
+	case SHAPE_SINGLE:
+		n = 1;
+		data = (uint64_t *)malloc(sizeof(uint64_t));
+		data[0] = next_word(in);
+		break;
+	case SHAPE_RANDOM:
+		n = 1 + len % 8;
+		data = (uint64_t *)malloc(n * sizeof(uint64_t));
+		for (size_t i = 0; i < n; i++) {
+			data[i] = next_word(in);
+		}
+		break;
+	case SHAPE_POW2: {
+		unsigned k = next_byte(in) + 256 * (len % 8);
+		n = k / 64 + 1;
+		data = (uint64_t *)calloc(n, sizeof(uint64_t));
+		data[k / 64] = 1UL << (k % 64);
+		if (len & 0x80) {
+			limbs_sub_1(data, data, n, 1);
+		}
+		break;
+	}
+	case SHAPE_SPARSE:
+		n += 2;
+		data = (uint64_t *)calloc(n, sizeof(uint64_t));
+		data[0] = ~0UL;
+		data[n - 1] = 1 + (next_byte(in) & 1);
+		data[n / 2] = (len & 1) ? ~0UL : 0;
+		break;
+	case SHAPE_ZERO:
+		n = 1;
+		flags = 1;
+		data = (uint64_t *)calloc(1, sizeof(uint64_t));
+		break;
+	default: {
+		uint64_t state = next_word(in);
+		n = FUZZ_HUGE_MIN + (len * 7 + next_byte(in)) % (FUZZ_HUGE_MAX - FUZZ_HUGE_MIN);
+		data = (uint64_t *)malloc(n * sizeof(uint64_t));
+		for (size_t i = 0; i < n; i++) {
+			data[i] = splitmix(&state);
+		}
+		if (state & 1) { //a run of ones in the middle
+			for (size_t i = n / 4; i < n / 2; i++) {
+				data[i] = ~0UL;
+			}
+		}
+		break;
+	}
+	}
+	if (data == NULL) {
+		abort();
+	}
+	if (limbs_normalized_len(data, n) == 0) {
+		flags = 1;
+	}
+	return apint_wrap_limbs(data, n, flags);
+}
+
+/*
+ * Runs every operation on the operands decoded from data
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	FuzzInput in = { data, size, 0 };
+	ApInt *a = make_operand(&in);
+	ApInt *b = make_operand(&in);
+	unsigned shift = (next_byte(&in) | (next_byte(&in) << 8)) % FUZZ_SHIFT_MAX;
+	Ref ra = ref_from_apint(a), rb = ref_from_apint(b);
+	size_t an = ra.n, bn = rb.n;
+	fuzz_inputs++;
+	double t;
+
+	t = now_ns();
+	ApInt *got = apint_add(a, b);
+	record(FUZZ_ADD, now_ns() - t, an, bn, an + bn);
+	check(FUZZ_ADD, &ra, &rb, ref_add(&ra, &rb, 0), got);
+
+	t = now_ns();
+	got = apint_sub(a, b);
+	record(FUZZ_SUB, now_ns() - t, an, bn, an + bn);
+	check(FUZZ_SUB, &ra, &rb, ref_add(&ra, &rb, 1), got);
+
+	t = now_ns();
+	got = apint_mul(a, b);
+	record(FUZZ_MUL, now_ns() - t, an, bn, (double) an * bn);
+	check(FUZZ_MUL, &ra, &rb, ref_mul(&ra, &rb), got);
+
+	if (bn > 0) {
+		ApInt *rem = NULL;
+		Ref rrem;
+		t = now_ns();
+		got = apint_divmod(a, b, &rem);
+		record(FUZZ_DIVMOD, now_ns() - t, an, bn, (double) ((an > bn) ? an - bn + 1 : 1) * bn);
+		Ref q = ref_divmod(&ra, &rb, &rrem);
+		check(FUZZ_DIVMOD, &ra, &rb, q, got);
+		check(FUZZ_DIVMOD, &ra, &rb, rrem, rem);
+	}
+
+	t = now_ns();
+	int cmp = apint_compare(a, b);
+	record(FUZZ_COMPARE, now_ns() - t, an, bn, an + bn);
+	Ref diff = ref_add(&ra, &rb, 1);
+	int expected_cmp = (diff.n == 0) ? 0 : (diff.neg ? -1 : 1);
+	if ((cmp > 0) - (cmp < 0) != expected_cmp) {
+		fail(FUZZ_COMPARE, &ra, &rb, &diff, NULL, "sign of comparison");
+	}
+	free(diff.d);
+
+	t = now_ns();
+	got = apint_lshift_n(a, shift);
+	record(FUZZ_LSHIFT, now_ns() - t, an, shift, an + shift / 64);
+	check(FUZZ_LSHIFT, &ra, &rb, ref_lshift(&ra, shift), got);
+
+	t = now_ns();
+	got = apint_rshift_n(a, shift);
+	record(FUZZ_RSHIFT, now_ns() - t, an, shift, an);
+	check(FUZZ_RSHIFT, &ra, &rb, ref_rshift(&ra, shift), got);
+
+	uint64_t scalar = (bn > 0) ? rb.d[0] : 0;
+	Ref rs = ref_alloc(1, 0);
+	rs.d[0] = scalar;
+	ref_norm(&rs);
+	t = now_ns();
+	got = apint_mul_u64(a, scalar);
+	record(FUZZ_MUL_U64, now_ns() - t, an, 1, an);
+	check(FUZZ_MUL_U64, &ra, &rs, ref_mul(&ra, &rs), got);
+	free(rs.d);
+
+	//acc = a +- a * b, in place on a copy of a
+	Ref prod = ref_mul(&ra, &rb);
+	ApInt *acc = apint_copy(a);
+	t = now_ns();
+	apint_addmul(acc, a, b);
+	record(FUZZ_ADDMUL, now_ns() - t, an, bn, (double) an * bn);
+	check(FUZZ_ADDMUL, &ra, &rb, ref_add(&ra, &prod, 0), acc);
+	acc = apint_copy(a);
+	t = now_ns();
+	apint_submul(acc, a, b);
+	record(FUZZ_SUBMUL, now_ns() - t, an, bn, (double) an * bn);
+	check(FUZZ_SUBMUL, &ra, &rb, ref_add(&ra, &prod, 1), acc);
+	free(prod.d);
+
+	t = now_ns();
+	char *hex = apint_format_as_hex(a);
+	got = apint_create_from_hex(hex);
+	record(FUZZ_HEX, now_ns() - t, an, 0, an);
+	Ref same = ref_from_apint(a);
+	check(FUZZ_HEX, &ra, &rb, same, got);
+	free(hex);
+
+	free(ra.d);
+	free(rb.d);
+	apint_destroy(a);
+	apint_destroy(b);
+	return 0;
+}
+
+/*
+ * Per operation timing: mean time, and the input with the worst time
+ * per unit of work (operand sizes in limbs, shift in bits)
+ */
+static void report(void) {
+	printf("%llu inputs\n", (unsigned long long) fuzz_inputs);
+	printf("%-10s %10s %12s %14s %12s %12s %10s\n", "operation", "runs", "mean ns", "worst ns/unit", "worst ns", "sizes", "input");
+	for (int op = 0; op < FUZZ_OPS; op++) {
+		FuzzTiming *t = &fuzz_timing[op];
+		if (t->runs == 0) {
+			continue;
+		}
+		char sizes[32];
+		snprintf(sizes, sizeof(sizes), "%zux%zu", t->worst_an, t->worst_bn);
+		printf("%-10s %10lu %12.0f %14.1f %12.0f %12s %10lu\n", fuzz_op_names[op], t->runs,
+			t->total_ns / t->runs, t->worst_ns_per_unit, t->worst_ns, sizes, t->worst_input);
+	}
+}
+
+#ifdef APINT_LIBFUZZER
+int LLVMFuzzerInitialize(int *argc, char ***argv) {
+	(void) argc;
+	(void) argv;
+	atexit(report);
+	return 0;
+}
+#else
+static uint8_t current_input[256];
+static size_t current_size;
+
+static void save_crash(void) {
+	FILE *out = fopen("apfuzz-crash.bin", "wb");
+	if (out != NULL) {
+		fwrite(current_input, 1, current_size, out);
+		fclose(out);
+		printf("input saved to apfuzz-crash.bin\n");
+	}
+}
+
+/*
+ * Arguments that are not numbers are input files to replay. Otherwise
+ * input number i of a run is a function of the seed and i alone, so
+ * "first" replays from any input number the report shows (counting
+ * from 1)
+ */
+int main(int argc, char **argv) {
+	fuzz_on_failure = save_crash;
+	if (argc > 1 && strspn(argv[1], "0123456789") != strlen(argv[1])) {
+		for (int i = 1; i < argc; i++) {
+			FILE *in = fopen(argv[i], "rb");
+			if (in == NULL) {
+				printf("cannot read %s\n", argv[i]);
+				return 1;
+			}
+			current_size = fread(current_input, 1, sizeof(current_input), in);
+			fclose(in);
+			LLVMFuzzerTestOneInput(current_input, current_size);
+		}
+		report();
+		return 0;
+	}
+
+	uint64_t iterations = (argc > 1) ? strtoull(argv[1], NULL, 0) : 100000;
+	uint64_t seed = (argc > 2) ? strtoull(argv[2], NULL, 0) : 1;
+	uint64_t first = (argc > 3) ? strtoull(argv[3], NULL, 0) : 1;
+	fuzz_inputs = first - 1;
+	for (uint64_t i = first; i < first + iterations; i++) {
+		uint64_t state = seed * 0x2545F4914F6CDD1DUL + i;
+		current_size = 8 + splitmix(&state) % (sizeof(current_input) - 8);
+		for (size_t j = 0; j < current_size; j++) {
+			current_input[j] = (uint8_t) splitmix(&state);
+		}
+		LLVMFuzzerTestOneInput(current_input, current_size);
+	}
+	report();
+	return 0;
+}
+#endif
@@ -14,7 +14,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <fenv.h>
+#include <math.h>
 #include "apint.h"
+#include "apthread.h"
+#include "apbatch.h"
+#include "apsoa.h"
+#include "aprns.h"
+#include "apmont.h"
+#include "apprime.h"
+#include "aprandom.h"
+#include "aphash.h"
+#include "apsort.h"
+#include "appoly.h"
+#include "aprat.h"
+#include "apfloat.h"
+#include "apconst.h"
+#include "apcpu.h"
+#include "apstats.h"
 #include "tctest.h"
 
 typedef struct {
@@ -43,10 +61,60 @@ void testSubNoHex(TestObjs *objs);
 void testCreateFromHex(); 
 void testLeftShiftOne(TestObjs *objs);
 void testLeftShiftN(TestObjs *objs);
+void testMul(TestObjs *objs);
+void testMulKaratsuba(TestObjs *objs);
+void testProduct(TestObjs *objs);
+void testFactorial(TestObjs *objs);
+void testBinomial(TestObjs *objs);
+void testThreadedMul(TestObjs *objs);
+void testBatch(TestObjs *objs);
+void testBatchThreaded(TestObjs *objs);
+void testSoA(TestObjs *objs);
+void testSoAShift(TestObjs *objs);
+void testLinearSum(TestObjs *objs);
+void testCopyOnWrite(TestObjs *objs);
+void testSubViews(TestObjs *objs);
+void testFusedMulAdd(TestObjs *objs);
+void testScalarOps(TestObjs *objs);
+void testRns(TestObjs *objs);
+void testDivmod(TestObjs *objs);
+void testPowm(TestObjs *objs);
+void testPrimes(TestObjs *objs);
+void testRandom(TestObjs *objs);
+void testHash(TestObjs *objs);
+void testHashMap(TestObjs *objs);
+void testSort(TestObjs *objs);
+void testCpuDispatch(TestObjs *objs);
+void testStats(TestObjs *objs);
+void testThreadStress(TestObjs *objs);
+void testPolyEval(TestObjs *objs);
+void testGcd(TestObjs *objs);
+void testRational(TestObjs *objs);
+void testFloat(TestObjs *objs);
+void testDivmodReciprocal(TestObjs *objs);
+void testFormatAsDecimal(TestObjs *objs);
+void testConstants(TestObjs *objs);
 /* TODO: add more test function prototypes */
 
+/*
+ * Allocations made by the library so far, for timed runs of a
+ * -DAPINT_STATS build
+ */
+static long count_allocs(void) {
+	long total = 0;
+	for (int op = 0; op < AP_OP_COUNT; op++) {
+		ApOpStats s;
+		apint_stats_get((ApStatsOp) op, &s);
+		total += (long) s.allocs;
+	}
+	return total;
+}
+
 int main(int argc, char **argv) {
 	TEST_INIT();
+	if (apint_stats_enabled()) {
+		tctest_alloc_count = count_allocs;
+	}
 
 	if (argc > 1) {
 		/*
@@ -67,6 +135,39 @@ int main(int argc, char **argv) {
 	TEST(testCreateFromHex);
        	TEST(testLeftShiftOne);
 	TEST(testLeftShiftN); 	
+	TEST(testMul);
+	TEST(testMulKaratsuba);
+	TEST(testProduct);
+	TEST(testFactorial);
+	TEST(testBinomial);
+	TEST(testThreadedMul);
+	TEST(testBatch);
+	TEST(testBatchThreaded);
+	TEST(testSoA);
+	TEST(testSoAShift);
+	TEST(testLinearSum);
+	TEST(testCopyOnWrite);
+	TEST(testSubViews);
+	TEST(testFusedMulAdd);
+	TEST(testScalarOps);
+	TEST(testRns);
+	TEST(testDivmod);
+	TEST(testPowm);
+	TEST(testPrimes);
+	TEST(testRandom);
+	TEST(testHash);
+	TEST(testHashMap);
+	TEST(testSort);
+	TEST(testCpuDispatch);
+	TEST(testStats);
+	TEST(testThreadStress);
+	TEST(testPolyEval);
+	TEST(testGcd);
+	TEST(testRational);
+	TEST(testFloat);
+	TEST(testDivmodReciprocal);
+	TEST(testFormatAsDecimal);
+	TEST(testConstants);
 	/* TODO: use TEST macro to execute more test functions */
 
 	TEST_FINI();
@@ -700,3 +801,2080 @@ void testLeftShiftN(TestObjs *objs) {
         free(s);
 
 }
+
+void testMul(TestObjs *objs) {
+	ApInt *prod, *a, *b;
+	char *s;
+
+	prod = apint_mul(objs->ap0, objs->minus1);
+	ASSERT(0 == strcmp("0", (s = apint_format_as_hex(prod))));
+	ASSERT(prod->flags == 1);
+	apint_destroy(prod);
+	free(s);
+
+	prod = apint_mul(objs->minus2, objs->minus1);
+	ASSERT(0 == strcmp("2", (s = apint_format_as_hex(prod))));
+	apint_destroy(prod);
+	free(s);
+
+	prod = apint_mul(objs->max1, objs->max1);
+	ASSERT(0 == strcmp("fffffffffffffffe0000000000000001", (s = apint_format_as_hex(prod))));
+	ASSERT(prod->len == 2);
+	apint_destroy(prod);
+	free(s);
+
+	a = apint_create_from_hex("539de8758b19e823b1badcccc9d587172a8117e2466f06c15bfd8ca26033661b8377b6795060c5feefab6975ec86634e");
+	b = apint_create_from_hex("-f2229c93c3f42f893e398c4ca6e5b120dfb7c8d386f626d9aa08010543c52");
+	prod = apint_mul(a, b);
+	ASSERT(0 == strcmp("-4f1693dc7a701d3f2695a2961a1bb678972b8d689980d5ecd1cf939c3cab3ad71a21664e411df19fedc47c6e506a05f9b9a91c56042a6d9176b7a37728a5fe651a2ad71dd4c711f47d482b7ea16fc", (s = apint_format_as_hex(prod))));
+	apint_destroy(prod);
+	free(s);
+	prod = apint_mul(b, a);
+	ASSERT(0 == strcmp("-4f1693dc7a701d3f2695a2961a1bb678972b8d689980d5ecd1cf939c3cab3ad71a21664e411df19fedc47c6e506a05f9b9a91c56042a6d9176b7a37728a5fe651a2ad71dd4c711f47d482b7ea16fc", (s = apint_format_as_hex(prod))));
+	apint_destroy(prod);
+	apint_destroy(a);
+	apint_destroy(b);
+	free(s);
+}
+
+/* simple deterministic filler for limb arrays */
+static uint64_t test_lcg_next(uint64_t *state) {
+	*state = *state * 6364136223846793005UL + 1442695040888963407UL;
+	return *state ^ (*state >> 29);
+}
+
+void testMulKaratsuba(TestObjs *objs) {
+	(void) objs;
+	size_t sizes[][2] = { {32, 32}, {33, 33}, {75, 75}, {200, 200}, {100, 40}, {257, 64}, {500, 37} };
+	uint64_t state = 12345;
+	for (size_t t = 0; t < sizeof(sizes) / sizeof(sizes[0]); t++) {
+		size_t an = sizes[t][0], bn = sizes[t][1];
+		uint64_t *a = malloc(an * sizeof(uint64_t));
+		uint64_t *b = malloc(bn * sizeof(uint64_t));
+		uint64_t *expected = malloc((an + bn) * sizeof(uint64_t));
+		uint64_t *actual = malloc((an + bn) * sizeof(uint64_t));
+		for (size_t i = 0; i < an; i++) {
+			a[i] = (t % 2 == 0) ? test_lcg_next(&state) : ~0UL; //odd cases are all ones (long carry chains)
+		}
+		for (size_t i = 0; i < bn; i++) {
+			b[i] = (t % 2 == 0) ? test_lcg_next(&state) : ~0UL;
+		}
+		ApScratch scratch;
+		apint_scratch_init(&scratch, limbs_mul_scratch_size(an, bn));
+		limbs_mul_basecase(expected, a, an, b, bn);
+		limbs_mul(actual, a, an, b, bn, &scratch);
+		ASSERT(0 == memcmp(expected, actual, (an + bn) * sizeof(uint64_t)));
+		ASSERT(scratch.used == 0);
+		apint_scratch_destroy(&scratch);
+		free(a);
+		free(b);
+		free(expected);
+		free(actual);
+	}
+}
+
+void testProduct(TestObjs *objs) {
+	ApInt *prod;
+	char *s;
+	uint64_t factors[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29 };
+
+	prod = apint_product_u64(factors, 10);
+	ASSERT(0 == strcmp("1819faf2e", (s = apint_format_as_hex(prod))));
+	apint_destroy(prod);
+	free(s);
+
+	prod = apint_primorial(30);
+	ASSERT(0 == strcmp("1819faf2e", (s = apint_format_as_hex(prod))));
+	apint_destroy(prod);
+	free(s);
+
+	prod = apint_product_u64(factors, 0);
+	ASSERT(0 == strcmp("1", (s = apint_format_as_hex(prod))));
+	apint_destroy(prod);
+	free(s);
+
+	ApInt *items[] = { objs->max1, objs->minus2, objs->max1, objs->ap110660361, objs->minus1 };
+	prod = apint_product(items, 5);
+	ApInt *step1 = apint_mul(objs->max1, objs->max1);
+	ApInt *step2 = apint_mul(step1, objs->ap110660361);
+	ApInt *expected = apint_add(step2, step2);
+	ASSERT(0 == apint_compare(prod, expected));
+	apint_destroy(prod);
+	apint_destroy(step1);
+	apint_destroy(step2);
+	apint_destroy(expected);
+
+	items[2] = objs->ap0;
+	prod = apint_product(items, 5);
+	ASSERT(apint_is_zero(prod));
+	ASSERT(prod->flags == 1);
+	apint_destroy(prod);
+}
+
+void testFactorial(TestObjs *objs) {
+	ApInt *f;
+	char *s;
+	(void) objs;
+
+	f = apint_factorial(0);
+	ASSERT(0 == strcmp("1", (s = apint_format_as_hex(f))));
+	apint_destroy(f);
+	free(s);
+
+	f = apint_factorial(20);
+	ASSERT(0 == strcmp("21c3677c82b40000", (s = apint_format_as_hex(f))));
+	apint_destroy(f);
+	free(s);
+
+	f = apint_factorial(100);
+	ASSERT(0 == strcmp("1b30964ec395dc24069528d54bbda40d16e966ef9a70eb21b5b2943a321cdf10391745570cca9420c6ecb3b72ed2ee8b02ea2735c61a000000000000000000000000", (s = apint_format_as_hex(f))));
+	apint_destroy(f);
+	free(s);
+
+	/* 1000! has 2133 hex digits */
+	f = apint_factorial(1000);
+	s = apint_format_as_hex(f);
+	ASSERT(2133 == strlen(s));
+	apint_destroy(f);
+	free(s);
+}
+
+void testBinomial(TestObjs *objs) {
+	ApInt *c;
+	char *s;
+	(void) objs;
+
+	c = apint_binomial(100, 50);
+	ASSERT(0 == strcmp("145ff5d3b1070380dc8085568", (s = apint_format_as_hex(c))));
+	apint_destroy(c);
+	free(s);
+
+	c = apint_binomial(1000, 333);
+	ASSERT(0 == strcmp("1ab177f6ded89e070a14aa7178fbfcfcccecf4cbc409c280dcd86a275c8600b1d2417f34fa4e61b85f6825567a76633834b3becf91bf039e9c861754c9e66cc3f75b71e0938bb5d1180332c161ea675ac9e0d0c6f3b06c81578acf71e3fa2a3a372e8711c0376ac105c371e78886737d10d60", (s = apint_format_as_hex(c))));
+	apint_destroy(c);
+	free(s);
+
+	c = apint_binomial(10, 0);
+	ASSERT(0 == strcmp("1", (s = apint_format_as_hex(c))));
+	apint_destroy(c);
+	free(s);
+
+	c = apint_binomial(3, 5);
+	ASSERT(apint_is_zero(c));
+	apint_destroy(c);
+}
+
+void testThreadedMul(TestObjs *objs) {
+	uint64_t state = 777;
+	size_t n = 3000;
+	uint64_t *a = malloc(n * sizeof(uint64_t));
+	uint64_t *b = malloc(n * sizeof(uint64_t));
+	for (size_t i = 0; i < n; i++) {
+		a[i] = test_lcg_next(&state);
+		b[i] = test_lcg_next(&state);
+	}
+	ApInt *x = apint_wrap_limbs(a, n, 1);
+	ApInt *y = apint_wrap_limbs(b, n - 7, 0);
+	ApInt *serial_prod = apint_mul(x, y);
+	ApInt *serial_fact = apint_factorial(5000);
+	ApInt *items[] = { x, y, objs->minus_max1, x, serial_fact };
+	ApInt *serial_tree = apint_product(items, 5);
+
+	size_t grain = apint_threads_grain();
+	apint_threads_init(4);
+	apint_threads_set_grain(64); //small grain so every level forks
+	ASSERT(apint_threads_count() == 4);
+	ApInt *par_prod = apint_mul(x, y);
+	ApInt *par_fact = apint_factorial(5000);
+	ApInt *par_tree = apint_product(items, 5);
+	apint_threads_shutdown();
+	apint_threads_set_grain(grain);
+
+	ASSERT(apint_threads_count() == 1);
+	ASSERT(0 == apint_compare(serial_prod, par_prod));
+	ASSERT(0 == apint_compare(serial_fact, par_fact));
+	ASSERT(0 == apint_compare(serial_tree, par_tree));
+	apint_destroy(serial_prod);
+	apint_destroy(serial_fact);
+	apint_destroy(serial_tree);
+	apint_destroy(par_prod);
+	apint_destroy(par_fact);
+	apint_destroy(par_tree);
+	apint_destroy(x);
+	apint_destroy(y);
+}
+
+void testBatch(TestObjs *objs) {
+	ApInt *big = apint_create_from_hex("539de8758b19e823b1badcccc9d587172a8117e2466f06c15bfd8ca26033661b8377b6795060c5feefab6975ec86634e");
+	ApInt *small = apint_create_from_hex("-f2229c93c3f42f893e398c4ca6e5b120dfb7c8d386f626d9aa08010543c52");
+	ApInt *a[] = { objs->ap0, objs->max1, objs->minus1, big, small, objs->minus2 };
+	ApInt *b[] = { objs->ap0, objs->ap1, objs->ap1, small, big, objs->minus2 };
+	const char *sums[] = { "0", "10000000000000000", "0",
+		"539de8758b19e823b1badcccc9d587172a71f5b87d32c77e6369a9099b68f7c07169bafcc328569c8210c8f5dc3226fc",
+		"539de8758b19e823b1badcccc9d587172a71f5b87d32c77e6369a9099b68f7c07169bafcc328569c8210c8f5dc3226fc",
+		"-4" };
+	const char *diffs[] = { "0", "fffffffffffffffe", "-2",
+		"539de8758b19e823b1badcccc9d587172a903a0c0fab46045491703b24fdd4769585b1f5dd9935615d4609f5fcda9fa0",
+		"-539de8758b19e823b1badcccc9d587172a903a0c0fab46045491703b24fdd4769585b1f5dd9935615d4609f5fcda9fa0",
+		"0" };
+	int cmps[] = { 0, 1, -1, 1, -1, 0 };
+	ApInt *results[6];
+	char *strings[6];
+	int order[6];
+
+	apint_add_batch(results, a, b, 6);
+	apint_format_as_hex_batch(strings, results, 6);
+	for (int i = 0; i < 6; i++) {
+		ASSERT(0 == strcmp(sums[i], strings[i]));
+		apint_destroy(results[i]);
+		free(strings[i]);
+	}
+
+	apint_sub_batch(results, a, b, 6);
+	apint_format_as_hex_batch(strings, results, 6);
+	for (int i = 0; i < 6; i++) {
+		ASSERT(0 == strcmp(diffs[i], strings[i]));
+		ASSERT(!apint_is_zero(results[i]) || results[i]->flags == 1);
+		apint_destroy(results[i]);
+		free(strings[i]);
+	}
+
+	apint_compare_batch(order, a, b, 6);
+	for (int i = 0; i < 6; i++) {
+		ASSERT(order[i] == cmps[i]);
+	}
+
+	apint_negate_batch(results, a, 6);
+	for (int i = 0; i < 6; i++) {
+		ASSERT(apint_is_zero(a[i]) || apint_is_negative(results[i]) != apint_is_negative(a[i]));
+		apint_destroy(results[i]);
+	}
+
+	apint_destroy(big);
+	apint_destroy(small);
+}
+
+void testBatchThreaded(TestObjs *objs) {
+	(void) objs;
+	size_t n = 10000;
+	uint64_t state = 99;
+	ApInt **a = malloc(n * sizeof(ApInt *));
+	ApInt **b = malloc(n * sizeof(ApInt *));
+	ApInt **serial = malloc(n * sizeof(ApInt *));
+	ApInt **parallel = malloc(n * sizeof(ApInt *));
+	int *serial_cmp = malloc(n * sizeof(int));
+	int *parallel_cmp = malloc(n * sizeof(int));
+	for (size_t i = 0; i < n; i++) {
+		size_t len = 1 + i % 5;
+		uint64_t *da = malloc(len * sizeof(uint64_t));
+		uint64_t *db = malloc(len * sizeof(uint64_t));
+		for (size_t j = 0; j < len; j++) {
+			da[j] = test_lcg_next(&state);
+			db[j] = (i % 7 == 0) ? da[j] : test_lcg_next(&state);
+		}
+		a[i] = apint_wrap_limbs(da, len, i % 2);
+		b[i] = apint_wrap_limbs(db, len, (i / 2) % 2);
+	}
+
+	apint_sub_batch(serial, a, b, n);
+	apint_compare_batch(serial_cmp, a, b, n);
+	apint_threads_init(3);
+	apint_sub_batch(parallel, a, b, n);
+	apint_compare_batch(parallel_cmp, a, b, n);
+	apint_threads_shutdown();
+
+	for (size_t i = 0; i < n; i++) {
+		ASSERT(0 == apint_compare(serial[i], parallel[i]));
+		ASSERT(serial_cmp[i] == parallel_cmp[i]);
+		ASSERT(apint_is_zero(serial[i]) == (serial_cmp[i] == 0));
+		apint_destroy(a[i]);
+		apint_destroy(b[i]);
+		apint_destroy(serial[i]);
+		apint_destroy(parallel[i]);
+	}
+	free(a);
+	free(b);
+	free(serial);
+	free(parallel);
+	free(serial_cmp);
+	free(parallel_cmp);
+}
+
+/* 1 if lane i of a and b hold the same limbs */
+static int soa_lane_equal(const ApSoA *a, const ApSoA *b, size_t i) {
+	for (uint32_t j = 0; j < a->width; j++) {
+		if (a->limbs[j * a->stride + i] != b->limbs[j * b->stride + i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void testSoA(TestObjs *objs) {
+	(void) objs;
+	size_t count = 13; //not a multiple of the vector width
+	uint64_t state = 4242;
+	ApInt *a[13], *b[13], *sums[13], *diffs[13];
+	int cmp[13], expected_cmp[13];
+	ApSoA *va = apint_soa_create(4, count);
+	ApSoA *vb = apint_soa_create(4, count);
+	ApSoA *vr = apint_soa_create(4, count);
+	ApSoA *ref = apint_soa_create(4, count);
+
+	for (size_t i = 0; i < count; i++) {
+		size_t len = 1 + i % 4;
+		uint64_t *da = malloc(len * sizeof(uint64_t));
+		uint64_t *db = malloc(len * sizeof(uint64_t));
+		for (size_t j = 0; j < len; j++) {
+			da[j] = (i % 3 == 0) ? ~0UL : test_lcg_next(&state); //all ones: carry through every limb
+			db[j] = (i % 5 == 0) ? da[j] : test_lcg_next(&state);
+		}
+		da[len - 1] >>= 2; //keep sums and differences inside 256 bits
+		db[len - 1] >>= 2;
+		a[i] = apint_wrap_limbs(da, len, (i / 2) % 2);
+		b[i] = apint_wrap_limbs(db, len, (i % 5 == 0) ? (i / 2) % 2 : i % 2);
+		apint_soa_set(va, i, a[i]);
+		apint_soa_set(vb, i, b[i]);
+	}
+
+	/* values survive the round trip */
+	for (size_t i = 0; i < count; i++) {
+		ApInt *back = apint_soa_get(va, i);
+		ASSERT(0 == apint_compare(back, a[i]));
+		apint_destroy(back);
+	}
+
+	apint_add_batch(sums, a, b, count);
+	apint_sub_batch(diffs, a, b, count);
+	apint_compare_batch(expected_cmp, a, b, count);
+
+	apint_soa_add(vr, va, vb);
+	for (size_t i = 0; i < count; i++) {
+		apint_soa_set(ref, i, sums[i]);
+		ASSERT(soa_lane_equal(vr, ref, i));
+	}
+
+	apint_soa_sub(vr, va, vb);
+	for (size_t i = 0; i < count; i++) {
+		apint_soa_set(ref, i, diffs[i]);
+		ASSERT(soa_lane_equal(vr, ref, i));
+		ApInt *back = apint_soa_get(vr, i);
+		ASSERT(0 == apint_compare(back, diffs[i]));
+		apint_destroy(back);
+	}
+
+	apint_soa_compare(cmp, va, vb);
+	for (size_t i = 0; i < count; i++) {
+		ASSERT(cmp[i] == expected_cmp[i]);
+	}
+
+	/* in place: a = a + b - b */
+	apint_soa_add(va, va, vb);
+	apint_soa_sub(va, va, vb);
+	for (size_t i = 0; i < count; i++) {
+		ApInt *back = apint_soa_get(va, i);
+		ASSERT(0 == apint_compare(back, a[i]));
+		apint_destroy(back);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		apint_destroy(a[i]);
+		apint_destroy(b[i]);
+		apint_destroy(sums[i]);
+		apint_destroy(diffs[i]);
+	}
+	apint_soa_destroy(va);
+	apint_soa_destroy(vb);
+	apint_soa_destroy(vr);
+	apint_soa_destroy(ref);
+}
+
+void testSoAShift(TestObjs *objs) {
+	unsigned shifts[] = { 0, 1, 63, 64, 65, 130, 200 };
+	ApInt *values[] = { objs->ap1, objs->minus1, objs->ap110660361, objs->minus_max1, objs->max1 };
+	ApSoA *v = apint_soa_create(4, 5);
+	ApSoA *r = apint_soa_create(4, 5);
+	ApSoA *ref = apint_soa_create(4, 5);
+
+	for (size_t t = 0; t < sizeof(shifts) / sizeof(shifts[0]); t++) {
+		for (size_t i = 0; i < 5; i++) {
+			apint_soa_set(v, i, values[i]);
+			ApInt *shifted = apint_lshift_n(values[i], shifts[t]);
+			apint_soa_set(ref, i, shifted);
+			apint_destroy(shifted);
+		}
+		apint_soa_lshift(r, v, shifts[t]);
+		for (size_t i = 0; i < 5; i++) {
+			ASSERT(soa_lane_equal(r, ref, i));
+		}
+
+		/* shifting back restores every value that did not overflow */
+		apint_soa_rshift(r, r, shifts[t]);
+		for (size_t i = 0; i < 5; i++) {
+			if (shifts[t] + 64 < 256) {
+				ASSERT(soa_lane_equal(r, v, i));
+			}
+		}
+	}
+
+	/* arithmetic shift keeps the sign */
+	apint_soa_rshift(r, v, 255);
+	for (size_t i = 0; i < 5; i++) {
+		ApInt *back = apint_soa_get(r, i);
+		ASSERT(apint_is_negative(back) == apint_is_negative(values[i]));
+		ASSERT(apint_is_zero(back) == !apint_is_negative(values[i]));
+		apint_destroy(back);
+	}
+
+	apint_soa_destroy(v);
+	apint_soa_destroy(r);
+	apint_soa_destroy(ref);
+}
+
+void testLinearSum(TestObjs *objs) {
+	ApInt *sum;
+	char *s;
+
+	/* max1 + max1 << 64 - (-1) = 2^128 */
+	ApTerm terms[] = { { objs->max1, 0, 0 }, { objs->max1, 0, 64 }, { objs->minus1, 1, 0 } };
+	sum = apint_linear_sum(terms, 3);
+	ASSERT(0 == strcmp("100000000000000000000000000000000", (s = apint_format_as_hex(sum))));
+	apint_destroy(sum);
+	free(s);
+
+	/* 1 - 2 << 70 is negative */
+	ApTerm neg[] = { { objs->ap1, 0, 0 }, { objs->ap2, 1, 70 } };
+	sum = apint_linear_sum(neg, 2);
+	ASSERT(0 == strcmp("-7fffffffffffffffff", (s = apint_format_as_hex(sum))));
+	apint_destroy(sum);
+	free(s);
+
+	/* cancelling terms give a normalized zero */
+	ApTerm zero[] = { { objs->max1, 0, 5 }, { objs->minus_max1, 0, 5 } };
+	sum = apint_linear_sum(zero, 2);
+	ASSERT(apint_is_zero(sum));
+	ASSERT(sum->len == 1 && sum->flags == 1);
+	apint_destroy(sum);
+
+	/* in place, dest is a term */
+	ApInt *acc = apint_create_from_u64(5UL);
+	ApTerm acc_terms[] = { { acc, 0, 0 }, { objs->max1, 1, 1 } };
+	apint_linear_sum_into(acc, acc_terms, 2);
+	ASSERT(0 == strcmp("-1fffffffffffffff9", (s = apint_format_as_hex(acc))));
+	free(s);
+	ApTerm shifted_self[] = { { acc, 1, 3 } };
+	apint_linear_sum_into(acc, shifted_self, 1);
+	ASSERT(0 == strcmp("fffffffffffffffc8", (s = apint_format_as_hex(acc))));
+	free(s);
+	apint_destroy(acc);
+}
+
+void testCopyOnWrite(TestObjs *objs) {
+	char *s;
+
+	/* copies, negations and absolute values share limbs */
+	ApInt *copy = apint_copy(objs->max1);
+	ApInt *neg = apint_negate(objs->max1);
+	ApInt *abs = apint_abs(objs->minus_max1);
+	ASSERT(copy->data == objs->max1->data);
+	ASSERT(neg->data == objs->max1->data);
+	ASSERT(abs->data == objs->minus_max1->data);
+	ASSERT(0 == strcmp("-ffffffffffffffff", (s = apint_format_as_hex(neg))));
+	free(s);
+	ASSERT(0 == strcmp("ffffffffffffffff", (s = apint_format_as_hex(abs))));
+	free(s);
+	apint_destroy(abs);
+
+	/* writing through one sharer leaves the others alone */
+	ApTerm terms[] = { { copy, 0, 0 }, { objs->ap1, 0, 0 } };
+	apint_linear_sum_into(copy, terms, 2);
+	ASSERT(copy->data != objs->max1->data);
+	ASSERT(0 == strcmp("10000000000000000", (s = apint_format_as_hex(copy))));
+	free(s);
+	ASSERT(0 == strcmp("ffffffffffffffff", (s = apint_format_as_hex(objs->max1))));
+	free(s);
+	ASSERT(0 == strcmp("-ffffffffffffffff", (s = apint_format_as_hex(neg))));
+	free(s);
+	apint_destroy(copy);
+
+	/* the last sharer standing owns the limbs, in either order */
+	ApInt *orig = apint_create_from_hex("123456789abcdef0123456789");
+	ApInt *second = apint_copy(orig);
+	ApInt *third = apint_copy(second);
+	apint_destroy(orig);
+	ASSERT(0 == strcmp("123456789abcdef0123456789", (s = apint_format_as_hex(third))));
+	free(s);
+	apint_destroy(third);
+	apint_make_writable(second, 4); //sole owner, nothing to copy
+	ASSERT(second->len == 4);
+	ASSERT(second->refs == NULL);
+	ASSERT(0 == strcmp("123456789abcdef0123456789", (s = apint_format_as_hex(second))));
+	free(s);
+	apint_destroy(second);
+
+	/* a zero stays non-negative when negated */
+	ApInt *zero = apint_negate(objs->ap0);
+	ASSERT(zero->flags == 1);
+	apint_destroy(zero);
+	apint_destroy(neg);
+}
+
+void testSubViews(TestObjs *objs) {
+	ApInt *a, *b, *r;
+	char *s;
+
+	/* negated view of b, b itself is untouched */
+	ApView v = apint_view_negated(objs->max1);
+	ASSERT(v.flags == 0 && v.data == objs->max1->data);
+	v = apint_view_negated(objs->ap0);
+	ASSERT(v.flags == 1);
+	ApView va = apint_view(objs->ap1);
+	ApView vb = apint_view_negated(objs->max1);
+	r = apint_add_views(&va, &vb);
+	ASSERT(0 == strcmp("-fffffffffffffffe", (s = apint_format_as_hex(r))));
+	ASSERT(objs->max1->flags == 1);
+	apint_destroy(r);
+	free(s);
+
+	/* carry in on all-ones limbs */
+	a = apint_create_from_hex("ffffffffffffffffffffffffffffffff");
+	r = apint_add(a, a);
+	ASSERT(0 == strcmp("1fffffffffffffffffffffffffffffffe", (s = apint_format_as_hex(r))));
+	apint_destroy(r);
+	free(s);
+	apint_destroy(a);
+
+	/* borrow propagates and the difference is normalized */
+	a = apint_create_from_hex("100000000000000000000000000000000");
+	b = apint_create_from_hex("10000000000000001");
+	r = apint_sub(a, b);
+	ASSERT(0 == strcmp("fffffffffffffffeffffffffffffffff", (s = apint_format_as_hex(r))));
+	ASSERT(r->len == 2);
+	apint_destroy(r);
+	free(s);
+	apint_destroy(a);
+	apint_destroy(b);
+
+	a = apint_create_from_hex("100000000000000005");
+	b = apint_create_from_hex("100000000000000007");
+	r = apint_sub(a, b);
+	ASSERT(0 == strcmp("-2", (s = apint_format_as_hex(r))));
+	ASSERT(r->len == 1);
+	apint_destroy(r);
+	free(s);
+	r = apint_sub(b, b);
+	ASSERT(apint_is_zero(r) && r->flags == 1);
+	apint_destroy(r);
+	apint_destroy(a);
+	apint_destroy(b);
+}
+
+static ApInt *test_random_apint(uint64_t *state, size_t n, uint32_t flags) {
+	uint64_t *data = malloc(n * sizeof(uint64_t));
+	for (size_t i = 0; i < n; i++) {
+		data[i] = test_lcg_next(state);
+	}
+	return apint_wrap_limbs(data, n, flags);
+}
+
+void testFusedMulAdd(TestObjs *objs) {
+	size_t sizes[][3] = { {1, 1, 1}, {4, 3, 2}, {1, 5, 40}, {90, 40, 40}, {2, 33, 70}, {10, 2, 2} };
+	uint64_t state = 777;
+	for (size_t t = 0; t < sizeof(sizes) / sizeof(sizes[0]); t++) {
+		ApInt *acc = test_random_apint(&state, sizes[t][0], t % 2);
+		ApInt *a = test_random_apint(&state, sizes[t][1], (t / 2) % 2);
+		ApInt *b = test_random_apint(&state, sizes[t][2], 1);
+		ApInt *prod = apint_mul(a, b);
+		ApInt *sum = apint_add(acc, prod);
+		ApInt *diff = apint_sub(acc, prod);
+
+		ApInt *r = apint_copy(acc);
+		apint_addmul(r, a, b);
+		ASSERT(0 == apint_compare(r, sum));
+		apint_destroy(r);
+		r = apint_copy(acc);
+		apint_submul(r, b, a);
+		ASSERT(0 == apint_compare(r, diff));
+		apint_destroy(r);
+		r = apint_sub(sum, prod); //writes through the copies left acc alone
+		ASSERT(0 == apint_compare(r, acc));
+		apint_destroy(r);
+
+		ApInt *shifted = apint_lshift_n(a, 100 + t);
+		ApInt *expected = apint_sub(acc, shifted);
+		r = apint_copy(acc);
+		apint_sub_shifted(r, a, 100 + t);
+		ASSERT(0 == apint_compare(r, expected));
+		apint_add_shifted(r, a, 100 + t);
+		ASSERT(0 == apint_compare(r, acc));
+		apint_destroy(r);
+		apint_destroy(expected);
+		apint_destroy(shifted);
+
+		apint_destroy(acc);
+		apint_destroy(a);
+		apint_destroy(b);
+		apint_destroy(prod);
+		apint_destroy(sum);
+		apint_destroy(diff);
+	}
+
+	/* by u64, through zero and back */
+	ApInt *acc = apint_create_from_u64(10UL);
+	apint_submul_u64(acc, objs->ap1, 12UL);
+	char *s;
+	ASSERT(0 == strcmp("-2", (s = apint_format_as_hex(acc))));
+	free(s);
+	apint_addmul_u64(acc, objs->max1, 2UL);
+	ASSERT(0 == strcmp("1fffffffffffffffc", (s = apint_format_as_hex(acc))));
+	free(s);
+	apint_submul_u64(acc, objs->max1, 2UL);
+	apint_addmul_u64(acc, objs->ap1, 2UL);
+	ASSERT(apint_is_zero(acc) && acc->flags == 1);
+
+	/* acc is an operand */
+	apint_addmul_u64(acc, objs->max1, 1UL);
+	apint_addmul(acc, acc, acc);
+	ASSERT(0 == strcmp("ffffffffffffffff0000000000000000", (s = apint_format_as_hex(acc))));
+	free(s);
+	apint_destroy(acc);
+}
+
+void testScalarOps(TestObjs *objs) {
+	ApInt *a = apint_create_from_hex("123456789abcdef0fedcba9876543210ffffffffffffffff");
+	ApInt *neg = apint_negate(a);
+	ApInt *r;
+	char *s;
+	uint64_t urem;
+	int64_t irem;
+
+	r = apint_add_u64(a, 1UL);
+	ASSERT(0 == strcmp("123456789abcdef0fedcba98765432110000000000000000", (s = apint_format_as_hex(r))));
+	apint_destroy(r);
+	free(s);
+	r = apint_sub_i64(neg, -5L);
+	ASSERT(0 == strcmp("-123456789abcdef0fedcba9876543210fffffffffffffffa", (s = apint_format_as_hex(r))));
+	apint_destroy(r);
+	free(s);
+	r = apint_mul_u64(a, 0xfedcba9876543210UL);
+	ASSERT(0 == strcmp("121fa00ad77d7423212849961ef529cdddc927701a9e730f0123456789abcdf0", (s = apint_format_as_hex(r))));
+	apint_destroy(r);
+	free(s);
+	r = apint_mul_i64(neg, -3L);
+	ASSERT(0 == strcmp("369d0369d0369cd2fc962fc962fc9632fffffffffffffffd", (s = apint_format_as_hex(r))));
+	apint_destroy(r);
+	free(s);
+
+	/* reciprocal division, normalized and unnormalized divisors */
+	r = apint_divmod_u64(a, 12345UL, &urem);
+	ASSERT(0 == strcmp("60a45f5207db50959d98bdcbbfcd4740b87a44246a17", (s = apint_format_as_hex(r))));
+	ASSERT(urem == 4320UL);
+	apint_destroy(r);
+	free(s);
+	r = apint_divmod_i64(neg, -7L, &irem);
+	ASSERT(0 == strcmp("299c335ccf668fddb441aa810e774dddb6db6db6db6db6d", (s = apint_format_as_hex(r))));
+	ASSERT(irem == -4L);
+	apint_destroy(r);
+	free(s);
+	uint64_t state = 99;
+	for (int t = 0; t < 20; t++) {
+		ApInt *x = test_random_apint(&state, 1 + t % 7, t % 2);
+		uint64_t d = test_lcg_next(&state) >> (t * 3);
+		r = apint_divmod_u64(x, d, &urem);
+		ApInt *back = apint_mul_u64(r, d); //q * d + r == x
+		ApInt *sum = (x->flags == 1) ? apint_add_u64(back, urem) : apint_sub_u64(back, urem);
+		ASSERT(urem < d);
+		ASSERT(0 == apint_compare(sum, x));
+		apint_destroy(sum);
+		apint_destroy(back);
+		apint_destroy(r);
+		apint_destroy(x);
+	}
+
+	/* one limb values crossing zero */
+	r = apint_sub_u64(objs->ap1, 3UL);
+	ASSERT(0 == strcmp("-2", (s = apint_format_as_hex(r))));
+	free(s);
+	ApInt *z = apint_add_i64(r, 2L);
+	ASSERT(apint_is_zero(z) && z->flags == 1);
+	apint_destroy(z);
+	apint_destroy(r);
+
+	ASSERT(1 == apint_compare_u64(a, ~0UL));
+	ASSERT(-1 == apint_compare_u64(neg, 0UL));
+	ASSERT(0 == apint_compare_u64(objs->max1, ~0UL));
+	ASSERT(0 == apint_compare_i64(objs->minus1, -1L));
+	ASSERT(1 == apint_compare_i64(objs->minus1, -2L));
+	ASSERT(-1 == apint_compare_i64(neg, INT64_MIN));
+	ASSERT(1 == apint_compare_i64(objs->ap0, INT64_MIN));
+	apint_destroy(a);
+	apint_destroy(neg);
+}
+
+void testRns(TestObjs *objs) {
+	(void) objs;
+	size_t n = 3000;
+	uint64_t state = 4242;
+	ApRnsBasis *basis = apint_rns_basis_create(256);
+	ASSERT(basis->count == 5);
+	ApRns *a = apint_rns_create(basis, n);
+	ApRns *b = apint_rns_create(basis, n);
+	ApRns *r = apint_rns_create(basis, n);
+	ApInt **xa = malloc(n * sizeof(ApInt *));
+	ApInt **xb = malloc(n * sizeof(ApInt *));
+	for (size_t i = 0; i < n; i++) {
+		xa[i] = test_random_apint(&state, 1 + i % 2, i % 2);
+		xb[i] = (i % 11 == 0) ? apint_create_from_u64(0UL) : test_random_apint(&state, 1 + i % 3 / 2, (i / 2) % 2);
+		apint_rns_set(a, i, xa[i]);
+		apint_rns_set(b, i, xb[i]);
+	}
+
+	for (unsigned threads = 1; threads <= 3; threads += 2) {
+		apint_threads_init(threads);
+		apint_rns_mul(r, a, b);
+		for (size_t i = 0; i < n; i++) {
+			ApInt *expected = apint_mul(xa[i], xb[i]);
+			ApInt *actual = apint_rns_get(r, i);
+			ASSERT(0 == apint_compare(expected, actual));
+			apint_destroy(expected);
+			apint_destroy(actual);
+		}
+		apint_rns_sub(r, a, b);
+		apint_rns_add(r, r, a);
+		for (size_t i = 0; i < n; i++) {
+			ApInt *expected = apint_sub(xa[i], xb[i]);
+			ApInt *twice = apint_add(expected, xa[i]);
+			ApInt *actual = apint_rns_get(r, i);
+			ASSERT(0 == apint_compare(twice, actual));
+			apint_destroy(expected);
+			apint_destroy(twice);
+			apint_destroy(actual);
+		}
+		apint_threads_shutdown();
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		apint_destroy(xa[i]);
+		apint_destroy(xb[i]);
+	}
+	free(xa);
+	free(xb);
+	apint_rns_destroy(a);
+	apint_rns_destroy(b);
+	apint_rns_destroy(r);
+	apint_rns_basis_destroy(basis);
+}
+
+void testDivmod(TestObjs *objs) {
+	ApInt *a = apint_create_from_hex("123456789abcdef0fedcba98765432100f0f0f0f0f0f0f0f0123456789abcdef");
+	ApInt *b = apint_create_from_hex("fedcba98765432100000000000000001");
+	ApInt *q, *r, *back;
+	char *s;
+
+	q = apint_divmod(a, b, &r);
+	ASSERT(0 == strcmp("1249249249249238ec687d6343eb1a20", (s = apint_format_as_hex(q))));
+	free(s);
+	ASSERT(0 == strcmp("8fcd46d5499e9ad614bac80445c0b3cf", (s = apint_format_as_hex(r))));
+	free(s);
+	apint_destroy(q);
+	apint_destroy(r);
+
+	/* q * b + r == a with C signs, random operands */
+	uint64_t state = 31337;
+	for (int t = 0; t < 40; t++) {
+		ApInt *x = test_random_apint(&state, 1 + t % 9, t % 2);
+		ApInt *y = test_random_apint(&state, 1 + t % 4, (t / 2) % 2);
+		q = apint_divmod(x, y, &r);
+		ApInt *prod = apint_mul(q, y);
+		back = apint_add(prod, r);
+		ASSERT(0 == apint_compare(back, x));
+		ASSERT(apint_is_zero(r) || r->flags == x->flags);
+		ApInt *abs_r = apint_abs(r);
+		ApInt *abs_y = apint_abs(y);
+		ASSERT(apint_compare(abs_r, abs_y) < 0);
+		apint_destroy(abs_r);
+		apint_destroy(abs_y);
+		apint_destroy(prod);
+		apint_destroy(back);
+		apint_destroy(q);
+		apint_destroy(r);
+		apint_destroy(x);
+		apint_destroy(y);
+	}
+
+	/* smaller dividend, and shifts */
+	q = apint_divmod(b, a, &r);
+	ASSERT(apint_is_zero(q) && 0 == apint_compare(r, b));
+	apint_destroy(q);
+	apint_destroy(r);
+	q = apint_rshift_n(objs->minus_max1, 4);
+	ASSERT(0 == strcmp("-fffffffffffffff", (s = apint_format_as_hex(q))));
+	free(s);
+	apint_destroy(q);
+	q = apint_rshift_n(a, 192);
+	ASSERT(0 == strcmp("123456789abcdef0", (s = apint_format_as_hex(q))));
+	free(s);
+	apint_destroy(q);
+	apint_destroy(a);
+	apint_destroy(b);
+}
+
+void testPowm(TestObjs *objs) {
+	ApInt *m = apint_create_from_hex("7fffffffffffffffffffffffffffffff"); //2^127 - 1
+	ApInt *e = apint_create_from_hex("10000000000000000000000007");
+	ApInt *b = apint_create_from_u64(3UL);
+	ApInt *r;
+	char *s;
+
+	r = apint_powm(b, e, m);
+	ASSERT(0 == strcmp("1b05a6dc0d646d0a2c72f7da985c4e98", (s = apint_format_as_hex(r))));
+	free(s);
+	apint_destroy(r);
+	apint_destroy(m);
+	apint_destroy(e);
+	apint_destroy(b);
+
+	m = apint_create_from_u64(1000000007UL);
+	e = apint_create_from_hex("10000000000000000");
+	r = apint_powm(objs->ap2, e, m); //2^(2^64)
+	ASSERT(0 == apint_compare_u64(r, 963061529UL));
+	apint_destroy(r);
+	r = apint_powm(objs->minus1, objs->ap1, m);
+	ASSERT(0 == apint_compare_u64(r, 1000000006UL));
+	apint_destroy(r);
+	r = apint_powm(objs->max1, objs->ap0, m);
+	ASSERT(0 == apint_compare_u64(r, 1UL));
+	apint_destroy(r);
+	apint_destroy(m);
+	apint_destroy(e);
+}
+
+static uint64_t test_random_word(void *ctx) {
+	return test_lcg_next((uint64_t *)ctx);
+}
+
+void testPrimes(TestObjs *objs) {
+	/* small values come from the table */
+	uint64_t small[] = { 0, 1, 2, 3, 4, 9, 65521, 65535 };
+	int small_prime[] = { 0, 0, 1, 1, 0, 0, 1, 0 };
+	for (size_t i = 0; i < sizeof(small) / sizeof(small[0]); i++) {
+		ApInt *x = apint_create_from_u64(small[i]);
+		ASSERT(apint_is_prime_bpsw(x) == small_prime[i]);
+		ASSERT(apint_is_prime_mr(x, 4) == small_prime[i]);
+		apint_destroy(x);
+	}
+	ASSERT(0 == apint_is_prime_bpsw(objs->minus1));
+
+	/* 2^127 - 1 and 2^521 - 1 are prime, 2^128 + 1 is not */
+	const char *hex[] = {
+		"7fffffffffffffffffffffffffffffff",
+		"1ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff",
+		"100000000000000000000000000000001",
+	};
+	for (size_t i = 0; i < 3; i++) {
+		ApInt *x = apint_create_from_hex(hex[i]);
+		ASSERT(apint_is_prime_bpsw(x) == (i < 2));
+		ASSERT(apint_is_prime_mr(x, 8) == (i < 2));
+		apint_destroy(x);
+	}
+
+	/* strong pseudoprime to the bases 2 through 31, BPSW sees through it */
+	ApInt *psp = apint_create_from_u64(3825123056546413051UL);
+	ASSERT(1 == apint_is_prime_mr(psp, 11));
+	ASSERT(0 == apint_is_prime_mr(psp, 12));
+	ASSERT(0 == apint_is_prime_bpsw(psp));
+	apint_destroy(psp);
+
+	/* next prime after 2^64 is 2^64 + 13 */
+	ApInt *p = apint_next_prime(objs->max1);
+	ApInt *expected = apint_create_from_hex("1000000000000000d");
+	ASSERT(0 == apint_compare(p, expected));
+	apint_destroy(p);
+	apint_destroy(expected);
+	p = apint_next_prime(objs->ap0);
+	ASSERT(0 == apint_compare_u64(p, 2UL));
+	apint_destroy(p);
+
+	uint64_t state = 2024;
+	for (unsigned bits = 62; bits < 300; bits += 79) {
+		p = apint_random_prime(bits, test_random_word, &state);
+		ASSERT(apint_highest_bit_set(p) == (int) bits - 1);
+		ASSERT(apint_is_prime_mr(p, 16));
+		apint_destroy(p);
+	}
+
+	//different draws give different primes
+	uint64_t other = 2025;
+	state = 2024;
+	p = apint_random_prime(128, test_random_word, &state);
+	ApInt *q = apint_random_prime(128, test_random_word, &other);
+	ASSERT(0 != apint_compare(p, q));
+	apint_destroy(p);
+	apint_destroy(q);
+}
+
+void testRandom(TestObjs *objs) {
+	ApRandom rng;
+	ApInt *r;
+
+	/* xoshiro256** seeded through splitmix64 */
+	apint_random_seed(&rng, 42UL);
+	ASSERT(0x15780b2e0c2ec716UL == apint_random_next(&rng));
+	ASSERT(0x6104d9866d113a7eUL == apint_random_next(&rng));
+	ASSERT(0xae17533239e499a1UL == apint_random_next(&rng));
+
+	/* bit lengths */
+	r = apint_random_bits(0, apint_random_next, &rng);
+	ASSERT(apint_is_zero(r));
+	apint_destroy(r);
+	int top_seen = 0;
+	for (int i = 0; i < 64; i++) {
+		r = apint_random_bits(130, apint_random_next, &rng);
+		ASSERT(apint_highest_bit_set(r) < 130);
+		top_seen |= apint_highest_bit_set(r) == 129;
+		apint_destroy(r);
+	}
+	ASSERT(top_seen);
+
+	/* below a bound, including the edges of the range */
+	ApInt *bound = apint_create_from_hex("100000000000000000000000000000001"); //2^128 + 1, worst case for rejection
+	int low_seen = 0;
+	for (int i = 0; i < 200; i++) {
+		r = apint_random_below(bound, apint_random_next, &rng);
+		ASSERT(apint_compare(r, bound) < 0 && r->flags == 1);
+		low_seen |= apint_highest_bit_set(r) < 127;
+		apint_destroy(r);
+	}
+	ASSERT(low_seen);
+	apint_destroy(bound);
+	r = apint_random_below(objs->ap1, apint_random_next, &rng);
+	ASSERT(apint_is_zero(r));
+	apint_destroy(r);
+	bound = apint_negate(objs->ap110660361);
+	for (int i = 0; i < 20; i++) {
+		r = apint_random_below(bound, NULL, NULL); //default generator, the magnitude bounds the range
+		ASSERT(apint_compare_u64(r, 110660361UL) < 0);
+		apint_destroy(r);
+	}
+	apint_destroy(bound);
+
+	/* signs, same seed gives the same values */
+	int neg_seen = 0, pos_seen = 0;
+	ApRandom again;
+	apint_random_seed(&rng, 7UL);
+	apint_random_seed(&again, 7UL);
+	for (int i = 0; i < 32; i++) {
+		r = apint_random_signed(70, apint_random_next, &rng);
+		ApInt *same = apint_random_signed(70, apint_random_next, &again);
+		ASSERT(0 == apint_compare(r, same));
+		neg_seen |= r->flags == 0;
+		pos_seen |= r->flags == 1;
+		apint_destroy(r);
+		apint_destroy(same);
+	}
+	ASSERT(neg_seen && pos_seen);
+}
+
+void testHash(TestObjs *objs) {
+	/* equal values hash equally whatever their len, signs and seeds matter */
+	uint64_t padded[4] = { ~0UL, 0, 0, 0 };
+	ApInt max1_padded = { 4, 1, padded, NULL }; //leading zero limbs
+	ASSERT(apint_hash(objs->max1, 1) == apint_hash(&max1_padded, 1));
+	ASSERT(apint_equal(objs->max1, &max1_padded));
+	ASSERT(apint_hash(objs->max1, 1) != apint_hash(objs->max1, 2));
+	ASSERT(apint_hash(objs->max1, 1) != apint_hash(objs->minus_max1, 1));
+	ASSERT(!apint_equal(objs->max1, objs->minus_max1));
+	ASSERT(apint_hash(objs->ap0, 5) == apint_hash(objs->ap0, 5));
+
+	/* long values go through the striped accumulators */
+	uint64_t state = 5150;
+	for (size_t n = 10; n < 200; n += 37) {
+		ApInt *a = test_random_apint(&state, n, 1);
+		ApInt *copy = apint_copy(a);
+		ApInt *other = apint_add_u64(a, 1UL);
+		ApInt *back = apint_sub_u64(other, 1UL); //same value, own limbs
+		ASSERT(apint_equal(a, copy) && apint_equal(a, back));
+		ASSERT(!apint_equal(a, other));
+		ASSERT(apint_hash(a, 9) == apint_hash(back, 9));
+		ASSERT(apint_hash(a, 9) != apint_hash(other, 9));
+		apint_destroy(a);
+		apint_destroy(copy);
+		apint_destroy(other);
+		apint_destroy(back);
+	}
+}
+
+static void count_entries(void *arg, const ApInt *key, void *value) {
+	(void) key;
+	(void) value;
+	(*(size_t *)arg)++;
+}
+
+void testHashMap(TestObjs *objs) {
+	(void) objs;
+	size_t n = 5000;
+	uint64_t state = 8675309;
+	ApInt **keys = malloc(n * sizeof(ApInt *));
+	ApIntMap *map = apint_map_create(0, 1234UL); //grows from the minimum size
+	for (size_t i = 0; i < n; i++) {
+		keys[i] = (i % 3 == 0) ? apint_create_from_u64(i) : test_random_apint(&state, 1 + i % 5, i % 2);
+		ASSERT(1 == apint_map_insert(map, keys[i], (void *)(keys + i)));
+	}
+	ASSERT(map->size == n);
+	ASSERT(0 == apint_map_insert(map, keys[7], (void *)keys)); //replaces the value
+	ASSERT(*apint_map_find(map, keys[7]) == (void *)keys);
+
+	for (size_t i = 0; i < n; i++) {
+		ApInt *same = apint_add_u64(keys[i], 0UL);
+		if (i != 7) {
+			void **v = apint_map_find(map, same);
+			ASSERT(v != NULL && *v == (void *)(keys + i));
+		}
+		apint_destroy(same);
+	}
+	ApInt *absent = apint_create_from_hex("123456789abcdef0123456789abcdef0123");
+	ASSERT(apint_map_find(map, absent) == NULL);
+	apint_destroy(absent);
+
+	/* removing every other key keeps the rest reachable */
+	for (size_t i = 0; i < n; i += 2) {
+		void *v = NULL;
+		ASSERT(1 == apint_map_remove(map, keys[i], &v));
+		ASSERT(i == 7 || v == (void *)(keys + i));
+		ASSERT(0 == apint_map_remove(map, keys[i], NULL));
+	}
+	ASSERT(map->size == n / 2);
+	for (size_t i = 0; i < n; i++) {
+		ASSERT((apint_map_find(map, keys[i]) != NULL) == (i % 2 == 1));
+	}
+	size_t visited = 0;
+	apint_map_foreach(map, count_entries, &visited);
+	ASSERT(visited == n / 2);
+
+	for (size_t i = 0; i < n; i++) {
+		apint_destroy(keys[i]); //long keys in the map keep their shared limbs
+	}
+	apint_map_destroy(map);
+	free(keys);
+}
+
+/*
+ * Mixed signs and lengths, zeros, duplicates, and shared leading bytes
+ * and limbs, checked against qsort; padding limbs do not change the order
+ */
+void testSort(TestObjs *objs) {
+	size_t n = 200000;
+	uint64_t state = 4040;
+	ApInt **values = malloc(n * sizeof(ApInt *));
+	for (size_t i = 0; i < n; i++) {
+		uint64_t r = test_lcg_next(&state);
+		if (r % 50 == 0) {
+			values[i] = apint_create_from_u64(0UL);
+		} else if (r % 50 == 1 && i > 0) {
+			values[i] = apint_copy(values[i - 1]);
+		} else {
+			size_t len = ((r >> 8) % 4 == 0) ? 2 + (r >> 10) % 2 : 1; //one group large enough to fork
+			ApInt *v = test_random_apint(&state, len, (r >> 16) % 4 != 0);
+			v->data[v->len - 1] >>= (r >> 20) % 64; //short top limbs tie on leading bytes
+			if ((r >> 28) % 4 == 0) {
+				v->data[0] = 0;
+			}
+			len = limbs_normalized_len(v->data, v->len);
+			v->len = (len > 0) ? len : 1;
+			if (len == 0) {
+				v->flags = 1; //no negative zero
+			}
+			values[i] = v;
+		}
+	}
+	ApInt **expected = malloc(n * sizeof(ApInt *));
+	ApInt **sorted = malloc(n * sizeof(ApInt *));
+	memcpy(expected, values, n * sizeof(ApInt *));
+	qsort(expected, n, sizeof(ApInt *), apint_compare_ptrs);
+	for (unsigned threads = 1; threads <= 4; threads += 3) {
+		apint_threads_init(threads);
+		memcpy(sorted, values, n * sizeof(ApInt *));
+		apint_sort(sorted, n);
+		apint_threads_shutdown();
+		for (size_t i = 0; i < n; i++) {
+			ASSERT(0 == apint_compare(sorted[i], expected[i]));
+		}
+	}
+
+	ApInt *single[] = { objs->max1 };
+	apint_sort(single, 1);
+	ASSERT(single[0] == objs->max1);
+	uint64_t padded[3] = { 5, 0, 0 };
+	ApInt padded_five = { 3, 1, padded, NULL };
+	ApInt *four = apint_create_from_u64(4UL), *six = apint_create_from_u64(6UL);
+	ApInt *few[] = { six, &padded_five, objs->minus_max1, four };
+	apint_sort(few, 4);
+	ASSERT(few[0] == objs->minus_max1 && few[1] == four && few[2] == &padded_five && few[3] == six);
+	apint_destroy(four);
+	apint_destroy(six);
+
+	for (size_t i = 0; i < n; i++) {
+		apint_destroy(values[i]);
+	}
+	free(values);
+	free(expected);
+	free(sorted);
+}
+
+/*
+ * Every tier this CPU supports against the portable kernels, at lengths
+ * around the vector widths and unroll factors, shifts in place included
+ */
+void testCpuDispatch(TestObjs *objs) {
+	size_t sizes[] = { 1, 2, 3, 4, 5, 7, 8, 9, 16, 17, 33, 100 };
+	uint64_t state = 4141;
+	uint64_t a[100], b[100], r1[101], r2[101];
+	ApCpuTier initial = apint_cpu_tier();
+	ApCpuTier best = apint_cpu_detect();
+	ASSERT(initial <= best);
+	ASSERT(apint_cpu_set_tier(AP_CPU_AVX512) == best);
+	ASSERT(0 == strcmp("generic", apint_cpu_tier_name(AP_CPU_GENERIC)));
+
+	for (int t = AP_CPU_GENERIC; t <= (int) best; t++) {
+		ASSERT(apint_cpu_set_tier((ApCpuTier) t) == (ApCpuTier) t);
+		ASSERT(apint_cpu_tier() == (ApCpuTier) t);
+		for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+			size_t n = sizes[k];
+			for (size_t i = 0; i < n; i++) {
+				a[i] = test_lcg_next(&state);
+				b[i] = (i % 3 == 0) ? ~0UL : test_lcg_next(&state); //long carry runs
+				r1[i] = test_lcg_next(&state);
+			}
+			uint64_t m = test_lcg_next(&state);
+			unsigned s = 1 + m % 63;
+
+			ASSERT(limbs_add_n(r2, a, b, n) == limbs_add_n_generic(r1, a, b, n));
+			ASSERT(0 == memcmp(r1, r2, n * sizeof(uint64_t)));
+			ASSERT(limbs_sub_n(r2, a, b, n) == limbs_sub_n_generic(r1, a, b, n));
+			ASSERT(0 == memcmp(r1, r2, n * sizeof(uint64_t)));
+			ASSERT(limbs_mul_1(r2, a, n, m) == limbs_mul_1_generic(r1, a, n, m));
+			ASSERT(0 == memcmp(r1, r2, n * sizeof(uint64_t)));
+			memcpy(r2, r1, n * sizeof(uint64_t));
+			ASSERT(limbs_addmul_1(r2, a, n, ~0UL) == limbs_addmul_1_generic(r1, a, n, ~0UL));
+			ASSERT(0 == memcmp(r1, r2, n * sizeof(uint64_t)));
+			ASSERT(limbs_submul_1(r2, b, n, m) == limbs_submul_1_generic(r1, b, n, m));
+			ASSERT(0 == memcmp(r1, r2, n * sizeof(uint64_t)));
+
+			ASSERT(limbs_lshift(r2, a, n, s) == limbs_lshift_generic(r1, a, n, s));
+			ASSERT(0 == memcmp(r1, r2, n * sizeof(uint64_t)));
+			ASSERT(limbs_rshift(r2, a, n, s) == limbs_rshift_generic(r1, a, n, s));
+			ASSERT(0 == memcmp(r1, r2, n * sizeof(uint64_t)));
+			memcpy(r1, a, n * sizeof(uint64_t));
+			memcpy(r2, a, n * sizeof(uint64_t));
+			ASSERT(limbs_lshift(r2, r2, n, s) == limbs_lshift_generic(r1, r1, n, s));
+			ASSERT(0 == memcmp(r1, r2, n * sizeof(uint64_t)));
+			ASSERT(limbs_rshift(r2, r2, n, s) == limbs_rshift_generic(r1, r1, n, s));
+			ASSERT(0 == memcmp(r1, r2, n * sizeof(uint64_t)));
+
+			limbs_and_n(r2, a, b, n);
+			limbs_and_n_generic(r1, a, b, n);
+			ASSERT(0 == memcmp(r1, r2, n * sizeof(uint64_t)));
+			limbs_ior_n(r2, a, b, n);
+			limbs_ior_n_generic(r1, a, b, n);
+			ASSERT(0 == memcmp(r1, r2, n * sizeof(uint64_t)));
+			limbs_xor_n(r2, a, b, n);
+			limbs_xor_n_generic(r1, a, b, n);
+			ASSERT(0 == memcmp(r1, r2, n * sizeof(uint64_t)));
+
+			if (n == 4 || n == 8) { //fixed size products, also with all ones operands
+				for (int ones = 0; ones < 2; ones++) {
+					if (ones) {
+						memset(a, 0xFF, n * sizeof(uint64_t));
+						memset(b, 0xFF, n * sizeof(uint64_t));
+					}
+					limbs_mul_basecase(r2, a, n, b, n);
+					if (n == 4) {
+						limbs_mul_4x4_generic(r1, a, b);
+					} else {
+						limbs_mul_8x8_generic(r1, a, b);
+					}
+					ASSERT(0 == memcmp(r1, r2, 2 * n * sizeof(uint64_t)));
+					r1[n] = limbs_mul_1_generic(r1, a, n, b[0]);
+					for (size_t j = 1; j < n; j++) {
+						r1[n + j] = limbs_addmul_1_generic(r1 + j, a, n, b[j]);
+					}
+					ASSERT(0 == memcmp(r1, r2, 2 * n * sizeof(uint64_t)));
+				}
+			}
+		}
+		ApInt *prod = apint_mul(objs->max1, objs->max1); //whole operations run on the tier too
+		char *s_hex = apint_format_as_hex(prod);
+		ASSERT(0 == strcmp("fffffffffffffffe0000000000000001", s_hex));
+		free(s_hex);
+		apint_destroy(prod);
+	}
+	apint_cpu_set_tier(initial);
+}
+
+/*
+ * Counters move only in a -DAPINT_STATS build, the dumps work in both
+ */
+void testStats(TestObjs *objs) {
+	apint_stats_reset();
+	ApInt *sum = apint_add(objs->max1, objs->ap1);
+	char *hex = apint_format_as_hex(sum);
+	ApInt *shifted = apint_lshift_n(sum, 130);
+	ApOpStats add, fmt, shl, mul;
+	apint_stats_get(AP_OP_ADD, &add);
+	apint_stats_get(AP_OP_FORMAT_AS_HEX, &fmt);
+	apint_stats_get(AP_OP_LSHIFT_N, &shl);
+	apint_stats_get(AP_OP_MUL, &mul);
+	if (apint_stats_enabled()) {
+		ASSERT(add.calls == 1 && add.sizes[1] == 1); //one limb operands
+		ASSERT(add.allocs >= 1 && add.bytes >= sizeof(ApInt));
+		ASSERT(add.cycles > 0);
+		ASSERT(fmt.calls == 1 && fmt.allocs >= 1);
+		ASSERT(shl.calls == 1 && shl.sizes[2] == 1); //2 limbs, bucket 2-3
+	} else {
+		ASSERT(add.calls == 0 && fmt.calls == 0 && shl.calls == 0);
+	}
+	ASSERT(mul.calls == 0);
+	ASSERT(0 == strcmp("lshift_n", apint_stats_op_name(AP_OP_LSHIFT_N)));
+
+	//a random prime is one prime_gen call, not one per nested search
+	uint64_t state = 99;
+	ApInt *prime = apint_random_prime(96, test_random_word, &state);
+	ApOpStats gen;
+	apint_stats_get(AP_OP_PRIME_GEN, &gen);
+	ASSERT(gen.calls == (apint_stats_enabled() ? 1UL : 0UL));
+	apint_destroy(prime);
+
+	char buf[4096];
+	FILE *out = tmpfile();
+	apint_stats_dump_json(out);
+	rewind(out);
+	size_t got = fread(buf, 1, sizeof(buf) - 1, out);
+	buf[got] = '\0';
+	ASSERT(0 == strncmp(apint_stats_enabled() ? "{\"enabled\": true" : "{\"enabled\": false", buf, 16));
+	ASSERT(strstr(buf, "\"format_as_hex\": {\"calls\": ") != NULL);
+	rewind(out);
+	apint_stats_dump(out);
+	ASSERT(ftell(out) > 0);
+	fclose(out);
+
+	free(hex);
+	apint_destroy(sum);
+	apint_destroy(shifted);
+	apint_stats_reset();
+}
+
+#define STRESS_THREADS 8
+#define STRESS_CASES 4
+
+/*
+ * Shared read-only operands and their serially computed results
+ */
+typedef struct {
+	ApInt *a[STRESS_CASES], *b[STRESS_CASES], *m, *shared;
+	char *prod[STRESS_CASES], *quot[STRESS_CASES], *rem[STRESS_CASES];
+	char *powm, *fact, *shared_hex;
+	uint64_t hash[STRESS_CASES];
+	int prime[2];
+	int failures;
+} StressData;
+
+static int stress_check(ApInt *result, const char *expected) {
+	char *hex = apint_format_as_hex(result);
+	int bad = strcmp(hex, expected) != 0;
+	free(hex);
+	apint_destroy(result);
+	return bad;
+}
+
+/*
+ * Every thread runs the whole mix a few times, starting at a different
+ * case, and counts mismatches (ASSERT cannot be used off the main thread)
+ */
+static void *stress_worker(void *arg) {
+	StressData *d = (StressData *)arg;
+	int bad = 0;
+	uint64_t p = 0x1FFFFFFFFFFFFFFFUL; //2^61 - 1
+	for (int round = 0; round < 3 * STRESS_CASES; round++) {
+		int i = round % STRESS_CASES;
+		bad += stress_check(apint_mul(d->a[i], d->b[i]), d->prod[i]);
+		ApInt *rem;
+		bad += stress_check(apint_divmod(d->a[i], d->b[i], &rem), d->quot[i]);
+		bad += stress_check(rem, d->rem[i]);
+		bad += apint_hash(d->a[i], 42) != d->hash[i];
+		ApInt *copy = apint_copy(d->shared);
+		bad += stress_check(copy, d->shared_hex);
+		if (i == 0) {
+			bad += stress_check(apint_powm(d->a[1], d->b[0], d->m), d->powm);
+			bad += stress_check(apint_factorial(400), d->fact);
+			ApInt *prime = apint_create_from_u64(p);
+			ApInt *composite = apint_create_from_u64(p - 2);
+			bad += apint_is_prime_bpsw(prime) != d->prime[0];
+			bad += apint_is_prime_bpsw(composite) != d->prime[1];
+			apint_destroy(prime);
+			apint_destroy(composite);
+		}
+	}
+	__atomic_fetch_add(&d->failures, bad, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+static int stress_run(StressData *d) {
+	pthread_t threads[STRESS_THREADS];
+	d->failures = 0;
+	for (int t = 0; t < STRESS_THREADS; t++) {
+		pthread_create(&threads[t], NULL, stress_worker, d);
+	}
+	for (int t = 0; t < STRESS_THREADS; t++) {
+		pthread_join(threads[t], NULL);
+	}
+	return d->failures;
+}
+
+/*
+ * Mixed operations on many threads at once must give the serial results,
+ * on the callers' threads alone and with the pool forking under them.
+ * make tsan runs the suite under ThreadSanitizer
+ */
+void testThreadStress(TestObjs *objs) {
+	(void) objs;
+	size_t an[STRESS_CASES] = { 8, 30, 45, 90 };
+	size_t bn[STRESS_CASES] = { 3, 20, 33, 40 };
+	uint64_t state = 4242;
+	StressData d;
+	for (int i = 0; i < STRESS_CASES; i++) {
+		d.a[i] = test_random_apint(&state, an[i], 1);
+		d.b[i] = test_random_apint(&state, bn[i], 1);
+		ApInt *prod = apint_mul(d.a[i], d.b[i]);
+		d.prod[i] = apint_format_as_hex(prod);
+		apint_destroy(prod);
+		ApInt *rem;
+		ApInt *quot = apint_divmod(d.a[i], d.b[i], &rem);
+		d.quot[i] = apint_format_as_hex(quot);
+		d.rem[i] = apint_format_as_hex(rem);
+		apint_destroy(quot);
+		apint_destroy(rem);
+		d.hash[i] = apint_hash(d.a[i], 42);
+	}
+	d.m = test_random_apint(&state, 8, 1);
+	d.m->data[0] |= 1;
+	ApInt *r = apint_powm(d.a[1], d.b[0], d.m);
+	d.powm = apint_format_as_hex(r);
+	apint_destroy(r);
+	r = apint_factorial(400);
+	d.fact = apint_format_as_hex(r);
+	apint_destroy(r);
+	r = apint_create_from_u64(0x1FFFFFFFFFFFFFFFUL);
+	d.prime[0] = apint_is_prime_bpsw(r);
+	apint_destroy(r);
+	r = apint_create_from_u64(0x1FFFFFFFFFFFFFFDUL);
+	d.prime[1] = apint_is_prime_bpsw(r);
+	apint_destroy(r);
+	ASSERT(d.prime[0] == 1);
+	d.shared = apint_copy(d.a[3]);
+	d.shared_hex = apint_format_as_hex(d.shared);
+
+	ASSERT(0 == stress_run(&d));
+	size_t grain = apint_threads_grain();
+	apint_threads_init(4);
+	apint_threads_set_grain(8);
+	ASSERT(0 == stress_run(&d));
+	apint_threads_shutdown();
+	apint_threads_set_grain(grain);
+
+	for (int i = 0; i < STRESS_CASES; i++) {
+		apint_destroy(d.a[i]);
+		apint_destroy(d.b[i]);
+		free(d.prod[i]);
+		free(d.quot[i]);
+		free(d.rem[i]);
+	}
+	apint_destroy(d.m);
+	apint_destroy(d.shared);
+	free(d.powm);
+	free(d.fact);
+	free(d.shared_hex);
+}
+
+/*
+ * c[0] + c[1] x + ... by explicit powers of x
+ */
+static ApInt *poly_by_powers(ApInt *const *c, size_t n, const ApInt *x) {
+	ApInt *sum = apint_create_from_u64(0UL);
+	ApInt *xp = apint_create_from_u64(1UL);
+	for (size_t i = 0; i < n; i++) {
+		apint_addmul(sum, c[i], xp);
+		ApInt *next = apint_mul(xp, x);
+		apint_destroy(xp);
+		xp = next;
+	}
+	apint_destroy(xp);
+	return sum;
+}
+
+static int poly_same(const ApInt *a, const ApInt *b) {
+	return apint_compare(a, b) == 0 && a->flags == b->flags;
+}
+
+void testPolyEval(TestObjs *objs) {
+	//3 - 2x + x^2
+	ApInt *c[3] = { apint_create_from_u64(3UL), apint_create_from_hex("-2"), objs->ap1 };
+	ApInt *five = apint_create_from_u64(5UL);
+	ApInt *r = apint_poly_horner(c, 3, five);
+	char *s = apint_format_as_hex(r);
+	ASSERT(0 == strcmp("12", s));
+	free(s);
+	apint_destroy(r);
+	r = apint_poly_estrin(c, 3, objs->minus1);
+	s = apint_format_as_hex(r);
+	ASSERT(0 == strcmp("6", s));
+	free(s);
+	apint_destroy(r);
+	r = apint_poly_horner(c, 0, five);
+	ASSERT(apint_is_zero(r) && r->flags == 1);
+	apint_destroy(r);
+	r = apint_poly_estrin(c, 1, five);
+	ASSERT(0 == apint_compare(r, c[0]));
+	apint_destroy(r);
+	apint_destroy(c[0]);
+	apint_destroy(c[1]);
+	apint_destroy(five);
+
+	//degree 40 with coefficients up to 6 limbs of both signs
+	uint64_t state = 31337;
+	size_t n = 41, m = 100;
+	ApInt *coeffs[41];
+	for (size_t i = 0; i < n; i++) {
+		coeffs[i] = test_random_apint(&state, 1 + i % 6, (i % 3) != 0);
+	}
+	ApInt *points[100];
+	for (size_t i = 0; i < m; i++) {
+		if (i % 10 == 0) {
+			points[i] = apint_create_from_u64(0UL);
+		} else if (i % 10 == 1) {
+			points[i] = (i > 1) ? apint_copy(points[i - 2]) : apint_create_from_u64(7UL); //repeated points
+		} else {
+			points[i] = test_random_apint(&state, 1 + (i % 4 == 0) * 2, i % 2);
+		}
+	}
+	ApInt *expected[100], *values[100];
+	for (size_t i = 0; i < m; i++) {
+		expected[i] = poly_by_powers(coeffs, n, points[i]);
+	}
+	for (int threads = 0; threads <= 4; threads += 4) {
+		size_t grain = apint_threads_grain();
+		if (threads > 0) {
+			apint_threads_init(threads);
+			apint_threads_set_grain(8);
+		}
+		for (size_t i = 0; i < m; i += 7) {
+			ApInt *h = apint_poly_horner(coeffs, n, points[i]);
+			ApInt *e = apint_poly_estrin(coeffs, n, points[i]);
+			ASSERT(poly_same(h, expected[i]));
+			ASSERT(poly_same(e, expected[i]));
+			apint_destroy(h);
+			apint_destroy(e);
+		}
+		apint_poly_eval_multi(coeffs, n, points, m, values);
+		for (size_t i = 0; i < m; i++) {
+			ASSERT(poly_same(values[i], expected[i]));
+			apint_destroy(values[i]);
+		}
+		apint_poly_eval_tree(coeffs, n, points, m, values);
+		for (size_t i = 0; i < m; i++) {
+			ASSERT(poly_same(values[i], expected[i]));
+			apint_destroy(values[i]);
+		}
+		//fewer coefficients than points
+		apint_poly_eval_tree(coeffs, 5, points, m, values);
+		for (size_t i = 0; i < m; i++) {
+			ApInt *h = apint_poly_horner(coeffs, 5, points[i]);
+			ASSERT(poly_same(values[i], h));
+			apint_destroy(h);
+			apint_destroy(values[i]);
+		}
+		if (threads > 0) {
+			apint_threads_shutdown();
+			apint_threads_set_grain(grain);
+		}
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		apint_destroy(coeffs[i]);
+	}
+	for (size_t i = 0; i < m; i++) {
+		apint_destroy(points[i]);
+		apint_destroy(expected[i]);
+	}
+}
+
+void testGcd(TestObjs *objs) {
+	ApInt *a = apint_create_from_u64(84UL);
+	ApInt *b = apint_create_from_hex("-24");
+	ApInt *g = apint_gcd(a, b);
+	ASSERT(apint_compare_u64(g, 12UL) == 0);
+	apint_destroy(g);
+	g = apint_gcd(objs->ap0, b);
+	ASSERT(apint_compare_u64(g, 0x24UL) == 0 && g->flags == 1);
+	apint_destroy(g);
+	g = apint_gcd(objs->ap0, objs->ap0);
+	ASSERT(apint_is_zero(g));
+	apint_destroy(g);
+	apint_destroy(a);
+	apint_destroy(b);
+
+	//x * g and y * g with coprime x, y: consecutive Fibonacci numbers
+	//take the most Euclid steps
+	uint64_t state = 2718;
+	ApInt *f0 = apint_create_from_u64(0UL), *f1 = apint_create_from_u64(1UL);
+	for (int i = 0; i < 300; i++) {
+		ApInt *f2 = apint_add(f0, f1);
+		apint_destroy(f0);
+		f0 = f1;
+		f1 = f2;
+	}
+	for (size_t n = 1; n <= 9; n += 4) {
+		ApInt *common = test_random_apint(&state, n, 1);
+		ApInt *x = apint_mul(f0, common);
+		ApInt *y = apint_mul(f1, common);
+		y->flags = 0;
+		g = apint_gcd(x, y);
+		ASSERT(apint_compare(g, common) == 0);
+		apint_destroy(g);
+		ApInt *rem;
+		ApInt *quot = apint_divmod(x, common, &rem);
+		ASSERT(apint_is_zero(rem));
+		apint_destroy(quot);
+		apint_destroy(rem);
+		apint_destroy(common);
+		apint_destroy(x);
+		apint_destroy(y);
+	}
+	apint_destroy(f0);
+	apint_destroy(f1);
+}
+
+static ApRat *test_rat(int64_t num, int64_t den) {
+	ApInt *n = apint_create_from_u64((num < 0) ? -(uint64_t) num : (uint64_t) num);
+	ApInt *d = apint_create_from_u64((den < 0) ? -(uint64_t) den : (uint64_t) den);
+	n->flags = (num < 0) ? 0 : 1;
+	d->flags = (den < 0) ? 0 : 1;
+	ApRat *q = apint_rat_create(n, d);
+	apint_destroy(n);
+	apint_destroy(d);
+	return q;
+}
+
+static int rat_is(ApRat *q, const char *expected) {
+	char *s = apint_rat_format_as_hex(q);
+	int same = strcmp(s, expected) == 0;
+	free(s);
+	return same;
+}
+
+void testRational(TestObjs *objs) {
+	ASSERT(test_rat(1, 0) == NULL);
+	ApRat *half = test_rat(1, 2), *third = test_rat(-1, -3), *sixth = test_rat(2, 12);
+	ApRat *r = apint_rat_add(half, third);
+	ASSERT(rat_is(r, "5/6"));
+	apint_rat_destroy(r);
+	r = apint_rat_add(sixth, third); //2/12 + 1/3 = 1/2
+	ASSERT(rat_is(r, "1/2"));
+	ASSERT(apint_rat_compare(r, half) == 0);
+	apint_rat_destroy(r);
+	r = apint_rat_sub(third, half);
+	ASSERT(rat_is(r, "-1/6"));
+	ASSERT(apint_rat_compare(r, sixth) < 0);
+	apint_rat_destroy(r);
+
+	//cross-cancellation: 2/3 * 9/4 = 3/2, -3/-2 / 3/4 = 2
+	ApRat *a = test_rat(2, 3), *b = test_rat(9, 4);
+	apint_rat_reduce(a);
+	apint_rat_reduce(b);
+	r = apint_rat_mul(a, b);
+	ASSERT(r->reduced && rat_is(r, "3/2"));
+	apint_rat_destroy(r);
+	apint_rat_destroy(a);
+	apint_rat_destroy(b);
+	a = test_rat(-3, -2);
+	b = test_rat(3, 4);
+	r = apint_rat_div(a, b);
+	ASSERT(rat_is(r, "2"));
+	apint_rat_destroy(r);
+	apint_rat_destroy(b);
+	b = test_rat(0, 5);
+	ASSERT(apint_rat_div(a, b) == NULL);
+	r = apint_rat_mul(a, b);
+	ASSERT(apint_rat_is_zero(r) && rat_is(r, "0"));
+	apint_rat_destroy(r);
+	r = apint_rat_negate(a);
+	ASSERT(rat_is(r, "-3/2"));
+	apint_rat_destroy(r);
+	apint_rat_destroy(a);
+	apint_rat_destroy(b);
+
+	//sum of 1/(i(i+1)) for i < 200 telescopes to 199/200; the partial
+	//sums are reduced lazily, so the denominator stays bounded
+	ApRat *sum = apint_rat_from_apint(objs->ap0);
+	for (int64_t i = 1; i < 200; i++) {
+		ApRat *t = test_rat(1, i * (i + 1));
+		ApRat *next = apint_rat_add(sum, t);
+		apint_rat_destroy(t);
+		apint_rat_destroy(sum);
+		sum = next;
+		ASSERT(sum->den->len <= 16);
+	}
+	ASSERT(rat_is(sum, "c7/c8"));
+	apint_rat_destroy(sum);
+
+	//a ledger of cents: equal denominators never multiply
+	ApRat *cent = test_rat(7, 100);
+	sum = apint_rat_from_apint(objs->ap0);
+	for (int i = 0; i < 1000; i++) {
+		ApRat *next = apint_rat_add(sum, cent);
+		apint_rat_destroy(sum);
+		sum = next;
+		ASSERT(sum->den->len == 1);
+	}
+	ASSERT(rat_is(sum, "46"));
+	ApRat *whole = apint_rat_from_apint(objs->max1);
+	apint_rat_reduce(half);
+	r = apint_rat_add(whole, half); //2^64 - 1 + 1/2 stays reduced
+	ASSERT(r->reduced && rat_is(r, "1ffffffffffffffff/2"));
+	apint_rat_destroy(r);
+	apint_rat_destroy(whole);
+	apint_rat_destroy(cent);
+	apint_rat_destroy(sum);
+	apint_rat_destroy(half);
+	apint_rat_destroy(third);
+	apint_rat_destroy(sixth);
+}
+
+static int float_is(ApFloat *f, const char *expected) {
+	char *s = apint_float_format_as_hex(f);
+	int same = strcmp(s, expected) == 0;
+	free(s);
+	return same;
+}
+
+static int float_is_double(ApFloat *f, double d) {
+	char expected[64];
+	snprintf(expected, sizeof(expected), "%a", d);
+	return float_is(f, expected);
+}
+
+static double test_random_double(uint64_t *state) {
+	uint64_t w = test_lcg_next(state);
+	double d = ldexp((double) ((w >> 11) | (1UL << 52)), (int) (w % 120) - 60 - 52);
+	return (w & 1024) ? -d : d;
+}
+
+/*
+ * a op b rounded by rnd to prec bits, from a round-to-odd result at
+ * 2000 bits (the low bit set when inexact), which rounds to prec bits
+ * like the exact value would; 2000 bits keeps every operation on its
+ * exact path for the operands below
+ */
+static ApFloat *test_float_ref(int op, const ApFloat *a, const ApFloat *b, size_t prec, ApRound rnd) {
+	size_t wide = 2000;
+	ApFloat *t, *back;
+	if (op == 0) {
+		t = apint_float_mul(a, b, wide, AP_ROUND_ZERO);
+		back = apint_float_div(t, b, wide, AP_ROUND_ZERO);
+	} else if (op == 1) {
+		t = apint_float_div(a, b, wide, AP_ROUND_ZERO);
+		back = apint_float_mul(t, b, 2 * wide, AP_ROUND_ZERO);
+	} else {
+		t = apint_float_sqrt(a, wide, AP_ROUND_ZERO);
+		back = apint_float_mul(t, t, 2 * wide, AP_ROUND_ZERO);
+	}
+	if (apint_float_compare(back, a) != 0 && !(t->man->data[0] & 1)) {
+		t->man->data[0] |= 1;
+	}
+	ApFloat *r = apint_float_round(t, prec, rnd);
+	apint_float_destroy(t);
+	apint_float_destroy(back);
+	return r;
+}
+
+void testFloat(TestObjs *objs) {
+	ApFloat *f = apint_float_from_double(1.5, 53, AP_ROUND_NEAREST);
+	ASSERT(float_is(f, "0x1.8p+0"));
+	apint_float_destroy(f);
+	f = apint_float_from_apint(objs->ap0, 53, AP_ROUND_NEAREST);
+	ASSERT(apint_float_is_zero(f) && float_is(f, "0x0p+0"));
+	apint_float_destroy(f);
+	f = apint_float_from_apint(objs->max1, 53, AP_ROUND_NEAREST);
+	ASSERT(float_is(f, "0x1p+64"));
+	apint_float_destroy(f);
+	f = apint_float_from_apint(objs->max1, 53, AP_ROUND_ZERO);
+	ASSERT(float_is(f, "0x1.fffffffffffffp+63"));
+	ApInt *n = apint_float_to_apint(f, AP_ROUND_NEAREST);
+	ASSERT(apint_compare_u64(n, 0xfffffffffffff800UL) == 0);
+	apint_destroy(n);
+	apint_float_destroy(f);
+	f = apint_float_from_double(-2.5, 53, AP_ROUND_NEAREST);
+	n = apint_float_to_apint(f, AP_ROUND_NEAREST); //ties to even
+	ASSERT(apint_compare_i64(n, -2) == 0);
+	apint_destroy(n);
+	n = apint_float_to_apint(f, AP_ROUND_DOWN);
+	ASSERT(apint_compare_i64(n, -3) == 0);
+	apint_destroy(n);
+	ApFloat *zero = apint_float_from_apint(objs->ap0, 53, AP_ROUND_NEAREST);
+	ASSERT(apint_float_div(f, zero, 53, AP_ROUND_NEAREST) == NULL);
+	ASSERT(apint_float_sqrt(f, 53, AP_ROUND_NEAREST) == NULL);
+	apint_float_destroy(zero);
+	apint_float_destroy(f);
+
+	//at 53 bits every mode must match the hardware's doubles
+	static const int fe_modes[] = { FE_TONEAREST, FE_TOWARDZERO, FE_UPWARD, FE_DOWNWARD };
+	uint64_t state = 1618;
+	for (int i = 0; i < 4000; i++) {
+		ApRound rnd = (ApRound) (i % 4);
+		volatile double x = test_random_double(&state), y = test_random_double(&state);
+		ApFloat *a = apint_float_from_double(x, 53, rnd), *b = apint_float_from_double(y, 53, rnd);
+		ApFloat *r[5] = {
+			apint_float_add(a, b, 53, rnd), apint_float_sub(a, b, 53, rnd),
+			apint_float_mul(a, b, 53, rnd), apint_float_div(a, b, 53, rnd),
+			apint_float_sqrt((x < 0) ? b : a, 53, rnd)
+		};
+		fesetround(fe_modes[i % 4]);
+		volatile double d[5] = { x + y, x - y, x * y, x / y, sqrt((x < 0) ? y : x) };
+		fesetround(FE_TONEAREST);
+		for (int k = 0; k < 5; k++) {
+			ASSERT(r[k] == NULL || float_is_double(r[k], d[k]));
+			if (r[k] != NULL) {
+				apint_float_destroy(r[k]);
+			}
+		}
+		ASSERT(apint_float_compare(a, b) == (x > y) - (x < y));
+		apint_float_destroy(a);
+		apint_float_destroy(b);
+	}
+
+	//1500 bit operands rounded to fewer bits take the short paths
+	size_t precs[] = { 53, 100, 700, 1200 };
+	for (int i = 0; i < 64; i++) {
+		ApRound rnd = (ApRound) (i % 4);
+		size_t prec = precs[(i / 4) % 4];
+		ApInt *ma = test_random_apint(&state, 24, i % 3 != 0), *mb = test_random_apint(&state, 24, 1);
+		ApFloat *a = apint_float_from_apint(ma, 1500, AP_ROUND_ZERO);
+		ApFloat *b = apint_float_from_apint(mb, 1500, AP_ROUND_ZERO);
+		for (int op = 0; op < 3; op++) {
+			if (op == 2 && apint_float_compare(a, b) < 0) {
+				continue;
+			}
+			ApFloat *got = (op == 0) ? apint_float_mul(a, b, prec, rnd) :
+				(op == 1) ? apint_float_div(a, b, prec, rnd) : apint_float_sqrt(a, prec, rnd);
+			ApFloat *want = test_float_ref(op, a, b, prec, rnd);
+			ASSERT(apint_float_compare(got, want) == 0 && got->prec == prec);
+			apint_float_destroy(got);
+			apint_float_destroy(want);
+		}
+		apint_float_destroy(a);
+		apint_float_destroy(b);
+		apint_destroy(ma);
+		apint_destroy(mb);
+	}
+
+	//past MULHIGH_MAX limbs the cut operands get a full Karatsuba product
+	for (int i = 0; i < 4; i++) {
+		ApInt *ma = test_random_apint(&state, 160, 1), *mb = test_random_apint(&state, 160, i % 2);
+		ApFloat *a = apint_float_from_apint(ma, 10240, AP_ROUND_ZERO);
+		ApFloat *b = apint_float_from_apint(mb, 10240, AP_ROUND_ZERO);
+		ApFloat *exact = apint_float_mul(a, b, 20480, AP_ROUND_ZERO);
+		ApFloat *want = apint_float_round(exact, 9000, (ApRound) i);
+		ApFloat *got = apint_float_mul(a, b, 9000, (ApRound) i);
+		ASSERT(apint_float_compare(got, want) == 0);
+		apint_float_destroy(got);
+		apint_float_destroy(want);
+		apint_float_destroy(exact);
+		apint_float_destroy(a);
+		apint_float_destroy(b);
+		apint_destroy(ma);
+		apint_destroy(mb);
+	}
+
+	//exact ties, which the short paths cannot round and hand over:
+	//(1 + 2^-53) * 1 and (3 + 3 2^-53) / 3 at 53 bits, 1500 bit operands
+	ApInt *one = apint_create_from_u64(1UL);
+	ApInt *tie_man = apint_create_from_hex("20000000000001");
+	ApFloat *tie = apint_float_from_apint(tie_man, 1500, AP_ROUND_NEAREST);
+	ApFloat *tie_scaled = apint_float_mul_2exp(tie, -53);
+	ApFloat *unit = apint_float_from_apint(one, 1500, AP_ROUND_NEAREST);
+	ApFloat *three = apint_float_from_double(3.0, 1500, AP_ROUND_NEAREST);
+	ApFloat *tie3 = apint_float_mul(tie_scaled, three, 1500, AP_ROUND_NEAREST);
+	f = apint_float_mul(tie_scaled, unit, 53, AP_ROUND_NEAREST);
+	ASSERT(float_is(f, "0x1p+0"));
+	apint_float_destroy(f);
+	f = apint_float_mul(tie_scaled, unit, 53, AP_ROUND_UP);
+	ASSERT(float_is(f, "0x1.0000000000001p+0"));
+	apint_float_destroy(f);
+	f = apint_float_div(tie3, three, 53, AP_ROUND_NEAREST);
+	ASSERT(float_is(f, "0x1p+0"));
+	apint_float_destroy(f);
+	f = apint_float_div(tie3, three, 53, AP_ROUND_UP);
+	ASSERT(float_is(f, "0x1.0000000000001p+0"));
+	apint_float_destroy(f);
+	ApFloat *low = apint_float_mul_2exp(unit, -1400); //cut from the divisor
+	ApFloat *d = apint_float_add(three, low, 1500, AP_ROUND_NEAREST);
+	ApFloat *tie_d = apint_float_mul(tie_scaled, d, 3000, AP_ROUND_NEAREST);
+	f = apint_float_div(tie_d, d, 53, AP_ROUND_NEAREST);
+	ASSERT(float_is(f, "0x1p+0"));
+	apint_float_destroy(f);
+	f = apint_float_div(tie_d, d, 53, AP_ROUND_DOWN);
+	ApFloat *neg = apint_float_negate(tie_d);
+	ApFloat *g = apint_float_div(neg, d, 53, AP_ROUND_UP);
+	ApFloat *h = apint_float_negate(g);
+	ASSERT(float_is(f, "0x1p+0") && apint_float_compare(h, f) == 0);
+	apint_float_destroy(h);
+	apint_float_destroy(g);
+	apint_float_destroy(neg);
+	apint_float_destroy(f);
+	apint_float_destroy(tie_d);
+	apint_float_destroy(d);
+	apint_float_destroy(low);
+
+	//a far smaller addend only decides the direction
+	ApFloat *tiny = apint_float_mul_2exp(unit, -200);
+	f = apint_float_add(unit, tiny, 53, AP_ROUND_NEAREST);
+	ASSERT(float_is(f, "0x1p+0"));
+	apint_float_destroy(f);
+	f = apint_float_add(unit, tiny, 53, AP_ROUND_UP);
+	ASSERT(float_is(f, "0x1.0000000000001p+0"));
+	apint_float_destroy(f);
+	f = apint_float_sub(unit, tiny, 53, AP_ROUND_DOWN);
+	ASSERT(float_is(f, "0x1.fffffffffffffp-1"));
+	apint_float_destroy(f);
+	f = apint_float_sub(unit, tiny, 300, AP_ROUND_NEAREST); //exact at 300 bits
+	ApFloat *back = apint_float_add(f, tiny, 300, AP_ROUND_NEAREST);
+	ASSERT(apint_float_compare(back, unit) == 0);
+	apint_float_destroy(back);
+	apint_float_destroy(f);
+
+	//sqrt(2) to 200 bits squares back to just under 2
+	ApFloat *two = apint_float_from_double(2.0, 200, AP_ROUND_NEAREST);
+	ApFloat *root = apint_float_sqrt(two, 200, AP_ROUND_DOWN);
+	ASSERT(float_is(root, "0x1.6a09e667f3bcc908b2fb1366ea957d3e3adec17512775099dap+0"));
+	ApFloat *sq = apint_float_mul(root, root, 400, AP_ROUND_NEAREST);
+	ASSERT(apint_float_compare(sq, two) < 0);
+	apint_float_destroy(sq);
+	apint_float_destroy(root);
+	ApFloat *four = apint_float_mul_2exp(two, 1);
+	root = apint_float_sqrt(four, 7, AP_ROUND_UP);
+	ASSERT(apint_float_compare(root, two) == 0);
+	apint_float_destroy(root);
+	apint_float_destroy(four);
+	apint_float_destroy(two);
+
+	apint_float_destroy(tiny);
+	apint_float_destroy(tie3);
+	apint_float_destroy(three);
+	apint_float_destroy(unit);
+	apint_float_destroy(tie_scaled);
+	apint_float_destroy(tie);
+	apint_destroy(tie_man);
+	apint_destroy(one);
+}
+
+/*
+ * Divisors and quotients past DIV_NEWTON_THRESHOLD limbs, which divide
+ * by a reciprocal
+ */
+void testDivmodReciprocal(TestObjs *objs) {
+	static const size_t sizes[][2] = { {2500, 1250}, {2500, 1200}, {4000, 1300}, {5200, 2600} };
+	uint64_t state = 4242;
+	for (int t = 0; t < 4; t++) {
+		ApInt *x = test_random_apint(&state, sizes[t][0], t % 2);
+		ApInt *y = test_random_apint(&state, sizes[t][1], (t / 2) % 2);
+		ApInt *r;
+		ApInt *q = apint_divmod(x, y, &r);
+		ApInt *prod = apint_mul(q, y);
+		ApInt *back = apint_add(prod, r);
+		ASSERT(0 == apint_compare(back, x));
+		ASSERT(apint_is_zero(r) || r->flags == x->flags);
+		ApInt *abs_r = apint_abs(r);
+		ApInt *abs_y = apint_abs(y);
+		ASSERT(apint_compare(abs_r, abs_y) < 0);
+		apint_destroy(abs_r);
+		apint_destroy(abs_y);
+		apint_destroy(back);
+		apint_destroy(r);
+		apint_destroy(q);
+
+		//exact multiples, and one short of them (remainder |y| - 1)
+		q = apint_divmod(prod, y, &r);
+		ApInt *q_in = apint_divmod(x, y, NULL);
+		ASSERT(0 == apint_compare(q, q_in) && apint_is_zero(r));
+		apint_destroy(q);
+		apint_destroy(r);
+		ApInt *less = apint_sub_i64(prod, (prod->flags == 1) ? 1 : -1);
+		q = apint_divmod(less, y, &r);
+		ApInt *q_less = (q_in->flags == 1) ? apint_sub_i64(q_in, 1) : apint_add_i64(q_in, 1);
+		ASSERT(0 == apint_compare(q, q_less));
+		abs_r = apint_abs(r);
+		abs_y = apint_abs(y);
+		ApInt *y_less = apint_sub_i64(abs_y, 1);
+		ASSERT(0 == apint_compare(abs_r, y_less));
+		apint_destroy(y_less);
+		apint_destroy(abs_r);
+		apint_destroy(abs_y);
+		apint_destroy(q_less);
+		apint_destroy(q);
+		apint_destroy(r);
+		apint_destroy(less);
+		apint_destroy(q_in);
+		apint_destroy(prod);
+		apint_destroy(x);
+		apint_destroy(y);
+	}
+
+	//2^(64*4000) - 1 by 2^(64*1500) - 1
+	ApInt *ones = apint_lshift_n(objs->ap1, 64 * 4000);
+	ApInt *big = apint_sub(ones, objs->ap1);
+	ApInt *shift = apint_lshift_n(objs->ap1, 64 * 1500);
+	ApInt *div = apint_sub(shift, objs->ap1);
+	ApInt *r;
+	ApInt *q = apint_divmod(big, div, &r);
+	ApInt *prod = apint_mul(q, div);
+	ApInt *back = apint_add(prod, r);
+	ASSERT(0 == apint_compare(back, big));
+	ASSERT(apint_compare(r, div) < 0);
+	apint_destroy(back);
+	apint_destroy(prod);
+	apint_destroy(q);
+	apint_destroy(r);
+	apint_destroy(div);
+	apint_destroy(shift);
+	apint_destroy(big);
+	apint_destroy(ones);
+}
+
+/*
+ * 10^k as an ApInt
+ */
+static ApInt *test_pow10(size_t k) {
+	uint64_t *tens = (uint64_t *)malloc(k * sizeof(uint64_t));
+	for (size_t i = 0; i < k; i++) {
+		tens[i] = 10;
+	}
+	ApInt *p = apint_product_u64(tens, k);
+	free(tens);
+	return p;
+}
+
+void testFormatAsDecimal(TestObjs *objs) {
+	char *s;
+
+	ASSERT(0 == strcmp("0", (s = apint_format_as_decimal(objs->ap0))));
+	free(s);
+	ASSERT(0 == strcmp("-1", (s = apint_format_as_decimal(objs->minus1))));
+	free(s);
+	ASSERT(0 == strcmp("18446744073709551615", (s = apint_format_as_decimal(objs->max1))));
+	free(s);
+	ApInt *chunk = apint_create_from_u64(10000000000000000000UL);
+	ASSERT(0 == strcmp("10000000000000000000", (s = apint_format_as_decimal(chunk))));
+	free(s);
+	apint_destroy(chunk);
+
+	//long enough for the reciprocal levels
+	static const size_t lengths[] = { 1, 19, 20, 1000, 60000 };
+	for (int t = 0; t < 5; t++) {
+		size_t k = lengths[t];
+		ApInt *p = test_pow10(k);
+		s = apint_format_as_decimal(p);
+		ASSERT(strlen(s) == k + 1 && s[0] == '1' && strspn(s + 1, "0") == k);
+		free(s);
+		ApInt *nines = apint_sub_i64(p, 1);
+		ApInt *minus = apint_negate(nines);
+		s = apint_format_as_decimal(minus);
+		ASSERT(strlen(s) == k + 1 && s[0] == '-' && strspn(s + 1, "9") == k);
+		free(s);
+		if (k % 6 == 0) {
+			ApInt *sevenths = apint_divmod_u64(nines, 7, NULL); //142857 repeating
+			s = apint_format_as_decimal(sevenths);
+			ASSERT(strlen(s) == k);
+			for (size_t i = 0; i < k; i += 6) {
+				ASSERT(0 == strncmp(s + i, "142857", 6));
+			}
+			free(s);
+			apint_destroy(sevenths);
+		}
+		apint_destroy(minus);
+		apint_destroy(nines);
+		apint_destroy(p);
+	}
+
+	//floats, truncated toward zero
+	ApFloat *f = apint_float_from_double(-2.75, 53, AP_ROUND_NEAREST);
+	ASSERT(0 == strcmp("-2.750", (s = apint_float_format_as_decimal(f, 3))));
+	free(s);
+	ASSERT(0 == strcmp("-2.7", (s = apint_float_format_as_decimal(f, 1))));
+	free(s);
+	ASSERT(0 == strcmp("-2", (s = apint_float_format_as_decimal(f, 0))));
+	free(s);
+	apint_float_destroy(f);
+	f = apint_float_from_double(0.001, 53, AP_ROUND_NEAREST);
+	ASSERT(0 == strcmp("0.00100000000000000002", (s = apint_float_format_as_decimal(f, 20))));
+	free(s);
+	apint_float_destroy(f);
+	f = apint_float_from_apint(objs->ap0, 53, AP_ROUND_NEAREST);
+	ASSERT(0 == strcmp("0.00", (s = apint_float_format_as_decimal(f, 2))));
+	free(s);
+	apint_float_destroy(f);
+}
+
+/*
+ * 1 + 1/2 + 1/4 + ...
+ */
+static void halves_term(uint64_t n, ApSeriesTerm *term) {
+	if (n > 0) {
+		term->q[0] = 2;
+		term->nq = 1;
+	}
+}
+
+void testConstants(TestObjs *objs) {
+	(void) objs;
+	char *s;
+	ApFloat *f;
+
+	f = apint_series_sum(halves_term, 64, 64);
+	ASSERT(float_is(f, "0x1.fffffffffffffffep+0")); //2 - 2^-63
+	apint_float_destroy(f);
+	f = apint_series_sum(halves_term, 0, 64);
+	ASSERT(apint_float_is_zero(f));
+	apint_float_destroy(f);
+
+	f = apint_const_pi(256);
+	ASSERT(0 == strcmp("3.14159265358979323846264338327950288419716939937510582097494", (s = apint_float_format_as_decimal(f, 59))));
+	free(s);
+	apint_float_destroy(f);
+	f = apint_const_e(256);
+	ASSERT(0 == strcmp("2.71828182845904523536028747135266249775724709369995957496696", (s = apint_float_format_as_decimal(f, 59))));
+	free(s);
+	apint_float_destroy(f);
+	f = apint_const_ln2(256);
+	ASSERT(0 == strcmp("0.69314718055994530941723212145817656807550013436025525412068", (s = apint_float_format_as_decimal(f, 59))));
+	free(s);
+	apint_float_destroy(f);
+	f = apint_const_pi(53);
+	ApFloat *hw = apint_float_from_double(M_PI, 53, AP_ROUND_NEAREST);
+	ASSERT(apint_float_compare(f, hw) == 0);
+	apint_float_destroy(hw);
+	apint_float_destroy(f);
+
+	//digits 9991 to 10000, on the pool too
+	static const char *tails[] = { "5256375678", "9465536788", "1359655560" };
+	ApFloat *(*constants[])(size_t prec) = { apint_const_pi, apint_const_e, apint_const_ln2 };
+	for (unsigned threads = 1; threads <= 3; threads += 2) {
+		apint_threads_init(threads);
+		for (int c = 0; c < 3; c++) {
+			f = constants[c](33300);
+			s = apint_float_format_as_decimal(f, 10000);
+			ASSERT(strlen(s) == 10002 && 0 == strcmp(tails[c], s + 9992));
+			free(s);
+			apint_float_destroy(f);
+		}
+		apint_threads_shutdown();
+	}
+}
@@ -0,0 +1,206 @@
+/*
+ * Montgomery modular arithmetic
+ * Function implementations
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "apint.h"
+#include "apmont.h"
+#include "apstats.h"
+
+#define MONT_WINDOW 4 //exponent bits per table lookup in apint_mont_pow
+
+/*
+ * Sets up the context for the odd modulus m (n limbs, m[n - 1] != 0)
+ */
+void apint_mont_init(ApMont *mt, const uint64_t *m, size_t n) {
+	assert(n > 0 && (m[0] & 1) == 1 && m[n - 1] != 0);
+	mt->n = n;
+	mt->m = (uint64_t *)malloc(n * sizeof(uint64_t));
+	mt->one = (uint64_t *)malloc(n * sizeof(uint64_t));
+	mt->r2 = (uint64_t *)malloc(n * sizeof(uint64_t));
+	mt->t = (uint64_t *)malloc((2 * n + 1) * sizeof(uint64_t));
+	assert(mt->m != NULL && mt->one != NULL && mt->r2 != NULL && mt->t != NULL); //check memory allocation
+	memcpy(mt->m, m, n * sizeof(uint64_t));
+
+	//Newton's iteration doubles the correct low bits of m^-1 each step, m * m = 1 mod 8
+	uint64_t inv = m[0];
+	for (int i = 0; i < 5; i++) {
+		inv *= 2 - m[0] * inv;
+	}
+	mt->minv = -inv;
+
+	//R mod m and R^2 mod m by division, once per context
+	uint64_t *pow = (uint64_t *)calloc(2 * n + 1, sizeof(uint64_t));
+	uint64_t *q = (uint64_t *)malloc((n + 2) * sizeof(uint64_t));
+	assert(pow != NULL && q != NULL); //check memory allocation
+	pow[n] = 1;
+	limbs_divrem(q, mt->one, pow, n + 1, m, n);
+	pow[n] = 0;
+	pow[2 * n] = 1;
+	limbs_divrem(q, mt->r2, pow, 2 * n + 1, m, n);
+	free(pow);
+	free(q);
+
+	apint_scratch_init(&mt->scratch, limbs_mul_scratch_size(n, n));
+}
+
+void apint_mont_destroy(ApMont *mt) {
+	free(mt->m);
+	free(mt->one);
+	free(mt->r2);
+	free(mt->t);
+	apint_scratch_destroy(&mt->scratch);
+}
+
+/*
+ * rp = t R^-1 mod m for the 2n limb value in mt->t (t < m R)
+ * Each step adds the multiple of m that clears the lowest limb
+ */
+static void mont_reduce(ApMont *mt, uint64_t *rp) {
+	size_t n = mt->n;
+	uint64_t *t = mt->t;
+	t[2 * n] = 0;
+	for (size_t i = 0; i < n; i++) {
+		uint64_t c = limbs_addmul_1(t + i, mt->m, n, t[i] * mt->minv);
+		for (size_t j = i + n; c != 0; j++) { //t < 2 m R, never runs past t[2n]
+			t[j] += c;
+			c = t[j] < c;
+		}
+	}
+	if (t[2 * n] != 0 || limbs_cmp(t + n, mt->m, n) >= 0) {
+		limbs_sub_n(rp, t + n, mt->m, n);
+	} else {
+		memcpy(rp, t + n, n * sizeof(uint64_t));
+	}
+}
+
+/*
+ * rp = ap bp R^-1 mod m
+ */
+void apint_mont_mul(ApMont *mt, uint64_t *rp, const uint64_t *ap, const uint64_t *bp) {
+	limbs_mul(mt->t, ap, mt->n, bp, mt->n, &mt->scratch);
+	mont_reduce(mt, rp);
+}
+
+/*
+ * rp (n limbs) = ap R mod m for any an limb ap >= 0
+ */
+void apint_mont_to(ApMont *mt, uint64_t *rp, const uint64_t *ap, size_t an) {
+	size_t n = mt->n;
+	uint64_t *x = (uint64_t *)calloc(n, sizeof(uint64_t));
+	assert(x != NULL); //check memory allocation
+	an = limbs_normalized_len(ap, an);
+	if (an > n || (an == n && limbs_cmp(ap, mt->m, n) >= 0)) {
+		uint64_t *q = (uint64_t *)malloc((an - n + 1) * sizeof(uint64_t));
+		assert(q != NULL); //check memory allocation
+		limbs_divrem(q, x, ap, an, mt->m, n);
+		free(q);
+	} else if (an > 0) {
+		memcpy(x, ap, an * sizeof(uint64_t));
+	}
+	apint_mont_mul(mt, rp, x, mt->r2);
+	free(x);
+}
+
+/*
+ * rp = ap R^-1 mod m, back out of Montgomery form
+ */
+void apint_mont_from(ApMont *mt, uint64_t *rp, const uint64_t *ap) {
+	memcpy(mt->t, ap, mt->n * sizeof(uint64_t));
+	memset(mt->t + mt->n, 0, mt->n * sizeof(uint64_t));
+	mont_reduce(mt, rp);
+}
+
+/*
+ * rp = ap + bp mod m
+ */
+void apint_mont_add(const ApMont *mt, uint64_t *rp, const uint64_t *ap, const uint64_t *bp) {
+	uint64_t carry = limbs_add_n(rp, ap, bp, mt->n);
+	if (carry != 0 || limbs_cmp(rp, mt->m, mt->n) >= 0) {
+		limbs_sub_n(rp, rp, mt->m, mt->n);
+	}
+}
+
+/*
+ * rp = ap - bp mod m
+ */
+void apint_mont_sub(const ApMont *mt, uint64_t *rp, const uint64_t *ap, const uint64_t *bp) {
+	if (limbs_sub_n(rp, ap, bp, mt->n) != 0) {
+		limbs_add_n(rp, rp, mt->m, mt->n);
+	}
+}
+
+/*
+ * rp = bp^ep (en limb exponent) in Montgomery form
+ * Fixed window: the exponent is read MONT_WINDOW bits at a time against
+ * a table of the first 2^MONT_WINDOW powers
+ */
+void apint_mont_pow(ApMont *mt, uint64_t *rp, const uint64_t *bp, const uint64_t *ep, size_t en) {
+	size_t n = mt->n;
+	en = limbs_normalized_len(ep, en);
+	if (en == 0) {
+		memcpy(rp, mt->one, n * sizeof(uint64_t));
+		return;
+	}
+	size_t entries = (size_t) 1 << MONT_WINDOW;
+	uint64_t *table = (uint64_t *)malloc(entries * n * sizeof(uint64_t));
+	uint64_t *acc = (uint64_t *)malloc(n * sizeof(uint64_t));
+	assert(table != NULL && acc != NULL); //check memory allocation
+	memcpy(table, mt->one, n * sizeof(uint64_t));
+	for (size_t i = 1; i < entries; i++) {
+		apint_mont_mul(mt, table + i * n, table + (i - 1) * n, bp);
+	}
+
+	size_t bits = en * 64 - __builtin_clzl(ep[en - 1]);
+	size_t pos = (bits + MONT_WINDOW - 1) / MONT_WINDOW * MONT_WINDOW; //top window may be partial
+	int started = 0;
+	while (pos > 0) {
+		pos -= MONT_WINDOW;
+		uint64_t w = (ep[pos / 64] >> (pos % 64)) & (entries - 1); //windows never straddle limbs
+		if (started) {
+			for (int k = 0; k < MONT_WINDOW; k++) {
+				apint_mont_mul(mt, acc, acc, acc);
+			}
+			if (w != 0) {
+				apint_mont_mul(mt, acc, acc, table + w * n);
+			}
+		} else {
+			memcpy(acc, table + w * n, n * sizeof(uint64_t));
+			started = 1;
+		}
+	}
+	memcpy(rp, acc, n * sizeof(uint64_t));
+	free(acc);
+	free(table);
+}
+
+/*
+ * Returns b^e mod m in [0, m) for odd m > 0 and e >= 0
+ */
+ApInt *apint_powm(const ApInt *b, const ApInt *e, const ApInt *m) {
+	APINT_STATS_OP(AP_OP_POWM, m->len);
+	size_t n = limbs_normalized_len(m->data, m->len);
+	assert(m->flags == 1 && n > 0 && (m->data[0] & 1) == 1); //odd positive modulus
+	assert(e->flags == 1); //non-negative exponent
+	if (n == 1 && m->data[0] == 1) {
+		return apint_create_from_u64(0UL);
+	}
+	ApMont mt;
+	apint_mont_init(&mt, m->data, n);
+	uint64_t *x = (uint64_t *)malloc(n * sizeof(uint64_t));
+	assert(x != NULL); //check memory allocation
+	apint_mont_to(&mt, x, b->data, b->len);
+	if (b->flags == 0) { //-|b| = m - (|b| mod m), also in Montgomery form
+		uint64_t *zero = (uint64_t *)calloc(n, sizeof(uint64_t));
+		assert(zero != NULL); //check memory allocation
+		apint_mont_sub(&mt, x, zero, x);
+		free(zero);
+	}
+	apint_mont_pow(&mt, x, x, e->data, e->len);
+	apint_mont_from(&mt, x, x);
+	apint_mont_destroy(&mt);
+	return apint_wrap_limbs(x, n, 1);
+}
@@ -0,0 +1,50 @@
+/*
+ * Montgomery modular arithmetic
+ *
+ * An ApMont context fixes an odd modulus m of n limbs. Values are n limb
+ * arrays in Montgomery form (x R mod m, R = 2^(64 n)), where a product
+ * costs one multiplication plus a reduction by shifting instead of a
+ * division. A context owns its product buffer, so use one per thread.
+ */
+
+#ifndef APMONT_H
+#define APMONT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "apint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	size_t n;        //limbs of the modulus
+	uint64_t *m;     //odd modulus
+	uint64_t minv;   //-m^-1 mod 2^64
+	uint64_t *one;   //R mod m, 1 in Montgomery form
+	uint64_t *r2;    //R^2 mod m, converts into Montgomery form
+	uint64_t *t;     //2n + 1 limbs for products
+	ApScratch scratch;
+} ApMont;
+
+/* Contexts */
+void apint_mont_init(ApMont *mt, const uint64_t *m, size_t n);
+void apint_mont_destroy(ApMont *mt);
+
+/* Arithmetic on n limb Montgomery form values, rp may alias operands */
+void apint_mont_to(ApMont *mt, uint64_t *rp, const uint64_t *ap, size_t an);
+void apint_mont_from(ApMont *mt, uint64_t *rp, const uint64_t *ap);
+void apint_mont_mul(ApMont *mt, uint64_t *rp, const uint64_t *ap, const uint64_t *bp);
+void apint_mont_add(const ApMont *mt, uint64_t *rp, const uint64_t *ap, const uint64_t *bp);
+void apint_mont_sub(const ApMont *mt, uint64_t *rp, const uint64_t *ap, const uint64_t *bp);
+void apint_mont_pow(ApMont *mt, uint64_t *rp, const uint64_t *bp, const uint64_t *ep, size_t en);
+
+/* b^e mod m for odd m > 0 and e >= 0 */
+ApInt *apint_powm(const ApInt *b, const ApInt *e, const ApInt *m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APMONT_H */
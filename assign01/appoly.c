@@ -0,0 +1,444 @@
+/*
+ * Polynomial evaluation over ApInt
+ * Function implementations
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "apint.h"
+#include "appoly.h"
+#include "apthread.h"
+#include "apstats.h"
+
+#define MULTI_LEAF 8 //point groups this small are finished by Horner
+
+/*
+ * Node of the subproduct tree: m[0..hi - lo] is the monic product of
+ * (X - x[i]) for lo <= i < hi, children split the points in halves
+ */
+typedef struct PolyNode {
+	ApInt **m;
+	size_t lo, hi;
+	struct PolyNode *left, *right;
+} PolyNode;
+
+typedef struct {
+	ApInt **vals;    //values of the current level
+	ApInt **out;     //values of the next one
+	const ApInt *xp; //x^(2^level)
+	size_t count;
+} EstrinJob;
+
+typedef struct {
+	ApInt *const *c;
+	size_t n;
+	ApInt *const *x;
+	ApInt **values;
+} MultiJob;
+
+typedef struct {
+	ApInt *const *x;
+	size_t lo, hi;
+	PolyNode *node;
+} BuildTask;
+
+typedef struct {
+	const PolyNode *node;
+	ApInt *const *p;
+	size_t pn;
+	ApInt *const *x;
+	ApInt **values;
+} DescendTask;
+
+static void descend(const PolyNode *node, ApInt *const *p, size_t pn, ApInt *const *x, ApInt **values);
+
+/*
+ * Total limbs of n values, the work estimate for forking
+ */
+static size_t total_limbs(ApInt *const *v, size_t n) {
+	size_t limbs = 0;
+	for (size_t i = 0; i < n; i++) {
+		limbs += v[i]->len;
+	}
+	return limbs;
+}
+
+/*
+ * dest = src, reusing dest's limbs when it owns them
+ */
+static void assign(ApInt *dest, const ApInt *src) {
+	size_t n = limbs_normalized_len(src->data, src->len);
+	n = (n > 0) ? n : 1;
+	apint_make_writable(dest, n);
+	memcpy(dest->data, src->data, n * sizeof(uint64_t));
+	dest->len = n;
+	dest->flags = src->flags;
+}
+
+/*
+ * acc *= x for x of at most one limb (magnitude x, sign flags), in place
+ */
+static void mul_limb_in_place(ApInt *acc, uint64_t x, uint32_t flags) {
+	size_t n = limbs_normalized_len(acc->data, acc->len);
+	if (n == 0 || x == 0) {
+		apint_make_writable(acc, 1);
+		acc->data[0] = 0;
+		acc->len = 1;
+		acc->flags = 1;
+		return;
+	}
+	apint_make_writable(acc, n + 1);
+	acc->data[n] = limbs_mul_1(acc->data, acc->data, n, x);
+	acc->len = (acc->data[n] != 0) ? n + 1 : n;
+	acc->flags = (acc->flags == flags) ? 1 : 0;
+}
+
+/*
+ * Horner's rule, acc = acc * x + c[i] from the top coefficient down
+ */
+ApInt *apint_poly_horner(ApInt *const *c, size_t n, const ApInt *x) {
+	APINT_STATS_OP(AP_OP_POLY, x->len);
+	if (n == 0) {
+		return apint_create_from_u64(0UL);
+	}
+	ApInt *acc = apint_copy(c[n - 1]);
+	if (limbs_normalized_len(x->data, x->len) <= 1) { //one accumulator, scaled in place
+		for (size_t i = n - 1; i-- > 0;) {
+			mul_limb_in_place(acc, x->data[0], x->flags);
+			apint_add_shifted(acc, c[i], 0);
+		}
+		return acc;
+	}
+
+	//next = c[i] + acc * x can't overwrite acc while reading it, so two
+	//accumulators trade places and keep their limbs between steps
+	ApInt *next = apint_create_from_u64(0UL);
+	for (size_t i = n - 1; i-- > 0;) {
+		assign(next, c[i]);
+		apint_addmul(next, acc, x);
+		ApInt *t = acc;
+		acc = next;
+		next = t;
+	}
+	apint_destroy(next);
+	return acc;
+}
+
+static void estrin_pairs(void *arg, size_t lo, size_t hi) {
+	EstrinJob *job = (EstrinJob *)arg;
+	for (size_t i = lo; i < hi; i++) {
+		ApInt *v = apint_copy(job->vals[2 * i]); //shares limbs until written
+		if (2 * i + 1 < job->count) {
+			apint_addmul(v, job->vals[2 * i + 1], job->xp);
+		}
+		job->out[i] = v;
+	}
+}
+
+/*
+ * Estrin's scheme: level k combines pairs as v[2i] + v[2i + 1] * x^(2^k)
+ */
+ApInt *apint_poly_estrin(ApInt *const *c, size_t n, const ApInt *x) {
+	APINT_STATS_OP(AP_OP_POLY, x->len);
+	if (n == 0) {
+		return apint_create_from_u64(0UL);
+	}
+	EstrinJob job;
+	job.vals = (ApInt **)malloc(n * sizeof(ApInt *));
+	job.out = (ApInt **)malloc(((n + 1) / 2) * sizeof(ApInt *));
+	assert(job.vals != NULL && job.out != NULL); //check memory allocation
+	for (size_t i = 0; i < n; i++) {
+		job.vals[i] = apint_copy(c[i]);
+	}
+	ApInt *xp = apint_copy(x);
+	job.count = n;
+
+	while (job.count > 1) {
+		size_t pairs = (job.count + 1) / 2;
+		job.xp = xp;
+		if (apint_threads_active() && pairs > 1 && total_limbs(job.vals, job.count) + pairs * xp->len >= apint_threads_grain()) {
+			apint_parallel_for(pairs, 1, estrin_pairs, &job);
+		} else {
+			estrin_pairs(&job, 0, pairs);
+		}
+		for (size_t i = 0; i < job.count; i++) {
+			apint_destroy(job.vals[i]);
+		}
+		ApInt **t = job.vals;
+		job.vals = job.out;
+		job.out = t;
+		job.count = pairs;
+		if (pairs > 1) {
+			ApInt *sq = apint_mul(xp, xp);
+			apint_destroy(xp);
+			xp = sq;
+		}
+	}
+
+	ApInt *result = job.vals[0];
+	apint_destroy(xp);
+	free(job.vals);
+	free(job.out);
+	return result;
+}
+
+/*
+ * Subproduct tree
+ */
+
+/*
+ * Monic product of (X - x[i]) for lo <= i < hi, one linear factor at a
+ * time: m[j] becomes m[j - 1] - x[i] * m[j], top coefficient first
+ */
+static ApInt **linear_product(ApInt *const *x, size_t lo, size_t hi) {
+	size_t d = hi - lo;
+	ApInt **m = (ApInt **)malloc((d + 1) * sizeof(ApInt *));
+	assert(m != NULL); //check memory allocation
+	m[0] = apint_create_from_u64(1UL);
+	for (size_t k = 0; k < d; k++) {
+		m[k + 1] = m[k]; //the leading 1 moves up
+		for (size_t j = k; j > 0; j--) {
+			ApInt *t = apint_copy(m[j - 1]);
+			apint_submul(t, m[j], x[lo + k]);
+			if (j != k) {
+				apint_destroy(m[j]);
+			}
+			m[j] = t;
+		}
+		ApInt *t = apint_create_from_u64(0UL);
+		apint_submul(t, m[0], x[lo + k]);
+		if (k != 0) {
+			apint_destroy(m[0]);
+		}
+		m[0] = t;
+	}
+	return m;
+}
+
+/*
+ * Bits in the largest magnitude of n coefficients
+ */
+static size_t max_bits(ApInt *const *v, size_t n) {
+	int bits = -1;
+	for (size_t i = 0; i < n; i++) {
+		int b = apint_highest_bit_set(v[i]);
+		bits = (b > bits) ? b : bits;
+	}
+	return (size_t) (bits + 1);
+}
+
+/*
+ * Product of polynomials of degrees da and db by Kronecker substitution:
+ * both are evaluated at X = 2^(64k) with k limbs per coefficient, wide
+ * enough for any coefficient of the product and its sign, multiplied as
+ * integers, and the product's coefficients are read back as balanced
+ * k limb digits (a digit with its top bit set is negative and borrows
+ * one from the next)
+ */
+static ApInt **poly_mul(ApInt *const *a, size_t da, ApInt *const *b, size_t db) {
+	size_t terms = (da > db) ? da + 1 : db + 1;
+	size_t log_terms = 64 - __builtin_clzl(terms);
+	size_t k = (max_bits(a, da + 1) + max_bits(b, db + 1) + log_terms + 1) / 64 + 1;
+
+	ApTerm *t = (ApTerm *)malloc(terms * sizeof(ApTerm));
+	assert(t != NULL); //check memory allocation
+	for (size_t i = 0; i <= da; i++) {
+		t[i] = (ApTerm) { a[i], 0, (unsigned) (64 * k * i) };
+	}
+	ApInt *av = apint_linear_sum(t, da + 1);
+	for (size_t i = 0; i <= db; i++) {
+		t[i] = (ApTerm) { b[i], 0, (unsigned) (64 * k * i) };
+	}
+	ApInt *bv = apint_linear_sum(t, db + 1);
+	free(t);
+	ApInt *cv = apint_mul(av, bv);
+	apint_destroy(av);
+	apint_destroy(bv);
+
+	size_t n = da + db + 1;
+	ApInt **r = (ApInt **)malloc(n * sizeof(ApInt *));
+	assert(r != NULL); //check memory allocation
+	uint32_t flags = cv->flags;
+	size_t cn = limbs_normalized_len(cv->data, cv->len);
+	uint64_t carry = 0;
+	for (size_t i = 0; i < n; i++) {
+		uint64_t *digit = (uint64_t *)calloc(k, sizeof(uint64_t));
+		assert(digit != NULL); //check memory allocation
+		if (i * k < cn) {
+			memcpy(digit, cv->data + i * k, ((cn - i * k < k) ? cn - i * k : k) * sizeof(uint64_t));
+		}
+		uint32_t sign = flags;
+		if (limbs_add_1(digit, digit, k, carry) != 0) {
+			carry = 1; //the digit was 2^(64k) - 1, now 0 with a borrow
+		} else if (digit[k - 1] >> 63) {
+			for (size_t j = 0; j < k; j++) {
+				digit[j] = ~digit[j];
+			}
+			limbs_add_1(digit, digit, k, 1);
+			sign = !flags;
+			carry = 1;
+		} else {
+			carry = 0;
+		}
+		r[i] = apint_wrap_limbs(digit, k, sign);
+	}
+	apint_destroy(cv);
+	return r;
+}
+
+static void destroy_poly(ApInt **p, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		apint_destroy(p[i]);
+	}
+	free(p);
+}
+
+static PolyNode *build(ApInt *const *x, size_t lo, size_t hi);
+
+static void build_task(void *arg) {
+	BuildTask *t = (BuildTask *)arg;
+	t->node = build(t->x, t->lo, t->hi);
+}
+
+static PolyNode *build(ApInt *const *x, size_t lo, size_t hi) {
+	PolyNode *node = (PolyNode *)malloc(sizeof(PolyNode));
+	assert(node != NULL); //check memory allocation
+	node->lo = lo;
+	node->hi = hi;
+	node->left = node->right = NULL;
+	if (hi - lo <= MULTI_LEAF) {
+		node->m = linear_product(x, lo, hi);
+		return node;
+	}
+
+	size_t mid = lo + (hi - lo) / 2;
+	if (apint_threads_active() && total_limbs(x + lo, hi - lo) >= apint_threads_grain()) {
+		BuildTask task = { x, lo, mid, NULL };
+		ApTaskGroup g;
+		ApTask t;
+		apint_task_group_init(&g);
+		apint_task_spawn(&g, &t, build_task, &task);
+		node->right = build(x, mid, hi);
+		apint_task_wait(&g);
+		node->left = task.node;
+	} else {
+		node->left = build(x, lo, mid);
+		node->right = build(x, mid, hi);
+	}
+	node->m = poly_mul(node->left->m, mid - lo, node->right->m, hi - mid);
+	return node;
+}
+
+static void destroy_tree(PolyNode *node) {
+	if (node->left != NULL) {
+		destroy_tree(node->left);
+		destroy_tree(node->right);
+	}
+	destroy_poly(node->m, node->hi - node->lo + 1);
+	free(node);
+}
+
+/*
+ * p mod m for monic m of degree d, in *rn <= d coefficients
+ * Each step cancels the top coefficient q with q * X^(i - d) * m
+ */
+static ApInt **poly_rem(ApInt *const *p, size_t pn, ApInt *const *m, size_t d, size_t *rn) {
+	ApInt **r = (ApInt **)malloc(pn * sizeof(ApInt *));
+	assert(r != NULL); //check memory allocation
+	for (size_t i = 0; i < pn; i++) {
+		r[i] = apint_copy(p[i]);
+	}
+	for (size_t i = pn; i-- > d;) {
+		for (size_t j = 0; j < d; j++) {
+			apint_submul(r[i - d + j], r[i], m[j]);
+		}
+		apint_destroy(r[i]);
+	}
+	*rn = (pn < d) ? pn : d;
+	return r;
+}
+
+static void descend_task(void *arg) {
+	DescendTask *t = (DescendTask *)arg;
+	descend(t->node, t->p, t->pn, t->x, t->values);
+}
+
+/*
+ * Values at the node's points of p, reduced modulo the node's product
+ * first so its children see a polynomial of lower degree
+ */
+static void descend(const PolyNode *node, ApInt *const *p, size_t pn, ApInt *const *x, ApInt **values) {
+	size_t rn;
+	ApInt **r = poly_rem(p, pn, node->m, node->hi - node->lo, &rn);
+	if (node->left == NULL) {
+		for (size_t i = node->lo; i < node->hi; i++) {
+			values[i] = apint_poly_horner(r, rn, x[i]);
+		}
+	} else if (apint_threads_active() && total_limbs(r, rn) >= apint_threads_grain()) {
+		DescendTask task = { node->left, r, rn, x, values };
+		ApTaskGroup g;
+		ApTask t;
+		apint_task_group_init(&g);
+		apint_task_spawn(&g, &t, descend_task, &task);
+		descend(node->right, r, rn, x, values);
+		apint_task_wait(&g);
+	} else {
+		descend(node->left, r, rn, x, values);
+		descend(node->right, r, rn, x, values);
+	}
+	destroy_poly(r, rn);
+}
+
+/*
+ * values[lo..hi) when p already has fewer coefficients than there are
+ * points: nothing is gained by reducing, so the points are halved until
+ * a group is small enough that p has to be reduced modulo its product
+ */
+static void eval_range(ApInt *const *p, size_t pn, ApInt *const *x, size_t lo, size_t hi, ApInt **values) {
+	if (hi - lo < pn) {
+		PolyNode *node = build(x, lo, hi);
+		descend(node, p, pn, x, values);
+		destroy_tree(node);
+		return;
+	}
+	if (hi - lo <= MULTI_LEAF) {
+		for (size_t i = lo; i < hi; i++) {
+			values[i] = apint_poly_horner(p, pn, x[i]);
+		}
+		return;
+	}
+	size_t mid = lo + (hi - lo) / 2;
+	eval_range(p, pn, x, lo, mid, values);
+	eval_range(p, pn, x, mid, hi, values);
+}
+
+/*
+ * values[i] = p(x[i]) for i < m by the subproduct tree
+ */
+void apint_poly_eval_tree(ApInt *const *c, size_t n, ApInt *const *x, size_t m, ApInt **values) {
+	APINT_STATS_OP(AP_OP_POLY, m);
+	eval_range(c, n, x, 0, m, values);
+}
+
+static void horner_points(void *arg, size_t lo, size_t hi) {
+	MultiJob *job = (MultiJob *)arg;
+	for (size_t i = lo; i < hi; i++) {
+		job->values[i] = apint_poly_horner(job->c, job->n, job->x[i]);
+	}
+}
+
+/*
+ * values[i] = p(x[i]) for i < m, each point by Horner
+ */
+void apint_poly_eval_multi(ApInt *const *c, size_t n, ApInt *const *x, size_t m, ApInt **values) {
+	APINT_STATS_OP(AP_OP_POLY, m);
+	MultiJob job = { c, n, x, values };
+	size_t limbs = total_limbs(c, n) + 1;
+	if (apint_threads_active() && m > 1 && m * limbs >= apint_threads_grain()) {
+		size_t grain = apint_threads_grain() / limbs;
+		apint_parallel_for(m, (grain > 0) ? grain : 1, horner_points, &job);
+	} else {
+		horner_points(&job, 0, m);
+	}
+}
@@ -0,0 +1,44 @@
+/*
+ * Polynomial evaluation over ApInt
+ *
+ * A polynomial is an array c[0..n) of coefficients for
+ * c[0] + c[1] x + ... + c[n-1] x^(n-1); n == 0 is the zero polynomial.
+ *
+ * apint_poly_horner runs Horner's rule in place on one accumulator
+ * (a pair of them for multi-limb x, swapped each step), adding the
+ * product into the next coefficient with the fused multiply-add.
+ * apint_poly_estrin combines coefficient pairs with x, x^2, x^4, ...,
+ * so each level is independent products that are spread over the
+ * thread pool (see apthread.h) when it is running.
+ * apint_poly_eval_multi evaluates at m points by Horner, the points
+ * spread over the thread pool. apint_poly_eval_tree gets the same values
+ * through a subproduct tree: the polynomial is reduced modulo the
+ * product of (X - x_i) over each half of the points, down to small
+ * groups that are finished by Horner. The tree polynomials are monic,
+ * so every division is exact over the integers, and they are multiplied
+ * by Kronecker substitution on apint_mul. Over the integers, though,
+ * the remainders' coefficients grow with the points' products and the
+ * divisions are schoolbook, so the tree has measured slower than Horner
+ * at every size tried (see apintBench); eval_multi is the one to use.
+ */
+
+#ifndef APPOLY_H
+#define APPOLY_H
+
+#include <stddef.h>
+#include "apint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ApInt *apint_poly_horner(ApInt *const *c, size_t n, const ApInt *x);
+ApInt *apint_poly_estrin(ApInt *const *c, size_t n, const ApInt *x);
+void apint_poly_eval_multi(ApInt *const *c, size_t n, ApInt *const *x, size_t m, ApInt **values);
+void apint_poly_eval_tree(ApInt *const *c, size_t n, ApInt *const *x, size_t m, ApInt **values);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APPOLY_H */
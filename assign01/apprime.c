@@ -0,0 +1,507 @@
+/*
+ * Primality testing and prime generation
+ * Function implementations
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "apint.h"
+#include "apmont.h"
+#include "apprime.h"
+#include "aprandom.h"
+#include "apstats.h"
+
+#define SIEVE_LIMIT 65536 //the small prime table holds every prime below this
+#define TRIAL_PRIMES 256  //small primes tried before a probable prime test
+#define PRIME_WINDOW 4096 //odd candidates sieved at once by apint_next_prime
+
+/*
+ * Consecutive odd small primes whose product fits in a limb, so one pass
+ * over a big value gives its remainder for all of them
+ */
+typedef struct {
+	ApLimbDivisor dv; //product of the primes
+	size_t first;     //index of the first prime in small_primes
+	size_t count;
+} PrimeGroup;
+
+static uint64_t *small_primes;
+static size_t small_count;
+static PrimeGroup *groups;
+static size_t group_count;
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Sieve of Eratosthenes below SIEVE_LIMIT, then the odd primes packed
+ * into groups (the tables live until the process exits)
+ */
+static void init_tables(void) {
+	char *composite = (char *)calloc(SIEVE_LIMIT, 1);
+	small_primes = (uint64_t *)malloc(SIEVE_LIMIT / 2 * sizeof(uint64_t));
+	groups = (PrimeGroup *)malloc(SIEVE_LIMIT / 2 * sizeof(PrimeGroup));
+	assert(composite != NULL && small_primes != NULL && groups != NULL); //check memory allocation
+	for (uint64_t i = 2; i < SIEVE_LIMIT; i++) {
+		if (!composite[i]) {
+			small_primes[small_count++] = i;
+			for (uint64_t j = i * i; j < SIEVE_LIMIT; j += i) {
+				composite[j] = 1;
+			}
+		}
+	}
+	free(composite);
+
+	for (size_t i = 1; i < small_count;) { //2 is handled by parity
+		uint64_t product = 1;
+		size_t first = i;
+		while (i < small_count && product <= UINT64_MAX / small_primes[i]) {
+			product *= small_primes[i++];
+		}
+		limb_divisor_init(&groups[group_count].dv, product);
+		groups[group_count].first = first;
+		groups[group_count].count = i - first;
+		group_count++;
+	}
+}
+
+static void ensure_tables(void) {
+	pthread_once(&tables_once, init_tables);
+}
+
+/*
+ * rems[i] = np mod small_primes[i] for the odd primes with index in
+ * [1, limit), one division pass per group instead of per prime
+ */
+static void small_remainders(const uint64_t *np, size_t n, uint64_t *rems, size_t limit) {
+	for (size_t g = 0; g < group_count && groups[g].first < limit; g++) {
+		uint64_t r = limbs_divrem_1_preinv(NULL, np, n, &groups[g].dv);
+		for (size_t i = groups[g].first; i < groups[g].first + groups[g].count; i++) {
+			rems[i] = r % small_primes[i];
+		}
+	}
+}
+
+/*
+ * Returns 0: n has a small factor, 1: no factor among the first
+ * TRIAL_PRIMES primes, 2: n is itself a small prime (n >= 2, odd or 2)
+ */
+static int trial_division(const uint64_t *np, size_t n) {
+	if (n == 1 && np[0] < SIEVE_LIMIT) {
+		size_t lo = 0, hi = small_count;
+		while (lo < hi) { //binary search the table
+			size_t mid = (lo + hi) / 2;
+			if (small_primes[mid] < np[0]) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		return (lo < small_count && small_primes[lo] == np[0]) ? 2 : 0;
+	}
+	if ((np[0] & 1) == 0) {
+		return 0;
+	}
+	uint64_t rems[TRIAL_PRIMES + 64]; //groups can run past the limit
+	small_remainders(np, n, rems, TRIAL_PRIMES);
+	for (size_t i = 1; i < TRIAL_PRIMES; i++) {
+		if (rems[i] == 0) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Common screening of the public tests, returns -1 when n still needs
+ * a probable prime test (n is then odd and above SIEVE_LIMIT)
+ */
+static int screen(const ApInt *n) {
+	size_t len = limbs_normalized_len(n->data, n->len);
+	if (n->flags == 0 || len == 0 || (len == 1 && n->data[0] < 2)) {
+		return 0;
+	}
+	ensure_tables();
+	int t = trial_division(n->data, len);
+	return (t == 1) ? -1 : t / 2;
+}
+
+/*
+ * Strong probable prime test to base: with n - 1 = d 2^s, base^d = 1 or
+ * base^(d 2^r) = -1 for some r < s
+ */
+static int miller_rabin(ApMont *mt, const uint64_t *d, size_t dn, unsigned s, uint64_t base, const uint64_t *minus_one) {
+	size_t n = mt->n;
+	uint64_t *x = (uint64_t *)malloc(n * sizeof(uint64_t));
+	assert(x != NULL); //check memory allocation
+	apint_mont_to(mt, x, &base, 1);
+	apint_mont_pow(mt, x, x, d, dn);
+	int prime = limbs_cmp(x, mt->one, n) == 0 || limbs_cmp(x, minus_one, n) == 0;
+	for (unsigned r = 1; r < s && !prime; r++) {
+		apint_mont_mul(mt, x, x, x);
+		if (limbs_cmp(x, mt->one, n) == 0) {
+			break; //1 without passing through -1, composite
+		}
+		prime = limbs_cmp(x, minus_one, n) == 0;
+	}
+	free(x);
+	return prime;
+}
+
+/*
+ * Montgomery context for n plus -1 in Montgomery form and n - 1 = d 2^s,
+ * the setup every Miller-Rabin round shares
+ */
+typedef struct {
+	ApMont mt;
+	uint64_t *minus_one;
+	uint64_t *d;
+	size_t dn;
+	unsigned s;
+} MrSetup;
+
+static void mr_setup(MrSetup *su, const uint64_t *np, size_t n) {
+	apint_mont_init(&su->mt, np, n);
+	su->minus_one = (uint64_t *)calloc(n, sizeof(uint64_t));
+	su->d = (uint64_t *)malloc(n * sizeof(uint64_t));
+	assert(su->minus_one != NULL && su->d != NULL); //check memory allocation
+	apint_mont_sub(&su->mt, su->minus_one, su->minus_one, su->mt.one);
+	limbs_sub_1(su->d, np, n, 1);
+	size_t zero_limbs = 0;
+	while (su->d[zero_limbs] == 0) { //n > 2, so d != 0
+		zero_limbs++;
+	}
+	unsigned bits = __builtin_ctzl(su->d[zero_limbs]);
+	su->dn = n - zero_limbs;
+	memmove(su->d, su->d + zero_limbs, su->dn * sizeof(uint64_t));
+	if (bits != 0) {
+		limbs_rshift(su->d, su->d, su->dn, bits);
+	}
+	su->s = zero_limbs * 64 + bits;
+}
+
+static void mr_teardown(MrSetup *su) {
+	apint_mont_destroy(&su->mt);
+	free(su->minus_one);
+	free(su->d);
+}
+
+/*
+ * Jacobi symbol (a / m) for odd m
+ */
+static int jacobi_u64(uint64_t a, uint64_t m) {
+	int result = 1;
+	a %= m;
+	while (a != 0) {
+		while ((a & 1) == 0) {
+			a >>= 1;
+			if ((m & 7) == 3 || (m & 7) == 5) {
+				result = -result;
+			}
+		}
+		uint64_t t = a; //reciprocity
+		a = m;
+		m = t;
+		if ((a & 3) == 3 && (m & 3) == 3) {
+			result = -result;
+		}
+		a %= m;
+	}
+	return (m == 1) ? result : 0;
+}
+
+/*
+ * Jacobi symbol (a / n) for a small a and odd n of len limbs
+ */
+static int jacobi_small(int64_t a, const uint64_t *np, size_t len) {
+	int result = 1;
+	uint64_t n8 = np[0] & 7;
+	uint64_t ua = (a < 0) ? -(uint64_t) a : (uint64_t) a;
+	if (a < 0 && (n8 & 3) == 3) { //(-1 / n)
+		result = -result;
+	}
+	while (ua != 0 && (ua & 1) == 0) { //(2 / n)
+		ua >>= 1;
+		if (n8 == 3 || n8 == 5) {
+			result = -result;
+		}
+	}
+	if (ua == 1) {
+		return result;
+	}
+	if ((ua & 3) == 3 && (n8 & 3) == 3) { //reciprocity, then n is reduced mod a
+		result = -result;
+	}
+	return result * jacobi_u64(limbs_divrem_1(NULL, np, len, ua), ua);
+}
+
+/*
+ * Newton's iteration for floor(sqrt(n)), compared back against n
+ */
+static int is_square(const ApInt *n) {
+	int bits = apint_highest_bit_set(n) + 1;
+	ApInt *one = apint_create_from_u64(1UL);
+	ApInt *x = apint_lshift_n(one, (bits + 1) / 2); //above the root
+	apint_destroy(one);
+	while (1) {
+		ApInt *q = apint_divmod(n, x, NULL);
+		ApInt *sum = apint_add(x, q);
+		ApInt *y = apint_rshift_n(sum, 1);
+		apint_destroy(q);
+		apint_destroy(sum);
+		if (apint_compare(y, x) >= 0) {
+			apint_destroy(y);
+			break;
+		}
+		apint_destroy(x);
+		x = y;
+	}
+	ApInt *sq = apint_mul(x, x);
+	int square = apint_compare(sq, n) == 0;
+	apint_destroy(sq);
+	apint_destroy(x);
+	return square;
+}
+
+/*
+ * x / 2 mod m for odd m, x < m
+ */
+static void mont_half(const ApMont *mt, uint64_t *x) {
+	uint64_t top = 0;
+	if (x[0] & 1) {
+		top = limbs_add_n(x, x, mt->m, mt->n);
+	}
+	limbs_rshift(x, x, mt->n, 1);
+	x[mt->n - 1] |= top << 63;
+}
+
+/*
+ * Residue of a small signed value in Montgomery form
+ */
+static void mont_small(ApMont *mt, uint64_t *rp, int64_t v) {
+	uint64_t mag = (v < 0) ? -(uint64_t) v : (uint64_t) v;
+	apint_mont_to(mt, rp, &mag, 1);
+	if (v < 0) {
+		uint64_t *zero = (uint64_t *)calloc(mt->n, sizeof(uint64_t));
+		assert(zero != NULL); //check memory allocation
+		apint_mont_sub(mt, rp, zero, rp);
+		free(zero);
+	}
+}
+
+static int limbs_is_zero(const uint64_t *ap, size_t n) {
+	return limbs_normalized_len(ap, n) == 0;
+}
+
+/*
+ * Strong Lucas probable prime test with Selfridge's parameters: the first
+ * D in 5, -7, 9, -11, ... with (D / n) = -1, P = 1, Q = (1 - D) / 4
+ * With n + 1 = d 2^s, n passes if U_d = 0 or V_(d 2^r) = 0 for some r < s
+ */
+static int strong_lucas(const ApInt *nap) {
+	const uint64_t *np = nap->data;
+	size_t n = limbs_normalized_len(np, nap->len);
+	int64_t D = 5;
+	for (int tries = 0;; tries++) {
+		int j = jacobi_small(D, np, n);
+		if (j == -1) {
+			break;
+		}
+		if (j == 0) { //n > SIEVE_LIMIT > |D| shares a factor with D
+			return 0;
+		}
+		if (tries == 8 && is_square(nap)) { //squares never give -1
+			return 0;
+		}
+		D = (D > 0) ? -(D + 2) : -D + 2;
+	}
+	int64_t Q = (1 - D) / 4;
+
+	//n + 1 = d 2^s
+	uint64_t *d = (uint64_t *)malloc((n + 1) * sizeof(uint64_t));
+	assert(d != NULL); //check memory allocation
+	d[n] = limbs_add_1(d, np, n, 1);
+	size_t dn = limbs_normalized_len(d, n + 1);
+	size_t zero_limbs = 0;
+	while (d[zero_limbs] == 0) {
+		zero_limbs++;
+	}
+	unsigned bits = __builtin_ctzl(d[zero_limbs]);
+	unsigned s = zero_limbs * 64 + bits;
+	dn -= zero_limbs;
+	memmove(d, d + zero_limbs, dn * sizeof(uint64_t));
+	if (bits != 0) {
+		limbs_rshift(d, d, dn, bits);
+	}
+	dn = limbs_normalized_len(d, dn);
+
+	ApMont mt;
+	apint_mont_init(&mt, np, n);
+	uint64_t *buf = (uint64_t *)malloc(7 * n * sizeof(uint64_t));
+	assert(buf != NULL); //check memory allocation
+	uint64_t *U = buf, *V = buf + n, *Qk = buf + 2 * n, *Dm = buf + 3 * n, *Qm = buf + 4 * n;
+	uint64_t *t1 = buf + 5 * n, *t2 = buf + 6 * n;
+	mont_small(&mt, Dm, D);
+	mont_small(&mt, Qm, Q);
+	memcpy(U, mt.one, n * sizeof(uint64_t)); //k = 1: U_1 = 1, V_1 = P = 1
+	memcpy(V, mt.one, n * sizeof(uint64_t));
+	memcpy(Qk, Qm, n * sizeof(uint64_t));
+
+	size_t top = dn * 64 - __builtin_clzl(d[dn - 1]) - 1;
+	for (size_t b = top; b-- > 0;) {
+		//k -> 2k: U_2k = U_k V_k, V_2k = V_k^2 - 2 Q^k
+		apint_mont_mul(&mt, U, U, V);
+		apint_mont_mul(&mt, V, V, V);
+		apint_mont_add(&mt, t1, Qk, Qk);
+		apint_mont_sub(&mt, V, V, t1);
+		apint_mont_mul(&mt, Qk, Qk, Qk);
+		if ((d[b / 64] >> (b % 64)) & 1) {
+			//k -> k + 1: U = (P U + V) / 2, V = (D U + P V) / 2
+			apint_mont_add(&mt, t1, U, V);
+			apint_mont_mul(&mt, t2, Dm, U);
+			apint_mont_add(&mt, t2, t2, V);
+			mont_half(&mt, t1);
+			mont_half(&mt, t2);
+			memcpy(U, t1, n * sizeof(uint64_t));
+			memcpy(V, t2, n * sizeof(uint64_t));
+			apint_mont_mul(&mt, Qk, Qk, Qm);
+		}
+	}
+
+	int prime = limbs_is_zero(U, n) || limbs_is_zero(V, n);
+	for (unsigned r = 1; r < s && !prime; r++) {
+		apint_mont_mul(&mt, V, V, V);
+		apint_mont_add(&mt, t1, Qk, Qk);
+		apint_mont_sub(&mt, V, V, t1);
+		apint_mont_mul(&mt, Qk, Qk, Qk);
+		prime = limbs_is_zero(V, n);
+	}
+	free(buf);
+	free(d);
+	apint_mont_destroy(&mt);
+	return prime;
+}
+
+/*
+ * Baillie-PSW on an odd n > SIEVE_LIMIT: Miller-Rabin to base 2, then
+ * a strong Lucas test (no composite is known to pass both)
+ */
+static int bpsw(const ApInt *n) {
+	MrSetup su;
+	size_t len = limbs_normalized_len(n->data, n->len);
+	mr_setup(&su, n->data, len);
+	int prime = miller_rabin(&su.mt, su.d, su.dn, su.s, 2, su.minus_one);
+	mr_teardown(&su);
+	return prime && strong_lucas(n);
+}
+
+/*
+ * Miller-Rabin to the bases 2, 3, 5, ... (the first rounds primes)
+ */
+int apint_is_prime_mr(const ApInt *n, unsigned rounds) {
+	APINT_STATS_OP(AP_OP_PRIME_TEST, n->len);
+	int t = screen(n);
+	if (t >= 0) {
+		return t;
+	}
+	if (rounds > small_count) {
+		rounds = small_count;
+	}
+	MrSetup su;
+	mr_setup(&su, n->data, limbs_normalized_len(n->data, n->len));
+	int prime = 1;
+	for (unsigned i = 0; i < rounds && prime; i++) {
+		prime = miller_rabin(&su.mt, su.d, su.dn, su.s, small_primes[i], su.minus_one);
+	}
+	mr_teardown(&su);
+	return prime;
+}
+
+int apint_is_prime_bpsw(const ApInt *n) {
+	APINT_STATS_OP(AP_OP_PRIME_TEST, n->len);
+	int t = screen(n);
+	if (t >= 0) {
+		return t;
+	}
+	return bpsw(n);
+}
+
+/*
+ * Smallest prime above n
+ * Candidates are sieved PRIME_WINDOW odd numbers at a time with every
+ * small prime (remainders of the window start in batches), so only
+ * survivors get a full BPSW test
+ */
+static ApInt *next_prime(const ApInt *n) {
+	ensure_tables();
+	size_t len = limbs_normalized_len(n->data, n->len);
+	if (n->flags == 0 || len == 0 || (len == 1 && n->data[0] < small_primes[small_count - 1])) {
+		uint64_t v = (n->flags == 0 || len == 0) ? 0 : n->data[0];
+		size_t i = 0;
+		while (small_primes[i] <= v) {
+			i++;
+		}
+		return apint_create_from_u64(small_primes[i]);
+	}
+
+	ApInt *start = apint_add_u64(n, (n->data[0] & 1) ? 2UL : 1UL); //odd, above n
+	uint64_t *rems = (uint64_t *)malloc(small_count * sizeof(uint64_t));
+	char *sieve = (char *)malloc(PRIME_WINDOW);
+	assert(rems != NULL && sieve != NULL); //check memory allocation
+	while (1) {
+		memset(sieve, 0, PRIME_WINDOW);
+		small_remainders(start->data, start->len, rems, small_count);
+		for (size_t i = 1; i < small_count; i++) {
+			//start + 2 k = 0 mod p  <=>  k = -r / 2 mod p
+			uint64_t p = small_primes[i];
+			uint64_t k = (p - rems[i]) % p * ((p + 1) / 2) % p;
+			for (; k < PRIME_WINDOW; k += p) {
+				sieve[k] = 1;
+			}
+		}
+		for (size_t k = 0; k < PRIME_WINDOW; k++) {
+			if (sieve[k]) {
+				continue;
+			}
+			ApInt *candidate = apint_add_u64(start, 2 * k);
+			if (bpsw(candidate)) {
+				apint_destroy(start);
+				free(rems);
+				free(sieve);
+				return candidate;
+			}
+			apint_destroy(candidate);
+		}
+		ApInt *next = apint_add_u64(start, 2 * PRIME_WINDOW);
+		apint_destroy(start);
+		start = next;
+	}
+}
+
+ApInt *apint_next_prime(const ApInt *n) {
+	APINT_STATS_OP(AP_OP_PRIME_GEN, n->len);
+	return next_prime(n);
+}
+
+/*
+ * Uniformly random bits bit value (top bit set) moved up to the next
+ * prime, retried if that prime no longer has bits bits
+ * rand may be NULL for the default generator (see aprandom.h)
+ */
+ApInt *apint_random_prime(unsigned bits, ApRandomFn rand, void *ctx) {
+	APINT_STATS_OP(AP_OP_PRIME_GEN, bits / 64 + 1);
+	assert(bits >= 2);
+	while (1) {
+		ApInt *x = apint_random_bits(bits - 1, rand, ctx);
+		ApInt *top = apint_create_from_u64(1UL);
+		ApTerm terms[] = { { x, 0, 0 }, { top, 0, bits - 1 }, { top, 1, 0 } };
+		apint_linear_sum_into(x, terms, 3); //x + 2^(bits - 1) - 1, the next prime is at least 2^(bits - 1)
+		ApInt *p = next_prime(x); //one prime_gen call per random prime
+		apint_destroy(x);
+		apint_destroy(top);
+		if (apint_highest_bit_set(p) == (int) bits - 1) {
+			return p;
+		}
+		apint_destroy(p);
+	}
+}
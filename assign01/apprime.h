@@ -0,0 +1,33 @@
+/*
+ * Primality testing and prime generation
+ *
+ * Tests run trial division by a table of small primes first (remainders
+ * for several primes at once, see small_remainders in apprime.c) and
+ * then Montgomery arithmetic modulo the candidate (see apmont.h).
+ * The tests answer 1 for (probable) primes and 0 for composites; 0, 1
+ * and negative values are not prime. The small prime tables are built
+ * once, on first use, and are safe to share between threads.
+ */
+
+#ifndef APPRIME_H
+#define APPRIME_H
+
+#include "apint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Probable prime tests */
+int apint_is_prime_mr(const ApInt *n, unsigned rounds);
+int apint_is_prime_bpsw(const ApInt *n);
+
+/* Generation */
+ApInt *apint_next_prime(const ApInt *n);
+ApInt *apint_random_prime(unsigned bits, ApRandomFn rand, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APPRIME_H */
@@ -0,0 +1,159 @@
+/*
+ * Random ApInt generation
+ * Function implementations
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <sys/random.h>
+#include "apint.h"
+#include "aprandom.h"
+#include "apstats.h"
+
+/*
+ * splitmix64 step, spreads a seed over the xoshiro state
+ */
+static uint64_t splitmix64(uint64_t *x) {
+	uint64_t z = (*x += 0x9e3779b97f4a7c15UL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+	return z ^ (z >> 31);
+}
+
+/*
+ * Deterministic state from a single seed (same seed, same sequence)
+ */
+void apint_random_seed(ApRandom *rng, uint64_t seed) {
+	for (int i = 0; i < 4; i++) {
+		rng->s[i] = splitmix64(&seed);
+	}
+}
+
+/*
+ * State from four words of a user entropy source, mixed through splitmix64
+ * so a weak source still gives a usable (nonzero) state
+ */
+void apint_random_seed_from(ApRandom *rng, ApRandomFn entropy, void *ctx) {
+	for (int i = 0; i < 4; i++) {
+		uint64_t x = entropy(ctx);
+		rng->s[i] = splitmix64(&x);
+	}
+}
+
+static uint64_t rotl(uint64_t x, int k) {
+	return (x << k) | (x >> (64 - k));
+}
+
+/*
+ * Next xoshiro256** output; takes the ApRandom as void * so it can be
+ * passed as an ApRandomFn
+ */
+uint64_t apint_random_next(void *rng) {
+	uint64_t *s = ((ApRandom *)rng)->s;
+	uint64_t result = rotl(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+	return result;
+}
+
+static _Thread_local ApRandom thread_rng;
+static _Thread_local int thread_rng_seeded;
+
+/*
+ * Per-thread generator used when no source is given
+ */
+static uint64_t default_random(void *ctx) {
+	(void) ctx;
+	if (!thread_rng_seeded) {
+		if (getrandom(thread_rng.s, sizeof(thread_rng.s), 0) != (ssize_t) sizeof(thread_rng.s)) {
+			apint_random_seed(&thread_rng, (uint64_t) time(NULL) ^ (uint64_t) (uintptr_t) &thread_rng);
+		}
+		thread_rng_seeded = 1;
+	}
+	return apint_random_next(&thread_rng);
+}
+
+/*
+ * Fills n limbs with random words, the top limb keeps its low top_bits
+ * bits only (0 < top_bits <= 64)
+ */
+static void fill_limbs(uint64_t *data, size_t n, unsigned top_bits, ApRandomFn rand, void *ctx) {
+	for (size_t i = 0; i < n; i++) {
+		data[i] = rand(ctx);
+	}
+	if (top_bits < 64) {
+		data[n - 1] &= (1UL << top_bits) - 1;
+	}
+}
+
+/*
+ * Uniform in [0, 2^bits)
+ */
+ApInt *apint_random_bits(unsigned bits, ApRandomFn rand, void *ctx) {
+	APINT_STATS_OP(AP_OP_RANDOM, bits / 64 + 1);
+	if (rand == NULL) {
+		rand = default_random;
+	}
+	size_t n = (bits + 63) / 64;
+	uint64_t *data = (uint64_t *)malloc((n > 0 ? n : 1) * sizeof(uint64_t));
+	assert(data != NULL); //check memory allocation
+	if (n == 0) {
+		data[0] = 0;
+		return apint_wrap_limbs(data, 1, 1);
+	}
+	fill_limbs(data, n, bits - 64 * (n - 1), rand, ctx);
+	return apint_wrap_limbs(data, n, 1);
+}
+
+/*
+ * Uniform in [0, |bound|) for bound != 0
+ * Draws as many bits as |bound| - 1 has and rejects draws past it, so on
+ * average fewer than two draws and no division
+ */
+ApInt *apint_random_below(const ApInt *bound, ApRandomFn rand, void *ctx) {
+	APINT_STATS_OP(AP_OP_RANDOM, bound->len);
+	if (rand == NULL) {
+		rand = default_random;
+	}
+	size_t bn = limbs_normalized_len(bound->data, bound->len);
+	assert(bn != 0); //empty range
+	uint64_t *max = (uint64_t *)malloc(bn * sizeof(uint64_t)); //largest allowed value
+	uint64_t *data = (uint64_t *)malloc(bn * sizeof(uint64_t));
+	assert(max != NULL && data != NULL); //check memory allocation
+	limbs_sub_1(max, bound->data, bn, 1);
+	size_t n = limbs_normalized_len(max, bn);
+	if (n == 0) { //bound is 1
+		free(max);
+		data[0] = 0;
+		return apint_wrap_limbs(data, 1, 1);
+	}
+	unsigned top_bits = 64 - __builtin_clzl(max[n - 1]);
+	do {
+		fill_limbs(data, n, top_bits, rand, ctx);
+	} while (limbs_cmp(data, max, n) > 0);
+	free(max);
+	return apint_wrap_limbs(data, n, 1);
+}
+
+/*
+ * Magnitude uniform in [0, 2^bits) with a random sign (0 stays non-negative)
+ */
+ApInt *apint_random_signed(unsigned bits, ApRandomFn rand, void *ctx) {
+	APINT_STATS_OP(AP_OP_RANDOM, bits / 64 + 1);
+	if (rand == NULL) {
+		rand = default_random;
+	}
+	uint32_t flags = rand(ctx) >> 63;
+	ApInt *ap = apint_random_bits(bits, rand, ctx);
+	if (!apint_is_zero(ap)) {
+		ap->flags = flags;
+	}
+	return ap;
+}
@@ -0,0 +1,41 @@
+/*
+ * Random ApInt generation
+ *
+ * Generators fill limb arrays straight from a source of random words:
+ * an ApRandomFn callback with its context (for example apint_random_next
+ * with an ApRandom), or NULL for a per-thread xoshiro256** generator
+ * seeded from the operating system on first use.
+ */
+
+#ifndef APRANDOM_H
+#define APRANDOM_H
+
+#include <stdint.h>
+#include "apint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * xoshiro256** state, never all zero once seeded
+ */
+typedef struct {
+	uint64_t s[4];
+} ApRandom;
+
+/* Generator state */
+void apint_random_seed(ApRandom *rng, uint64_t seed);
+void apint_random_seed_from(ApRandom *rng, ApRandomFn entropy, void *ctx);
+uint64_t apint_random_next(void *rng);
+
+/* Random values */
+ApInt *apint_random_bits(unsigned bits, ApRandomFn rand, void *ctx);
+ApInt *apint_random_below(const ApInt *bound, ApRandomFn rand, void *ctx);
+ApInt *apint_random_signed(unsigned bits, ApRandomFn rand, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APRANDOM_H */
@@ -0,0 +1,234 @@
+/*
+ * Exact rationals over ApInt
+ * Function implementations
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "apint.h"
+#include "aprat.h"
+#include "apstats.h"
+
+#define RAT_LAZY_LIMBS 4 //denominators up to this size are reduced only on request
+
+static int is_one(const ApInt *ap) {
+	return ap->flags == 1 && limbs_normalized_len(ap->data, ap->len) == 1 && ap->data[0] == 1;
+}
+
+/*
+ * New ApRat owning num and den (den != 0), with the sign moved to num
+ * and reduced once den has doubled since it last was
+ */
+static ApRat *rat_wrap(ApInt *num, ApInt *den, int reduced, size_t base_len) {
+	ApRat *q = (ApRat *)malloc(sizeof(ApRat));
+	assert(q != NULL); //check memory allocation
+	if (den->flags == 0) {
+		den->flags = 1;
+		num->flags = apint_is_zero(num) ? 1 : !num->flags;
+	}
+	q->num = num;
+	q->den = den;
+	q->reduced = reduced || is_one(den);
+	q->base_len = base_len;
+	size_t dn = limbs_normalized_len(den->data, den->len);
+	if (!q->reduced && dn > RAT_LAZY_LIMBS && dn >= 2 * base_len) {
+		apint_rat_reduce(q);
+	}
+	return q;
+}
+
+static size_t larger_base(const ApRat *a, const ApRat *b) {
+	return (a->base_len > b->base_len) ? a->base_len : b->base_len;
+}
+
+/*
+ * num / den, sharing their limbs
+ */
+ApRat *apint_rat_create(const ApInt *num, const ApInt *den) {
+	if (apint_is_zero(den)) {
+		return NULL;
+	}
+	if (apint_is_zero(num)) {
+		return rat_wrap(apint_create_from_u64(0UL), apint_create_from_u64(1UL), 1, 1);
+	}
+	return rat_wrap(apint_copy(num), apint_copy(den), 0, limbs_normalized_len(den->data, den->len));
+}
+
+ApRat *apint_rat_from_apint(const ApInt *ap) {
+	return rat_wrap(apint_copy(ap), apint_create_from_u64(1UL), 1, 1);
+}
+
+ApRat *apint_rat_copy(const ApRat *q) {
+	return rat_wrap(apint_copy(q->num), apint_copy(q->den), q->reduced, q->base_len);
+}
+
+void apint_rat_destroy(ApRat *q) {
+	apint_destroy(q->num);
+	apint_destroy(q->den);
+	free(q);
+}
+
+int apint_rat_is_zero(const ApRat *q) {
+	return apint_is_zero(q->num);
+}
+
+ApRat *apint_rat_negate(const ApRat *q) {
+	return rat_wrap(apint_negate(q->num), apint_copy(q->den), q->reduced, q->base_len);
+}
+
+/*
+ * Divides num and den by their gcd, unless already known to be reduced
+ */
+void apint_rat_reduce(ApRat *q) {
+	if (q->reduced) {
+		return;
+	}
+	ApInt *g = apint_gcd(q->num, q->den);
+	if (!is_one(g)) {
+		ApInt *num = apint_divmod(q->num, g, NULL);
+		ApInt *den = apint_divmod(q->den, g, NULL);
+		apint_destroy(q->num);
+		apint_destroy(q->den);
+		q->num = num;
+		q->den = den;
+	}
+	apint_destroy(g);
+	q->reduced = 1;
+	q->base_len = limbs_normalized_len(q->den->data, q->den->len);
+}
+
+/*
+ * "num/den" in lowest terms, or just "num" for a whole number
+ */
+char *apint_rat_format_as_hex(ApRat *q) {
+	apint_rat_reduce(q);
+	char *num = apint_format_as_hex(q->num);
+	if (is_one(q->den)) {
+		return num;
+	}
+	char *den = apint_format_as_hex(q->den);
+	size_t nn = strlen(num), dn = strlen(den);
+	char *s = (char *)malloc(nn + dn + 2);
+	assert(s != NULL); //check memory allocation
+	memcpy(s, num, nn);
+	s[nn] = '/';
+	memcpy(s + nn + 1, den, dn + 1);
+	free(num);
+	free(den);
+	return s;
+}
+
+/*
+ * a + b, or a - b when negate is set
+ * A whole number added to a reduced fraction stays reduced: for n + m/d,
+ * gcd(nd + m, d) = gcd(m, d) = 1
+ */
+static ApRat *rat_add(const ApRat *a, const ApRat *b, int negate) {
+	APINT_STATS_OP(AP_OP_RATIONAL, (a->den->len > b->den->len) ? a->den->len : b->den->len);
+	ApInt *num;
+	if (a->den->data == b->den->data || apint_compare(a->den, b->den) == 0) {
+		num = negate ? apint_sub(a->num, b->num) : apint_add(a->num, b->num);
+		return rat_wrap(num, apint_copy(a->den), 0, larger_base(a, b));
+	}
+	if (is_one(b->den)) { //a +- n
+		num = apint_copy(a->num);
+		if (negate) {
+			apint_submul(num, b->num, a->den);
+		} else {
+			apint_addmul(num, b->num, a->den);
+		}
+		return rat_wrap(num, apint_copy(a->den), a->reduced, a->base_len);
+	}
+	if (is_one(a->den)) { //n +- b
+		num = negate ? apint_negate(b->num) : apint_copy(b->num);
+		apint_addmul(num, a->num, b->den);
+		return rat_wrap(num, apint_copy(b->den), b->reduced, b->base_len);
+	}
+	num = apint_mul(a->num, b->den);
+	if (negate) {
+		apint_submul(num, b->num, a->den);
+	} else {
+		apint_addmul(num, b->num, a->den);
+	}
+	return rat_wrap(num, apint_mul(a->den, b->den), 0, larger_base(a, b));
+}
+
+ApRat *apint_rat_add(const ApRat *a, const ApRat *b) {
+	return rat_add(a, b, 0);
+}
+
+ApRat *apint_rat_sub(const ApRat *a, const ApRat *b) {
+	return rat_add(a, b, 1);
+}
+
+/*
+ * x / gcd(x, y) and y / gcd(x, y) into *xr and *yr (new values)
+ */
+static void cancel(const ApInt *x, const ApInt *y, ApInt **xr, ApInt **yr) {
+	ApInt *g = is_one(y) ? NULL : apint_gcd(x, y);
+	if (g == NULL || is_one(g)) {
+		*xr = apint_copy(x);
+		*yr = apint_copy(y);
+	} else {
+		*xr = apint_divmod(x, g, NULL);
+		*yr = apint_divmod(y, g, NULL);
+	}
+	if (g != NULL) {
+		apint_destroy(g);
+	}
+}
+
+/*
+ * (an / ad) * (bn / bd) with cross-cancellation: reduced inputs give
+ * a reduced product
+ */
+static ApRat *rat_mul(const ApInt *an, const ApInt *ad, int ar, const ApInt *bn, const ApInt *bd, int br, size_t base_len) {
+	APINT_STATS_OP(AP_OP_RATIONAL, (ad->len > bd->len) ? ad->len : bd->len);
+	if (apint_is_zero(an) || apint_is_zero(bn)) {
+		return rat_wrap(apint_create_from_u64(0UL), apint_create_from_u64(1UL), 1, 1);
+	}
+	ApInt *n1, *d1, *n2, *d2;
+	cancel(an, bd, &n1, &d2);
+	cancel(bn, ad, &n2, &d1);
+	ApInt *num = apint_mul(n1, n2);
+	ApInt *den = apint_mul(d1, d2);
+	apint_destroy(n1);
+	apint_destroy(d1);
+	apint_destroy(n2);
+	apint_destroy(d2);
+	return rat_wrap(num, den, ar && br, base_len);
+}
+
+ApRat *apint_rat_mul(const ApRat *a, const ApRat *b) {
+	return rat_mul(a->num, a->den, a->reduced, b->num, b->den, b->reduced, larger_base(a, b));
+}
+
+ApRat *apint_rat_div(const ApRat *a, const ApRat *b) {
+	if (apint_is_zero(b->num)) {
+		return NULL;
+	}
+	ApInt *inv_num = apint_copy(b->den); //b's reciprocal with the sign on top
+	inv_num->flags = b->num->flags;
+	ApInt *inv_den = apint_abs(b->num);
+	ApRat *q = rat_mul(a->num, a->den, a->reduced, inv_num, inv_den, b->reduced, larger_base(a, b));
+	apint_destroy(inv_num);
+	apint_destroy(inv_den);
+	return q;
+}
+
+/*
+ * Sign of left - right, by cross multiplication (dens are positive)
+ */
+int apint_rat_compare(const ApRat *left, const ApRat *right) {
+	APINT_STATS_OP(AP_OP_RATIONAL, (left->den->len > right->den->len) ? left->den->len : right->den->len);
+	if (apint_compare(left->den, right->den) == 0) {
+		return apint_compare(left->num, right->num);
+	}
+	ApInt *l = apint_mul(left->num, right->den);
+	ApInt *r = apint_mul(right->num, left->den);
+	int cmp = apint_compare(l, r);
+	apint_destroy(l);
+	apint_destroy(r);
+	return cmp;
+}
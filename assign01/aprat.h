@@ -0,0 +1,58 @@
+/*
+ * Exact rationals over ApInt
+ *
+ * An ApRat is num / den with den > 0 and the sign on num. Lowest terms
+ * are not kept after every operation, since the gcd usually costs more
+ * than the arithmetic: sums are left unreduced until the denominator has
+ * doubled in limbs since the last reduction (and is past
+ * RAT_LAZY_LIMBS), or until the value is formatted or apint_rat_reduce
+ * is called. Sums over equal denominators skip the cross products.
+ * Products cancel across (gcd(a, d) and gcd(c, b) for a/b * c/d), which
+ * keeps reduced operands reduced with gcds of the smaller factors.
+ * Comparisons never need lowest terms. The value of an ApRat never
+ * changes, but reduction rewrites its fields, so like an ApInt it may
+ * only be used by one thread at a time while that can happen.
+ */
+
+#ifndef APRAT_H
+#define APRAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "apint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	ApInt *num;
+	ApInt *den;
+	int reduced;     //known to be in lowest terms
+	size_t base_len; //limbs of den after the last reduction
+} ApRat;
+
+/* Constructors and destructors, NULL for a zero denominator */
+ApRat *apint_rat_create(const ApInt *num, const ApInt *den);
+ApRat *apint_rat_from_apint(const ApInt *ap);
+ApRat *apint_rat_copy(const ApRat *q);
+void apint_rat_destroy(ApRat *q);
+
+/* Operations, apint_rat_div returns NULL when dividing by 0 */
+int apint_rat_is_zero(const ApRat *q);
+int apint_rat_compare(const ApRat *left, const ApRat *right);
+ApRat *apint_rat_negate(const ApRat *q);
+ApRat *apint_rat_add(const ApRat *a, const ApRat *b);
+ApRat *apint_rat_sub(const ApRat *a, const ApRat *b);
+ApRat *apint_rat_mul(const ApRat *a, const ApRat *b);
+ApRat *apint_rat_div(const ApRat *a, const ApRat *b);
+
+/* Lowest terms, in place */
+void apint_rat_reduce(ApRat *q);
+char *apint_rat_format_as_hex(ApRat *q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APRAT_H */
@@ -0,0 +1,311 @@
+/*
+ * Residue number system (RNS) vectors
+ * Function implementations
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "apint.h"
+#include "aprns.h"
+#include "apthread.h"
+#include "apstats.h"
+
+#define RNS_PRIME_BITS 62
+#define RNS_PARALLEL_MIN 4096 //fewer residues are not worth forking for
+
+typedef enum { RNS_ADD, RNS_SUB, RNS_MUL } RnsOp;
+
+typedef struct {
+	RnsOp op;
+	uint64_t *r;
+	const uint64_t *a;
+	const uint64_t *b;
+	const ApRnsBasis *basis;
+	size_t count;
+} RnsJob;
+
+/*
+ * b^e mod d
+ */
+static uint64_t powmod(uint64_t b, uint64_t e, const ApLimbDivisor *dv) {
+	uint64_t r = 1;
+	while (e != 0) {
+		if (e & 1) {
+			r = limb_mulmod(r, b, dv);
+		}
+		b = limb_mulmod(b, b, dv);
+		e >>= 1;
+	}
+	return r;
+}
+
+/*
+ * Deterministic Miller-Rabin for odd n < 2^64 (these seven bases cover
+ * every 64 bit n)
+ */
+static int is_prime_u64(uint64_t n) {
+	static const uint64_t bases[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+	ApLimbDivisor dv;
+	limb_divisor_init(&dv, n);
+	uint64_t d = n - 1;
+	int s = 0;
+	while ((d & 1) == 0) {
+		d >>= 1;
+		s++;
+	}
+	for (size_t i = 0; i < sizeof(bases) / sizeof(bases[0]); i++) {
+		uint64_t a = bases[i] % n;
+		if (a == 0) {
+			continue;
+		}
+		uint64_t x = powmod(a, d, &dv);
+		if (x == 1 || x == n - 1) {
+			continue;
+		}
+		int composite = 1;
+		for (int j = 1; j < s && composite; j++) {
+			x = limb_mulmod(x, x, &dv);
+			composite = (x != n - 1);
+		}
+		if (composite) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * (a + b) mod p for a, b < 2^62 and p > 2^61
+ */
+static uint64_t add_reduce(uint64_t a, uint64_t b, uint64_t p) {
+	uint64_t s = a + b;
+	while (s >= p) {
+		s -= p;
+	}
+	return s;
+}
+
+/*
+ * Picks the largest 62 bit primes until M exceeds 2^(bits + 1), so every
+ * |x| < 2^bits lands in (-M/2, M/2], and precomputes the Garner plan
+ */
+ApRnsBasis *apint_rns_basis_create(unsigned bits) {
+	ApRnsBasis *basis = (ApRnsBasis *)malloc(sizeof(ApRnsBasis));
+	assert(basis != NULL); //check memory allocation
+	size_t k = (bits + 1) / (RNS_PRIME_BITS - 1) + 1; //each prime is above 2^61
+	basis->count = k;
+	basis->primes = (uint64_t *)malloc(k * sizeof(uint64_t));
+	basis->divisors = (ApLimbDivisor *)malloc(k * sizeof(ApLimbDivisor));
+	basis->garner = (uint64_t *)malloc(k * sizeof(uint64_t));
+	basis->cross = (uint64_t *)malloc(k * k * sizeof(uint64_t));
+	basis->modulus = (uint64_t *)calloc(k, sizeof(uint64_t));
+	basis->half = (uint64_t *)malloc(k * sizeof(uint64_t));
+	assert(basis->primes != NULL && basis->divisors != NULL && basis->garner != NULL); //check memory allocation
+	assert(basis->cross != NULL && basis->modulus != NULL && basis->half != NULL);
+
+	uint64_t candidate = (1UL << RNS_PRIME_BITS) - 1;
+	for (size_t i = 0; i < k; i++) {
+		while (!is_prime_u64(candidate)) {
+			candidate -= 2;
+		}
+		basis->primes[i] = candidate;
+		limb_divisor_init(&basis->divisors[i], candidate);
+		candidate -= 2;
+	}
+
+	//garner[i] inverts p_0 * ... * p_{i-1} mod p_i (Fermat, p_i is prime)
+	for (size_t i = 0; i < k; i++) {
+		uint64_t p = basis->primes[i];
+		uint64_t prod = 1 % p;
+		for (size_t j = 0; j < i; j++) {
+			basis->cross[i * k + j] = basis->primes[j] % p;
+			prod = limb_mulmod(prod, basis->cross[i * k + j], &basis->divisors[i]);
+		}
+		basis->garner[i] = powmod(prod, p - 2, &basis->divisors[i]);
+	}
+
+	size_t n = 1;
+	basis->modulus[0] = 1;
+	for (size_t i = 0; i < k; i++) {
+		uint64_t carry = limbs_mul_1(basis->modulus, basis->modulus, n, basis->primes[i]);
+		if (carry != 0) {
+			basis->modulus[n++] = carry;
+		}
+	}
+	for (size_t i = 0; i < k; i++) {
+		basis->half[i] = (basis->modulus[i] >> 1) | ((i + 1 < k) ? basis->modulus[i + 1] << 63 : 0);
+	}
+	return basis;
+}
+
+void apint_rns_basis_destroy(ApRnsBasis *basis) {
+	free(basis->primes);
+	free(basis->divisors);
+	free(basis->garner);
+	free(basis->cross);
+	free(basis->modulus);
+	free(basis->half);
+	free(basis);
+}
+
+/*
+ * Allocates count zero integers over basis
+ */
+ApRns *apint_rns_create(const ApRnsBasis *basis, size_t count) {
+	ApRns *v = (ApRns *)malloc(sizeof(ApRns));
+	assert(v != NULL); //check memory allocation
+	v->basis = basis;
+	v->count = count;
+	v->res = (uint64_t *)calloc(basis->count * (count > 0 ? count : 1), sizeof(uint64_t));
+	assert(v->res != NULL); //check memory allocation
+	return v;
+}
+
+void apint_rns_destroy(ApRns *v) {
+	free(v->res);
+	free(v);
+}
+
+/*
+ * Stores the residues of ap as element i
+ */
+void apint_rns_set(ApRns *v, size_t i, const ApInt *ap) {
+	APINT_STATS_OP(AP_OP_RNS, ap->len);
+	const ApRnsBasis *basis = v->basis;
+	size_t n = limbs_normalized_len(ap->data, ap->len);
+	for (size_t k = 0; k < basis->count; k++) {
+		uint64_t r = (n == 0) ? 0 : limbs_divrem_1_preinv(NULL, ap->data, n, &basis->divisors[k]);
+		if (ap->flags == 0 && r != 0) {
+			r = basis->primes[k] - r;
+		}
+		v->res[k * v->count + i] = r;
+	}
+}
+
+/*
+ * Reconstructs element i (Garner): mixed radix digits d_j with
+ * x = d_0 + d_1 p_0 + d_2 p_0 p_1 + ..., then x - M if x > M / 2
+ */
+ApInt *apint_rns_get(const ApRns *v, size_t i) {
+	APINT_STATS_OP(AP_OP_RNS, v->basis->count);
+	const ApRnsBasis *basis = v->basis;
+	size_t k = basis->count;
+	uint64_t *digits = (uint64_t *)calloc(k, sizeof(uint64_t));
+	uint64_t *x = (uint64_t *)calloc(k, sizeof(uint64_t));
+	assert(digits != NULL && x != NULL); //check memory allocation
+
+	for (size_t j = 0; j < k; j++) {
+		uint64_t p = basis->primes[j];
+		const ApLimbDivisor *dv = &basis->divisors[j];
+		const uint64_t *cross = basis->cross + j * k;
+		uint64_t t = 0; //d_0 + d_1 p_0 + ... + d_{j-1} p_0...p_{j-2} mod p_j, by Horner
+		for (size_t m = j; m-- > 0;) {
+			t = add_reduce(limb_mulmod(t, cross[m], dv), digits[m], p);
+		}
+		uint64_t r = v->res[j * v->count + i];
+		digits[j] = limb_mulmod((r >= t) ? r - t : r + (p - t), basis->garner[j], dv);
+	}
+
+	size_t n = 1;
+	x[0] = digits[k - 1];
+	for (size_t j = k - 1; j-- > 0;) {
+		uint64_t carry = limbs_mul_1(x, x, n, basis->primes[j]);
+		if (carry != 0) {
+			x[n++] = carry;
+		}
+		carry = limbs_add_1(x, x, n, digits[j]);
+		if (carry != 0) {
+			x[n++] = carry;
+		}
+	}
+	free(digits);
+
+	uint32_t flags = 1;
+	if (limbs_cmp(x, basis->half, k) > 0) { //upper half of [0, M) is negative
+		limbs_sub_n(x, basis->modulus, x, k);
+		flags = 0;
+	}
+	return apint_wrap_limbs(x, k, flags);
+}
+
+/*
+ * Residues [lo, hi) of prime k's row
+ */
+static void rns_row(RnsJob *job, size_t k, size_t lo, size_t hi) {
+	uint64_t p = job->basis->primes[k];
+	uint64_t *r = job->r;
+	const uint64_t *a = job->a, *b = job->b;
+	switch (job->op) {
+		case RNS_ADD:
+			for (size_t i = lo; i < hi; i++) {
+				uint64_t s = a[i] + b[i];
+				r[i] = (s >= p) ? s - p : s;
+			}
+			break;
+		case RNS_SUB:
+			for (size_t i = lo; i < hi; i++) {
+				uint64_t d = a[i] - b[i];
+				r[i] = (a[i] < b[i]) ? d + p : d;
+			}
+			break;
+		case RNS_MUL:
+			for (size_t i = lo; i < hi; i++) {
+				r[i] = limb_mulmod(a[i], b[i], &job->basis->divisors[k]);
+			}
+			break;
+	}
+}
+
+/*
+ * Residues [lo, hi) of the flattened rows, split at row boundaries
+ */
+static void rns_range(void *arg, size_t lo, size_t hi) {
+	RnsJob *job = (RnsJob *)arg;
+	while (lo < hi) {
+		size_t k = lo / job->count;
+		size_t end = (k + 1) * job->count;
+		if (end > hi) {
+			end = hi;
+		}
+		rns_row(job, k, lo, end);
+		lo = end;
+	}
+}
+
+static void run_rns(RnsOp op, ApRns *r, const ApRns *a, const ApRns *b) {
+	assert(a->basis == b->basis && r->basis == a->basis);
+	assert(a->count == b->count && r->count == a->count);
+	RnsJob job = { op, r->res, a->res, b->res, a->basis, a->count };
+	size_t n = a->basis->count * a->count;
+	if (apint_threads_active() && n >= RNS_PARALLEL_MIN) {
+		size_t chunk = n / (4 * apint_threads_count()); //a few chunks per thread for stealing
+		apint_parallel_for(n, (chunk > 1024) ? chunk : 1024, rns_range, &job);
+	} else if (n > 0) {
+		rns_range(&job, 0, n);
+	}
+}
+
+/*
+ * r[i] = a[i] + b[i]
+ */
+void apint_rns_add(ApRns *r, const ApRns *a, const ApRns *b) {
+	APINT_STATS_OP(AP_OP_RNS, a->basis->count);
+	run_rns(RNS_ADD, r, a, b);
+}
+
+/*
+ * r[i] = a[i] - b[i]
+ */
+void apint_rns_sub(ApRns *r, const ApRns *a, const ApRns *b) {
+	APINT_STATS_OP(AP_OP_RNS, a->basis->count);
+	run_rns(RNS_SUB, r, a, b);
+}
+
+/*
+ * r[i] = a[i] * b[i]
+ */
+void apint_rns_mul(ApRns *r, const ApRns *a, const ApRns *b) {
+	APINT_STATS_OP(AP_OP_RNS, a->basis->count);
+	run_rns(RNS_MUL, r, a, b);
+}
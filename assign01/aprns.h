@@ -0,0 +1,63 @@
+/*
+ * Residue number system (RNS) vectors
+ *
+ * An ApRnsBasis is a set of distinct 62 bit primes p_0..p_{k-1} with
+ * product M. An ApRns holds count integers as their residues modulo every
+ * prime: residue k of integer i is res[k * count + i]. Addition,
+ * subtraction and multiplication act on every residue independently,
+ * with no carries between them, so each prime's row is one flat loop and
+ * the rows are spread over the thread pool (see apthread.h) when it is
+ * running. Values are reconstructed with Garner's algorithm as signed
+ * integers in (-M/2, M/2], so results are exact while they fit the
+ * width the basis was created for.
+ */
+
+#ifndef APRNS_H
+#define APRNS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "apint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	size_t count;            //number of primes
+	uint64_t *primes;
+	ApLimbDivisor *divisors; //one per prime, for modular multiplication
+	uint64_t *garner;        //garner[i] = (p_0 * ... * p_{i-1})^-1 mod p_i
+	uint64_t *cross;         //cross[i * count + j] = p_j mod p_i for j < i
+	uint64_t *modulus;       //M, count limbs
+	uint64_t *half;          //floor(M / 2), count limbs
+} ApRnsBasis;
+
+typedef struct {
+	const ApRnsBasis *basis;
+	size_t count;  //number of integers
+	uint64_t *res; //basis->count rows of count residues
+} ApRns;
+
+/* Bases, every value (and result) must satisfy |x| < 2^bits */
+ApRnsBasis *apint_rns_basis_create(unsigned bits);
+void apint_rns_basis_destroy(ApRnsBasis *basis);
+
+/* Constructors and destructors */
+ApRns *apint_rns_create(const ApRnsBasis *basis, size_t count);
+void apint_rns_destroy(ApRns *v);
+
+/* Conversion to and from ApInt */
+void apint_rns_set(ApRns *v, size_t i, const ApInt *ap);
+ApInt *apint_rns_get(const ApRns *v, size_t i);
+
+/* Element-wise operations (all operands must share the basis and count) */
+void apint_rns_add(ApRns *r, const ApRns *a, const ApRns *b);
+void apint_rns_sub(ApRns *r, const ApRns *a, const ApRns *b);
+void apint_rns_mul(ApRns *r, const ApRns *a, const ApRns *b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APRNS_H */
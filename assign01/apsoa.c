@@ -0,0 +1,410 @@
+/*
+ * Structure-of-arrays batch of same-width integers
+ * Function implementations
+ *
+ * Every operation has a portable version plus AVX2 and AVX-512 versions
+ * for x86-64, picked at run time from the dispatch tier (see apcpu.h).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "apint.h"
+#include "apsoa.h"
+#include "apcpu.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define SOA_LANES 8 //lanes of the widest vector (AVX-512), stride is a multiple of it
+
+/* 
+ * Allocates a batch of count zero integers of width limbs
+ */
+ApSoA *apint_soa_create(uint32_t width, size_t count) {
+	assert(width > 0);
+	ApSoA *v = (ApSoA *)malloc(sizeof(ApSoA));
+	assert(v != NULL); //check memory allocation
+	v->width = width;
+	v->count = count;
+	v->stride = (count + SOA_LANES - 1) / SOA_LANES * SOA_LANES;
+	if (v->stride == 0) {
+		v->stride = SOA_LANES;
+	}
+	size_t bytes = (size_t)width * v->stride * sizeof(uint64_t); //multiple of 64
+	v->limbs = (uint64_t *)aligned_alloc(64, bytes);
+	assert(v->limbs != NULL); //check memory allocation
+	memset(v->limbs, 0, bytes);
+	return v;
+}
+
+void apint_soa_destroy(ApSoA *v) {
+	free(v->limbs);
+	free(v);
+}
+
+/* 
+ * Stores ap in lane i as a width limb two's complement value
+ * (bits above 64 * width are dropped)
+ */
+void apint_soa_set(ApSoA *v, size_t i, const ApInt *ap) {
+	uint64_t carry = 1; //negating is ~x + 1
+	for (uint32_t j = 0; j < v->width; j++) {
+		uint64_t limb = (j < ap->len) ? ap->data[j] : 0;
+		if (ap->flags == 0) {
+			limb = ~limb + carry;
+			carry = carry && limb == 0;
+		}
+		v->limbs[j * v->stride + i] = limb;
+	}
+}
+
+/* 
+ * Returns the value in lane i as a new ApInt
+ */
+ApInt *apint_soa_get(const ApSoA *v, size_t i) {
+	uint64_t *data = (uint64_t *)malloc(v->width * sizeof(uint64_t));
+	assert(data != NULL); //check memory allocation
+	int negative = (v->limbs[(v->width - 1) * v->stride + i] >> 63) != 0;
+	uint64_t carry = 1;
+	for (uint32_t j = 0; j < v->width; j++) {
+		data[j] = v->limbs[j * v->stride + i];
+		if (negative) { //magnitude of a two's complement value
+			data[j] = ~data[j] + carry;
+			carry = carry && data[j] == 0;
+		}
+	}
+	return apint_wrap_limbs(data, v->width, negative ? 0 : 1);
+}
+
+static void check_shapes(const ApSoA *a, const ApSoA *b) {
+	assert(a->width == b->width && a->count == b->count);
+	(void) a;
+	(void) b;
+}
+
+/*
+ * Portable kernels, one lane at a time
+ */
+static void soa_add_generic(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t stride, size_t count, uint32_t width) {
+	for (size_t i = 0; i < count; i++) {
+		uint64_t carry = 0;
+		for (uint32_t j = 0; j < width; j++) {
+			size_t k = j * stride + i;
+			uint64_t s = a[k] + b[k];
+			uint64_t c = s < a[k];
+			r[k] = s + carry;
+			carry = c | (r[k] < s);
+		}
+	}
+}
+
+static void soa_sub_generic(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t stride, size_t count, uint32_t width) {
+	for (size_t i = 0; i < count; i++) {
+		uint64_t borrow = 0;
+		for (uint32_t j = 0; j < width; j++) {
+			size_t k = j * stride + i;
+			uint64_t d = a[k] - b[k];
+			uint64_t c = a[k] < b[k];
+			r[k] = d - borrow;
+			borrow = c | (d < borrow);
+		}
+	}
+}
+
+static void soa_compare_generic(int *results, const uint64_t *a, const uint64_t *b, size_t stride, size_t count, uint32_t width) {
+	for (size_t i = 0; i < count; i++) {
+		size_t top = (width - 1) * stride + i;
+		int res = 0;
+		if (a[top] != b[top]) { //top limb carries the sign
+			res = ((int64_t) a[top] > (int64_t) b[top]) ? 1 : -1;
+		}
+		for (uint32_t j = width - 1; res == 0 && j-- > 0; ) {
+			size_t k = j * stride + i;
+			if (a[k] != b[k]) {
+				res = (a[k] > b[k]) ? 1 : -1;
+			}
+		}
+		results[i] = res;
+	}
+}
+
+#if defined(__x86_64__)
+/*
+ * AVX2 kernels, 4 lanes per instruction
+ * AVX2 has no unsigned 64 bit compare, so operands are biased by 2^63
+ * and compared signed. Carries and borrows are kept as all-ones masks.
+ */
+__attribute__((target("avx2")))
+static void soa_add_avx2(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t stride, uint32_t width) {
+	const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+	const __m256i zero = _mm256_setzero_si256();
+	for (size_t i = 0; i < stride; i += 4) {
+		__m256i carry = zero;
+		for (uint32_t j = 0; j < width; j++) {
+			size_t k = j * stride + i;
+			__m256i x = _mm256_load_si256((const __m256i *)(a + k));
+			__m256i y = _mm256_load_si256((const __m256i *)(b + k));
+			__m256i s = _mm256_add_epi64(x, y);
+			__m256i c1 = _mm256_cmpgt_epi64(_mm256_xor_si256(x, bias), _mm256_xor_si256(s, bias)); //s < x
+			__m256i t = _mm256_sub_epi64(s, carry); //mask is -1, so this adds the carry
+			__m256i c2 = _mm256_and_si256(carry, _mm256_cmpeq_epi64(t, zero));
+			carry = _mm256_or_si256(c1, c2);
+			_mm256_store_si256((__m256i *)(r + k), t);
+		}
+	}
+}
+
+__attribute__((target("avx2")))
+static void soa_sub_avx2(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t stride, uint32_t width) {
+	const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+	const __m256i zero = _mm256_setzero_si256();
+	for (size_t i = 0; i < stride; i += 4) {
+		__m256i borrow = zero;
+		for (uint32_t j = 0; j < width; j++) {
+			size_t k = j * stride + i;
+			__m256i x = _mm256_load_si256((const __m256i *)(a + k));
+			__m256i y = _mm256_load_si256((const __m256i *)(b + k));
+			__m256i d = _mm256_sub_epi64(x, y);
+			__m256i b1 = _mm256_cmpgt_epi64(_mm256_xor_si256(y, bias), _mm256_xor_si256(x, bias)); //x < y
+			__m256i b2 = _mm256_and_si256(borrow, _mm256_cmpeq_epi64(d, zero));
+			_mm256_store_si256((__m256i *)(r + k), _mm256_add_epi64(d, borrow)); //mask is -1, so this subtracts
+			borrow = _mm256_or_si256(b1, b2);
+		}
+	}
+}
+
+__attribute__((target("avx2")))
+static void soa_compare_avx2(int *results, const uint64_t *a, const uint64_t *b, size_t stride, size_t count, uint32_t width) {
+	const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+	int64_t out[4];
+	for (size_t i = 0; i < count; i += 4) {
+		__m256i gt = _mm256_setzero_si256(), lt = gt, decided = gt;
+		for (uint32_t j = width; j-- > 0; ) {
+			size_t k = j * stride + i;
+			__m256i x = _mm256_load_si256((const __m256i *)(a + k));
+			__m256i y = _mm256_load_si256((const __m256i *)(b + k));
+			if (j != width - 1) { //lower limbs compare unsigned
+				x = _mm256_xor_si256(x, bias);
+				y = _mm256_xor_si256(y, bias);
+			}
+			__m256i g = _mm256_cmpgt_epi64(x, y), l = _mm256_cmpgt_epi64(y, x);
+			gt = _mm256_or_si256(gt, _mm256_andnot_si256(decided, g));
+			lt = _mm256_or_si256(lt, _mm256_andnot_si256(decided, l));
+			decided = _mm256_or_si256(decided, _mm256_or_si256(g, l));
+		}
+		_mm256_storeu_si256((__m256i *)out, _mm256_sub_epi64(lt, gt)); //1, 0 or -1 per lane
+		for (size_t l = 0; l < 4 && i + l < count; l++) {
+			results[i + l] = (int) out[l];
+		}
+	}
+}
+
+/*
+ * AVX-512 kernels, 8 lanes per instruction with carries in mask registers
+ */
+__attribute__((target("avx512f")))
+static void soa_add_avx512(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t stride, uint32_t width) {
+	const __m512i one = _mm512_set1_epi64(1);
+	const __m512i zero = _mm512_setzero_si512();
+	for (size_t i = 0; i < stride; i += 8) {
+		__mmask8 carry = 0;
+		for (uint32_t j = 0; j < width; j++) {
+			size_t k = j * stride + i;
+			__m512i x = _mm512_load_si512((const void *)(a + k));
+			__m512i y = _mm512_load_si512((const void *)(b + k));
+			__m512i s = _mm512_add_epi64(x, y);
+			__mmask8 c1 = _mm512_cmplt_epu64_mask(s, x);
+			__m512i t = _mm512_mask_add_epi64(s, carry, s, one);
+			__mmask8 c2 = carry & _mm512_cmpeq_epi64_mask(t, zero);
+			carry = c1 | c2;
+			_mm512_store_si512((void *)(r + k), t);
+		}
+	}
+}
+
+__attribute__((target("avx512f")))
+static void soa_sub_avx512(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t stride, uint32_t width) {
+	const __m512i one = _mm512_set1_epi64(1);
+	const __m512i zero = _mm512_setzero_si512();
+	for (size_t i = 0; i < stride; i += 8) {
+		__mmask8 borrow = 0;
+		for (uint32_t j = 0; j < width; j++) {
+			size_t k = j * stride + i;
+			__m512i x = _mm512_load_si512((const void *)(a + k));
+			__m512i y = _mm512_load_si512((const void *)(b + k));
+			__m512i d = _mm512_sub_epi64(x, y);
+			__mmask8 b1 = _mm512_cmplt_epu64_mask(x, y);
+			__mmask8 b2 = borrow & _mm512_cmpeq_epi64_mask(d, zero);
+			_mm512_store_si512((void *)(r + k), _mm512_mask_sub_epi64(d, borrow, d, one));
+			borrow = b1 | b2;
+		}
+	}
+}
+
+__attribute__((target("avx512f")))
+static void soa_compare_avx512(int *results, const uint64_t *a, const uint64_t *b, size_t stride, size_t count, uint32_t width) {
+	for (size_t i = 0; i < count; i += 8) {
+		__mmask8 gt = 0, lt = 0, decided = 0;
+		for (uint32_t j = width; j-- > 0; ) {
+			size_t k = j * stride + i;
+			__m512i x = _mm512_load_si512((const void *)(a + k));
+			__m512i y = _mm512_load_si512((const void *)(b + k));
+			__mmask8 g, l;
+			if (j == width - 1) { //top limb carries the sign
+				g = _mm512_cmpgt_epi64_mask(x, y);
+				l = _mm512_cmplt_epi64_mask(x, y);
+			} else {
+				g = _mm512_cmpgt_epu64_mask(x, y);
+				l = _mm512_cmplt_epu64_mask(x, y);
+			}
+			gt |= g & ~decided;
+			lt |= l & ~decided;
+			decided |= g | l;
+		}
+		for (size_t l = 0; l < 8 && i + l < count; l++) {
+			results[i + l] = ((gt >> l) & 1) - ((lt >> l) & 1);
+		}
+	}
+}
+#endif
+
+/* 
+ * SIMD tier in effect (see apcpu.h): 2 = AVX-512, 1 = AVX2, 0 = portable
+ */
+static int soa_tier(void) {
+	ApCpuTier tier = apint_cpu_tier();
+	if (tier >= AP_CPU_AVX512) {
+		return 2;
+	}
+	return (tier >= AP_CPU_AVX2) ? 1 : 0;
+}
+
+/* 
+ * r = a + b in every lane (modulo 2^(64 * width))
+ */
+void apint_soa_add(ApSoA *r, const ApSoA *a, const ApSoA *b) {
+	check_shapes(r, a);
+	check_shapes(a, b);
+	switch (soa_tier()) {
+#if defined(__x86_64__)
+		case 2:
+			soa_add_avx512(r->limbs, a->limbs, b->limbs, a->stride, a->width);
+			break;
+		case 1:
+			soa_add_avx2(r->limbs, a->limbs, b->limbs, a->stride, a->width);
+			break;
+#endif
+		default:
+			soa_add_generic(r->limbs, a->limbs, b->limbs, a->stride, a->count, a->width);
+			break;
+	}
+}
+
+/* 
+ * r = a - b in every lane (modulo 2^(64 * width))
+ */
+void apint_soa_sub(ApSoA *r, const ApSoA *a, const ApSoA *b) {
+	check_shapes(r, a);
+	check_shapes(a, b);
+	switch (soa_tier()) {
+#if defined(__x86_64__)
+		case 2:
+			soa_sub_avx512(r->limbs, a->limbs, b->limbs, a->stride, a->width);
+			break;
+		case 1:
+			soa_sub_avx2(r->limbs, a->limbs, b->limbs, a->stride, a->width);
+			break;
+#endif
+		default:
+			soa_sub_generic(r->limbs, a->limbs, b->limbs, a->stride, a->count, a->width);
+			break;
+	}
+}
+
+/* 
+ * results[i] = 1, 0 or -1 as lane i of a is greater, equal or less
+ * than lane i of b (signed two's complement order)
+ */
+void apint_soa_compare(int *results, const ApSoA *a, const ApSoA *b) {
+	check_shapes(a, b);
+	switch (soa_tier()) {
+#if defined(__x86_64__)
+		case 2:
+			soa_compare_avx512(results, a->limbs, b->limbs, a->stride, a->count, a->width);
+			break;
+		case 1:
+			soa_compare_avx2(results, a->limbs, b->limbs, a->stride, a->count, a->width);
+			break;
+#endif
+		default:
+			soa_compare_generic(results, a->limbs, b->limbs, a->stride, a->count, a->width);
+			break;
+	}
+}
+
+/* 
+ * r = a << n in every lane, bits shifted past the width are lost
+ * Rows are written top down so r may be a; the inner lane loops are
+ * plain shifts that the compiler vectorizes
+ */
+void apint_soa_lshift(ApSoA *r, const ApSoA *a, unsigned n) {
+	check_shapes(r, a);
+	size_t stride = a->stride;
+	unsigned q = n / 64, s = n % 64;
+	for (uint32_t j = a->width; j-- > 0; ) {
+		uint64_t *out = r->limbs + j * stride;
+		if (j < q) {
+			memset(out, 0, stride * sizeof(uint64_t));
+			continue;
+		}
+		const uint64_t *src = a->limbs + (j - q) * stride;
+		if (s == 0) {
+			memmove(out, src, stride * sizeof(uint64_t));
+		} else if (j == q) {
+			for (size_t i = 0; i < stride; i++) {
+				out[i] = src[i] << s;
+			}
+		} else {
+			const uint64_t *below = src - stride;
+			for (size_t i = 0; i < stride; i++) {
+				out[i] = (src[i] << s) | (below[i] >> (64 - s));
+			}
+		}
+	}
+}
+
+/* 
+ * r = a >> n in every lane (arithmetic, the sign bit is copied in)
+ * Rows are written bottom up so r may be a
+ */
+void apint_soa_rshift(ApSoA *r, const ApSoA *a, unsigned n) {
+	check_shapes(r, a);
+	size_t stride = a->stride;
+	uint32_t width = a->width;
+	unsigned q = n / 64, s = n % 64;
+	const uint64_t *top = a->limbs + (width - 1) * stride;
+	for (uint32_t j = 0; j < width; j++) {
+		uint64_t *out = r->limbs + j * stride;
+		if (j + q >= width) { //only sign bits are left
+			for (size_t i = 0; i < stride; i++) {
+				out[i] = (uint64_t)((int64_t) top[i] >> 63);
+			}
+			continue;
+		}
+		const uint64_t *src = a->limbs + (j + q) * stride;
+		if (s == 0) {
+			memmove(out, src, stride * sizeof(uint64_t));
+		} else if (j + q == width - 1) {
+			for (size_t i = 0; i < stride; i++) {
+				out[i] = (uint64_t)((int64_t) src[i] >> s);
+			}
+		} else {
+			const uint64_t *above = src + stride;
+			for (size_t i = 0; i < stride; i++) {
+				out[i] = (src[i] >> s) | (above[i] << (64 - s));
+			}
+		}
+	}
+}
@@ -0,0 +1,48 @@
+/*
+ * Structure-of-arrays batch of same-width integers
+ *
+ * An ApSoA holds count integers of width limbs each, stored limb-interleaved:
+ * limb j of integer i is limbs[j * stride + i]. Values are two's complement
+ * and wrap modulo 2^(64 * width) like fixed-width machine integers, so
+ * every operation is the same instruction sequence for every lane and
+ * runs 4 (AVX2) or 8 (AVX-512) integers per instruction.
+ */
+
+#ifndef APSOA_H
+#define APSOA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "apint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	uint32_t width;  //limbs per integer
+	size_t count;    //number of integers
+	size_t stride;   //count rounded up to a whole number of 512 bit vectors
+	uint64_t *limbs; //width rows of stride limbs, 64 byte aligned
+} ApSoA;
+
+/* Constructors and destructors */
+ApSoA *apint_soa_create(uint32_t width, size_t count);
+void apint_soa_destroy(ApSoA *v);
+
+/* Conversion to and from ApInt */
+void apint_soa_set(ApSoA *v, size_t i, const ApInt *ap);
+ApInt *apint_soa_get(const ApSoA *v, size_t i);
+
+/* Lane-wise operations (all operands must have the same width and count) */
+void apint_soa_add(ApSoA *r, const ApSoA *a, const ApSoA *b);
+void apint_soa_sub(ApSoA *r, const ApSoA *a, const ApSoA *b);
+void apint_soa_compare(int *results, const ApSoA *a, const ApSoA *b);
+void apint_soa_lshift(ApSoA *r, const ApSoA *a, unsigned n);
+void apint_soa_rshift(ApSoA *r, const ApSoA *a, unsigned n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APSOA_H */
@@ -0,0 +1,251 @@
+/*
+ * Sorting arrays of ApInt values
+ * Function implementations
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "apint.h"
+#include "apsort.h"
+#include "apthread.h"
+#include "apstats.h"
+
+#define SORT_INSERTION 32        //buckets below this are insertion sorted
+#define SORT_PARALLEL_MIN 65536  //smaller groups are not worth forking for
+#define SORT_GROUP_RANGE 65536   //wider spreads of lengths fall back to qsort
+
+/*
+ * A value being sorted: key is the group while grouping, then the limb
+ * the radix digits are currently taken from
+ */
+typedef struct {
+	uint64_t key;
+	ApInt *p;
+} SortItem;
+
+typedef struct {
+	SortItem *items;
+	SortItem *tmp;
+	size_t start[257];
+	size_t skip; //bucket left to the caller
+	size_t limb;
+	int shift;
+} SortJob;
+
+typedef struct {
+	SortItem *items;
+	ApInt **a;
+} GroupJob;
+
+static void msd_sort(SortItem *items, SortItem *tmp, size_t n, size_t limb, int shift);
+
+/*
+ * qsort comparator for arrays of ApInt pointers
+ */
+int apint_compare_ptrs(const void *left, const void *right) {
+	return apint_compare(*(ApInt *const *)left, *(ApInt *const *)right);
+}
+
+/*
+ * Negative values by decreasing length, zero, then positive values by
+ * increasing length: groups in ascending order of value
+ */
+static void group_range(void *arg, size_t lo, size_t hi) {
+	GroupJob *job = (GroupJob *)arg;
+	for (size_t i = lo; i < hi; i++) {
+		ApInt *p = job->a[i];
+		uint64_t len = limbs_normalized_len(p->data, p->len);
+		job->items[i].key = (p->flags == 0) ? (1UL << 32) - len : (1UL << 32) + len;
+		job->items[i].p = p;
+	}
+}
+
+static int compare_keys(const void *left, const void *right) {
+	uint64_t l = ((const SortItem *)left)->key, r = ((const SortItem *)right)->key;
+	return (l > r) - (l < r);
+}
+
+/*
+ * Items with equal limbs above limb and an equal key (limb itself)
+ */
+static void insertion_sort(SortItem *items, size_t n, size_t limb) {
+	for (size_t i = 1; i < n; i++) {
+		SortItem x = items[i];
+		size_t j = i;
+		while (j > 0) {
+			SortItem *y = &items[j - 1];
+			if (y->key < x.key || (y->key == x.key && limbs_cmp(y->p->data, x.p->data, limb) <= 0)) {
+				break;
+			}
+			items[j] = *y;
+			j--;
+		}
+		items[j] = x;
+	}
+}
+
+static void sort_buckets(void *arg, size_t lo, size_t hi) {
+	SortJob *job = (SortJob *)arg;
+	for (size_t b = lo; b < hi; b++) {
+		size_t start = job->start[b], n = job->start[b + 1] - start;
+		if (n > 1 && b != job->skip) {
+			msd_sort(job->items + start, job->tmp + start, n, job->limb, job->shift);
+		}
+	}
+}
+
+/*
+ * Sorts n magnitudes that agree above byte shift of limb, with key
+ * holding limb. tmp is scratch of the same size. The largest bucket is
+ * handled by the loop and the others by recursion, so the depth stays
+ * logarithmic in n
+ */
+static void msd_sort(SortItem *items, SortItem *tmp, size_t n, size_t limb, int shift) {
+	while (n >= SORT_INSERTION) {
+		size_t count[256] = { 0 };
+		for (size_t i = 0; i < n; i++) {
+			count[(items[i].key >> shift) & 0xFF]++;
+		}
+		if (count[(items[0].key >> shift) & 0xFF] == n) { //one bucket, move to the next byte
+			if (shift > 0) {
+				shift -= 8;
+				continue;
+			}
+			if (limb == 0) {
+				return; //all equal
+			}
+			limb--;
+			shift = 56;
+			for (size_t i = 0; i < n; i++) {
+				items[i].key = items[i].p->data[limb];
+			}
+			continue;
+		}
+
+		SortJob job;
+		job.items = items;
+		job.tmp = tmp;
+		job.start[0] = 0;
+		size_t largest = 0;
+		for (size_t b = 0; b < 256; b++) {
+			job.start[b + 1] = job.start[b] + count[b];
+			if (count[b] > count[largest]) {
+				largest = b;
+			}
+		}
+		size_t pos[256];
+		memcpy(pos, job.start, sizeof(pos));
+		for (size_t i = 0; i < n; i++) {
+			tmp[pos[(items[i].key >> shift) & 0xFF]++] = items[i];
+		}
+		memcpy(items, tmp, n * sizeof(SortItem));
+
+		//the next digit, reloading keys when it is in the next limb down
+		if (shift == 0 && limb == 0) {
+			return; //buckets hold equal values
+		}
+		int next_shift = shift - 8;
+		size_t next_limb = limb;
+		if (shift == 0) {
+			next_shift = 56;
+			next_limb = limb - 1;
+			for (size_t i = 0; i < n; i++) {
+				items[i].key = items[i].p->data[next_limb];
+			}
+		}
+		job.skip = largest;
+		job.limb = next_limb;
+		job.shift = next_shift;
+
+		if (apint_threads_active() && n >= SORT_PARALLEL_MIN) {
+			apint_parallel_for(256, 1, sort_buckets, &job);
+		} else {
+			sort_buckets(&job, 0, 256);
+		}
+		items += job.start[largest];
+		tmp += job.start[largest];
+		n = count[largest];
+		limb = next_limb;
+		shift = next_shift;
+	}
+	if (n > 1) {
+		insertion_sort(items, n, limb);
+	}
+}
+
+/*
+ * Sorts a[0..n) ascending
+ */
+void apint_sort(ApInt **a, size_t n) {
+	APINT_STATS_OP(AP_OP_SORT, n);
+	if (n < 2) {
+		return;
+	}
+	SortItem *items = (SortItem *)malloc(n * sizeof(SortItem));
+	SortItem *tmp = (SortItem *)malloc(n * sizeof(SortItem));
+	assert(items != NULL && tmp != NULL); //check memory allocation
+
+	GroupJob gjob = { items, a };
+	if (apint_threads_active() && n >= SORT_PARALLEL_MIN) {
+		apint_parallel_for(n, SORT_PARALLEL_MIN, group_range, &gjob);
+	} else {
+		group_range(&gjob, 0, n);
+	}
+
+	//counting sort on the group, which only spans the lengths present
+	uint64_t lo = items[0].key, hi = items[0].key;
+	for (size_t i = 1; i < n; i++) {
+		lo = (items[i].key < lo) ? items[i].key : lo;
+		hi = (items[i].key > hi) ? items[i].key : hi;
+	}
+	if (hi - lo < SORT_GROUP_RANGE) {
+		size_t groups = hi - lo + 1;
+		size_t *start = (size_t *)calloc(groups + 1, sizeof(size_t));
+		assert(start != NULL); //check memory allocation
+		for (size_t i = 0; i < n; i++) {
+			start[items[i].key - lo + 1]++;
+		}
+		for (size_t g = 0; g < groups; g++) {
+			start[g + 1] += start[g];
+		}
+		for (size_t i = 0; i < n; i++) {
+			tmp[start[items[i].key - lo]++] = items[i];
+		}
+		memcpy(items, tmp, n * sizeof(SortItem));
+		free(start);
+	} else {
+		qsort(items, n, sizeof(SortItem), compare_keys);
+	}
+
+	//radix sort the magnitudes in each group, negative groups come out reversed
+	size_t i = 0;
+	while (i < n) {
+		uint64_t group = items[i].key;
+		size_t end = i + 1;
+		while (end < n && items[end].key == group) {
+			end++;
+		}
+		size_t len = (group >= (1UL << 32)) ? group - (1UL << 32) : (1UL << 32) - group;
+		if (len > 0 && end - i > 1) {
+			for (size_t j = i; j < end; j++) {
+				items[j].key = items[j].p->data[len - 1];
+			}
+			msd_sort(items + i, tmp + i, end - i, len - 1, 56);
+			if (group < (1UL << 32)) {
+				for (size_t l = i, r = end - 1; l < r; l++, r--) {
+					SortItem t = items[l];
+					items[l] = items[r];
+					items[r] = t;
+				}
+			}
+		}
+		i = end;
+	}
+
+	for (size_t j = 0; j < n; j++) {
+		a[j] = items[j].p;
+	}
+	free(items);
+	free(tmp);
+}
@@ -0,0 +1,29 @@
+/*
+ * Sorting arrays of ApInt values
+ *
+ * apint_sort orders an array of ApInt pointers ascending, the same
+ * order as qsort with apint_compare but without a comparison call per
+ * step: values are grouped by sign and normalized length first, and
+ * each group is then MSD radix sorted on its limbs, most significant
+ * byte first. Large groups are split over the thread pool (see
+ * apthread.h) when it is running. Only the pointers move.
+ */
+
+#ifndef APSORT_H
+#define APSORT_H
+
+#include <stddef.h>
+#include "apint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void apint_sort(ApInt **a, size_t n);
+int apint_compare_ptrs(const void *left, const void *right);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APSORT_H */
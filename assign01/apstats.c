@@ -0,0 +1,154 @@
+/*
+ * Operation statistics for the ApInt library
+ * Function implementations
+ *
+ * Counters are shared by all threads and updated with relaxed atomics;
+ * the operation that allocations are charged to is per thread.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#define APSTATS_NO_REDIRECT
+#include "apstats.h"
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+static ApOpStats stats[AP_OP_COUNT];
+
+static const char *const op_names[AP_OP_COUNT] = {
+	"create_from_hex", "format_as_hex", "format_as_decimal", "copy", "negate", "compare",
+	"add", "sub", "lshift_n", "rshift_n", "mul", "divmod", "gcd", "scalar",
+	"addmul", "submul", "add_shifted", "linear_sum", "product", "powm",
+	"prime_test", "prime_gen", "random", "rns", "hash", "sort", "poly", "rational", "float", "series", "other"
+};
+
+int apint_stats_enabled(void) {
+#ifdef APINT_STATS
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+void apint_stats_reset(void) {
+	memset(stats, 0, sizeof(stats)); //not safe while operations are running
+}
+
+/*
+ * Snapshot of one operation's counters
+ */
+void apint_stats_get(ApStatsOp op, ApOpStats *out) {
+	uint64_t *dst = (uint64_t *)out;
+	uint64_t *src = (uint64_t *)&stats[op];
+	for (size_t i = 0; i < sizeof(ApOpStats) / sizeof(uint64_t); i++) {
+		dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+	}
+}
+
+const char *apint_stats_op_name(ApStatsOp op) {
+	return (op < AP_OP_COUNT) ? op_names[op] : "unknown";
+}
+
+/*
+ * One line per operation that was used, then its non-empty size buckets
+ * as "limbs:calls" with the lower bound of each bucket
+ */
+void apint_stats_dump(FILE *out) {
+	if (!apint_stats_enabled()) {
+		fprintf(out, "apint stats: disabled (build with -DAPINT_STATS)\n");
+		return;
+	}
+	fprintf(out, "%-16s %12s %16s %10s %14s  sizes\n", "operation", "calls", "cycles", "allocs", "bytes");
+	for (int op = 0; op < AP_OP_COUNT; op++) {
+		ApOpStats s;
+		apint_stats_get((ApStatsOp) op, &s);
+		if (s.calls == 0 && s.allocs == 0) {
+			continue;
+		}
+		fprintf(out, "%-16s %12lu %16lu %10lu %14lu ", op_names[op], s.calls, s.cycles, s.allocs, s.bytes);
+		for (int b = 0; b < AP_STATS_BUCKETS; b++) {
+			if (s.sizes[b] != 0) {
+				fprintf(out, " %lu:%lu", (b == 0) ? 0UL : 1UL << (b - 1), s.sizes[b]);
+			}
+		}
+		fprintf(out, "\n");
+	}
+}
+
+/*
+ * {"enabled": true, "operations": {"add": {"calls": ..., "sizes": [...]}, ...}}
+ * with all AP_STATS_BUCKETS buckets per operation
+ */
+void apint_stats_dump_json(FILE *out) {
+	fprintf(out, "{\"enabled\": %s, \"operations\": {", apint_stats_enabled() ? "true" : "false");
+	for (int op = 0; op < AP_OP_COUNT; op++) {
+		ApOpStats s;
+		apint_stats_get((ApStatsOp) op, &s);
+		fprintf(out, "%s\"%s\": {\"calls\": %lu, \"cycles\": %lu, \"allocs\": %lu, \"bytes\": %lu, \"sizes\": [",
+			(op > 0) ? ", " : "", op_names[op], s.calls, s.cycles, s.allocs, s.bytes);
+		for (int b = 0; b < AP_STATS_BUCKETS; b++) {
+			fprintf(out, "%s%lu", (b > 0) ? ", " : "", s.sizes[b]);
+		}
+		fprintf(out, "]}");
+	}
+	fprintf(out, "}}\n");
+}
+
+#ifdef APINT_STATS
+static _Thread_local ApStatsOp current = AP_OP_OTHER;
+
+static uint64_t read_cycles(void) {
+#if defined(__x86_64__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000UL + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+static void count(uint64_t *counter, uint64_t n) {
+	__atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+ApStatsScope apint_stats_scope_begin(ApStatsOp op, size_t limbs) {
+	int bucket = (limbs == 0) ? 0 : 64 - __builtin_clzl(limbs);
+	if (bucket >= AP_STATS_BUCKETS) {
+		bucket = AP_STATS_BUCKETS - 1;
+	}
+	count(&stats[op].calls, 1);
+	count(&stats[op].sizes[bucket], 1);
+	ApStatsScope scope = { op, current, 0 };
+	current = op;
+	scope.start = read_cycles();
+	return scope;
+}
+
+void apint_stats_scope_end(ApStatsScope *scope) {
+	count(&stats[scope->op].cycles, read_cycles() - scope->start);
+	current = scope->outer;
+}
+
+static void count_alloc(size_t bytes) {
+	count(&stats[current].allocs, 1);
+	count(&stats[current].bytes, bytes);
+}
+
+void *apint_stats_malloc(size_t bytes) {
+	count_alloc(bytes);
+	return malloc(bytes);
+}
+
+void *apint_stats_calloc(size_t n, size_t size) {
+	count_alloc(n * size);
+	return calloc(n, size);
+}
+
+void *apint_stats_realloc(void *p, size_t bytes) {
+	count_alloc(bytes);
+	return realloc(p, bytes);
+}
+#endif
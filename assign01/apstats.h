@@ -0,0 +1,109 @@
+/*
+ * Operation statistics for the ApInt library
+ *
+ * Built with -DAPINT_STATS (make STATS=1, after make clean), every public
+ * operation records its calls, a histogram of its largest operand size
+ * (power of two limb buckets), the allocations made while it runs and
+ * its cycles (rdtsc on x86-64, nanoseconds elsewhere). Cycles include
+ * nested operations, allocations go to the innermost one. Translation
+ * units that include this header then route malloc, calloc and realloc
+ * through the counters. Without APINT_STATS nothing is recorded and the
+ * hooks compile to nothing; the dump says so.
+ */
+
+#ifndef APSTATS_H
+#define APSTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AP_STATS_BUCKETS 24 //limbs 0, 1, 2-3, 4-7, ..., the last is open ended
+
+typedef enum {
+	AP_OP_CREATE_FROM_HEX,
+	AP_OP_FORMAT_AS_HEX,
+	AP_OP_FORMAT_AS_DECIMAL,
+	AP_OP_COPY,
+	AP_OP_NEGATE,
+	AP_OP_COMPARE,
+	AP_OP_ADD,
+	AP_OP_SUB,
+	AP_OP_LSHIFT_N,
+	AP_OP_RSHIFT_N,
+	AP_OP_MUL,
+	AP_OP_DIVMOD,
+	AP_OP_GCD,
+	AP_OP_SCALAR,
+	AP_OP_ADDMUL,
+	AP_OP_SUBMUL,
+	AP_OP_ADD_SHIFTED,
+	AP_OP_LINEAR_SUM,
+	AP_OP_PRODUCT,
+	AP_OP_POWM,
+	AP_OP_PRIME_TEST,
+	AP_OP_PRIME_GEN,
+	AP_OP_RANDOM,
+	AP_OP_RNS,
+	AP_OP_HASH,
+	AP_OP_SORT,
+	AP_OP_POLY,
+	AP_OP_RATIONAL,
+	AP_OP_FLOAT,
+	AP_OP_SERIES,
+	AP_OP_OTHER, //allocations outside any operation
+	AP_OP_COUNT
+} ApStatsOp;
+
+typedef struct {
+	uint64_t calls;
+	uint64_t cycles;
+	uint64_t allocs;
+	uint64_t bytes;
+	uint64_t sizes[AP_STATS_BUCKETS];
+} ApOpStats;
+
+/* Reporting (available in every build) */
+int apint_stats_enabled(void);
+void apint_stats_reset(void);
+void apint_stats_get(ApStatsOp op, ApOpStats *out);
+const char *apint_stats_op_name(ApStatsOp op);
+void apint_stats_dump(FILE *out);
+void apint_stats_dump_json(FILE *out);
+
+#ifdef APINT_STATS
+typedef struct {
+	ApStatsOp op;
+	ApStatsOp outer; //operation allocations went to before this one
+	uint64_t start;
+} ApStatsScope;
+
+ApStatsScope apint_stats_scope_begin(ApStatsOp op, size_t limbs);
+void apint_stats_scope_end(ApStatsScope *scope);
+void *apint_stats_malloc(size_t bytes);
+void *apint_stats_calloc(size_t count, size_t size);
+void *apint_stats_realloc(void *p, size_t bytes);
+
+/* Records the enclosing function as op until it returns, by any path */
+#define APINT_STATS_OP(op, limbs) \
+	__attribute__((cleanup(apint_stats_scope_end))) ApStatsScope apint_stats_scope_ = \
+		apint_stats_scope_begin(op, limbs)
+
+#ifndef APSTATS_NO_REDIRECT
+#define malloc(bytes) apint_stats_malloc(bytes)
+#define calloc(count, size) apint_stats_calloc(count, size)
+#define realloc(p, bytes) apint_stats_realloc(p, bytes)
+#endif
+#else
+#define APINT_STATS_OP(op, limbs) ((void) 0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APSTATS_H */
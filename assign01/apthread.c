@@ -0,0 +1,287 @@
+/*
+ * Thread pool for the ApInt library
+ * Work-stealing scheduler: every worker owns a deque, pushing and popping
+ * its own tasks at the bottom while idle workers steal from the top.
+ * Threads outside the pool push to a shared injection deque. Waiting
+ * threads run queued tasks instead of blocking, so nested fork/join
+ * (e.g. recursive Karatsuba) cannot deadlock.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include "apthread.h"
+
+#define DEFAULT_GRAIN 1024 //limbs
+
+typedef struct {
+	ApTask **items;
+	size_t head; //steal end
+	size_t tail; //owner end
+	size_t cap;
+	pthread_mutex_t lock;
+} ApDeque;
+
+static struct {
+	unsigned nworkers;
+	size_t grain;
+	pthread_t *threads;
+	ApDeque *deques; //nworkers + 1, the last one is the injection deque
+	pthread_mutex_t idle_lock;
+	pthread_cond_t idle_cond;
+	long queued;
+	int stop;
+} pool = { 0, DEFAULT_GRAIN, NULL, NULL, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0 };
+
+static _Thread_local int worker_id = -1; //index of this thread's deque, -1 outside the pool
+
+static void deque_init(ApDeque *d) {
+	d->cap = 64;
+	d->head = 0;
+	d->tail = 0;
+	d->items = (ApTask **)malloc(d->cap * sizeof(ApTask *));
+	assert(d->items != NULL); //check memory allocation
+	pthread_mutex_init(&d->lock, NULL);
+}
+
+static void deque_destroy(ApDeque *d) {
+	free(d->items);
+	pthread_mutex_destroy(&d->lock);
+}
+
+static void deque_push(ApDeque *d, ApTask *t) {
+	pthread_mutex_lock(&d->lock);
+	if (d->tail == d->cap) {
+		if (d->head > 0) { //slide live items down before growing
+			for (size_t i = d->head; i < d->tail; i++) {
+				d->items[i - d->head] = d->items[i];
+			}
+			d->tail -= d->head;
+			d->head = 0;
+		}
+		if (d->tail == d->cap) {
+			d->cap *= 2;
+			d->items = (ApTask **)realloc(d->items, d->cap * sizeof(ApTask *));
+			assert(d->items != NULL); //check memory allocation
+		}
+	}
+	d->items[d->tail++] = t;
+	pthread_mutex_unlock(&d->lock);
+}
+
+/* 
+ * Takes a task from the bottom (owner) or top (thief) of the deque
+ * Returns NULL if the deque is empty
+ */
+static ApTask *deque_take(ApDeque *d, int from_bottom) {
+	ApTask *t = NULL;
+	pthread_mutex_lock(&d->lock);
+	if (d->head < d->tail) {
+		t = from_bottom ? d->items[--d->tail] : d->items[d->head++];
+		if (d->head == d->tail) {
+			d->head = 0;
+			d->tail = 0;
+		}
+	}
+	pthread_mutex_unlock(&d->lock);
+	return t;
+}
+
+/* 
+ * Finds work for thread self: own deque first, then the injection deque,
+ * then steal from the other workers
+ */
+static ApTask *find_task(int self) {
+	ApTask *t = NULL;
+	if (__atomic_load_n(&pool.queued, __ATOMIC_ACQUIRE) == 0) {
+		return NULL;
+	}
+	if (self >= 0) {
+		t = deque_take(&pool.deques[self], 1);
+	}
+	if (t == NULL) {
+		t = deque_take(&pool.deques[pool.nworkers], 0);
+	}
+	for (unsigned i = 1; t == NULL && i <= pool.nworkers; i++) {
+		unsigned victim = (unsigned)(self + (int)i) % pool.nworkers;
+		if ((int)victim != self) {
+			t = deque_take(&pool.deques[victim], 0);
+		}
+	}
+	if (t != NULL) {
+		__atomic_sub_fetch(&pool.queued, 1, __ATOMIC_ACQ_REL);
+	}
+	return t;
+}
+
+static void run_task(ApTask *t) {
+	ApTaskGroup *g = t->group;
+	t->fn(t->arg);
+	__atomic_sub_fetch(&g->pending, 1, __ATOMIC_RELEASE); //t may be gone after this
+}
+
+static void *worker_main(void *arg) {
+	worker_id = (int)(size_t)arg;
+	for (;;) {
+		ApTask *t = find_task(worker_id);
+		if (t != NULL) {
+			run_task(t);
+			continue;
+		}
+		pthread_mutex_lock(&pool.idle_lock);
+		while (!pool.stop && __atomic_load_n(&pool.queued, __ATOMIC_ACQUIRE) == 0) {
+			pthread_cond_wait(&pool.idle_cond, &pool.idle_lock);
+		}
+		int stop = pool.stop;
+		pthread_mutex_unlock(&pool.idle_lock);
+		if (stop) {
+			return NULL;
+		}
+	}
+}
+
+/* 
+ * Starts the pool with nthreads threads in total (the calling thread
+ * counts as one since it runs tasks while waiting)
+ * nthreads <= 1 shuts the pool down and runs everything serially
+ */
+void apint_threads_init(unsigned nthreads) {
+	apint_threads_shutdown();
+	if (nthreads <= 1) {
+		return;
+	}
+	pool.nworkers = nthreads - 1;
+	pool.stop = 0;
+	pool.queued = 0;
+	pool.deques = (ApDeque *)malloc((pool.nworkers + 1) * sizeof(ApDeque));
+	pool.threads = (pthread_t *)malloc(pool.nworkers * sizeof(pthread_t));
+	assert(pool.deques != NULL && pool.threads != NULL); //check memory allocation
+	for (unsigned i = 0; i <= pool.nworkers; i++) {
+		deque_init(&pool.deques[i]);
+	}
+	for (unsigned i = 0; i < pool.nworkers; i++) {
+		pthread_create(&pool.threads[i], NULL, worker_main, (void *)(size_t)i);
+	}
+}
+
+/* 
+ * Stops and joins all workers
+ */
+void apint_threads_shutdown(void) {
+	if (pool.nworkers == 0) {
+		return;
+	}
+	pthread_mutex_lock(&pool.idle_lock);
+	pool.stop = 1;
+	pthread_cond_broadcast(&pool.idle_cond);
+	pthread_mutex_unlock(&pool.idle_lock);
+	for (unsigned i = 0; i < pool.nworkers; i++) {
+		pthread_join(pool.threads[i], NULL);
+	}
+	for (unsigned i = 0; i <= pool.nworkers; i++) {
+		deque_destroy(&pool.deques[i]);
+	}
+	free(pool.deques);
+	free(pool.threads);
+	pool.deques = NULL;
+	pool.threads = NULL;
+	pool.nworkers = 0;
+}
+
+/* 
+ * Returns total number of threads running pool tasks (1 when serial)
+ */
+unsigned apint_threads_count(void) {
+	return pool.nworkers + 1;
+}
+
+int apint_threads_active(void) {
+	return pool.nworkers > 0;
+}
+
+/* 
+ * Sets the operand size (in limbs) from which operations fork tasks
+ */
+void apint_threads_set_grain(size_t limbs) {
+	pool.grain = (limbs > 0) ? limbs : 1;
+}
+
+size_t apint_threads_grain(void) {
+	return pool.grain;
+}
+
+void apint_task_group_init(ApTaskGroup *g) {
+	g->pending = 0;
+}
+
+/* 
+ * Queues fn(arg) on the pool, or runs it right away when the pool is off
+ */
+void apint_task_spawn(ApTaskGroup *g, ApTask *t, void (*fn)(void *arg), void *arg) {
+	t->fn = fn;
+	t->arg = arg;
+	t->group = g;
+	if (pool.nworkers == 0) {
+		fn(arg);
+		return;
+	}
+	__atomic_add_fetch(&g->pending, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&pool.queued, 1, __ATOMIC_RELEASE); //counted before it is visible, so never negative
+	deque_push(&pool.deques[worker_id >= 0 ? (unsigned)worker_id : pool.nworkers], t);
+	pthread_mutex_lock(&pool.idle_lock); //pairs with the check in worker_main, no lost wakeups
+	pthread_cond_signal(&pool.idle_cond);
+	pthread_mutex_unlock(&pool.idle_lock);
+}
+
+/* 
+ * Returns once every task of g has finished, running queued tasks meanwhile
+ */
+void apint_task_wait(ApTaskGroup *g) {
+	while (__atomic_load_n(&g->pending, __ATOMIC_ACQUIRE) > 0) {
+		ApTask *t = find_task(worker_id);
+		if (t != NULL) {
+			run_task(t);
+		} else {
+			sched_yield();
+		}
+	}
+}
+
+typedef struct {
+	void (*fn)(void *arg, size_t lo, size_t hi);
+	void *arg;
+	size_t lo, hi, grain;
+} ParallelRange;
+
+/* 
+ * Splits the range in halves until it is at most grain long, so idle
+ * workers steal the large outer halves first
+ */
+static void parallel_range(void *p) {
+	ParallelRange *r = (ParallelRange *)p;
+	if (r->hi - r->lo <= r->grain || pool.nworkers == 0) {
+		r->fn(r->arg, r->lo, r->hi);
+		return;
+	}
+	size_t mid = r->lo + (r->hi - r->lo) / 2;
+	ParallelRange left = { r->fn, r->arg, r->lo, mid, r->grain };
+	ParallelRange right = { r->fn, r->arg, mid, r->hi, r->grain };
+	ApTaskGroup g;
+	ApTask t;
+	apint_task_group_init(&g);
+	apint_task_spawn(&g, &t, parallel_range, &left);
+	parallel_range(&right);
+	apint_task_wait(&g);
+}
+
+/* 
+ * Calls fn(arg, lo, hi) over disjoint subranges covering [0, n)
+ */
+void apint_parallel_for(size_t n, size_t grain, void (*fn)(void *arg, size_t lo, size_t hi), void *arg) {
+	if (n == 0) {
+		return;
+	}
+	ParallelRange r = { fn, arg, 0, n, (grain > 0) ? grain : 1 };
+	parallel_range(&r);
+}
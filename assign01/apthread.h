@@ -0,0 +1,65 @@
+/*
+ * Optional thread pool for the ApInt library
+ *
+ * Large multiplications and product trees fork their independent
+ * sub-products onto this pool when it has been started with
+ * apint_threads_init and the operands are at least the grain size.
+ * Without a pool (the default) everything runs on the calling thread.
+ *
+ * Threading model: any number of threads may run operations at once,
+ * with or without the pool. An ApInt may be read by many threads but
+ * written by one at a time; copies share data through atomic reference
+ * counts, so copying a shared value is safe. Tables the library needs
+ * (the small primes in apprime.c) are immutable once built and built
+ * lazily under pthread_once. Temporaries come from a per-thread scratch
+ * arena (apint_scratch_acquire), so operations never share scratch
+ * memory. Statistics counters are relaxed atomics. Configuration calls
+ * (apint_threads_init, apint_cpu_set_tier, apint_stats_reset) are the
+ * exceptions and must not overlap running operations.
+ */
+
+#ifndef APTHREAD_H
+#define APTHREAD_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Group of spawned tasks that can be waited for together
+ */
+typedef struct {
+	long pending;
+} ApTaskGroup;
+
+/*
+ * A spawned task; storage is provided by the spawner and must stay
+ * valid until apint_task_wait on its group returns
+ */
+typedef struct ApTask {
+	void (*fn)(void *arg);
+	void *arg;
+	ApTaskGroup *group;
+} ApTask;
+
+/* Pool configuration (not safe to call while operations are running) */
+void apint_threads_init(unsigned nthreads);
+void apint_threads_shutdown(void);
+unsigned apint_threads_count(void);
+int apint_threads_active(void);
+void apint_threads_set_grain(size_t limbs);
+size_t apint_threads_grain(void);
+
+/* Fork/join */
+void apint_task_group_init(ApTaskGroup *g);
+void apint_task_spawn(ApTaskGroup *g, ApTask *t, void (*fn)(void *arg), void *arg);
+void apint_task_wait(ApTaskGroup *g);
+void apint_parallel_for(size_t n, size_t grain, void (*fn)(void *arg, size_t lo, size_t hi), void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APTHREAD_H */
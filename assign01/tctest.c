@@ -23,6 +23,8 @@
  */
 
 #include <signal.h>
+#include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include "tctest.h"
 
@@ -48,6 +50,28 @@ int tctest_num_executed;
 const char *tctest_testname_to_execute;
 void (*tctest_on_test_executed)(const char *testname, int passed);
 void (*tctest_on_complete)(int num_passed, int num_executed);
+int tctest_runs;
+double tctest_threshold = 25.0;
+long (*tctest_alloc_count)(void);
+
+typedef struct {
+	char name[128];
+	double min_ms;
+	double median_ms;
+	long allocs;
+} tctest_baseline_entry;
+
+/* differences below this are timer noise, not regressions */
+#define TCTEST_SLACK_MS 0.1
+
+static tctest_baseline_entry *tctest_baseline;
+static int tctest_baseline_len;
+static FILE *tctest_save_file;
+static double *tctest_samples;
+static int tctest_runs_done;
+static long tctest_allocs;
+static struct timespec tctest_run_start;
+static long tctest_run_start_allocs;
 
 /*
  * Special version of write to work around the fact that
@@ -138,3 +162,141 @@ void tctest_register_signal_handlers(void) {
 		sigaction(tctest_signal_list[i].signum, &sa, NULL);
 	}
 }
+
+static void tctest_load_baseline(const char *path) {
+	FILE *in = fopen(path, "r");
+	if (in == NULL) {
+		printf("tctest: cannot read baseline %s\n", path);
+		return;
+	}
+	tctest_baseline_entry e;
+	while (fscanf(in, "%127s %lf %lf %ld", e.name, &e.min_ms, &e.median_ms, &e.allocs) == 4) {
+		tctest_baseline_entry *grown = realloc(tctest_baseline, (tctest_baseline_len + 1) * sizeof(e));
+		if (grown == NULL) {
+			break;
+		}
+		tctest_baseline = grown;
+		tctest_baseline[tctest_baseline_len++] = e;
+	}
+	fclose(in);
+}
+
+static void tctest_close_save_file(void) {
+	fclose(tctest_save_file);
+}
+
+/*
+ * Reads the TCTEST_* environment variables described in tctest.h
+ */
+void tctest_init_timing(void) {
+	const char *runs = getenv("TCTEST_RUNS");
+	const char *threshold = getenv("TCTEST_THRESHOLD");
+	const char *baseline = getenv("TCTEST_BASELINE");
+	const char *save = getenv("TCTEST_SAVE_BASELINE");
+
+	if (runs != NULL) {
+		tctest_runs = atoi(runs);
+	}
+	if (threshold != NULL) {
+		tctest_threshold = atof(threshold);
+	}
+	if (tctest_runs <= 0) {
+		return;
+	}
+	if (baseline != NULL) {
+		tctest_load_baseline(baseline);
+	}
+	if (save != NULL) {
+		tctest_save_file = fopen(save, "w");
+		if (tctest_save_file == NULL) {
+			printf("tctest: cannot write baseline %s\n", save);
+		} else {
+			atexit(tctest_close_save_file);
+		}
+	}
+	tctest_samples = malloc(tctest_runs * sizeof(double));
+	if (tctest_samples == NULL) {
+		tctest_runs = 0;
+	}
+}
+
+void tctest_timing_begin(void) {
+	tctest_runs_done = 0;
+	tctest_allocs = 0;
+}
+
+void tctest_run_begin(void) {
+	if (tctest_runs > 0) {
+		tctest_run_start_allocs = tctest_alloc_count ? tctest_alloc_count() : 0;
+		clock_gettime(CLOCK_MONOTONIC, &tctest_run_start);
+	}
+}
+
+void tctest_run_end(void) {
+	if (tctest_runs > 0) {
+		struct timespec end;
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		tctest_samples[tctest_runs_done] = (end.tv_sec - tctest_run_start.tv_sec) * 1e3
+			+ (end.tv_nsec - tctest_run_start.tv_nsec) / 1e6;
+		if (tctest_alloc_count) {
+			//a counter that went backwards was reset by the test itself
+			tctest_allocs = tctest_alloc_count() - tctest_run_start_allocs;
+			tctest_allocs = (tctest_allocs < 0) ? -1 : tctest_allocs;
+		}
+	}
+	tctest_runs_done++;
+}
+
+/*
+ * True while a timed test still has runs to do
+ */
+int tctest_timing_more(void) {
+	return tctest_runs_done < tctest_runs;
+}
+
+static int tctest_compare_samples(const void *left, const void *right) {
+	double l = *(const double *)left, r = *(const double *)right;
+	return (l > r) - (l < r);
+}
+
+/*
+ * Prints the timings of the test that just ran, records them, and fails
+ * the test (as FAIL does) if it regressed against the baseline
+ */
+void tctest_timing_end(const char *testname) {
+	if (tctest_runs <= 0) {
+		return;
+	}
+	qsort(tctest_samples, tctest_runs, sizeof(double), tctest_compare_samples);
+	double min_ms = tctest_samples[0];
+	double median_ms = (tctest_runs % 2) ? tctest_samples[tctest_runs / 2]
+		: (tctest_samples[tctest_runs / 2 - 1] + tctest_samples[tctest_runs / 2]) / 2;
+	long allocs = tctest_alloc_count ? tctest_allocs : -1; //-1 when not counted
+
+	printf("min %.3f ms, median %.3f ms", min_ms, median_ms);
+	if (allocs >= 0) {
+		printf(", %ld allocs", allocs);
+	}
+	printf("...");
+	if (tctest_save_file != NULL) {
+		fprintf(tctest_save_file, "%s %.6f %.6f %ld\n", testname, min_ms, median_ms, allocs);
+		fflush(tctest_save_file);
+	}
+
+	double limit = 1.0 + tctest_threshold / 100.0;
+	for (int i = 0; i < tctest_baseline_len; i++) {
+		tctest_baseline_entry *e = &tctest_baseline[i];
+		if (strcmp(e->name, testname) != 0) {
+			continue;
+		}
+		if (min_ms > e->min_ms * limit + TCTEST_SLACK_MS) {
+			printf("slower than baseline %.3f ms\n", e->min_ms);
+			siglongjmp(tctest_env, 1);
+		}
+		if (allocs >= 0 && e->allocs >= 0 && allocs > e->allocs * limit) {
+			printf("more allocations than baseline %ld\n", e->allocs);
+			siglongjmp(tctest_env, 1);
+		}
+		break;
+	}
+}
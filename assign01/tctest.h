@@ -65,8 +65,38 @@ extern void (*tctest_on_test_executed)(const char *testname, int passed);
  */
 extern void (*tctest_on_complete)(int num_passed, int num_executed);
 
+/*
+ * Timed mode: when tctest_runs is greater than zero, each test is run
+ * that many times (with a fresh setup each time) and its minimum and
+ * median wall time are printed. If tctest_alloc_count is set, it should
+ * return a running count of allocations, and the allocations made by
+ * one run are printed too. These are set from the environment by
+ * TEST_INIT:
+ *
+ *   TCTEST_RUNS=n             run each test n times
+ *   TCTEST_BASELINE=file      fail a test whose minimum time (or
+ *                             allocation count) exceeds its entry in
+ *                             file by more than the threshold (and
+ *                             the time by more than 0.1 ms)
+ *   TCTEST_THRESHOLD=percent  allowed slowdown, default 25
+ *   TCTEST_SAVE_BASELINE=file write "name min_ms median_ms allocs"
+ *                             lines for the tests that ran
+ *
+ * The minimum is compared because it is the least noisy of the two.
+ */
+extern int tctest_runs;
+extern double tctest_threshold;
+extern long (*tctest_alloc_count)(void);
+void tctest_init_timing(void);
+void tctest_timing_begin(void);
+void tctest_run_begin(void);
+void tctest_run_end(void);
+int tctest_timing_more(void);
+void tctest_timing_end(const char *testname);
+
 #define TEST_INIT() do { \
 	tctest_register_signal_handlers(); \
+	tctest_init_timing(); \
 } while (0)
 
 #define TEST(func) do { \
@@ -74,11 +104,17 @@ extern void (*tctest_on_complete)(int num_passed, int num_executed);
 		tctest_num_executed++; \
 		tctest_assertion_line = -1; \
 		if (sigsetjmp(tctest_env, 1) == 0) { \
-			TestObjs *t = setup(); \
 			printf("%s...", #func); \
 			fflush(stdout); \
-			func(t); \
-			cleanup(t); \
+			tctest_timing_begin(); \
+			do { \
+				TestObjs *t = setup(); \
+				tctest_run_begin(); \
+				func(t); \
+				tctest_run_end(); \
+				cleanup(t); \
+			} while (tctest_timing_more()); \
+			tctest_timing_end(#func); \
 			printf("passed!\n"); \
 			if (tctest_on_test_executed) { \
 				tctest_on_test_executed(#func, 1); \